@@ -58,16 +58,52 @@
 
 #define netifMAX_MTU 1500
 
+/* Received frames are read out of the MAC straight into one of
+netifNUM_RX_BUFFERS driver owned buffers, which is then passed up the stack as
+a custom pbuf.  The buffer is returned to the driver when the stack frees the
+pbuf.  Only if every buffer is still held by the stack is the frame copied
+into a PBUF_POOL chain instead. */
+#ifndef netifNUM_RX_BUFFERS
+	#define netifNUM_RX_BUFFERS		( 4 )
+#endif
+
+/* Large enough for a maximum sized frame plus the padding word. */
+#define netifRX_BUFFER_SIZE			( 1520 + ETH_PAD_SIZE )
+
+#if !LWIP_SUPPORT_CUSTOM_PBUF
+	#error This driver requires LWIP_SUPPORT_CUSTOM_PBUF to be set to 1 in lwipopts.h.
+#endif
+
 struct xEthernetIf
 {
 	struct eth_addr *ethaddr;
 	/* Add whatever per-interface state that is needed here. */
 };
 
+/* A driver owned receive buffer.  xPbuf must be the first member as the
+pbuf passed to prvFreeRxBuffer() is cast back to the buffer that holds it. */
+struct xRxBuffer
+{
+	struct pbuf_custom xPbuf;
+	struct xRxBuffer *pxNext;
+	unsigned char ucData[ netifRX_BUFFER_SIZE ] __attribute__((aligned(32)));
+};
+
+/*
+ * Read the next frame from the MAC into a pbuf.
+ */
+static struct pbuf *prvLowLevelInput( void );
+
+/*
+ * Copy a frame that could not be given a driver buffer into a pbuf chain.
+ */
+static struct pbuf *prvCopyToPool( const unsigned char * const pucInputData, unsigned short usDataLength );
+
 /*
- * Copy the received data into a pbuf.
+ * Take a receive buffer from the free list, or return one to it.
  */
-static struct pbuf *prvLowLevelInput( const unsigned char * const pucInputData, unsigned short usDataLength );
+static struct xRxBuffer *prvTakeRxBuffer( void );
+static void prvFreeRxBuffer( struct pbuf *p );
 
 /*
  * Send data from a pbuf to the hardware.
@@ -92,6 +128,11 @@ static void prvTxHandler( void *pvUnused );
 /* The instance of the xEmacLite IP being used in this driver. */
 static XEmacLite xEMACInstance;
 
+/* The receive buffers, and the list of those not currently held by the
+stack. */
+static struct xRxBuffer xRxBuffers[ netifNUM_RX_BUFFERS ];
+static struct xRxBuffer *pxFreeRxBuffers = NULL;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -106,6 +147,7 @@ static void prvLowLevelInit( struct netif *pxNetIf )
 portBASE_TYPE xStatus;
 extern void vInitialisePHY( XEmacLite *xemaclitep );
 unsigned portBASE_TYPE uxOriginalPriority;
+long x;
 
 	/* Hardware initialisation can take some time, so temporarily lower the
 	task priority to ensure other functionality is not adversely effected.
@@ -133,6 +175,15 @@ unsigned portBASE_TYPE uxOriginalPriority;
 	/* Broadcast capability */
 	pxNetIf->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
 
+	/* Place every receive buffer on the free list before the Rx interrupt
+	can start taking them. */
+	for( x = 0; x < netifNUM_RX_BUFFERS; x++ )
+	{
+		xRxBuffers[ x ].xPbuf.custom_free_function = prvFreeRxBuffer;
+		xRxBuffers[ x ].pxNext = pxFreeRxBuffers;
+		pxFreeRxBuffers = &( xRxBuffers[ x ] );
+	}
+
 	/* Initialize the mac */
 	xStatus = XEmacLite_Initialize( &xEMACInstance, XPAR_EMACLITE_0_DEVICE_ID );
 
@@ -184,6 +235,11 @@ unsigned portBASE_TYPE uxOriginalPriority;
  *	   strange results. You might consider waiting for space in the DMA queue
  *	   to become availale since the stack doesn't retry to send a packet
  *	   dropped because of memory failure (except for the TCP timers).
+ *
+ * @note The Ethernet Lite MAC has neither DMA nor scatter-gather, and
+ *	   XEmacLite_Send() always copies the frame into the MAC's own buffer.  A
+ *	   single pbuf is passed to it directly.  A chain has to be gathered into
+ *	   a contiguous buffer first, which is counted in link.copy.
  */
 
 static err_t prvLowLevelOutput( struct netif *pxNetIf, struct pbuf *p )
@@ -245,6 +301,8 @@ long x;
 					pucChar += q->len;
 				}
 			}
+
+			LINK_STATS_INC( link.copy );
 		}
 	}
 
@@ -292,22 +350,85 @@ long x;
 	return xReturn;
 }
 
+/**
+ * Read the next frame out of the MAC.  The frame is read straight into a
+ * driver owned buffer that is handed to the stack as a custom pbuf, so the
+ * only copy made is the one out of the MAC's own buffer.  If every driver
+ * buffer is still held by the stack the frame is copied into a PBUF_POOL
+ * chain instead, and counted in link.copy.
+ *
+ * @return a pbuf filled with the received packet (including MAC header)
+ *		 NULL if there was no frame or on memory error
+ */
+static struct pbuf *prvLowLevelInput( void )
+{
+static unsigned char ucBuffer[ netifRX_BUFFER_SIZE ] __attribute__((aligned(32)));
+struct xRxBuffer *pxBuffer;
+struct pbuf *p = NULL;
+unsigned short usDataLength;
+
+	pxBuffer = prvTakeRxBuffer();
+
+	if( pxBuffer != NULL )
+	{
+		/* Leave room for the padding word in front of the frame. */
+		usDataLength = ( unsigned short ) XEmacLite_Recv( &xEMACInstance, &( pxBuffer->ucData[ ETH_PAD_SIZE ] ) );
+
+		if( usDataLength > 0U )
+		{
+			/* PBUF_RAM rather than PBUF_REF so the stack can move the payload
+			pointer back over headers it has already stripped, as it does to
+			turn an ICMP echo request around in place. */
+			p = pbuf_alloced_custom( PBUF_RAW, usDataLength + ETH_PAD_SIZE, PBUF_RAM, &( pxBuffer->xPbuf ), pxBuffer->ucData, sizeof( pxBuffer->ucData ) );
+		}
+
+		if( p == NULL )
+		{
+			prvFreeRxBuffer( &( pxBuffer->xPbuf.pbuf ) );
+		}
+	}
+	else
+	{
+		usDataLength = ( unsigned short ) XEmacLite_Recv( &xEMACInstance, ucBuffer );
+		p = prvCopyToPool( ucBuffer, usDataLength );
+
+		if( p != NULL )
+		{
+			LINK_STATS_INC( link.copy );
+		}
+		else if( usDataLength > 0U )
+		{
+			LINK_STATS_INC( link.memerr );
+			LINK_STATS_INC( link.drop );
+		}
+	}
+
+	if( p != NULL )
+	{
+		LINK_STATS_INC( link.recv );
+	}
+
+	return p;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
  *
- * @param pxNetIf the lwip network interface structure for this etherpxNetIf
+ * @param pucInputData the received frame
+ * @param usDataLength the length of the received frame
  * @return a pbuf filled with the received packet (including MAC header)
  *		 NULL on memory error
  */
-static struct pbuf *prvLowLevelInput( const unsigned char * const pucInputData, unsigned short usDataLength )
+static struct pbuf *prvCopyToPool( const unsigned char * const pucInputData, unsigned short usDataLength )
 {
 struct pbuf *p = NULL, *q;
 
 	if( usDataLength > 0U )
 	{
 		#if ETH_PAD_SIZE
-			len += ETH_PAD_SIZE; /* allow room for Ethernet padding */
+			usDataLength += ETH_PAD_SIZE; /* allow room for Ethernet padding */
 		#endif
 
 		/* We allocate a pbuf chain of pbufs from the pool. */
@@ -326,12 +447,7 @@ struct pbuf *p = NULL, *q;
 			{
 				/* Read enough bytes to fill this pbuf in the chain. The
 				* available data in the pbuf is given by the q->len
-				* variable.
-				* This does not necessarily have to be a memcpy, you can also preallocate
-				* pbufs for a DMA-enabled MAC and after receiving truncate it to the
-				* actually received size. In this case, ensure the usTotalLength member of the
-				* pbuf is the sum of the chained pbuf len members.
-				*/
+				* variable. */
 				memcpy( q->payload, &( pucInputData[ usDataLength ] ), q->len );
 				usDataLength += q->len;
 			}
@@ -339,13 +455,47 @@ struct pbuf *p = NULL, *q;
 			#if ETH_PAD_SIZE
 				pbuf_header( p, ETH_PAD_SIZE ); /* reclaim the padding word */
 			#endif
-
-			LINK_STATS_INC(link.recv);
 		}
 	}
 
 	return p;  
 }
+/*-----------------------------------------------------------*/
+
+static struct xRxBuffer *prvTakeRxBuffer( void )
+{
+struct xRxBuffer *pxBuffer;
+SYS_ARCH_DECL_PROTECT( xLevel );
+
+	SYS_ARCH_PROTECT( xLevel );
+	{
+		pxBuffer = pxFreeRxBuffers;
+		if( pxBuffer != NULL )
+		{
+			pxFreeRxBuffers = pxBuffer->pxNext;
+		}
+	}
+	SYS_ARCH_UNPROTECT( xLevel );
+
+	return pxBuffer;
+}
+/*-----------------------------------------------------------*/
+
+static void prvFreeRxBuffer( struct pbuf *p )
+{
+struct xRxBuffer *pxBuffer = ( struct xRxBuffer * ) p;
+SYS_ARCH_DECL_PROTECT( xLevel );
+
+	/* Called by pbuf_free(), from either a task or the Rx interrupt, once
+	the stack has finished with the frame. */
+	SYS_ARCH_PROTECT( xLevel );
+	{
+		pxBuffer->pxNext = pxFreeRxBuffers;
+		pxFreeRxBuffers = pxBuffer;
+	}
+	SYS_ARCH_UNPROTECT( xLevel );
+}
+/*-----------------------------------------------------------*/
 
 /**
  * Should be called at the beginning of the program to set up the
@@ -416,8 +566,6 @@ static void prvRxHandler( void *pvNetIf )
 
 struct eth_hdr *pxHeader;
 struct pbuf *p;
-unsigned short usInputLength;
-static unsigned char ucBuffer[ 1520 ] __attribute__((aligned(32)));
 extern portBASE_TYPE xInsideISR;
 struct netif *pxNetIf = ( struct netif * ) pvNetIf;
 
@@ -427,10 +575,8 @@ struct netif *pxNetIf = ( struct netif * ) pvNetIf;
 	sections. */
 	xInsideISR++;
 
-	usInputLength = ( long ) XEmacLite_Recv( &xEMACInstance, ucBuffer );
-
-	/* move received packet into a new pbuf */
-	p = prvLowLevelInput( ucBuffer, usInputLength );
+	/* move received packet into a pbuf */
+	p = prvLowLevelInput();
 
 	/* no packet could be read, silently ignore this */
 	if( p != NULL )
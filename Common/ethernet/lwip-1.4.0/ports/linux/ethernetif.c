@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+
+/*
+ * Linux host ethernetif: the stack runs as a process on a developer box or a
+ * CI machine, with no hardware, e.g. for throughput, latency and connection
+ * scaling benchmarks.
+ *
+ * Frames go through either
+ * - a TAP device (netifLINUX_USE_TAP 1, the default), created by the
+ *   administrator and configured like any other interface:
+ *       ip tuntap add dev tap0 mode tap user $USER
+ *       ip addr add 192.168.0.1/24 dev tap0
+ *       ip link set tap0 up
+ *   lwIP is then another host on 192.168.0.0/24, or
+ * - an AF_PACKET socket bound to an existing interface (netifLINUX_USE_TAP 0,
+ *   needs CAP_NET_RAW), which is put in promiscuous mode as lwIP has a MAC
+ *   address of its own.  If the peer is on the same host (e.g. the other end
+ *   of a veth pair), turn its transmit checksum offload off
+ *   (ethtool -K veth0 tx off) as lwIP checks the checksums.
+ *
+ * The device name is the state pointer passed to netif_add(), or
+ * netifLINUX_DEVICE if that is NULL.
+ *
+ * A receive thread reads up to netifRX_BATCH frames per system call
+ * (recvmmsg() for AF_PACKET, a poll() then reads until empty for TAP)
+ * straight into pool pbufs, which are handed to netif->input, i.e.
+ * tcpip_input().  Frames are sent with one writev() over the pbuf chain.
+ *
+ * Pbufs are allocated outside the tcpip thread, so lwipopts.h must set
+ * SYS_LIGHTWEIGHT_PROT to 1.
+ *
+ * With TCP_GSO, every frame carries a virtio-net header (IFF_VNET_HDR for
+ * TAP, PACKET_VNET_HDR for AF_PACKET) and large TCP segments are passed to
+ * the kernel whole, which cuts them up and fills in the checksums, like a
+ * MAC with TCP segmentation offload would.
+ */
+
+/* recvmmsg() */
+#ifndef _GNU_SOURCE
+	#define _GNU_SOURCE
+#endif
+
+/* Standard includes. */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+
+/* lwIP includes. */
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/mem.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/tcp_impl.h"
+#include <lwip/stats.h>
+#include <lwip/snmp.h>
+#include "netif/etharp.h"
+
+#if !SYS_LIGHTWEIGHT_PROT
+	#error "The Linux ethernetif allocates pbufs in its own thread, set SYS_LIGHTWEIGHT_PROT to 1"
+#endif
+
+/* Define those to better describe your network interface. */
+#define IFNAME0 't'
+#define IFNAME1 'p'
+
+#define netifMAX_MTU 1500
+
+/* Largest frame received or sent: MTU, Ethernet header and a VLAN tag. */
+#define netifMAX_FRAME ( netifMAX_MTU + 18 )
+
+/* Largest frame sent, the kernel cuts up large TCP segments.  Frames
+start with a virtio-net header then, in an iovec of its own. */
+#if TCP_GSO
+	#define netifMAX_TX_FRAME ( SIZEOF_ETH_HDR - ETH_PAD_SIZE + 0xffff )
+	#define netifVNET_IOV 1
+	#define netifVNET_HDR_SIZE sizeof( struct virtio_net_hdr )
+#else
+	#define netifMAX_TX_FRAME netifMAX_FRAME
+	#define netifVNET_IOV 0
+	#define netifVNET_HDR_SIZE 0
+#endif
+
+/* Configuration, lwipopts.h may override these. */
+#ifndef netifLINUX_DEVICE
+	#define netifLINUX_DEVICE "tap0"
+#endif
+
+#ifndef netifLINUX_USE_TAP
+	#define netifLINUX_USE_TAP 1
+#endif
+
+/* Frames read per system call. */
+#ifndef netifRX_BATCH
+	#define netifRX_BATCH 32
+#endif
+
+/* Most pbufs in a received or sent frame, more are copied when sending. */
+#ifndef netifMAX_IOV
+	#define netifMAX_IOV 8
+#endif
+
+/* Locally administered address. */
+#ifndef netifMAC_ADDR0
+	#define netifMAC_ADDR0 0x02
+	#define netifMAC_ADDR1 0x00
+	#define netifMAC_ADDR2 0x00
+	#define netifMAC_ADDR3 0x12
+	#define netifMAC_ADDR4 0x34
+	#define netifMAC_ADDR5 0x56
+#endif
+
+struct xEthernetIf
+{
+	struct eth_addr *ethaddr;
+	/* TAP device or AF_PACKET socket. */
+	int iFd;
+	/* Pbufs the next frames are read into, NULL once passed to the stack. */
+	struct pbuf *pxRxPbufs[ netifRX_BATCH ];
+};
+
+/*
+ * Pass a received frame to the tcpip task, or drop it if it is not IP or
+ * ARP.
+ */
+static void prvEthernetInput( struct netif *pxNetIf, struct pbuf *p );
+
+/*
+ * Send data from a pbuf to the device.
+ */
+static err_t prvLowLevelOutput( struct netif *pxNetIf, struct pbuf *p );
+
+/*
+ * Open the device and start the receive thread.
+ */
+static err_t prvLowLevelInit( struct netif *pxNetIf, const char *pcDevice );
+
+/*
+ * Open a TAP device or an AF_PACKET socket, return the file descriptor or -1.
+ */
+#if netifLINUX_USE_TAP
+	static int prvOpenTap( const char *pcDevice );
+#else
+	static int prvOpenPacketSocket( const char *pcDevice );
+#endif
+
+/*
+ * Point up to netifMAX_IOV entries of pxIov at the frame part of a pbuf
+ * chain.  Returns the number of entries used, 0 if there are not enough.
+ */
+static int prvPbufToIovec( struct pbuf *p, struct iovec *pxIov );
+
+/*
+ * Fill in the virtio-net header of a frame to send: asks the kernel to cut
+ * up a large TCP segment (p->gso_size) and to finish its checksum.
+ */
+#if TCP_GSO
+	static void prvSetVnetHeader( struct pbuf *p, struct virtio_net_hdr *pxVnetHeader );
+#endif
+
+/*
+ * Reads frames in batches and passes them to prvEthernetInput().
+ */
+static void prvReceiveThread( void *pvParameters );
+
+/*-----------------------------------------------------------*/
+
+#if netifLINUX_USE_TAP
+
+static int prvOpenTap( const char *pcDevice )
+{
+struct ifreq xRequest;
+int iFd;
+
+	iFd = open( "/dev/net/tun", O_RDWR | O_NONBLOCK );
+	if( iFd < 0 )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: cannot open /dev/net/tun: %s\n", strerror( errno ) ) );
+		return -1;
+	}
+
+	/* Ethernet frames, without the packet information header. */
+	memset( &xRequest, 0, sizeof( xRequest ) );
+	xRequest.ifr_flags = IFF_TAP | IFF_NO_PI;
+	#if TCP_GSO
+	{
+		/* Each frame starts with a struct virtio_net_hdr. */
+		xRequest.ifr_flags |= IFF_VNET_HDR;
+	}
+	#endif
+	strncpy( xRequest.ifr_name, pcDevice, IFNAMSIZ - 1 );
+
+	if( ioctl( iFd, TUNSETIFF, &xRequest ) < 0 )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: cannot attach to %s: %s\n", pcDevice, strerror( errno ) ) );
+		close( iFd );
+		return -1;
+	}
+
+	return iFd;
+}
+/*-----------------------------------------------------------*/
+
+#else /* netifLINUX_USE_TAP */
+
+static int prvOpenPacketSocket( const char *pcDevice )
+{
+struct sockaddr_ll xAddress;
+struct packet_mreq xMembership;
+int iFd;
+
+	iFd = socket( AF_PACKET, SOCK_RAW, htons( ETH_P_ALL ) );
+	if( iFd < 0 )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: cannot open a packet socket: %s\n", strerror( errno ) ) );
+		return -1;
+	}
+
+	memset( &xAddress, 0, sizeof( xAddress ) );
+	xAddress.sll_family = AF_PACKET;
+	xAddress.sll_protocol = htons( ETH_P_ALL );
+	xAddress.sll_ifindex = ( int ) if_nametoindex( pcDevice );
+
+	memset( &xMembership, 0, sizeof( xMembership ) );
+	xMembership.mr_ifindex = xAddress.sll_ifindex;
+	xMembership.mr_type = PACKET_MR_PROMISC;
+
+	if( ( xAddress.sll_ifindex == 0 ) ||
+		( bind( iFd, ( struct sockaddr * ) &xAddress, sizeof( xAddress ) ) < 0 ) ||
+		( setsockopt( iFd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &xMembership, sizeof( xMembership ) ) < 0 ) )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: cannot bind to %s: %s\n", pcDevice, strerror( errno ) ) );
+		close( iFd );
+		return -1;
+	}
+
+	#if TCP_GSO
+	{
+		/* Each frame starts with a struct virtio_net_hdr. */
+		int iOne = 1;
+
+		if( setsockopt( iFd, SOL_PACKET, PACKET_VNET_HDR, &iOne, sizeof( iOne ) ) < 0 )
+		{
+			LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: no PACKET_VNET_HDR: %s\n", strerror( errno ) ) );
+			close( iFd );
+			return -1;
+		}
+	}
+	#endif
+
+	#ifdef PACKET_IGNORE_OUTGOING
+	{
+		/* Our own frames are also filtered by sll_pkttype on older kernels. */
+		int iOne = 1;
+
+		setsockopt( iFd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &iOne, sizeof( iOne ) );
+	}
+	#endif
+
+	return iFd;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* netifLINUX_USE_TAP */
+
+static err_t prvLowLevelInit( struct netif *pxNetIf, const char *pcDevice )
+{
+struct xEthernetIf *pxEthernetIf = pxNetIf->state;
+
+	/* set MAC hardware address length */
+	pxNetIf->hwaddr_len = ETHARP_HWADDR_LEN;
+
+	/* set MAC hardware address */
+	pxNetIf->hwaddr[ 0 ] = netifMAC_ADDR0;
+	pxNetIf->hwaddr[ 1 ] = netifMAC_ADDR1;
+	pxNetIf->hwaddr[ 2 ] = netifMAC_ADDR2;
+	pxNetIf->hwaddr[ 3 ] = netifMAC_ADDR3;
+	pxNetIf->hwaddr[ 4 ] = netifMAC_ADDR4;
+	pxNetIf->hwaddr[ 5 ] = netifMAC_ADDR5;
+
+	/* device capabilities */
+	/* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
+	pxNetIf->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP | NETIF_FLAG_LINK_UP;
+
+	#if netifLINUX_USE_TAP
+		pxEthernetIf->iFd = prvOpenTap( pcDevice );
+	#else
+		pxEthernetIf->iFd = prvOpenPacketSocket( pcDevice );
+	#endif
+
+	if( pxEthernetIf->iFd < 0 )
+	{
+		return ERR_IF;
+	}
+
+	memset( pxEthernetIf->pxRxPbufs, 0, sizeof( pxEthernetIf->pxRxPbufs ) );
+	sys_thread_new( "eth_rx", prvReceiveThread, pxNetIf, 0, 0 );
+
+	return ERR_OK;
+}
+/*-----------------------------------------------------------*/
+
+static int prvPbufToIovec( struct pbuf *p, struct iovec *pxIov )
+{
+struct pbuf *q;
+int iCount = 0;
+
+	for( q = p; q != NULL; q = q->next )
+	{
+		if( iCount == netifMAX_IOV )
+		{
+			return 0;
+		}
+
+		pxIov[ iCount ].iov_base = q->payload;
+		pxIov[ iCount ].iov_len = q->len;
+
+		/* The padding word is not part of the frame. */
+		if( q == p )
+		{
+			pxIov[ iCount ].iov_base = ( char * ) q->payload + ETH_PAD_SIZE;
+			pxIov[ iCount ].iov_len -= ETH_PAD_SIZE;
+		}
+
+		iCount++;
+
+		if( q->len == q->tot_len )
+		{
+			break;
+		}
+	}
+
+	return iCount;
+}
+/*-----------------------------------------------------------*/
+
+#if TCP_GSO
+
+static void prvSetVnetHeader( struct pbuf *p, struct virtio_net_hdr *pxVnetHeader )
+{
+struct ip_hdr *pxIpHeader;
+struct tcp_hdr *pxTcpHeader;
+u16_t usIpHeaderLength;
+
+	memset( pxVnetHeader, 0, sizeof( *pxVnetHeader ) );
+
+	if( p->gso_size != 0 )
+	{
+		/* The Ethernet, IP and TCP headers are all in the first pbuf. */
+		pxIpHeader = ( struct ip_hdr * ) ( ( u8_t * ) p->payload + SIZEOF_ETH_HDR );
+		usIpHeaderLength = IPH_HL( pxIpHeader ) * 4;
+		pxTcpHeader = ( struct tcp_hdr * ) ( ( u8_t * ) pxIpHeader + usIpHeaderLength );
+
+		pxVnetHeader->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		pxVnetHeader->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+		pxVnetHeader->gso_size = p->gso_size;
+		pxVnetHeader->csum_start = SIZEOF_ETH_HDR - ETH_PAD_SIZE + usIpHeaderLength;
+		pxVnetHeader->csum_offset = 16; /* chksum in struct tcp_hdr */
+		pxVnetHeader->hdr_len = pxVnetHeader->csum_start + TCPH_HDRLEN( pxTcpHeader ) * 4;
+	}
+}
+/*-----------------------------------------------------------*/
+
+#endif /* TCP_GSO */
+
+/**
+ * This function should do the actual transmission of the packet. The packet is
+ * contained in the pbuf that is passed to the function. This pbuf
+ * might be chained, each pbuf is one iovec of a writev().
+ *
+ * @param pxNetIf the lwip network interface structure for this ethernetif
+ * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
+ * @return ERR_OK if the packet could be sent
+ *		 an err_t value if the packet couldn't be sent
+ */
+static err_t prvLowLevelOutput( struct netif *pxNetIf, struct pbuf *p )
+{
+struct xEthernetIf *pxEthernetIf = pxNetIf->state;
+static unsigned char ucBuffer[ netifMAX_TX_FRAME ];
+struct iovec xIov[ netifVNET_IOV + netifMAX_IOV ];
+struct eth_hdr *pxHeader;
+u16_t usTotalLength = p->tot_len - ETH_PAD_SIZE;
+int iCount;
+ssize_t xWritten;
+#if TCP_GSO
+struct virtio_net_hdr xVnetHeader;
+
+	prvSetVnetHeader( p, &xVnetHeader );
+	xIov[ 0 ].iov_base = &xVnetHeader;
+	xIov[ 0 ].iov_len = sizeof( xVnetHeader );
+#endif
+
+	iCount = prvPbufToIovec( p, &xIov[ netifVNET_IOV ] );
+
+	if( iCount == 0 )
+	{
+		/* Longer chain than netifMAX_IOV, copy into contiguous ucBuffer. */
+		if( usTotalLength > sizeof( ucBuffer ) )
+		{
+			LINK_STATS_INC( link.lenerr );
+			LINK_STATS_INC( link.drop );
+			snmp_inc_ifoutdiscards( pxNetIf );
+			return ERR_BUF;
+		}
+
+		pbuf_copy_partial( p, ucBuffer, usTotalLength, ETH_PAD_SIZE );
+		xIov[ netifVNET_IOV ].iov_base = ucBuffer;
+		xIov[ netifVNET_IOV ].iov_len = usTotalLength;
+		iCount = 1;
+	}
+
+	do
+	{
+		xWritten = writev( pxEthernetIf->iFd, xIov, netifVNET_IOV + iCount );
+	} while( ( xWritten < 0 ) && ( errno == EINTR ) );
+
+	if( xWritten != ( ssize_t ) ( netifVNET_HDR_SIZE + usTotalLength ) )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif: send failed: %s\n", strerror( errno ) ) );
+		LINK_STATS_INC( link.memerr );
+		LINK_STATS_INC( link.drop );
+		snmp_inc_ifoutdiscards( pxNetIf );
+		return ERR_BUF;
+	}
+
+	LINK_STATS_INC( link.xmit );
+	snmp_add_ifoutoctets( pxNetIf, usTotalLength );
+	pxHeader = ( struct eth_hdr * ) p->payload;
+
+	if( ( pxHeader->dest.addr[ 0 ] & 1 ) != 0 )
+	{
+		/* broadcast or multicast packet*/
+		snmp_inc_ifoutnucastpkts( pxNetIf );
+	}
+	else
+	{
+		/* unicast packet */
+		snmp_inc_ifoutucastpkts( pxNetIf );
+	}
+
+	return ERR_OK;
+}
+/*-----------------------------------------------------------*/
+
+static void prvEthernetInput( struct netif *pxNetIf, struct pbuf *p )
+{
+struct eth_hdr *pxHeader;
+
+	/* points to packet payload, which starts with an Ethernet header */
+	pxHeader = p->payload;
+
+	switch( htons( pxHeader->type ) )
+	{
+		/* IP or ARP packet? */
+		case ETHTYPE_IP:
+		case ETHTYPE_ARP:
+			/* full packet send to tcpip_thread to process */
+			if( pxNetIf->input( p, pxNetIf ) != ERR_OK )
+			{
+				LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif_input: IP input error\n" ) );
+				pbuf_free( p );
+			}
+			break;
+
+		default:
+			pbuf_free( p );
+			break;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvReceiveThread( void *pvParameters )
+{
+struct netif *pxNetIf = pvParameters;
+struct xEthernetIf *pxEthernetIf = pxNetIf->state;
+struct mmsghdr xMessages[ netifRX_BATCH ];
+struct iovec xIov[ netifRX_BATCH ][ netifVNET_IOV + netifMAX_IOV ];
+struct sockaddr_ll xFrom[ netifRX_BATCH ];
+struct pbuf *p;
+int iReady, iReceived, i;
+ssize_t xLength;
+
+#if TCP_GSO
+struct virtio_net_hdr xVnetHeader;
+#endif
+#if netifLINUX_USE_TAP
+struct pollfd xPoll;
+
+	xPoll.fd = pxEthernetIf->iFd;
+	xPoll.events = POLLIN;
+#endif
+
+	memset( xMessages, 0, sizeof( xMessages ) );
+
+	#if TCP_GSO
+	{
+		/* The kernel checks the checksums of what it sends us, the header
+		of a received frame is not needed. */
+		for( i = 0; i < netifRX_BATCH; i++ )
+		{
+			xIov[ i ][ 0 ].iov_base = &xVnetHeader;
+			xIov[ i ][ 0 ].iov_len = sizeof( xVnetHeader );
+		}
+	}
+	#endif
+
+	for( ;; )
+	{
+		/* Pbufs for a full batch, as many as the pool can give. */
+		for( iReady = 0; iReady < netifRX_BATCH; iReady++ )
+		{
+			p = pxEthernetIf->pxRxPbufs[ iReady ];
+			if( p == NULL )
+			{
+				p = pbuf_alloc( PBUF_RAW, netifMAX_FRAME + ETH_PAD_SIZE, PBUF_POOL );
+				if( p == NULL )
+				{
+					break;
+				}
+				pxEthernetIf->pxRxPbufs[ iReady ] = p;
+			}
+
+			xMessages[ iReady ].msg_hdr.msg_iov = xIov[ iReady ];
+			xMessages[ iReady ].msg_hdr.msg_iovlen = prvPbufToIovec( p, &xIov[ iReady ][ netifVNET_IOV ] );
+			LWIP_ASSERT( "ethernetif: PBUF_POOL_BUFSIZE too small for netifMAX_IOV", xMessages[ iReady ].msg_hdr.msg_iovlen != 0 );
+			xMessages[ iReady ].msg_hdr.msg_iovlen += netifVNET_IOV;
+			xMessages[ iReady ].msg_hdr.msg_name = &xFrom[ iReady ];
+			xMessages[ iReady ].msg_hdr.msg_namelen = sizeof( xFrom[ iReady ] );
+		}
+
+		if( iReady == 0 )
+		{
+			/* Pool empty, the stack is still holding the last frames. */
+			LINK_STATS_INC( link.memerr );
+			sys_msleep( 1 );
+			continue;
+		}
+
+		#if netifLINUX_USE_TAP
+		{
+			/* One frame per read(), read until the device is empty. */
+			if( poll( &xPoll, 1, -1 ) < 0 )
+			{
+				continue;
+			}
+
+			for( iReceived = 0; iReceived < iReady; iReceived++ )
+			{
+				xLength = readv( pxEthernetIf->iFd, xIov[ iReceived ], xMessages[ iReceived ].msg_hdr.msg_iovlen );
+				if( xLength < 0 )
+				{
+					break;
+				}
+				xMessages[ iReceived ].msg_len = ( unsigned int ) xLength;
+				xMessages[ iReceived ].msg_hdr.msg_flags = 0;
+				xFrom[ iReceived ].sll_pkttype = PACKET_HOST;
+			}
+		}
+		#else
+		{
+			/* Blocks for the first frame, then takes what is queued. */
+			iReceived = recvmmsg( pxEthernetIf->iFd, xMessages, iReady, MSG_WAITFORONE | MSG_TRUNC, NULL );
+			if( iReceived < 0 )
+			{
+				continue;
+			}
+		}
+		#endif
+
+		for( i = 0; i < iReceived; i++ )
+		{
+			xLength = ( ssize_t ) xMessages[ i ].msg_len - ( ssize_t ) netifVNET_HDR_SIZE;
+
+			/* Frames sent by this host on the interface and frames too long
+			for the pbuf are dropped, their pbuf is used again. */
+			if( xFrom[ i ].sll_pkttype == PACKET_OUTGOING )
+			{
+				continue;
+			}
+			if( ( xLength > netifMAX_FRAME ) || ( xLength < SIZEOF_ETH_HDR - ETH_PAD_SIZE ) )
+			{
+				LINK_STATS_INC( link.lenerr );
+				LINK_STATS_INC( link.drop );
+				continue;
+			}
+
+			p = pxEthernetIf->pxRxPbufs[ i ];
+			pxEthernetIf->pxRxPbufs[ i ] = NULL;
+			pbuf_realloc( p, ( u16_t ) ( xLength + ETH_PAD_SIZE ) );
+			LINK_STATS_INC( link.recv );
+			prvEthernetInput( pxNetIf, p );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Should be called at the beginning of the program to set up the
+ * network interface. It calls the function prvLowLevelInit() to do the
+ * actual setup of the device.
+ *
+ * This function should be passed as a parameter to netif_add(), with the
+ * name of the device (or NULL) as state and tcpip_input as input function.
+ *
+ * @param pxNetIf the lwip network interface structure for this ethernetif
+ * @return ERR_OK if the device is open
+ *		 ERR_MEM if private data couldn't be allocated
+ *		 ERR_IF if the device could not be opened
+ */
+err_t ethernetif_init( struct netif *pxNetIf )
+{
+struct xEthernetIf *pxEthernetIf;
+const char *pcDevice;
+err_t xReturn;
+
+	LWIP_ASSERT( "pxNetIf != NULL", ( pxNetIf != NULL ) );
+
+	pcDevice = ( pxNetIf->state != NULL ) ? ( const char * ) pxNetIf->state : netifLINUX_DEVICE;
+
+	pxEthernetIf = mem_malloc( sizeof( struct xEthernetIf ) );
+	if( pxEthernetIf == NULL )
+	{
+		LWIP_DEBUGF( NETIF_DEBUG, ( "ethernetif_init: out of memory\n" ) );
+		return ERR_MEM;
+	}
+
+	#if LWIP_NETIF_HOSTNAME
+	{
+		/* Initialize interface hostname */
+		pxNetIf->hostname = "lwip";
+	}
+	#endif /* LWIP_NETIF_HOSTNAME */
+
+	pxNetIf->state = pxEthernetIf;
+	pxNetIf->name[ 0 ] = IFNAME0;
+	pxNetIf->name[ 1 ] = IFNAME1;
+
+	/* We directly use etharp_output() here to save a function call. */
+	pxNetIf->output = etharp_output;
+	pxNetIf->mtu = netifMAX_MTU;
+	pxNetIf->linkoutput = prvLowLevelOutput;
+
+	#if TCP_GSO
+	{
+		/* The kernel takes IP packets up to 64 KB and cuts them up. */
+		pxNetIf->gso_max_size = 0xffff - IP_HLEN;
+	}
+	#endif
+
+	pxEthernetIf->ethaddr = ( struct eth_addr * ) &( pxNetIf->hwaddr[ 0 ] );
+
+	/* initialize the device */
+	xReturn = prvLowLevelInit( pxNetIf, pcDevice );
+	if( xReturn != ERR_OK )
+	{
+		pxNetIf->state = NULL;
+		mem_free( pxEthernetIf );
+	}
+
+	return xReturn;
+}
@@ -0,0 +1,719 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+
+//*****************************************************************************
+//
+// Include OS functionality: POSIX threads, for running lwIP on a Linux host.
+//
+//*****************************************************************************
+
+/* ------------------------ System includes ----------------------------- */
+/* pthread_setname_np() */
+#ifndef _GNU_SOURCE
+	#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* ------------------------ System architecture includes ----------------------------- */
+#include "arch/sys_arch.h"
+
+/* ------------------------ lwIP includes --------------------------------- */
+#include "lwip/opt.h"
+
+#include "lwip/debug.h"
+#include "lwip/def.h"
+#include "lwip/sys.h"
+#include "lwip/mem.h"
+#include "lwip/stats.h"
+
+/* Size of a mailbox created with a size of 0. */
+#define archMBOX_DEFAULT_SIZE	128
+
+/* Counting semaphore.  The condition variable times out on CLOCK_MONOTONIC so
+that setting the wall clock does not disturb lwIP timeouts. */
+struct xSysSem
+{
+	pthread_mutex_t xMutex;
+	pthread_cond_t xCond;
+	unsigned long ulCount;
+};
+
+/* Ring buffer of message pointers. */
+struct xSysMbox
+{
+	pthread_mutex_t xMutex;
+	pthread_cond_t xNotEmpty;
+	pthread_cond_t xNotFull;
+	void **ppvMessages;
+	int iSize;
+	int iHead;
+	int iCount;
+};
+
+/* Arguments of a thread created with sys_thread_new(). */
+struct xSysThread
+{
+	lwip_thread_fn pxThread;
+	void *pvArg;
+};
+
+/* Used by sys_arch_protect(). */
+static pthread_mutex_t xProtectMutex;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Initialise a condition variable that times out on CLOCK_MONOTONIC.
+ */
+static void prvCondInit( pthread_cond_t *pxCond )
+{
+pthread_condattr_t xAttr;
+
+	pthread_condattr_init( &xAttr );
+	pthread_condattr_setclock( &xAttr, CLOCK_MONOTONIC );
+	pthread_cond_init( pxCond, &xAttr );
+	pthread_condattr_destroy( &xAttr );
+}
+
+/*
+ * Milliseconds on CLOCK_MONOTONIC.
+ */
+static u32_t prvMilliseconds( const struct timespec *pxTime )
+{
+	return ( u32_t ) ( ( unsigned long long ) pxTime->tv_sec * 1000ULL + pxTime->tv_nsec / 1000000L );
+}
+
+/*
+ * Wait on a condition variable with the mutex held.  Returns 0 if signaled,
+ * non zero once ulTimeout ms (0 is forever) from pxStart have passed, so a
+ * wait that loops on spurious wakeups keeps its deadline.
+ */
+static int prvCondWait( pthread_cond_t *pxCond, pthread_mutex_t *pxMutex, const struct timespec *pxStart, u32_t ulTimeout )
+{
+struct timespec xDeadline;
+
+	if( ulTimeout == 0UL )
+	{
+		return pthread_cond_wait( pxCond, pxMutex );
+	}
+
+	xDeadline.tv_sec = pxStart->tv_sec + ulTimeout / 1000UL;
+	xDeadline.tv_nsec = pxStart->tv_nsec + ( long ) ( ulTimeout % 1000UL ) * 1000000L;
+	if( xDeadline.tv_nsec >= 1000000000L )
+	{
+		xDeadline.tv_sec++;
+		xDeadline.tv_nsec -= 1000000000L;
+	}
+
+	return pthread_cond_timedwait( pxCond, pxMutex, &xDeadline );
+}
+
+/*
+ * Milliseconds since pxStart, at least 1 as 0 would mean "did not wait".
+ */
+static u32_t prvElapsed( const struct timespec *pxStart )
+{
+struct timespec xNow;
+u32_t ulElapsed;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	ulElapsed = prvMilliseconds( &xNow ) - prvMilliseconds( pxStart );
+
+	if( ulElapsed == 0UL )
+	{
+		ulElapsed = 1UL;
+	}
+
+	return ulElapsed;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_new
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Creates a new mailbox
+ * Inputs:
+ *      int size                -- Size of elements in the mailbox
+ * Outputs:
+ *      sys_mbox_t              -- Handle to new mailbox
+ *---------------------------------------------------------------------------*/
+err_t sys_mbox_new( sys_mbox_t *pxMailBox, int iSize )
+{
+struct xSysMbox *pxBox;
+
+	if( iSize <= 0 )
+	{
+		iSize = archMBOX_DEFAULT_SIZE;
+	}
+
+	pxBox = malloc( sizeof( struct xSysMbox ) );
+	if( pxBox != NULL )
+	{
+		pxBox->ppvMessages = malloc( iSize * sizeof( void * ) );
+		if( pxBox->ppvMessages == NULL )
+		{
+			free( pxBox );
+			pxBox = NULL;
+		}
+	}
+
+	*pxMailBox = pxBox;
+	if( pxBox == NULL )
+	{
+		SYS_STATS_INC( mbox.err );
+		return ERR_MEM;
+	}
+
+	pthread_mutex_init( &pxBox->xMutex, NULL );
+	prvCondInit( &pxBox->xNotEmpty );
+	prvCondInit( &pxBox->xNotFull );
+	pxBox->iSize = iSize;
+	pxBox->iHead = 0;
+	pxBox->iCount = 0;
+	SYS_STATS_INC_USED( mbox );
+
+	return ERR_OK;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_free
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Deallocates a mailbox. If there are messages still present in the
+ *      mailbox when the mailbox is deallocated, it is an indication of a
+ *      programming error in lwIP and the developer should be notified.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *---------------------------------------------------------------------------*/
+void sys_mbox_free( sys_mbox_t *pxMailBox )
+{
+struct xSysMbox *pxBox = *pxMailBox;
+
+	LWIP_ASSERT( "sys_mbox_free: mailbox not empty", pxBox->iCount == 0 );
+
+	#if SYS_STATS
+	{
+		if( pxBox->iCount != 0 )
+		{
+			SYS_STATS_INC( mbox.err );
+		}
+
+		SYS_STATS_DEC( mbox.used );
+	}
+	#endif /* SYS_STATS */
+
+	pthread_cond_destroy( &pxBox->xNotFull );
+	pthread_cond_destroy( &pxBox->xNotEmpty );
+	pthread_mutex_destroy( &pxBox->xMutex );
+	free( pxBox->ppvMessages );
+	free( pxBox );
+}
+
+/*
+ * Append a message, the mailbox mutex is held and there is room.
+ */
+static void prvMboxPut( struct xSysMbox *pxBox, void *pvMessage )
+{
+	pxBox->ppvMessages[ ( pxBox->iHead + pxBox->iCount ) % pxBox->iSize ] = pvMessage;
+	pxBox->iCount++;
+	pthread_cond_signal( &pxBox->xNotEmpty );
+}
+
+/*
+ * Remove the oldest message, the mailbox mutex is held and there is one.
+ */
+static void *prvMboxGet( struct xSysMbox *pxBox )
+{
+void *pvMessage = pxBox->ppvMessages[ pxBox->iHead ];
+
+	pxBox->iHead = ( pxBox->iHead + 1 ) % pxBox->iSize;
+	pxBox->iCount--;
+	pthread_cond_signal( &pxBox->xNotFull );
+
+	return pvMessage;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_post
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Post the "msg" to the mailbox.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *      void *data              -- Pointer to data to post
+ *---------------------------------------------------------------------------*/
+void sys_mbox_post( sys_mbox_t *pxMailBox, void *pxMessageToPost )
+{
+struct xSysMbox *pxBox = *pxMailBox;
+
+	pthread_mutex_lock( &pxBox->xMutex );
+
+	while( pxBox->iCount == pxBox->iSize )
+	{
+		pthread_cond_wait( &pxBox->xNotFull, &pxBox->xMutex );
+	}
+	prvMboxPut( pxBox, pxMessageToPost );
+
+	pthread_mutex_unlock( &pxBox->xMutex );
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_trypost
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Try to post the "msg" to the mailbox.  Returns immediately with
+ *      error if cannot.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *      void *msg               -- Pointer to data to post
+ * Outputs:
+ *      err_t                   -- ERR_OK if message posted, else ERR_MEM
+ *                                  if not.
+ *---------------------------------------------------------------------------*/
+err_t sys_mbox_trypost( sys_mbox_t *pxMailBox, void *pxMessageToPost )
+{
+struct xSysMbox *pxBox = *pxMailBox;
+err_t xReturn;
+
+	pthread_mutex_lock( &pxBox->xMutex );
+
+	if( pxBox->iCount < pxBox->iSize )
+	{
+		prvMboxPut( pxBox, pxMessageToPost );
+		xReturn = ERR_OK;
+	}
+	else
+	{
+		/* The mailbox was already full. */
+		xReturn = ERR_MEM;
+		SYS_STATS_INC( mbox.err );
+	}
+
+	pthread_mutex_unlock( &pxBox->xMutex );
+
+	return xReturn;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_arch_mbox_fetch
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Blocks the thread until a message arrives in the mailbox, but does
+ *      not block the thread longer than "timeout" milliseconds (similar to
+ *      the sys_arch_sem_wait() function). The "msg" argument is a result
+ *      parameter that is set by the function (i.e., by doing "*msg =
+ *      ptr"). The "msg" parameter maybe NULL to indicate that the message
+ *      should be dropped.
+ *
+ *      The return values are the same as for the sys_arch_sem_wait() function:
+ *      Number of milliseconds spent waiting or SYS_ARCH_TIMEOUT if there was a
+ *      timeout.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *      void **msg              -- Pointer to pointer to msg received
+ *      u32_t timeout           -- Number of milliseconds until timeout
+ * Outputs:
+ *      u32_t                   -- SYS_ARCH_TIMEOUT if timeout, else number
+ *                                  of milliseconds until received.
+ *---------------------------------------------------------------------------*/
+u32_t sys_arch_mbox_fetch( sys_mbox_t *pxMailBox, void **ppvBuffer, u32_t ulTimeOut )
+{
+struct xSysMbox *pxBox = *pxMailBox;
+struct timespec xStartTime;
+void *pvMessage;
+u32_t ulReturn;
+
+	clock_gettime( CLOCK_MONOTONIC, &xStartTime );
+	pthread_mutex_lock( &pxBox->xMutex );
+
+	while( pxBox->iCount == 0 )
+	{
+		if( prvCondWait( &pxBox->xNotEmpty, &pxBox->xMutex, &xStartTime, ulTimeOut ) != 0 )
+		{
+			break;
+		}
+	}
+
+	if( pxBox->iCount != 0 )
+	{
+		pvMessage = prvMboxGet( pxBox );
+		ulReturn = prvElapsed( &xStartTime );
+	}
+	else
+	{
+		/* Timed out. */
+		pvMessage = NULL;
+		ulReturn = SYS_ARCH_TIMEOUT;
+	}
+
+	pthread_mutex_unlock( &pxBox->xMutex );
+
+	if( ppvBuffer != NULL )
+	{
+		*ppvBuffer = pvMessage;
+	}
+
+	return ulReturn;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_arch_mbox_tryfetch
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Similar to sys_arch_mbox_fetch, but if message is not ready
+ *      immediately, we'll return with SYS_MBOX_EMPTY.  On success, 0 is
+ *      returned.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *      void **msg              -- Pointer to pointer to msg received
+ * Outputs:
+ *      u32_t                   -- SYS_MBOX_EMPTY if no messages.  Otherwise,
+ *                                  return ERR_OK.
+ *---------------------------------------------------------------------------*/
+u32_t sys_arch_mbox_tryfetch( sys_mbox_t *pxMailBox, void **ppvBuffer )
+{
+struct xSysMbox *pxBox = *pxMailBox;
+void *pvMessage = NULL;
+u32_t ulReturn;
+
+	pthread_mutex_lock( &pxBox->xMutex );
+
+	if( pxBox->iCount != 0 )
+	{
+		pvMessage = prvMboxGet( pxBox );
+		ulReturn = ERR_OK;
+	}
+	else
+	{
+		ulReturn = SYS_MBOX_EMPTY;
+	}
+
+	pthread_mutex_unlock( &pxBox->xMutex );
+
+	if( ( ppvBuffer != NULL ) && ( ulReturn == ERR_OK ) )
+	{
+		*ppvBuffer = pvMessage;
+	}
+
+	return ulReturn;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_sem_new
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Creates and returns a new semaphore. The "ucCount" argument specifies
+ *      the initial state of the semaphore.
+ * Inputs:
+ *      sys_sem_t sem           -- Handle of semaphore
+ *      u8_t ucCount            -- Initial ucCount of semaphore
+ * Outputs:
+ *      err_t                   -- ERR_OK or ERR_MEM if could not create.
+ *---------------------------------------------------------------------------*/
+err_t sys_sem_new( sys_sem_t *pxSemaphore, u8_t ucCount )
+{
+struct xSysSem *pxSem;
+
+	pxSem = malloc( sizeof( struct xSysSem ) );
+	*pxSemaphore = pxSem;
+
+	if( pxSem == NULL )
+	{
+		SYS_STATS_INC( sem.err );
+		return ERR_MEM;
+	}
+
+	pthread_mutex_init( &pxSem->xMutex, NULL );
+	prvCondInit( &pxSem->xCond );
+	pxSem->ulCount = ucCount;
+	SYS_STATS_INC_USED( sem );
+
+	return ERR_OK;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_arch_sem_wait
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Blocks the thread while waiting for the semaphore to be
+ *      signaled. If the "timeout" argument is non-zero, the thread should
+ *      only be blocked for the specified time (measured in
+ *      milliseconds).
+ *
+ *      If the timeout argument is non-zero, the return value is the number of
+ *      milliseconds spent waiting for the semaphore to be signaled. If the
+ *      semaphore wasn't signaled within the specified time, the return value is
+ *      SYS_ARCH_TIMEOUT. If the thread didn't have to wait for the semaphore
+ *      (i.e., it was already signaled), the function may return zero.
+ * Inputs:
+ *      sys_sem_t sem           -- Semaphore to wait on
+ *      u32_t timeout           -- Number of milliseconds until timeout
+ * Outputs:
+ *      u32_t                   -- Time elapsed or SYS_ARCH_TIMEOUT.
+ *---------------------------------------------------------------------------*/
+u32_t sys_arch_sem_wait( sys_sem_t *pxSemaphore, u32_t ulTimeout )
+{
+struct xSysSem *pxSem = *pxSemaphore;
+struct timespec xStartTime;
+u32_t ulReturn;
+
+	clock_gettime( CLOCK_MONOTONIC, &xStartTime );
+	pthread_mutex_lock( &pxSem->xMutex );
+
+	while( pxSem->ulCount == 0UL )
+	{
+		if( prvCondWait( &pxSem->xCond, &pxSem->xMutex, &xStartTime, ulTimeout ) != 0 )
+		{
+			break;
+		}
+	}
+
+	if( pxSem->ulCount != 0UL )
+	{
+		pxSem->ulCount--;
+		ulReturn = prvElapsed( &xStartTime );
+	}
+	else
+	{
+		ulReturn = SYS_ARCH_TIMEOUT;
+	}
+
+	pthread_mutex_unlock( &pxSem->xMutex );
+
+	return ulReturn;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_sem_signal
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Signals (releases) a semaphore
+ * Inputs:
+ *      sys_sem_t sem           -- Semaphore to signal
+ *---------------------------------------------------------------------------*/
+void sys_sem_signal( sys_sem_t *pxSemaphore )
+{
+struct xSysSem *pxSem = *pxSemaphore;
+
+	pthread_mutex_lock( &pxSem->xMutex );
+	pxSem->ulCount++;
+	pthread_cond_signal( &pxSem->xCond );
+	pthread_mutex_unlock( &pxSem->xMutex );
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_sem_free
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Deallocates a semaphore
+ * Inputs:
+ *      sys_sem_t sem           -- Semaphore to free
+ *---------------------------------------------------------------------------*/
+void sys_sem_free( sys_sem_t *pxSemaphore )
+{
+struct xSysSem *pxSem = *pxSemaphore;
+
+	SYS_STATS_DEC( sem.used );
+	pthread_cond_destroy( &pxSem->xCond );
+	pthread_mutex_destroy( &pxSem->xMutex );
+	free( pxSem );
+}
+
+/** Create a new mutex
+ * @param mutex pointer to the mutex to create
+ * @return a new mutex */
+err_t sys_mutex_new( sys_mutex_t *pxMutex )
+{
+	*pxMutex = malloc( sizeof( pthread_mutex_t ) );
+
+	if( *pxMutex == NULL )
+	{
+		SYS_STATS_INC( mutex.err );
+		return ERR_MEM;
+	}
+
+	pthread_mutex_init( *pxMutex, NULL );
+	SYS_STATS_INC_USED( mutex );
+
+	return ERR_OK;
+}
+
+/** Lock a mutex
+ * @param mutex the mutex to lock */
+void sys_mutex_lock( sys_mutex_t *pxMutex )
+{
+	pthread_mutex_lock( *pxMutex );
+}
+
+/** Unlock a mutex
+ * @param mutex the mutex to unlock */
+void sys_mutex_unlock( sys_mutex_t *pxMutex )
+{
+	pthread_mutex_unlock( *pxMutex );
+}
+
+/** Delete a mutex
+ * @param mutex the mutex to delete */
+void sys_mutex_free( sys_mutex_t *pxMutex )
+{
+	SYS_STATS_DEC( mutex.used );
+	pthread_mutex_destroy( *pxMutex );
+	free( *pxMutex );
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_init
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Initialize sys arch
+ *---------------------------------------------------------------------------*/
+void sys_init( void )
+{
+pthread_mutexattr_t xAttr;
+
+	/* sys_arch_protect() may nest. */
+	pthread_mutexattr_init( &xAttr );
+	pthread_mutexattr_settype( &xAttr, PTHREAD_MUTEX_RECURSIVE );
+	pthread_mutex_init( &xProtectMutex, &xAttr );
+	pthread_mutexattr_destroy( &xAttr );
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_now
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Milliseconds on CLOCK_MONOTONIC, used by the lwIP timers
+ *---------------------------------------------------------------------------*/
+u32_t sys_now( void )
+{
+struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return prvMilliseconds( &xNow );
+}
+
+/*
+ * Entry of the threads created by sys_thread_new().
+ */
+static void *prvThreadEntry( void *pvParameters )
+{
+struct xSysThread xThread = *( struct xSysThread * ) pvParameters;
+
+	free( pvParameters );
+	xThread.pxThread( xThread.pvArg );
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_thread_new
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Starts a new thread that will begin its execution in the function
+ *      "thread()". The "arg" argument will be passed as an argument to the
+ *      thread() function. The threads are detached and use the default
+ *      stack size and scheduling policy of the process, so "stacksize" and
+ *      "prio" are not used.
+ * Inputs:
+ *      char *name              -- Name of thread
+ *      void (* thread)(void *arg) -- Pointer to function to run.
+ *      void *arg               -- Argument passed into function
+ *      int stacksize           -- Required stack amount in bytes
+ *      int prio                -- Thread priority
+ * Outputs:
+ *      sys_thread_t            -- Id of the new thread.
+ *---------------------------------------------------------------------------*/
+sys_thread_t sys_thread_new( const char *pcName, void( *pxThread )( void *pvParameters ), void *pvArg, int iStackSize, int iPriority )
+{
+struct xSysThread *pxNew;
+pthread_t xCreatedThread;
+char cName[ 16 ];
+int iResult;
+
+	( void ) iStackSize;
+	( void ) iPriority;
+
+	pxNew = malloc( sizeof( struct xSysThread ) );
+	LWIP_ASSERT( "sys_thread_new: out of memory", pxNew != NULL );
+	pxNew->pxThread = pxThread;
+	pxNew->pvArg = pvArg;
+
+	iResult = pthread_create( &xCreatedThread, NULL, prvThreadEntry, pxNew );
+	LWIP_ASSERT( "sys_thread_new: pthread_create failed", iResult == 0 );
+	pthread_detach( xCreatedThread );
+
+	/* Shows in top and gdb, at most 15 characters. */
+	snprintf( cName, sizeof( cName ), "%s", pcName );
+	pthread_setname_np( xCreatedThread, cName );
+
+	return xCreatedThread;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_arch_protect
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      This optional function does a "fast" critical region protection and
+ *      returns the previous protection level. This function is only called
+ *      during very short critical regions. Here it locks one recursive
+ *      mutex shared by all threads, so sys_arch_protect() can be called
+ *      while already protected.
+ * Outputs:
+ *      sys_prot_t              -- Previous protection level (not used here)
+ *---------------------------------------------------------------------------*/
+sys_prot_t sys_arch_protect( void )
+{
+	pthread_mutex_lock( &xProtectMutex );
+	return ( sys_prot_t ) 1;
+}
+
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_arch_unprotect
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      This optional function does a "fast" set of critical region
+ *      protection to the value specified by pval. See the documentation for
+ *      sys_arch_protect() for more information.
+ * Inputs:
+ *      sys_prot_t              -- Previous protection level (not used here)
+ *---------------------------------------------------------------------------*/
+void sys_arch_unprotect( sys_prot_t xValue )
+{
+	( void ) xValue;
+	pthread_mutex_unlock( &xProtectMutex );
+}
+/*-------------------------------------------------------------------------*
+ * End of File:  sys_arch.c
+ *-------------------------------------------------------------------------*/
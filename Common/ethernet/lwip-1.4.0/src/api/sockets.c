@@ -833,7 +833,7 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
 #if LWIP_CHECKSUM_ON_COPY
       u16_t chksum = 0;
       if (sock->conn->type != NETCONN_RAW) {
-        chksum = LWIP_CHKSUM_COPY(p->payload, data, short_size);
+        pbuf_copy_chksum(p, data, short_size, &chksum);
       } else
 #endif /* LWIP_CHECKSUM_ON_COPY */
       MEMCPY(p->payload, data, size);
@@ -907,9 +907,9 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
   } else {
 #if LWIP_CHECKSUM_ON_COPY
     if (sock->conn->type != NETCONN_RAW) {
-      u16_t chksum = LWIP_CHKSUM_COPY(buf.p->payload, data, short_size);
+      u16_t chksum;
+      err = pbuf_copy_chksum(buf.p, data, short_size, &chksum);
       netbuf_set_chksum(&buf, chksum);
-      err = ERR_OK;
     } else
 #endif /* LWIP_CHECKSUM_ON_COPY */
     {
@@ -187,6 +187,15 @@
 #if IP_FRAG && IP_FRAG_USES_STATIC_BUF && LWIP_NETIF_TX_SINGLE_PBUF
   #error "LWIP_NETIF_TX_SINGLE_PBUF does not work with IP_FRAG_USES_STATIC_BUF==1 as that creates pbuf queues"
 #endif
+#if LWIP_TCP && TCP_GSO && LWIP_NETIF_TX_SINGLE_PBUF
+  #error "TCP_GSO sends pbuf chains referencing the segment payload, it does not work with LWIP_NETIF_TX_SINGLE_PBUF"
+#endif
+#if LWIP_TCP && TCP_GSO && !LWIP_SUPPORT_CUSTOM_PBUF
+  #error "TCP_GSO needs LWIP_SUPPORT_CUSTOM_PBUF"
+#endif
+#if LWIP_TCP && TCP_GSO && ((TCP_GSO_MAX_SIZE < TCP_MSS) || (TCP_GSO_MAX_SIZE > 65000))
+  #error "TCP_GSO_MAX_SIZE must be between TCP_MSS and 65000, so that a segment and its headers fit into a pbuf"
+#endif
 
 
 /* Compile-time checks for deprecated options.
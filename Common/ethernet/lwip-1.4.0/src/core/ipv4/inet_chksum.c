@@ -52,7 +52,11 @@
  * #define LWIP_CHKSUM <your_checksum_routine> 
  *
  * Or you can select from the implementations below by defining
- * LWIP_CHKSUM_ALGORITHM to 1, 2 or 3.
+ * LWIP_CHKSUM_ALGORITHM to 1, 2, 3, 4 or 5:
+ * - 1 to 3 are portable and work 16 or 32 bits at a time,
+ * - 4 adds 32-bit words into a 64-bit sum, for 64-bit hosts,
+ * - 5 uses SSE2, AVX2 or NEON, whichever the compiler targets (e.g.
+ *   -mavx2), and falls back to 4 on other CPUs.
  */
 
 #ifndef LWIP_CHKSUM
@@ -256,6 +260,203 @@ lwip_standard_chksum(void *dataptr, int len)
 }
 #endif
 
+#if (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_ALGORITHM == 5) || (LWIP_CHKSUM_COPY_ALGORITHM == 2)
+/* 64-bit accumulator: native 32-bit words are added without carry and the
+ * result folds to the same 16 bits as a sum of 16-bit words (RFC1071). */
+typedef unsigned long long chksum_acc_t;
+
+/** Fold a 64-bit sum to 16 bits */
+static u16_t
+lwip_chksum_fold(chksum_acc_t sum)
+{
+  u32_t s;
+
+  sum = (sum >> 32) + (sum & 0xffffffffULL);
+  sum = (sum >> 32) + (sum & 0xffffffffULL);
+  s = (u32_t)sum;
+  s = FOLD_U32T(s);
+  s = FOLD_U32T(s);
+  return (u16_t)s;
+}
+#endif /* 64-bit accumulator */
+
+#if (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_ALGORITHM == 5)
+/**
+ * Adds data to a 64-bit sum, 32-bit words, 16 bytes per loop. The sum has
+ * room for the carries of 2^32 words, so none is added back here.
+ *
+ * @param sum running sum
+ * @param pb start of data, 16-bit aligned
+ * @param len length of data, a last odd byte is summed as the first byte
+ *        of a word
+ * @return the new sum
+ */
+static chksum_acc_t
+lwip_chksum_add64(chksum_acc_t sum, const u8_t *pb, int len)
+{
+  const u16_t *ps = (const u16_t *)(const void *)pb;
+  const u32_t *pl;
+  u16_t t = 0;
+
+  /* Get aligned to u32_t */
+  if (((mem_ptr_t)ps & 3) && len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  pl = (const u32_t *)(const void *)ps;
+  while (len > 15) {
+    sum += (chksum_acc_t)pl[0] + pl[1] + (chksum_acc_t)pl[2] + pl[3];
+    pl += 4;
+    len -= 16;
+  }
+  while (len > 3) {
+    sum += *pl++;
+    len -= 4;
+  }
+
+  ps = (const u16_t *)pl;
+  if (len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+  if (len > 0) {
+    ((u8_t *)&t)[0] = *(const u8_t *)ps;
+    sum += t;
+  }
+  return sum;
+}
+#endif /* (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_ALGORITHM == 5) */
+
+#if (LWIP_CHKSUM_ALGORITHM == 5)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CHKSUM_VEC_SIZE 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CHKSUM_VEC_SIZE 16
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CHKSUM_VEC_SIZE 16
+#endif
+
+#ifdef CHKSUM_VEC_SIZE
+/* Every vector adds two 16-bit words to each 32-bit lane, so the lanes are
+   moved to the 64-bit sum before they can overflow */
+#define CHKSUM_VEC_BLOCK 16384
+
+/**
+ * Adds data to a 64-bit sum, one vector per loop.
+ *
+ * @param sum running sum
+ * @param pb start of data, 16-bit aligned
+ * @param len length of data
+ * @return the new sum
+ */
+static chksum_acc_t
+lwip_chksum_add_vec(chksum_acc_t sum, const u8_t *pb, int len)
+{
+  int head = (int)((0 - (mem_ptr_t)pb) & (CHKSUM_VEC_SIZE - 1));
+  int n;
+  u32_t lanes[CHKSUM_VEC_SIZE / 4];
+  u8_t i;
+
+  /* Even number of bytes up to the first aligned vector */
+  if (head > len) {
+    head = len;
+  }
+  sum = lwip_chksum_add64(sum, pb, head);
+  pb += head;
+  len -= head;
+
+  while (len >= CHKSUM_VEC_SIZE) {
+    n = len / CHKSUM_VEC_SIZE;
+    if (n > CHKSUM_VEC_BLOCK) {
+      n = CHKSUM_VEC_BLOCK;
+    }
+    len -= n * CHKSUM_VEC_SIZE;
+#if defined(__AVX2__)
+    {
+      __m256i mask = _mm256_set1_epi32(0xffff), lo = _mm256_setzero_si256(), hi = lo, v;
+      do {
+        v = _mm256_load_si256((const __m256i *)(const void *)pb);
+        lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+        hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+        pb += CHKSUM_VEC_SIZE;
+      } while (--n);
+      _mm256_storeu_si256((__m256i *)(void *)lanes, _mm256_add_epi32(lo, hi));
+    }
+#elif defined(__SSE2__)
+    {
+      __m128i mask = _mm_set1_epi32(0xffff), lo = _mm_setzero_si128(), hi = lo, v;
+      do {
+        v = _mm_load_si128((const __m128i *)(const void *)pb);
+        lo = _mm_add_epi32(lo, _mm_and_si128(v, mask));
+        hi = _mm_add_epi32(hi, _mm_srli_epi32(v, 16));
+        pb += CHKSUM_VEC_SIZE;
+      } while (--n);
+      _mm_storeu_si128((__m128i *)(void *)lanes, _mm_add_epi32(lo, hi));
+    }
+#else /* NEON */
+    {
+      uint32x4_t acc = vdupq_n_u32(0);
+      do {
+        acc = vpadalq_u16(acc, vld1q_u16((const uint16_t *)(const void *)pb));
+        pb += CHKSUM_VEC_SIZE;
+      } while (--n);
+      vst1q_u32(lanes, acc);
+    }
+#endif
+    for (i = 0; i < CHKSUM_VEC_SIZE / 4; i++) {
+      sum += lanes[i];
+    }
+  }
+
+  return lwip_chksum_add64(sum, pb, len);
+}
+#else /* CHKSUM_VEC_SIZE */
+/* No vector unit known for this target */
+#define lwip_chksum_add_vec lwip_chksum_add64
+#endif /* CHKSUM_VEC_SIZE */
+#endif /* (LWIP_CHKSUM_ALGORITHM == 5) */
+
+#if (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_ALGORITHM == 5)
+/**
+ * Checksum with a 64-bit sum of 32-bit words (4) or of vectors (5).
+ * Head and tail bytes are treated like in version #2.
+ *
+ * @param dataptr points to start of data to be summed at any boundary
+ * @param len length of data to be summed
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+static u16_t
+lwip_standard_chksum(void *dataptr, int len)
+{
+  u8_t *pb = (u8_t *)dataptr;
+  u16_t t = 0, sum;
+  int odd = ((mem_ptr_t)pb & 1);
+
+  /* Get aligned to u16_t */
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+
+#if (LWIP_CHKSUM_ALGORITHM == 4)
+  sum = lwip_chksum_fold(lwip_chksum_add64(t, pb, len));
+#else
+  sum = lwip_chksum_fold(lwip_chksum_add_vec(t, pb, len));
+#endif
+
+  /* Swap if alignment was odd */
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  return sum;
+}
+#endif /* (LWIP_CHKSUM_ALGORITHM == 4) || (LWIP_CHKSUM_ALGORITHM == 5) */
+
 /* inet_chksum_pseudo:
  *
  * Calculates the pseudo Internet checksum used by TCP and UDP for a pbuf chain.
@@ -434,6 +635,7 @@ inet_chksum_pbuf(struct pbuf *p)
  * performance-sensitive function, you might want to create your own version
  * in assembly targeted at your hardware by defining it in lwipopts.h:
  *   #define LWIP_CHKSUM_COPY(dst, src, len) your_chksum_copy(dst, src, len)
+ * Or select LWIP_CHKSUM_COPY_ALGORITHM 1 (default) or 2 (single pass).
  */
 
 #if (LWIP_CHKSUM_COPY_ALGORITHM == 1) /* Version #1 */
@@ -448,3 +650,71 @@ lwip_chksum_copy(void *dst, const void *src, u16_t len)
   return LWIP_CHKSUM(dst, len);
 }
 #endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 1) */
+
+#if (LWIP_CHKSUM_COPY_ALGORITHM == 2) /* Version #2 */
+/** Copies and sums in one pass, 32 bits at a time, so the data is only
+ * read once. Needs src and dst at the same offset to a 32-bit boundary,
+ * else it does like version #1.
+ */
+u16_t
+lwip_chksum_copy(void *dst, const void *src, u16_t len)
+{
+  const u8_t *ps = (const u8_t *)src;
+  u8_t *pd = (u8_t *)dst;
+  chksum_acc_t sum;
+  u32_t w;
+  u16_t t = 0, chksum;
+  int odd = ((mem_ptr_t)ps & 1);
+
+  if ((((mem_ptr_t)ps ^ (mem_ptr_t)pd) & 3) != 0) {
+    MEMCPY(dst, src, len);
+    return LWIP_CHKSUM(dst, len);
+  }
+
+  /* Get aligned to u16_t */
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pd++ = *ps++;
+    len--;
+  }
+  sum = t;
+
+  /* Get aligned to u32_t */
+  if (((mem_ptr_t)ps & 3) && len > 1) {
+    t = *(const u16_t *)(const void *)ps;
+    *(u16_t *)(void *)pd = t;
+    sum += t;
+    ps += 2;
+    pd += 2;
+    len -= 2;
+  }
+
+  while (len > 3) {
+    w = *(const u32_t *)(const void *)ps;
+    *(u32_t *)(void *)pd = w;
+    sum += w;
+    ps += 4;
+    pd += 4;
+    len -= 4;
+  }
+
+  if (len > 1) {
+    t = *(const u16_t *)(const void *)ps;
+    *(u16_t *)(void *)pd = t;
+    sum += t;
+    ps += 2;
+    pd += 2;
+    len -= 2;
+  }
+  if (len > 0) {
+    t = 0;
+    ((u8_t *)&t)[0] = *pd = *ps;
+    sum += t;
+  }
+
+  chksum = lwip_chksum_fold(sum);
+  if (odd) {
+    chksum = SWAP_BYTES_IN_WORD(chksum);
+  }
+  return chksum;
+}
+#endif /* (LWIP_CHKSUM_COPY_ALGORITHM == 2) */
@@ -718,7 +718,12 @@ err_t ip_output_if_opt(struct pbuf *p, ip_addr_t *src, ip_addr_t *dest,
 #endif /* ENABLE_LOOPBACK */
 #if IP_FRAG
   /* don't fragment if interface has mtu set to 0 [loopif] */
-  if (netif->mtu && (p->tot_len > netif->mtu)) {
+  /* or if it cuts up large TCP segments itself */
+  if (netif->mtu && (p->tot_len > netif->mtu)
+#if TCP_GSO
+      && (p->gso_size == 0)
+#endif /* TCP_GSO */
+     ) {
     return ip_frag(p, netif, dest);
   }
 #endif /* IP_FRAG */
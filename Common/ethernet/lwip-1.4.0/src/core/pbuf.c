@@ -322,6 +322,9 @@ pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
   p->ref = 1;
   /* set flags */
   p->flags = 0;
+#if TCP_GSO
+  p->gso_size = 0;
+#endif /* TCP_GSO */
   LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_TRACE, ("pbuf_alloc(length=%"U16_F") == %p\n", length, (void *)p));
   return p;
 }
@@ -369,7 +372,7 @@ pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_cust
     return NULL;
   }
 
-  if (LWIP_MEM_ALIGN_SIZE(offset) + length < payload_mem_len) {
+  if (LWIP_MEM_ALIGN_SIZE(offset) + length > payload_mem_len) {
     LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_LEVEL_WARNING, ("pbuf_alloced_custom(length=%"U16_F") buffer too short\n", length));
     return NULL;
   }
@@ -381,6 +384,9 @@ pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_cust
     p->pbuf.payload = NULL;
   }
   p->pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+#if TCP_GSO
+  p->pbuf.gso_size = 0;
+#endif /* TCP_GSO */
   p->pbuf.len = p->pbuf.tot_len = length;
   p->pbuf.type = type;
   p->pbuf.ref = 1;
@@ -444,8 +450,12 @@ pbuf_realloc(struct pbuf *p, u16_t new_len)
   /* rem_len == desired length for pbuf q */
 
   /* shrink allocated memory for PBUF_RAM */
-  /* (other types merely adjust their length fields */
-  if ((q->type == PBUF_RAM) && (rem_len != q->len)) {
+  /* (other types and custom pbufs merely adjust their length fields */
+  if ((q->type == PBUF_RAM) && (rem_len != q->len)
+#if LWIP_SUPPORT_CUSTOM_PBUF
+      && ((q->flags & PBUF_FLAG_IS_CUSTOM) == 0)
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+     ) {
     /* reallocate and adjust the length of the pbuf that will be split */
     q = (struct pbuf *)mem_trim(q, (u16_t)((u8_t *)q->payload - (u8_t *)q) + rem_len);
     LWIP_ASSERT("mem_trim returned q == NULL", q != NULL);
@@ -1041,6 +1051,55 @@ pbuf_fill_chksum(struct pbuf *p, u16_t start_offset, const void *dataptr,
   *chksum = FOLD_U32T(acc);
   return ERR_OK;
 }
+
+/**
+ * Copy application supplied data into a pbuf chain like pbuf_take() and
+ * return the checksum of the copied data, summed while copying with
+ * LWIP_CHKSUM_COPY. The result can be passed to udp_sendto_chksum().
+ *
+ * @param buf pbuf to fill with data
+ * @param dataptr application supplied data buffer
+ * @param len length of the application supplied data buffer
+ * @param chksum returns the (non-inverted) checksum of the data
+ *
+ * @return ERR_OK if successful, ERR_MEM if the pbuf is not big enough
+ */
+err_t
+pbuf_copy_chksum(struct pbuf *buf, const void *dataptr, u16_t len, u16_t *chksum)
+{
+  struct pbuf *p;
+  u16_t buf_copy_len;
+  u16_t copied_total = 0;
+  u16_t copy_chksum;
+  u32_t acc = 0;
+
+  LWIP_ERROR("pbuf_copy_chksum: invalid buf", (buf != NULL), return ERR_ARG;);
+  LWIP_ERROR("pbuf_copy_chksum: invalid dataptr", (dataptr != NULL), return ERR_ARG;);
+  LWIP_ERROR("pbuf_copy_chksum: invalid chksum", (chksum != NULL), return ERR_ARG;);
+
+  if (buf->tot_len < len) {
+    return ERR_MEM;
+  }
+
+  for(p = buf; copied_total != len; p = p->next) {
+    LWIP_ASSERT("pbuf_copy_chksum: invalid pbuf", p != NULL);
+    buf_copy_len = len - copied_total;
+    if (buf_copy_len > p->len) {
+      /* this pbuf cannot hold all remaining data */
+      buf_copy_len = p->len;
+    }
+    copy_chksum = LWIP_CHKSUM_COPY(p->payload, &((const char*)dataptr)[copied_total], buf_copy_len);
+    /* data starting at an odd offset is summed in the other byte lane */
+    if ((copied_total & 1) != 0) {
+      copy_chksum = SWAP_BYTES_IN_WORD(copy_chksum);
+    }
+    acc += copy_chksum;
+    acc = FOLD_U32T(acc);
+    copied_total += buf_copy_len;
+  }
+  *chksum = (u16_t)FOLD_U32T(acc);
+  return ERR_OK;
+}
 #endif /* LWIP_CHECKSUM_ON_COPY */
 
  /** Get one byte from the specified position in a pbuf
@@ -83,7 +83,8 @@ stats_display_proto(struct stats_proto *proto, char *name)
   LWIP_PLATFORM_DIAG(("proterr: %"STAT_COUNTER_F"\n\t", proto->proterr)); 
   LWIP_PLATFORM_DIAG(("opterr: %"STAT_COUNTER_F"\n\t", proto->opterr)); 
   LWIP_PLATFORM_DIAG(("err: %"STAT_COUNTER_F"\n\t", proto->err)); 
-  LWIP_PLATFORM_DIAG(("cachehit: %"STAT_COUNTER_F"\n", proto->cachehit)); 
+  LWIP_PLATFORM_DIAG(("cachehit: %"STAT_COUNTER_F"\n\t", proto->cachehit)); 
+  LWIP_PLATFORM_DIAG(("copy: %"STAT_COUNTER_F"\n", proto->copy)); 
 }
 
 #if IGMP_STATS
@@ -97,6 +97,139 @@ struct tcp_pcb ** const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcb
 /** Only used for temporary storage. */
 struct tcp_pcb *tcp_tmp_pcb;
 
+#if TCP_PCB_HASH_SIZE
+/** Active and TIME-WAIT PCBs, chained by hash_next, bucket by 4-tuple */
+struct tcp_pcb *tcp_pcb_hash[TCP_PCB_HASH_SIZE];
+/** LISTEN PCBs, chained by hash_next, bucket by local port */
+struct tcp_pcb_listen *tcp_listen_hash[TCP_PCB_HASH_SIZE];
+
+/**
+ * Spreads a 32-bit key over all the bits, so nearby addresses and
+ * ports do not share buckets.
+ */
+static u16_t
+tcp_hash_index(u32_t key)
+{
+  key ^= key >> 16;
+  key *= 0x45d9f3bUL;
+  key ^= key >> 16;
+  return (u16_t)(key & (TCP_PCB_HASH_SIZE - 1));
+}
+
+/** Bucket of a 4-tuple, ports in host byte order */
+#define TCP_PCB_HASH_INDEX(lip, lport, rip, rport) \
+  tcp_hash_index(ip4_addr_get_u32(lip) ^ (ip4_addr_get_u32(rip) * 0x9e3779b1UL) ^ \
+                 (((u32_t)(lport) << 16) | (rport)))
+
+/**
+ * Adds a PCB to the hash table of the list it was just registered with.
+ * Called by TCP_REG. Bound PCBs are not demultiplexed, so not hashed.
+ *
+ * @param pcbs the list the PCB was added to
+ * @param pcb the PCB, with its addresses and ports set
+ */
+void
+tcp_pcb_hash_add(struct tcp_pcb **pcbs, struct tcp_pcb *pcb)
+{
+  u16_t i;
+
+  if (pcbs == &tcp_listen_pcbs.pcbs) {
+    struct tcp_pcb_listen *lpcb = (struct tcp_pcb_listen *)pcb;
+    i = tcp_hash_index(lpcb->local_port);
+    lpcb->hash_next = tcp_listen_hash[i];
+    tcp_listen_hash[i] = lpcb;
+  } else if (pcbs == &tcp_active_pcbs || pcbs == &tcp_tw_pcbs) {
+    i = TCP_PCB_HASH_INDEX(&pcb->local_ip, pcb->local_port, &pcb->remote_ip, pcb->remote_port);
+    pcb->hash_next = tcp_pcb_hash[i];
+    tcp_pcb_hash[i] = pcb;
+  }
+}
+
+/**
+ * Removes a PCB from the hash table of the list it was just removed from.
+ * Called by TCP_RMV.
+ *
+ * @param pcbs the list the PCB was removed from
+ * @param pcb the PCB, with the addresses and ports it was added with
+ */
+void
+tcp_pcb_hash_remove(struct tcp_pcb **pcbs, struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **link;
+  struct tcp_pcb_listen **llink;
+
+  if (pcbs == &tcp_listen_pcbs.pcbs) {
+    for (llink = &tcp_listen_hash[tcp_hash_index(pcb->local_port)]; *llink != NULL; llink = &(*llink)->hash_next) {
+      if (*llink == (struct tcp_pcb_listen *)pcb) {
+        *llink = (*llink)->hash_next;
+        break;
+      }
+    }
+  } else if (pcbs == &tcp_active_pcbs || pcbs == &tcp_tw_pcbs) {
+    link = &tcp_pcb_hash[TCP_PCB_HASH_INDEX(&pcb->local_ip, pcb->local_port, &pcb->remote_ip, pcb->remote_port)];
+    for (; *link != NULL; link = &(*link)->hash_next) {
+      if (*link == pcb) {
+        *link = pcb->hash_next;
+        break;
+      }
+    }
+  }
+  pcb->hash_next = NULL;
+}
+
+/**
+ * Finds the active or TIME-WAIT PCB of a 4-tuple. An active PCB is
+ * preferred, like the order tcp_input() used to walk the lists in.
+ *
+ * @return the PCB or NULL if there is none
+ */
+struct tcp_pcb *
+tcp_pcb_hash_lookup(ip_addr_t *local_ip, u16_t local_port,
+                    ip_addr_t *remote_ip, u16_t remote_port)
+{
+  struct tcp_pcb *pcb;
+  struct tcp_pcb *tw_pcb = NULL;
+
+  for (pcb = tcp_pcb_hash[TCP_PCB_HASH_INDEX(local_ip, local_port, remote_ip, remote_port)];
+       pcb != NULL; pcb = pcb->hash_next) {
+    if (pcb->remote_port == remote_port &&
+        pcb->local_port == local_port &&
+        ip_addr_cmp(&(pcb->remote_ip), remote_ip) &&
+        ip_addr_cmp(&(pcb->local_ip), local_ip)) {
+      if (pcb->state != TIME_WAIT) {
+        return pcb;
+      }
+      tw_pcb = pcb;
+    }
+  }
+  return tw_pcb;
+}
+
+/**
+ * Finds the LISTEN PCB for a local address and port. A PCB bound to the
+ * address is preferred over one bound to IP_ADDR_ANY.
+ *
+ * @return the PCB or NULL if there is none
+ */
+struct tcp_pcb_listen *
+tcp_listen_hash_lookup(ip_addr_t *local_ip, u16_t local_port)
+{
+  struct tcp_pcb_listen *lpcb;
+  struct tcp_pcb_listen *lpcb_any = NULL;
+
+  for (lpcb = tcp_listen_hash[tcp_hash_index(local_port)]; lpcb != NULL; lpcb = lpcb->hash_next) {
+    if (lpcb->local_port == local_port) {
+      if (ip_addr_cmp(&(lpcb->local_ip), local_ip)) {
+        return lpcb;
+      } else if (ip_addr_isany(&(lpcb->local_ip))) {
+        lpcb_any = lpcb;
+      }
+    }
+  }
+  return lpcb_any;
+}
+#endif /* TCP_PCB_HASH_SIZE */
+
 /** Timer counter to handle calling slow-timer from tcp_tmr() */ 
 static u8_t tcp_timer;
 static u16_t tcp_new_port(void);
@@ -916,6 +1049,7 @@ tcp_slowtmr(void)
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_active_pcbs, pcb);
 
       TCP_EVENT_ERR(pcb->errf, pcb->callback_arg, ERR_ABRT);
       if (pcb_reset) {
@@ -973,6 +1107,7 @@ tcp_slowtmr(void)
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_tw_pcbs", tcp_tw_pcbs == pcb);
         tcp_tw_pcbs = pcb->next;
       }
+      TCP_HASH_RMV(&tcp_tw_pcbs, pcb);
       pcb2 = pcb;
       pcb = pcb->next;
       memp_free(MEMP_TCP_PCB, pcb2);
@@ -91,12 +91,15 @@ static err_t tcp_timewait_input(struct tcp_pcb *pcb);
 void
 tcp_input(struct pbuf *p, struct netif *inp)
 {
-  struct tcp_pcb *pcb, *prev;
+  struct tcp_pcb *pcb;
   struct tcp_pcb_listen *lpcb;
+#if !TCP_PCB_HASH_SIZE
+  struct tcp_pcb *prev;
 #if SO_REUSE
   struct tcp_pcb *lpcb_prev = NULL;
   struct tcp_pcb_listen *lpcb_any = NULL;
 #endif /* SO_REUSE */
+#endif /* !TCP_PCB_HASH_SIZE */
   u8_t hdrlen;
   err_t err;
 
@@ -174,6 +177,26 @@ tcp_input(struct pbuf *p, struct netif *inp)
   flags = TCPH_FLAGS(tcphdr);
   tcplen = p->tot_len + ((flags & (TCP_FIN | TCP_SYN)) ? 1 : 0);
 
+#if TCP_PCB_HASH_SIZE
+  /* Demultiplex an incoming segment through the hash tables: an active
+     connection, else one in TIME-WAIT, else a listening PCB. */
+  pcb = tcp_pcb_hash_lookup(&current_iphdr_dest, tcphdr->dest, &current_iphdr_src, tcphdr->src);
+  if (pcb != NULL && pcb->state == TIME_WAIT) {
+    LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for TIME_WAITing connection.\n"));
+    tcp_timewait_input(pcb);
+    pbuf_free(p);
+    return;
+  }
+  if (pcb == NULL) {
+    lpcb = tcp_listen_hash_lookup(&current_iphdr_dest, tcphdr->dest);
+    if (lpcb != NULL) {
+      LWIP_DEBUGF(TCP_INPUT_DEBUG, ("tcp_input: packed for LISTENing connection.\n"));
+      tcp_listen_input(lpcb);
+      pbuf_free(p);
+      return;
+    }
+  }
+#else /* TCP_PCB_HASH_SIZE */
   /* Demultiplex an incoming segment. First, we check if it is destined
      for an active connection. */
   prev = NULL;
@@ -272,6 +295,7 @@ tcp_input(struct pbuf *p, struct netif *inp)
       return;
     }
   }
+#endif /* TCP_PCB_HASH_SIZE */
 
 #if TCP_INPUT_DEBUG
   LWIP_DEBUGF(TCP_INPUT_DEBUG, ("+-+-+-+-+-+-+-+-+-+-+-+-+-+- tcp_input: flags "));
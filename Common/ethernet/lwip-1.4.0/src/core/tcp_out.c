@@ -281,6 +281,157 @@ tcp_seg_add_chksum(u16_t chksum, u16_t len, u16_t *seg_chksum,
 }
 #endif /* TCP_CHECKSUM_ON_COPY */
 
+#if TCP_GSO
+/** Largest segment (data and options) tcp_write() builds: as many MSS
+ * sized pieces as fit into TCP_GSO_MAX_SIZE, but at least one. */
+static u16_t
+tcp_gso_seg_max(struct tcp_pcb *pcb, u8_t optlen)
+{
+  u16_t piece = pcb->mss - optlen;
+  u16_t n = TCP_GSO_MAX_SIZE / piece;
+
+  if (n == 0) {
+    n = 1;
+  }
+  return (u16_t)(n * piece + optlen);
+}
+#define TCP_WRITE_SEG_MAX(pcb, optlen) tcp_gso_seg_max(pcb, optlen)
+#else /* TCP_GSO */
+#define TCP_WRITE_SEG_MAX(pcb, optlen) ((pcb)->mss)
+#endif /* TCP_GSO */
+
+#if TCP_GSO
+
+/** Free function of the pbufs referencing segment payload */
+static void
+tcp_gso_free_pbuf_custom(struct pbuf *p)
+{
+  struct pbuf_custom_ref *pcr = (struct pbuf_custom_ref*)p;
+  LWIP_ASSERT("pcr != NULL", pcr != NULL);
+  LWIP_ASSERT("pcr == p", (void*)pcr == (void*)p);
+  if (pcr->original != NULL) {
+    pbuf_free(pcr->original);
+  }
+  memp_free(MEMP_TCP_GSO_PBUF, pcr);
+}
+
+/**
+ * Allocate a pbuf referencing len bytes of q, starting at offset.
+ * PBUF_ROM data outlives the segment anyway, any other pbuf is kept
+ * from being freed for as long as the reference exists.
+ *
+ * @return the new pbuf or NULL if out of memory
+ */
+static struct pbuf *
+tcp_gso_ref_pbuf(struct pbuf *q, u16_t offset, u16_t len)
+{
+  struct pbuf_custom_ref *pcr;
+  struct pbuf *r;
+
+  LWIP_ASSERT("tcp_gso_ref_pbuf: range inside q", offset + len <= q->len);
+  if (q->type == PBUF_ROM) {
+    r = pbuf_alloc(PBUF_RAW, len, PBUF_ROM);
+    if (r == NULL) {
+      return NULL;
+    }
+  } else {
+    pcr = (struct pbuf_custom_ref*)memp_malloc(MEMP_TCP_GSO_PBUF);
+    if (pcr == NULL) {
+      return NULL;
+    }
+    /* no payload_mem: pbuf_alloced_custom() would align it */
+    r = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &pcr->pc, NULL, len);
+    LWIP_ASSERT("tcp_gso_ref_pbuf: PBUF_RAW can't fail", r != NULL);
+    pbuf_ref(q);
+    pcr->original = q;
+    pcr->pc.custom_free_function = tcp_gso_free_pbuf_custom;
+  }
+  r->payload = (u8_t *)q->payload + offset;
+  return r;
+}
+
+/**
+ * Split a segment after len bytes of data, so that its head can be sent
+ * within the window. The head is copied into a segment of its own, which
+ * takes the place of seg, and the head data is cut off the front of the
+ * pbufs of seg, which becomes the tail behind it. No pbuf is shared
+ * between the two, so nothing is held for as long as either is queued.
+ *
+ * @param pcb the tcp_pcb seg is queued on (unsent)
+ * @param seg the segment to split, the head afterwards
+ * @param len data bytes to leave in seg, 0 < len < seg->len
+ * @return ERR_OK, or ERR_MEM with seg left as it was
+ */
+static err_t
+tcp_split_segment(struct tcp_pcb *pcb, struct tcp_seg *seg, u16_t len)
+{
+  struct tcp_seg *tail, tmp;
+  struct pbuf *p, *q;
+  u8_t optflags = seg->flags & (TF_SEG_OPTS_MSS | TF_SEG_OPTS_TS);
+  u8_t optlen = LWIP_TCP_OPT_LENGTH(optflags);
+  u16_t hdrlen = TCP_HLEN + optlen;
+  u16_t clen, cut, rest;
+
+  LWIP_ASSERT("tcp_split_segment: 0 < len < seg->len",
+              (len > 0) && (len < seg->len));
+
+  /* strip headers left from sending seg before */
+  cut = (u16_t)((u8_t *)seg->tcphdr - (u8_t *)seg->p->payload);
+  seg->p->payload = seg->tcphdr;
+  seg->p->len -= cut;
+  seg->p->tot_len -= cut;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, optlen + len, PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  pbuf_copy_partial(seg->p, (u8_t *)p->payload + optlen, len, hdrlen);
+  /* PSH and FIN go with the last byte; frees p on failure */
+  tail = tcp_create_segment(pcb, p, TCPH_FLAGS(seg->tcphdr) & ~(TCP_PSH | TCP_FIN),
+                            ntohl(seg->tcphdr->seqno), optflags);
+  if (tail == NULL) {
+    return ERR_MEM;
+  }
+  clen = pbuf_clen(seg->p);
+
+  /* cut the head data off the front of seg: what follows the header in
+     its first pbuf by moving the header up, then whole or part pbufs */
+  cut = LWIP_MIN(len, seg->p->len - hdrlen);
+  if (cut > 0) {
+    memmove((u8_t *)seg->tcphdr + cut, seg->tcphdr, hdrlen);
+    seg->p->payload = (u8_t *)seg->p->payload + cut;
+    seg->p->len -= cut;
+    seg->tcphdr = (struct tcp_hdr *)seg->p->payload;
+  }
+  for (rest = len - cut; rest > 0; ) {
+    q = seg->p->next;
+    if (q->len <= rest) {
+      seg->p->next = q->next;
+      q->next = NULL;
+      rest -= q->len;
+      pbuf_free(q);
+    } else {
+      q->payload = (u8_t *)q->payload + rest;
+      q->len -= rest;
+      q->tot_len -= rest;
+      rest = 0;
+    }
+  }
+  seg->p->tot_len = seg->p->len + (seg->p->next != NULL ? seg->p->next->tot_len : 0);
+  seg->tcphdr->seqno = htonl(ntohl(seg->tcphdr->seqno) + len);
+  seg->len -= len;
+
+  /* the caller holds seg: make it the head and the new segment the tail,
+     which keeps any spare room (TCP_OVERSIZE) of seg at the end */
+  tmp = *seg;
+  *seg = *tail;
+  *tail = tmp;
+  seg->next = tail;
+  pcb->snd_queuelen += pbuf_clen(seg->p) + pbuf_clen(tail->p) - clen;
+  return ERR_OK;
+}
+#endif /* TCP_GSO */
+
 /** Checks if tcp_write is allowed or not (checks state, snd_buf and snd_queuelen).
  *
  * @param pcb the tcp pcb to check for
@@ -424,7 +575,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 
     /* Usable space at the end of the last unsent segment */
     unsent_optlen = LWIP_TCP_OPT_LENGTH(last_unsent->flags);
-    space = pcb->mss - (last_unsent->len + unsent_optlen);
+    space = TCP_WRITE_SEG_MAX(pcb, unsent_optlen) - (last_unsent->len + unsent_optlen);
 
     /*
      * Phase 1: Copy data directly into an oversized pbuf.
@@ -456,10 +607,12 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
      * Phase 2: Chain a new pbuf to the end of pcb->unsent.
      *
      * We don't extend segments containing SYN/FIN flags or options
-     * (len==0). The new pbuf is kept in concat_p and pbuf_cat'ed at
-     * the end.
+     * (len==0), nor a segment put back for a fast retransmit, which
+     * does not end at snd_lbb. The new pbuf is kept in concat_p and
+     * pbuf_cat'ed at the end.
      */
-    if ((pos < len) && (space > 0) && (last_unsent->len > 0)) {
+    if ((pos < len) && (space > 0) && (last_unsent->len > 0) &&
+        (ntohl(last_unsent->tcphdr->seqno) + last_unsent->len == pcb->snd_lbb)) {
       u16_t seglen = space < len - pos ? space : len - pos;
       seg = last_unsent;
 
@@ -474,9 +627,6 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
                        seglen));
           goto memerr;
         }
-#if TCP_OVERSIZE_DBGCHECK
-        last_unsent->oversize_left = oversize;
-#endif /* TCP_OVERSIZE_DBGCHECK */
         TCP_DATA_COPY2(concat_p->payload, (u8_t*)arg + pos, seglen, &concat_chksum, &concat_chksum_swapped);
 #if TCP_CHECKSUM_ON_COPY
         concat_chksummed += seglen;
@@ -517,7 +667,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
   while (pos < len) {
     struct pbuf *p;
     u16_t left = len - pos;
-    u16_t max_len = pcb->mss - optlen;
+    u16_t max_len = TCP_WRITE_SEG_MAX(pcb, optlen) - optlen;
     u16_t seglen = left > max_len ? max_len : left;
 #if TCP_CHECKSUM_ON_COPY
     u16_t chksum = 0;
@@ -527,7 +677,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     if (apiflags & TCP_WRITE_FLAG_COPY) {
       /* If copy is set, memory should be allocated and data copied
        * into pbuf */
-      if ((p = tcp_pbuf_prealloc(PBUF_TRANSPORT, seglen + optlen, pcb->mss, &oversize, pcb, apiflags, queue == NULL)) == NULL) {
+      if ((p = tcp_pbuf_prealloc(PBUF_TRANSPORT, seglen + optlen, TCP_WRITE_SEG_MAX(pcb, optlen), &oversize, pcb, apiflags, queue == NULL)) == NULL) {
         LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_write : could not allocate memory for pbuf copy size %"U16_F"\n", seglen));
         goto memerr;
       }
@@ -644,8 +794,17 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
       (last_unsent != NULL));
     pbuf_cat(last_unsent->p, concat_p);
     last_unsent->len += concat_p->tot_len;
+#if TCP_OVERSIZE_DBGCHECK
+    /* after phase 1 took its share: with TCP_GSO, both can add to last_unsent */
+    last_unsent->oversize_left = oversize;
+#endif /* TCP_OVERSIZE_DBGCHECK */
 #if TCP_CHECKSUM_ON_COPY
     if (concat_chksummed) {
+      /* concat_chksum is byte swapped after an odd number of bytes, but
+         is added as one block starting at an even offset */
+      if (concat_chksum_swapped) {
+        concat_chksum = SWAP_BYTES_IN_WORD(concat_chksum);
+      }
       tcp_seg_add_chksum(concat_chksum, concat_chksummed, &last_unsent->chksum,
         &last_unsent->chksum_swapped);
       last_unsent->flags |= TF_SEG_DATA_CHECKSUMMED;
@@ -881,6 +1040,43 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+#if TCP_GSO
+/**
+ * Check if a segment may be sent within the window. A segment too large
+ * for it is split at the last MSS boundary that fits, if there is one.
+ *
+ * @param pcb the tcp_pcb seg is queued on (unsent)
+ * @param seg the segment to check
+ * @param wnd the usable window, relative to lastack
+ * @return 1 if seg (now) fits, 0 otherwise
+ */
+static u8_t
+tcp_output_fits(struct tcp_pcb *pcb, struct tcp_seg *seg, u32_t wnd)
+{
+  u32_t used = ntohl(seg->tcphdr->seqno) - pcb->lastack;
+  u8_t optlen = LWIP_TCP_OPT_LENGTH(seg->flags);
+  u16_t piece = pcb->mss - optlen;
+  u16_t len;
+
+  if (used + seg->len <= wnd) {
+    return 1;
+  }
+  if ((seg->len <= piece) || (used + piece > wnd)) {
+    return 0;
+  }
+  len = (u16_t)(((wnd - used) / piece) * piece);
+  if (tcp_split_segment(pcb, seg, len) == ERR_OK) {
+    return 1;
+  }
+  /* short of memory for a copy of the head, try a single piece */
+  return (len > piece) && (tcp_split_segment(pcb, seg, piece) == ERR_OK);
+}
+#define TCP_OUTPUT_FITS(pcb, seg, wnd) tcp_output_fits(pcb, seg, wnd)
+#else /* TCP_GSO */
+#define TCP_OUTPUT_FITS(pcb, seg, wnd) \
+  (ntohl((seg)->tcphdr->seqno) - (pcb)->lastack + (seg)->len <= (wnd))
+#endif /* TCP_GSO */
+
 /**
  * Find out what we can send and send it
  *
@@ -916,8 +1112,7 @@ tcp_output(struct tcp_pcb *pcb)
    * If data is to be sent, we will just piggyback the ACK (see below).
    */
   if (pcb->flags & TF_ACK_NOW &&
-     (seg == NULL ||
-      ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len > wnd)) {
+     (seg == NULL || !TCP_OUTPUT_FITS(pcb, seg, wnd))) {
      return tcp_send_empty_ack(pcb);
   }
 
@@ -950,7 +1145,7 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_CWND_DEBUG */
   /* data available and window allows it to be sent? */
   while (seg != NULL &&
-         ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len <= wnd) {
+         TCP_OUTPUT_FITS(pcb, seg, wnd)) {
     LWIP_ASSERT("RST not expected here!", 
                 (TCPH_FLAGS(seg->tcphdr) & TCP_RST) == 0);
     /* Stop sending if the nagle algorithm would prevent it
@@ -974,6 +1169,11 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_CWND_DEBUG */
 
     pcb->unsent = seg->next;
+#if TCP_OVERSIZE_DBGCHECK
+    /* spare room is only used in the last unsent segment, and this one
+       may come back to unsent by tcp_rexmit_rto() */
+    seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
 
     if (pcb->state != SYN_SENT) {
       TCPH_SET_FLAG(seg->tcphdr, TCP_ACK);
@@ -1025,8 +1225,11 @@ tcp_output(struct tcp_pcb *pcb)
   }
 #endif /* TCP_OVERSIZE */
 
-  if (seg != NULL && pcb->persist_backoff == 0 && 
-      ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len > pcb->snd_wnd) {
+  /* seg is left for the window (or with TCP_GSO, for lack of memory to
+     split it, the ACK of a probe gets us here again). Persist only with
+     nothing in flight: it stops the retransmission timer, and probes
+     repeat the first byte of unacked, which does not recover a loss. */
+  if (seg != NULL && pcb->persist_backoff == 0 && pcb->unacked == NULL) {
     /* prepare for persist timer */
     pcb->persist_cnt = 0;
     pcb->persist_backoff = 1;
@@ -1036,6 +1239,114 @@ tcp_output(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+#if TCP_GSO
+/**
+ * Called by tcp_output_segment() to send a segment longer than the MSS,
+ * with everything but the checksum of its TCP header filled in.
+ *
+ * A netif that cuts up segments itself (netif->gso_max_size) gets the
+ * whole segment with p->gso_size set and the pseudo header sum in the
+ * checksum field, as checksum offloading hardware expects. Any other
+ * netif gets MSS sized packets: a copy of the TCP header in a pbuf of its
+ * own, chained to pbufs referencing its part of the segment data, or to
+ * a copy of it while MEMP_NUM_TCP_GSO_PBUF is used up.
+ *
+ * @param seg the tcp_seg to send, seg->p->payload pointing to the TCP header
+ * @param pcb the tcp_pcb for the TCP connection used to send the segment
+ * @param piece data bytes per packet
+ */
+static void
+tcp_output_gso(struct tcp_seg *seg, struct tcp_pcb *pcb, u16_t piece)
+{
+  struct netif *netif;
+  struct pbuf *p, *q, *r;
+  struct tcp_hdr *tcphdr;
+  u16_t hdrlen = TCPH_HDRLEN(seg->tcphdr) * 4;
+  u16_t left, n, part, offset;
+
+  netif = ip_route(&(pcb->remote_ip));
+  if (netif == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG, ("tcp_output_gso: no route\n"));
+    IP_STATS_INC(ip.rterr);
+    return;
+  }
+#if LWIP_NETIF_HWADDRHINT
+  netif->addr_hint = &(pcb->addr_hint);
+#endif /* LWIP_NETIF_HWADDRHINT*/
+
+  if ((seg->p->tot_len <= netif->gso_max_size)
+#if ENABLE_LOOPBACK
+      /* looped back packets are checked by ip_input() as they are */
+      && !ip_addr_cmp(&(pcb->remote_ip), &(netif->ip_addr))
+#endif /* ENABLE_LOOPBACK */
+     ) {
+    seg->tcphdr->chksum = ~inet_chksum_pseudo_partial(seg->p, &(pcb->local_ip),
+           &(pcb->remote_ip), IP_PROTO_TCP, seg->p->tot_len, 0);
+    seg->p->gso_size = piece;
+    TCP_STATS_INC(tcp.xmit);
+    ip_output_if(seg->p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl,
+      pcb->tos, IP_PROTO_TCP, netif);
+  } else {
+    q = seg->p;
+    offset = hdrlen;
+    for (left = seg->len; left > 0; left -= n) {
+      n = LWIP_MIN(left, piece);
+      p = pbuf_alloc(PBUF_IP, hdrlen, PBUF_RAM);
+      if (p == NULL) {
+        break;
+      }
+      for (part = n; part > 0; part -= r->len) {
+        while (offset >= q->len) {
+          offset -= q->len;
+          q = q->next;
+        }
+        r = tcp_gso_ref_pbuf(q, offset, LWIP_MIN(part, q->len - offset));
+        if (r == NULL) {
+          break;
+        }
+        pbuf_cat(p, r);
+        offset += r->len;
+      }
+      if (part > 0) {
+        /* out of references: send a copy of the piece instead */
+        pbuf_free(p);
+        p = pbuf_alloc(PBUF_IP, hdrlen + n, PBUF_RAM);
+        if (p == NULL) {
+          break;
+        }
+        pbuf_copy_partial(seg->p, (u8_t *)p->payload + hdrlen, n, hdrlen + (seg->len - left));
+        offset += part;
+      }
+      tcphdr = (struct tcp_hdr *)p->payload;
+      SMEMCPY(tcphdr, seg->tcphdr, hdrlen);
+      tcphdr->seqno = htonl(ntohl(seg->tcphdr->seqno) + (seg->len - left));
+      if (n < left) {
+        /* PSH and FIN go with the last byte */
+        TCPH_UNSET_FLAG(tcphdr, TCP_PSH | TCP_FIN);
+      }
+      tcphdr->chksum = 0;
+#if CHECKSUM_GEN_TCP
+      tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip),
+             &(pcb->remote_ip), IP_PROTO_TCP, p->tot_len);
+#endif /* CHECKSUM_GEN_TCP */
+      TCP_STATS_INC(tcp.xmit);
+      ip_output_if(p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl,
+        pcb->tos, IP_PROTO_TCP, netif);
+      pbuf_free(p);
+    }
+    if (left > 0) {
+      /* the retransmission timer is running, the rest is sent again */
+      LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_output_gso: no memory.\n"));
+      TCP_STATS_INC(tcp.memerr);
+    }
+  }
+
+#if LWIP_NETIF_HWADDRHINT
+  netif->addr_hint = NULL;
+#endif /* LWIP_NETIF_HWADDRHINT*/
+}
+#endif /* TCP_GSO */
+
 /**
  * Called by tcp_output() to actually send a TCP segment over IP.
  *
@@ -1111,6 +1422,15 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 
   seg->p->payload = seg->tcphdr;
 
+#if TCP_GSO
+  if (seg->len > pcb->mss - (LWIP_TCP_OPT_LENGTH(seg->flags))) {
+    tcp_output_gso(seg, pcb, pcb->mss - (LWIP_TCP_OPT_LENGTH(seg->flags)));
+    return;
+  }
+  /* may be left from sending the segment before it was split */
+  seg->p->gso_size = 0;
+#endif /* TCP_GSO */
+
   seg->tcphdr->chksum = 0;
 #if CHECKSUM_GEN_TCP
 #if TCP_CHECKSUM_ON_COPY
@@ -1236,12 +1556,33 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
     return;
   }
 
+#if TCP_GSO
+  /* Merge all unacked segments into the unsent queue, in sequence order:
+     the tail of a segment split for a fast retransmit stays on unsent,
+     with later segments still unacked */
+  {
+    struct tcp_seg **cur_seg = &(pcb->unsent);
+    struct tcp_seg *next;
+
+    for (seg = pcb->unacked; seg != NULL; seg = next) {
+      next = seg->next;
+      while (*cur_seg &&
+        TCP_SEQ_LT(ntohl((*cur_seg)->tcphdr->seqno), ntohl(seg->tcphdr->seqno))) {
+          cur_seg = &((*cur_seg)->next);
+      }
+      seg->next = *cur_seg;
+      *cur_seg = seg;
+      cur_seg = &(seg->next);
+    }
+  }
+#else /* TCP_GSO */
   /* Move all unacked segments to the head of the unsent queue */
   for (seg = pcb->unacked; seg->next != NULL; seg = seg->next);
   /* concatenate unsent queue after unacked queue */
   seg->next = pcb->unsent;
   /* unsent queue is the concatenated queue (of unacked, unsent) */
   pcb->unsent = pcb->unacked;
+#endif /* TCP_GSO */
   /* unacked queue is now empty */
   pcb->unacked = NULL;
 
@@ -1439,10 +1780,11 @@ tcp_zero_window_probe(struct tcp_pcb *pcb)
     /* FIN segment, no data */
     TCPH_FLAGS_SET(tcphdr, TCP_ACK | TCP_FIN);
   } else {
-    /* Data segment, copy in one byte from the head of the unacked queue */
-    struct tcp_hdr *thdr = (struct tcp_hdr *)seg->p->payload;
+    /* Data segment, copy in one byte from the head of the unacked queue,
+       whose pbuf may still start with the headers it was last sent with */
     char *d = ((char *)p->payload + TCP_HLEN);
-    pbuf_copy_partial(seg->p, d, 1, TCPH_HDRLEN(thdr) * 4);
+    pbuf_copy_partial(seg->p, d, 1, (u16_t)((u8_t *)seg->tcphdr - (u8_t *)seg->p->payload) +
+                      TCPH_HDRLEN(seg->tcphdr) * 4);
   }
 
 #if CHECKSUM_GEN_TCP
@@ -42,6 +42,9 @@ LWIP_MEMPOOL(UDP_PCB,        MEMP_NUM_UDP_PCB,         sizeof(struct udp_pcb),
 LWIP_MEMPOOL(TCP_PCB,        MEMP_NUM_TCP_PCB,         sizeof(struct tcp_pcb),        "TCP_PCB")
 LWIP_MEMPOOL(TCP_PCB_LISTEN, MEMP_NUM_TCP_PCB_LISTEN,  sizeof(struct tcp_pcb_listen), "TCP_PCB_LISTEN")
 LWIP_MEMPOOL(TCP_SEG,        MEMP_NUM_TCP_SEG,         sizeof(struct tcp_seg),        "TCP_SEG")
+#if TCP_GSO
+LWIP_MEMPOOL(TCP_GSO_PBUF,   MEMP_NUM_TCP_GSO_PBUF,    sizeof(struct pbuf_custom_ref),"TCP_GSO_PBUF")
+#endif /* TCP_GSO */
 #endif /* LWIP_TCP */
 
 #if IP_REASSEMBLY
@@ -190,6 +190,11 @@ struct netif {
   char name[2];
   /** number of this interface */
   u8_t num;
+#if TCP_GSO
+  /** largest TCP segment (TCP header included) this netif cuts into MTU
+   *  sized packets itself, 0 if it can't (see pbuf->gso_size) */
+  u16_t gso_max_size;
+#endif /* TCP_GSO */
 #if LWIP_SNMP
   /** link type (from "snmp_ifType" enum from snmp.h) */
   u8_t link_type;
@@ -286,6 +286,17 @@
 #define MEMP_NUM_FRAG_PBUF              15
 #endif
 
+/**
+ * MEMP_NUM_TCP_GSO_PBUF: the number of pbufs referencing the payload of a
+ * large TCP segment, for the pieces tcp_output_segment() cuts it into. Only
+ * used with TCP_GSO==1. They are freed once a piece is sent, so as with
+ * MEMP_NUM_FRAG_PBUF a few are enough unless a DMA-enabled MAC holds on to
+ * sent packets; pieces are copied while none is left.
+ */
+#ifndef MEMP_NUM_TCP_GSO_PBUF
+#define MEMP_NUM_TCP_GSO_PBUF           16
+#endif
+
 /**
  * MEMP_NUM_ARP_QUEUE: the number of simulateously queued outgoing
  * packets (pbufs) that are waiting for an ARP request (to resolve
@@ -994,6 +1005,17 @@
 #define TCP_DEFAULT_LISTEN_BACKLOG      0xff
 #endif
 
+/**
+ * TCP_PCB_HASH_SIZE: Number of buckets of the hash tables tcp_input() uses
+ * to find the pcb of a segment: one on the 4-tuple for active and TIME-WAIT
+ * pcbs, one on the local port for listen pcbs. Must be a power of 2.
+ * Costs two pointers per bucket and one per pcb.
+ * 0: walk the pcb lists instead (old behaviour).
+ */
+#ifndef TCP_PCB_HASH_SIZE
+#define TCP_PCB_HASH_SIZE               0
+#endif
+
 /**
  * TCP_OVERSIZE: The maximum number of bytes that tcp_write may
  * allocate ahead of time in an attempt to create shorter pbuf chains
@@ -1012,6 +1034,29 @@
 #define TCP_OVERSIZE                    TCP_MSS
 #endif
 
+/**
+ * TCP_GSO==1: Let tcp_write() build segments of up to TCP_GSO_MAX_SIZE
+ * bytes, a whole number of MSS sized pieces, so that bulk data costs one
+ * tcp_seg and one pbuf per large segment instead of one per MSS. Such a
+ * segment is handed in one piece to a netif that sets gso_max_size, which
+ * cuts it up itself (TSO), and is cut up by tcp_output_segment() for all
+ * other netifs, with a fresh header per piece and the payload referenced
+ * rather than copied. Segments larger than the send window are split at
+ * an MSS boundary before they are sent, the part sent being copied. Data is not summed on copy with
+ * TCP_GSO (see LWIP_CHECKSUM_ON_COPY), as the sums are per piece.
+ */
+#ifndef TCP_GSO
+#define TCP_GSO                         0
+#endif
+
+/**
+ * TCP_GSO_MAX_SIZE: Largest amount of data in one segment with TCP_GSO.
+ * The segment and its headers must fit into a pbuf, so at most 65000.
+ */
+#ifndef TCP_GSO_MAX_SIZE
+#define TCP_GSO_MAX_SIZE                (16 * TCP_MSS)
+#endif
+
 /**
  * LWIP_TCP_TIMESTAMPS==1: support the TCP timestamp option.
  */
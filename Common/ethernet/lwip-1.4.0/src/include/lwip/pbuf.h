@@ -40,9 +40,13 @@
 extern "C" {
 #endif
 
-/** Currently, the pbuf_custom code is only needed for one specific configuration
- * of IP_FRAG */
-#define LWIP_SUPPORT_CUSTOM_PBUF (IP_FRAG && !IP_FRAG_USES_STATIC_BUF && !LWIP_NETIF_TX_SINGLE_PBUF)
+/** The pbuf_custom code is needed by IP_FRAG in one specific configuration.
+ * Drivers that wrap their own receive buffers in custom pbufs can enable it
+ * in lwipopts.h. */
+#ifndef LWIP_SUPPORT_CUSTOM_PBUF
+#define LWIP_SUPPORT_CUSTOM_PBUF ((IP_FRAG && !IP_FRAG_USES_STATIC_BUF && !LWIP_NETIF_TX_SINGLE_PBUF) || \
+                                  (LWIP_TCP && TCP_GSO))
+#endif
 
 #define PBUF_TRANSPORT_HLEN 20
 #define PBUF_IP_HLEN        20
@@ -101,6 +105,15 @@ struct pbuf {
    * the stack itself, or pbuf->next pointers from a chain.
    */
   u16_t ref;
+
+#if TCP_GSO
+  /**
+   * For the netif, only valid in the first pbuf of a packet: 0 to send the
+   * packet as it is, else it holds a TCP segment larger than the MTU that
+   * the netif must cut into pieces of gso_size data bytes.
+   */
+  u16_t gso_size;
+#endif /* TCP_GSO */
 };
 
 #if LWIP_SUPPORT_CUSTOM_PBUF
@@ -114,6 +127,16 @@ struct pbuf_custom {
   /** This function is called when pbuf_free deallocates this pbuf(_custom) */
   pbuf_free_custom_fn custom_free_function;
 };
+
+/** A custom pbuf that holds a reference to another pbuf, which is freed
+ * when this custom pbuf is freed. This is used to create a custom PBUF_REF
+ * that points into the original pbuf. */
+struct pbuf_custom_ref {
+  /** 'base class' */
+  struct pbuf_custom pc;
+  /** pointer to the original pbuf that is referenced */
+  struct pbuf *original;
+};
 #endif /* LWIP_SUPPORT_CUSTOM_PBUF */
 
 /* Initializes the pbuf module. This call is empty for now, but may not be in future. */
@@ -140,6 +163,7 @@ struct pbuf *pbuf_coalesce(struct pbuf *p, pbuf_layer layer);
 #if LWIP_CHECKSUM_ON_COPY
 err_t pbuf_fill_chksum(struct pbuf *p, u16_t start_offset, const void *dataptr,
                        u16_t len, u16_t *chksum);
+err_t pbuf_copy_chksum(struct pbuf *buf, const void *dataptr, u16_t len, u16_t *chksum);
 #endif /* LWIP_CHECKSUM_ON_COPY */
 
 u8_t pbuf_get_at(struct pbuf* p, u16_t offset);
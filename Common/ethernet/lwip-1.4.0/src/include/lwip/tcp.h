@@ -151,11 +151,18 @@ enum tcp_state {
 #define DEF_ACCEPT_CALLBACK
 #endif /* LWIP_CALLBACK_API */
 
+#if TCP_PCB_HASH_SIZE
+#define DEF_HASH_NEXT(type)  type *hash_next; /* for the hash bucket */
+#else /* TCP_PCB_HASH_SIZE */
+#define DEF_HASH_NEXT(type)
+#endif /* TCP_PCB_HASH_SIZE */
+
 /**
  * members common to struct tcp_pcb and struct tcp_listen_pcb
  */
 #define TCP_PCB_COMMON(type) \
   type *next; /* for the linked list */ \
+  DEF_HASH_NEXT(type) \
   enum tcp_state state; /* TCP state */ \
   u8_t prio; \
   void *callback_arg; \
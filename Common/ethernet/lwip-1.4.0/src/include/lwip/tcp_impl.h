@@ -180,7 +180,7 @@ PACK_STRUCT_END
 #define TCPH_HDRLEN_FLAGS_SET(phdr, len, flags) (phdr)->_hdrlen_rsvd_flags = htons(((len) << 12) | (flags))
 
 #define TCPH_SET_FLAG(phdr, flags ) (phdr)->_hdrlen_rsvd_flags = ((phdr)->_hdrlen_rsvd_flags | htons(flags))
-#define TCPH_UNSET_FLAG(phdr, flags) (phdr)->_hdrlen_rsvd_flags = htons(ntohs((phdr)->_hdrlen_rsvd_flags) | (TCPH_FLAGS(phdr) & ~(flags)) )
+#define TCPH_UNSET_FLAG(phdr, flags) (phdr)->_hdrlen_rsvd_flags = htons(ntohs((phdr)->_hdrlen_rsvd_flags) & ~(flags))
 
 #define TCP_TCPLEN(seg) ((seg)->len + ((TCPH_FLAGS((seg)->tcphdr) & (TCP_FIN | TCP_SYN)) != 0))
 
@@ -271,8 +271,9 @@ PACK_STRUCT_END
 #define TCP_OVERSIZE_DBGCHECK 0
 #endif
 
-/** Don't generate checksum on copy if CHECKSUM_GEN_TCP is disabled */
-#define TCP_CHECKSUM_ON_COPY  (LWIP_CHECKSUM_ON_COPY && CHECKSUM_GEN_TCP)
+/** Don't generate checksum on copy if CHECKSUM_GEN_TCP is disabled, nor
+ * with TCP_GSO: large segments are summed by the netif or per piece */
+#define TCP_CHECKSUM_ON_COPY  (LWIP_CHECKSUM_ON_COPY && CHECKSUM_GEN_TCP && !TCP_GSO)
 
 /* This structure represents a TCP segment on the unsent, unacked and ooseq queues */
 struct tcp_seg {
@@ -330,6 +331,29 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
    3) All PCBs in the tcp_listen_pcbs list is in LISTEN state.
    4) All PCBs in the tcp_tw_pcbs list is in TIME-WAIT state.
 */
+#if TCP_PCB_HASH_SIZE
+#if TCP_PCB_HASH_SIZE & (TCP_PCB_HASH_SIZE - 1)
+#error "TCP_PCB_HASH_SIZE must be a power of 2"
+#endif
+/* Hash tables of the active and TIME-WAIT PCBs (4-tuple) and of the
+   LISTEN PCBs (local port), kept in step with the lists by TCP_REG and
+   TCP_RMV so tcp_input() does not walk the lists. */
+extern struct tcp_pcb *tcp_pcb_hash[TCP_PCB_HASH_SIZE];
+extern struct tcp_pcb_listen *tcp_listen_hash[TCP_PCB_HASH_SIZE];
+
+void tcp_pcb_hash_add(struct tcp_pcb **pcbs, struct tcp_pcb *pcb);
+void tcp_pcb_hash_remove(struct tcp_pcb **pcbs, struct tcp_pcb *pcb);
+struct tcp_pcb *tcp_pcb_hash_lookup(ip_addr_t *local_ip, u16_t local_port,
+                                    ip_addr_t *remote_ip, u16_t remote_port);
+struct tcp_pcb_listen *tcp_listen_hash_lookup(ip_addr_t *local_ip, u16_t local_port);
+
+#define TCP_HASH_ADD(pcbs, npcb) tcp_pcb_hash_add((pcbs), (npcb))
+#define TCP_HASH_RMV(pcbs, npcb) tcp_pcb_hash_remove((pcbs), (npcb))
+#else /* TCP_PCB_HASH_SIZE */
+#define TCP_HASH_ADD(pcbs, npcb)
+#define TCP_HASH_RMV(pcbs, npcb)
+#endif /* TCP_PCB_HASH_SIZE */
+
 /* Define two macros, TCP_REG and TCP_RMV that registers a TCP PCB
    with a PCB list or removes a PCB from a list, respectively. */
 #ifndef TCP_DEBUG_PCB_LISTS
@@ -347,6 +371,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_HASH_ADD(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -362,6 +387,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_HASH_RMV(pcbs, npcb); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (npcb), *(pcbs))); \
                             } while(0)
@@ -372,6 +398,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_HASH_ADD(pcbs, npcb);                      \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -391,6 +418,7 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_HASH_RMV(pcbs, npcb);                      \
   } while(0)
 
 #endif /* LWIP_DEBUG */
@@ -1039,6 +1039,11 @@ etharp_query(struct netif *netif, ip_addr_t *ipaddr, struct pbuf *q)
           pbuf_free(p);
           p = NULL;
         }
+#if TCP_GSO
+        else {
+          p->gso_size = q->gso_size;
+        }
+#endif /* TCP_GSO */
       }
     } else {
       /* referencing the old pbuf is enough */
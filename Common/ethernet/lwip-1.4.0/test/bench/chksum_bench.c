@@ -0,0 +1,173 @@
+/*
+ * chksum_bench.c - throughput of the Internet checksum kernels.
+ *
+ * inet_chksum() (LWIP_CHKSUM) and lwip_chksum_copy() (LWIP_CHKSUM_COPY) are
+ * checked against a bytewise RFC1071 sum for every length up to 300 at 32
+ * start offsets, then timed from 20 bytes to 64 KB, at an aligned and an
+ * odd start address. pbuf_copy_chksum() is checked over pbuf chains.
+ *
+ * Build and run from this folder, choosing the kernels, e.g. the default
+ * ones against the 64-bit, vector and single pass copy ones:
+ *   gcc -O2 -I../../ports/linux/include -I. -I../../src/include -I../../src/include/ipv4 \
+ *       [-DLWIP_CHKSUM_ALGORITHM=4|5 [-mavx2]] [-DLWIP_CHKSUM_COPY_ALGORITHM=2] \
+ *       -o chksum_bench chksum_bench.c $(ls ../../src/core/{,ipv4/}[a-z]*.c)
+ *   ./chksum_bench
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lwip/init.h"
+#include "lwip/pbuf.h"
+#include "lwip/inet_chksum.h"
+
+#ifndef LWIP_CHKSUM_ALGORITHM
+#define LWIP_CHKSUM_ALGORITHM 2 /* default of inet_chksum.c */
+#endif
+
+#define BENCH_MAX_LEN          0xffff
+#define BENCH_CHECK_LEN        300
+#define BENCH_CHECK_OFFSETS    32
+#define BENCH_BYTES_PER_RUN    (256UL * 1024 * 1024) /* Summed per measurement */
+
+static u8_t src_buf[BENCH_MAX_LEN + 64] __attribute__((aligned(64)));
+static u8_t dst_buf[BENCH_MAX_LEN + 64] __attribute__((aligned(64)));
+static volatile u16_t sink;
+
+u32_t
+sys_now(void)
+{
+  return 0;
+}
+
+/** Reference: RFC1071, bytewise, inverted like inet_chksum() */
+static u16_t
+bench_ref_chksum(const u8_t *p, u32_t len)
+{
+  u32_t acc = 0;
+
+  for (; len > 1; len -= 2, p += 2) {
+    acc += (p[0] << 8) | p[1];
+  }
+  if (len > 0) {
+    acc += p[0] << 8;
+  }
+  while (acc >> 16) {
+    acc = (acc >> 16) + (acc & 0xffff);
+  }
+  return (u16_t)~htons((u16_t)acc);
+}
+
+static double
+bench_ns(const struct timespec *start, const struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static int
+bench_check(void)
+{
+  u32_t len, offset, i;
+  u16_t ref, chksum;
+  struct pbuf *p;
+
+  for (len = 0; len <= BENCH_CHECK_LEN; len++) {
+    for (offset = 0; offset < BENCH_CHECK_OFFSETS; offset++) {
+      ref = bench_ref_chksum(&src_buf[offset], len);
+      if (inet_chksum(&src_buf[offset], (u16_t)len) != ref) {
+        printf("FAIL inet_chksum len %u offset %u\n", (unsigned)len, (unsigned)offset);
+        return 0;
+      }
+      /* same and different offsets of source and destination */
+      for (i = 0; i < 2; i++) {
+        u8_t *dst = &dst_buf[i ? offset : (offset + 3) % BENCH_CHECK_OFFSETS];
+        memset(dst_buf, 0, BENCH_CHECK_LEN + 2 * BENCH_CHECK_OFFSETS);
+        if ((u16_t)~LWIP_CHKSUM_COPY(dst, &src_buf[offset], (u16_t)len) != ref ||
+            memcmp(dst, &src_buf[offset], len) != 0) {
+          printf("FAIL lwip_chksum_copy len %u offset %u\n", (unsigned)len, (unsigned)offset);
+          return 0;
+        }
+      }
+    }
+  }
+
+  /* Odd and even pbuf lengths in a chain */
+  for (len = 1; len < 9000; len += 997) {
+    for (i = 1; i <= 3; i++) {
+      p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_RAM);
+      if (len > i * 7) {
+        pbuf_realloc(p, (u16_t)(i * 7));
+        pbuf_cat(p, pbuf_alloc(PBUF_RAW, (u16_t)(len - i * 7), PBUF_POOL));
+      }
+      if (pbuf_copy_chksum(p, &src_buf[i], (u16_t)len, &chksum) != ERR_OK ||
+          (u16_t)~chksum != bench_ref_chksum(&src_buf[i], len) ||
+          inet_chksum_pbuf(p) != (u16_t)~chksum) {
+        printf("FAIL pbuf_copy_chksum len %u\n", (unsigned)len);
+        return 0;
+      }
+      pbuf_free(p);
+    }
+  }
+  return 1;
+}
+
+static void
+bench_run(u32_t len, u32_t offset)
+{
+  struct timespec start, end;
+  u32_t n = BENCH_BYTES_PER_RUN / len + 1;
+  u32_t i;
+  double sum_ns, copy_ns, memcpy_ns;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < n; i++) {
+    sink = inet_chksum(&src_buf[offset], (u16_t)len);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  sum_ns = bench_ns(&start, &end) / n;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < n; i++) {
+    sink = LWIP_CHKSUM_COPY(&dst_buf[offset], &src_buf[offset], (u16_t)len);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  copy_ns = bench_ns(&start, &end) / n;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < n; i++) {
+    memcpy(&dst_buf[offset], &src_buf[offset], len);
+    sink = dst_buf[offset];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  memcpy_ns = bench_ns(&start, &end) / n;
+
+  printf("%6u %6u %10.1f %8.2f %10.1f %8.2f %10.1f\n", (unsigned)len, (unsigned)offset,
+         sum_ns, len / sum_ns, copy_ns, len / copy_ns, memcpy_ns);
+}
+
+int
+main(void)
+{
+  static const u32_t lens[] = {20, 40, 64, 128, 256, 576, 1460, 1500, 4096, 9000, 16384, 32768, BENCH_MAX_LEN};
+  u32_t i;
+  int ok;
+
+  lwip_init();
+  for (i = 0; i < sizeof(src_buf); i++) {
+    src_buf[i] = (u8_t)(i * 167 + (i >> 8) * 13 + 0xa5);
+  }
+
+  printf("LWIP_CHKSUM_ALGORITHM %d, LWIP_CHKSUM_COPY_ALGORITHM %d\n",
+         LWIP_CHKSUM_ALGORITHM, LWIP_CHKSUM_COPY_ALGORITHM);
+  ok = bench_check();
+  if (ok) {
+    printf("   len offset   chksum ns     GB/s    copy ns     GB/s  memcpy ns\n");
+    for (i = 0; i < sizeof(lens)/sizeof(lens[0]); i++) {
+      bench_run(lens[i], 0);
+      bench_run(lens[i], 1);
+    }
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
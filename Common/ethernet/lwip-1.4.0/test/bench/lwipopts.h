@@ -0,0 +1,34 @@
+/*
+ * lwIP options of the host benchmarks: raw API only, no OS, no ARP.
+ * The frames go straight to ip_input() and the replies are captured by
+ * the benchmark netif. TCP_PCB_HASH_SIZE, TCP_GSO and the
+ * LWIP_CHKSUM_ALGORITHM and LWIP_CHKSUM_COPY_ALGORITHM choices are left
+ * to the command line.
+ */
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+#define NO_SYS                          1
+#define LWIP_SOCKET                     0
+#define LWIP_NETCONN                    0
+#define LWIP_ARP                        0
+#define LWIP_STATS                      0
+#define LWIP_CHECKSUM_ON_COPY           1
+
+#define MEM_ALIGNMENT                   8
+#define MEM_SIZE                        (1024 * 1024)
+
+/* One PCB per flow, a few listeners */
+#define MEMP_NUM_TCP_PCB                4096
+#define MEMP_NUM_TCP_PCB_LISTEN         16
+#define MEMP_NUM_TCP_SEG                256
+#define MEMP_NUM_PBUF                   256
+#define PBUF_POOL_SIZE                  256
+
+#define LWIP_TCP                        1
+#define TCP_MSS                         1460
+#define TCP_WND                         (4 * TCP_MSS)
+/* Room for large segments in bulk transfers */
+#define TCP_SND_BUF                     (32 * TCP_MSS)
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,430 @@
+/*
+ * tcp_demux_bench.c - cost of tcp_input() demultiplexing against the
+ * number of open connections.
+ *
+ * Every flow is opened through the real three way handshake against a
+ * listening PCB, so the PCB lists and hash tables hold what a server
+ * would. Then pure ACK segments of the flows are replayed through
+ * ip_input() and the time per segment is reported. Last, one data byte
+ * per flow must reach the recv callback of that flow's own PCB.
+ *
+ * The flows and their order come from a pcap file (Ethernet, Linux
+ * cooked or raw IPv4 captures, TCP only). Remote addresses and ports are
+ * kept, the local side is mapped onto the benchmark netif address. The
+ * side that sent the first SYN (or else the first packet) is the remote
+ * one. Without a file, 16 to 4000 flows over four server ports are
+ * generated and replayed in random order.
+ *
+ * Build and run from this folder, once with the PCB lists and once with
+ * the hash tables:
+ *   gcc -O2 -I../../ports/linux/include -I. -I../../src/include -I../../src/include/ipv4 [-DTCP_PCB_HASH_SIZE=1024]
+ *       -o tcp_demux_bench tcp_demux_bench.c $(ls ../../src/core/{,ipv4/}[a-z]*.c)
+ *   ./tcp_demux_bench [file.pcap]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/ip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/inet_chksum.h"
+
+#define BENCH_MAX_FLOWS        (MEMP_NUM_TCP_PCB - 1)
+#define BENCH_MIN_SEGMENTS     2000000UL /* Replayed per measurement */
+#define BENCH_MAX_PACKETS      (1UL << 22) /* Taken from a pcap file */
+#define BENCH_FLOW_HASH        8192 /* Flow table of the pcap reader, > BENCH_MAX_FLOWS */
+#define BENCH_FRAME_LEN        (IP_HLEN + TCP_HLEN)
+#define BENCH_CLIENT_ISS       1000UL
+
+/** One connection, remote side is the traffic source */
+struct bench_flow {
+  ip_addr_t remote_ip;
+  u16_t remote_port;
+  u16_t local_port;
+  u32_t server_iss;    /* from our SYN-ACK */
+  u32_t received;      /* data bytes delivered to this flow's PCB */
+  u8_t frame[BENCH_FRAME_LEN]; /* pure ACK, replayed */
+};
+
+static struct netif bench_netif;
+static ip_addr_t local_ip;
+static struct bench_flow flows[BENCH_MAX_FLOWS];
+static u16_t num_flows;
+static u16_t *replay;  /* flow of every replayed packet */
+static u32_t num_replay;
+
+/* Handshake state */
+static struct bench_flow *accepting;
+static u32_t captured_seqno;
+static u8_t captured_flags;
+
+u32_t
+sys_now(void)
+{
+  return 0; /* timers are not run */
+}
+
+/** Netif output: keeps the sequence number and flags of the last segment */
+static err_t
+bench_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  u8_t hdr[BENCH_FRAME_LEN];
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)&hdr[IP_HLEN];
+
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+  if (pbuf_copy_partial(p, hdr, sizeof(hdr), 0) == sizeof(hdr)) {
+    captured_seqno = ntohl(tcphdr->seqno);
+    captured_flags = TCPH_FLAGS(tcphdr);
+  }
+  return ERR_OK;
+}
+
+static err_t
+bench_netif_init(struct netif *netif)
+{
+  netif->output = bench_output;
+  netif->mtu = 1500;
+  return ERR_OK;
+}
+
+/** Builds an IPv4 + TCP segment from the remote side of a flow */
+static void
+bench_frame(struct bench_flow *flow, u8_t flags, u32_t seqno, u32_t ackno,
+            const u8_t *data, u16_t len, u8_t *out)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_IP, TCP_HLEN + len, PBUF_RAM);
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)p->payload;
+  struct ip_hdr *iphdr;
+
+  memset(tcphdr, 0, TCP_HLEN);
+  tcphdr->src = htons(flow->remote_port);
+  tcphdr->dest = htons(flow->local_port);
+  tcphdr->seqno = htonl(seqno);
+  tcphdr->ackno = htonl(ackno);
+  TCPH_HDRLEN_FLAGS_SET(tcphdr, TCP_HLEN / 4, flags);
+  tcphdr->wnd = htons(TCP_WND);
+  MEMCPY((u8_t *)tcphdr + TCP_HLEN, data, len);
+  tcphdr->chksum = inet_chksum_pseudo(p, &flow->remote_ip, &local_ip, IP_PROTO_TCP, p->tot_len);
+
+  pbuf_header(p, IP_HLEN);
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHLTOS_SET(iphdr, 4, IP_HLEN / 4, 0);
+  IPH_LEN_SET(iphdr, htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_TCP);
+  ip_addr_copy(iphdr->src, flow->remote_ip);
+  ip_addr_copy(iphdr->dest, local_ip);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  pbuf_copy_partial(p, out, p->tot_len, 0);
+  pbuf_free(p);
+}
+
+/** Hands a frame to the stack like a driver would */
+static void
+bench_input(const u8_t *frame, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+
+  LWIP_ASSERT("bench_input: pbuf pool empty", p != NULL);
+  pbuf_take(p, frame, len);
+  bench_netif.input(p, &bench_netif);
+}
+
+static err_t
+bench_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct bench_flow *flow = (struct bench_flow *)arg;
+
+  LWIP_UNUSED_ARG(err);
+  if (p != NULL) {
+    flow->received += p->tot_len;
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+  }
+  return ERR_OK;
+}
+
+static err_t
+bench_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  tcp_arg(newpcb, accepting);
+  tcp_recv(newpcb, bench_recv);
+  return ERR_OK;
+}
+
+/** Listens on port if no PCB does yet */
+static int
+bench_listen(u16_t port)
+{
+  struct tcp_pcb_listen *lpcb;
+  struct tcp_pcb *pcb;
+
+  for (lpcb = tcp_listen_pcbs.listen_pcbs; lpcb != NULL; lpcb = lpcb->next) {
+    if (lpcb->local_port == port) {
+      return 1;
+    }
+  }
+  pcb = tcp_new();
+  if (pcb == NULL || tcp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK ||
+      (pcb = tcp_listen(pcb)) == NULL) {
+    return 0;
+  }
+  tcp_accept(pcb, bench_accept);
+  return 1;
+}
+
+/** SYN, SYN-ACK, ACK. Leaves the pure ACK of the flow in flow->frame */
+static int
+bench_open(struct bench_flow *flow)
+{
+  u8_t frame[BENCH_FRAME_LEN];
+
+  if (!bench_listen(flow->local_port)) {
+    return 0;
+  }
+  accepting = flow;
+  captured_flags = 0;
+  bench_frame(flow, TCP_SYN, BENCH_CLIENT_ISS, 0, NULL, 0, frame);
+  bench_input(frame, sizeof(frame));
+  if (captured_flags != (TCP_SYN | TCP_ACK)) {
+    return 0;
+  }
+  flow->server_iss = captured_seqno;
+  bench_frame(flow, TCP_ACK, BENCH_CLIENT_ISS + 1, flow->server_iss + 1, NULL, 0, flow->frame);
+  bench_input(flow->frame, BENCH_FRAME_LEN);
+  return 1;
+}
+
+/** Replays the ACKs of replay[] until BENCH_MIN_SEGMENTS, returns ns per segment */
+static double
+bench_replay(u32_t *segments)
+{
+  struct timespec start, end;
+  u32_t i, n = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (n < BENCH_MIN_SEGMENTS) {
+    for (i = 0; i < num_replay; i++) {
+      bench_input(flows[replay[i]].frame, BENCH_FRAME_LEN);
+    }
+    n += num_replay;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  *segments = n;
+  return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / n;
+}
+
+/** One data byte per flow, each must reach its own PCB */
+static int
+bench_check(void)
+{
+  u8_t frame[BENCH_FRAME_LEN + 1];
+  u8_t byte = 0x5a;
+  u16_t i;
+
+  for (i = 0; i < num_flows; i++) {
+    bench_frame(&flows[i], TCP_ACK | TCP_PSH, BENCH_CLIENT_ISS + 1, flows[i].server_iss + 1, &byte, 1, frame);
+    bench_input(frame, sizeof(frame));
+  }
+  for (i = 0; i < num_flows; i++) {
+    if (flows[i].received != 1) {
+      printf("FAIL flow %u got %u bytes\n", i, (unsigned)flows[i].received);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static u32_t
+bench_rand(void)
+{
+  static u32_t state = 12345;
+
+  state = state * 1103515245UL + 12345;
+  return state >> 8;
+}
+
+/** Generated flows: 10.1.x.y:1024+ to four server ports, random order */
+static int
+bench_generated(void)
+{
+  static const u16_t counts[] = {16, 64, 256, 1024, 4000};
+  static const u16_t ports[] = {80, 443, 1883, 8080};
+  u32_t segments;
+  double ns;
+  u16_t c;
+  u32_t i;
+
+  replay = (u16_t *)malloc(BENCH_MIN_SEGMENTS * sizeof(replay[0]));
+  for (c = 0; c < sizeof(counts)/sizeof(counts[0]) && counts[c] <= BENCH_MAX_FLOWS; c++) {
+    for (; num_flows < counts[c]; num_flows++) {
+      struct bench_flow *flow = &flows[num_flows];
+      IP4_ADDR(&flow->remote_ip, 10, 1, num_flows >> 8, num_flows & 0xff);
+      flow->remote_port = 1024 + num_flows;
+      flow->local_port = ports[num_flows % 4];
+      if (!bench_open(flow)) {
+        printf("FAIL cannot open flow %u\n", num_flows);
+        return 0;
+      }
+    }
+    num_replay = BENCH_MIN_SEGMENTS;
+    for (i = 0; i < num_replay; i++) {
+      replay[i] = (u16_t)(bench_rand() % num_flows);
+    }
+    ns = bench_replay(&segments);
+    printf("%6u flows: %u segments, %.1f ns/segment\n", num_flows, (unsigned)segments, ns);
+  }
+  return bench_check();
+}
+
+static u32_t
+bench_rd32(const u8_t *b, int swap)
+{
+  return swap ? ((u32_t)b[0] << 24) | ((u32_t)b[1] << 16) | ((u32_t)b[2] << 8) | b[3]
+              : ((u32_t)b[3] << 24) | ((u32_t)b[2] << 16) | ((u32_t)b[1] << 8) | b[0];
+}
+
+/** Flow of a packet, added if new. remote/local as seen from the remote side */
+static int
+bench_flow_of(u32_t src, u16_t sport, u32_t dst, u16_t dport, int syn, u16_t *table)
+{
+  u32_t key[2][3] = {{src, sport, dport}, {dst, dport, sport}};
+  u32_t h;
+  int dir;
+  struct bench_flow *flow;
+
+  /* Known in either direction */
+  for (dir = syn ? 0 : 1; dir >= 0; dir--) {
+    for (h = (key[dir][0] ^ (key[dir][1] << 16) ^ key[dir][2]) * 2654435761UL % BENCH_FLOW_HASH;
+         table[h] != 0; h = (h + 1) % BENCH_FLOW_HASH) {
+      flow = &flows[table[h] - 1];
+      if (ip4_addr_get_u32(&flow->remote_ip) == key[dir][0] &&
+          flow->remote_port == key[dir][1] && flow->local_port == key[dir][2]) {
+        return table[h] - 1;
+      }
+    }
+  }
+  if (num_flows == BENCH_MAX_FLOWS) {
+    return -1;
+  }
+  /* h is the free slot of key[0] */
+  flow = &flows[num_flows];
+  ip4_addr_set_u32(&flow->remote_ip, src);
+  flow->remote_port = sport;
+  flow->local_port = dport;
+  table[h] = ++num_flows;
+  return num_flows - 1;
+}
+
+/** Flows and packet order from a pcap file */
+static int
+bench_pcap(const char *name)
+{
+  static u16_t table[BENCH_FLOW_HASH];
+  u8_t hdr[24], rec[16], pkt[65536];
+  FILE *f = fopen(name, "rb");
+  u32_t magic, linktype, caplen, skipped = 0;
+  int swap, flow;
+  u16_t ethertype;
+  u8_t *ip, *tcp;
+  u32_t segments, i;
+  double ns;
+
+  if (f == NULL || fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr)) {
+    printf("FAIL cannot read %s\n", name);
+    return 0;
+  }
+  magic = bench_rd32(hdr, 0);
+  swap = (magic == 0xd4c3b2a1UL || magic == 0x4d3cb2a1UL);
+  if (!swap && magic != 0xa1b2c3d4UL && magic != 0xa1b23c4dUL) {
+    printf("FAIL %s is not a pcap file\n", name);
+    return 0;
+  }
+  linktype = bench_rd32(&hdr[20], swap);
+  replay = (u16_t *)malloc(BENCH_MAX_PACKETS * sizeof(replay[0]));
+
+  while (num_replay < BENCH_MAX_PACKETS && fread(rec, 1, sizeof(rec), f) == sizeof(rec)) {
+    caplen = bench_rd32(&rec[8], swap);
+    if (caplen > sizeof(pkt) || fread(pkt, 1, caplen, f) != caplen) {
+      break;
+    }
+    ip = NULL;
+    if (linktype == 1 && caplen >= 14) { /* Ethernet, with or without one VLAN tag */
+      ethertype = (pkt[12] << 8) | pkt[13];
+      ip = &pkt[14];
+      if (ethertype == 0x8100 && caplen >= 18) {
+        ethertype = (pkt[16] << 8) | pkt[17];
+        ip = &pkt[18];
+      }
+      if (ethertype != 0x0800) {
+        ip = NULL;
+      }
+    } else if (linktype == 113 && caplen >= 16 && pkt[14] == 0x08 && pkt[15] == 0x00) { /* Linux cooked */
+      ip = &pkt[16];
+    } else if (linktype == 101 || linktype == 12) { /* Raw IP */
+      ip = pkt;
+    }
+    if (ip == NULL || ip + IP_HLEN > pkt + caplen || (ip[0] >> 4) != 4 || ip[9] != IP_PROTO_TCP) {
+      skipped++;
+      continue;
+    }
+    tcp = ip + (ip[0] & 0x0f) * 4;
+    if (tcp + TCP_HLEN > pkt + caplen) {
+      skipped++;
+      continue;
+    }
+    /* Addresses kept in network order, like ip_addr_t */
+    flow = bench_flow_of(bench_rd32(&ip[12], 0), (tcp[0] << 8) | tcp[1], bench_rd32(&ip[16], 0),
+                         (tcp[2] << 8) | tcp[3], (tcp[13] & (TCP_SYN | TCP_ACK)) == TCP_SYN, table);
+    if (flow < 0) {
+      skipped++;
+      continue;
+    }
+    replay[num_replay++] = (u16_t)flow;
+  }
+  fclose(f);
+  if (num_replay == 0) {
+    printf("FAIL no TCP/IPv4 packets in %s\n", name);
+    return 0;
+  }
+
+  for (i = 0; i < num_flows; i++) {
+    if (!bench_open(&flows[i])) {
+      printf("FAIL cannot open flow %u\n", (unsigned)i);
+      return 0;
+    }
+  }
+  ns = bench_replay(&segments);
+  printf("%s: %u flows, %u packets (%u skipped), %u segments, %.1f ns/segment\n", name, num_flows,
+         (unsigned)num_replay, (unsigned)skipped, (unsigned)segments, ns);
+  return bench_check();
+}
+
+int
+main(int argc, char **argv)
+{
+  ip_addr_t netmask, gw;
+  int ok;
+
+  lwip_init();
+  IP4_ADDR(&local_ip, 10, 0, 0, 1);
+  IP4_ADDR(&netmask, 0, 0, 0, 0); /* every remote is on link */
+  IP4_ADDR(&gw, 0, 0, 0, 0);
+  netif_add(&bench_netif, &local_ip, &netmask, &gw, NULL, bench_netif_init, ip_input);
+  netif_set_default(&bench_netif);
+  netif_set_up(&bench_netif);
+
+  printf("TCP_PCB_HASH_SIZE %d\n", TCP_PCB_HASH_SIZE);
+  ok = (argc > 1) ? bench_pcap(argv[1]) : bench_generated();
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,543 @@
+/*
+ * tcp_gso_bench.c - cost per byte of bulk tcp_write() and tcp_output()
+ * with and without large segments (TCP_GSO).
+ *
+ * One connection is opened through the real three way handshake against
+ * a listening PCB. Then the accepted PCB writes a byte pattern (copied,
+ * as the socket API does) as fast as the send buffer allows, and the peer
+ * acknowledges everything sent after every tcp_output(). The benchmark
+ * netif plays the peer: it checks the first megabytes it gets (sequence
+ * numbers, packet size, TCP checksum, data) and only looks at the headers
+ * while the time per byte is measured.
+ *
+ * Built with TCP_GSO, the run is repeated for a netif that cuts up large
+ * segments itself (netif->gso_max_size), which gets them whole with the
+ * checksum left to it, like a TSO capable MAC or a virtio-net device.
+ *
+ * After that, a few megabytes are sent, copied and by reference, to a
+ * lossy peer with a few seeds: it drops a tenth of the packets (pieces
+ * of a large segment) and of its ACKs, only takes data in order, ACKs
+ * every piece (dupacks for the ones out of order) and reads at random,
+ * so that its window is wide open, a few MSS or closed. The TCP timers
+ * run, so this covers fast retransmit, RTO, persist and segments split
+ * to fit the window. All of the data must get through, checked as above.
+ *
+ * Build and run from this folder, once without and once with TCP_GSO:
+ *   gcc -O2 -I../../ports/linux/include -I. -I../../src/include -I../../src/include/ipv4 [-DTCP_GSO=1]
+ *       -o tcp_gso_bench tcp_gso_bench.c $(ls ../../src/core/{,ipv4/}[a-z]*.c)
+ *   ./tcp_gso_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/ip.h"
+#include "lwip/tcp_impl.h"
+#include "lwip/inet_chksum.h"
+
+#define BENCH_MTU              1500
+#define BENCH_CHECK_BYTES      (4UL << 20)   /* Checked before measuring */
+#define BENCH_BYTES            (512UL << 20) /* Measured */
+#define BENCH_WRITE_LEN        8192          /* Largest tcp_write() */
+#define BENCH_PATTERN_LEN      251           /* Prime, so no segment size lines up with it */
+#define BENCH_FRAME_LEN        (IP_HLEN + TCP_HLEN)
+#define BENCH_CLIENT_ISS       1000UL
+#define BENCH_SERVER_PORT      5001
+#define BENCH_LOSSY_BYTES      (8UL << 20)   /* Sent to the lossy peer */
+#define BENCH_LOSSY_SEEDS      6
+#define BENCH_LOSSY_TICKS      200000UL      /* TCP timer ticks before giving up */
+#define BENCH_MAX_ACKS         1024          /* ACKs queued by the peer per tick */
+
+static struct netif bench_netif;
+static ip_addr_t local_ip, remote_ip;
+static u8_t pattern[BENCH_PATTERN_LEN + BENCH_WRITE_LEN];
+static u8_t packet[0x10000];
+
+/* Peer state */
+static u16_t remote_port = 1024;
+static struct tcp_pcb *accepted;
+static u32_t server_iss;   /* sequence number of the first data byte - 1 */
+static u32_t snd_max;      /* highest sequence number received + 1 */
+static u32_t written;      /* bytes given to tcp_write() */
+static u32_t frames;
+static u32_t gso_frames;
+static int checking;
+static int failed;
+
+/* Lossy peer state */
+static int lossy;
+static u32_t rnd_state;
+static u32_t rcv_nxt;      /* next byte taken in order */
+static u32_t rcv_edge;     /* right edge of the window, never moves back */
+static u32_t drops;
+static u32_t acks[BENCH_MAX_ACKS];
+static u16_t ack_wnds[BENCH_MAX_ACKS];
+static u16_t num_acks;
+
+u32_t
+sys_now(void)
+{
+  return 0; /* timers are not run */
+}
+
+static void
+bench_fail(const char *what, u32_t seqno)
+{
+  if (!failed) {
+    printf("FAIL %s at seqno %u\n", what, (unsigned)seqno);
+  }
+  failed = 1;
+}
+
+/** Checks a packet from the stack: headers, checksum and data */
+static void
+bench_check_packet(struct pbuf *p, u16_t gso_size)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr *)packet;
+  struct tcp_hdr *tcphdr;
+  struct pbuf q;
+  u16_t iphlen, tcphlen, datalen, i;
+  u32_t seqno, offset;
+
+  pbuf_copy_partial(p, packet, p->tot_len, 0);
+  iphlen = IPH_HL(iphdr) * 4;
+  tcphdr = (struct tcp_hdr *)&packet[iphlen];
+  tcphlen = TCPH_HDRLEN(tcphdr) * 4;
+  datalen = p->tot_len - iphlen - tcphlen;
+  seqno = ntohl(tcphdr->seqno);
+
+  if (ntohs(IPH_LEN(iphdr)) != p->tot_len || inet_chksum(iphdr, iphlen) != 0) {
+    bench_fail("IP header", seqno);
+  }
+  if (gso_size == 0 && p->tot_len > BENCH_MTU) {
+    bench_fail("packet larger than the MTU", seqno);
+  }
+  if (gso_size != 0) {
+    if (gso_size != tcp_mss(accepted) || datalen <= gso_size) {
+      bench_fail("gso_size", seqno);
+    }
+    /* what the netif does: sum from the TCP header on, pseudo header sum in place */
+    tcphdr->chksum = inet_chksum(tcphdr, p->tot_len - iphlen);
+  }
+  /* a pbuf over the TCP segment for inet_chksum_pseudo() */
+  q.next = NULL;
+  q.payload = tcphdr;
+  q.tot_len = q.len = p->tot_len - iphlen;
+  if (inet_chksum_pseudo(&q, &local_ip, &remote_ip, IP_PROTO_TCP, q.tot_len) != 0) {
+    bench_fail("TCP checksum", seqno);
+  }
+
+  offset = seqno - server_iss - 1;
+  for (i = 0; i < datalen; i++) {
+    if (packet[iphlen + tcphlen + i] != (u8_t)((offset + i) % BENCH_PATTERN_LEN)) {
+      bench_fail("data", seqno);
+      break;
+    }
+  }
+}
+
+static u32_t
+bench_rand(void)
+{
+  rnd_state = rnd_state * 1103515245UL + 12345UL;
+  return (rnd_state >> 16) & 0x7fff;
+}
+
+/** The lossy peer queues an ACK, or loses it */
+static void
+bench_lossy_ack(void)
+{
+  if (bench_rand() % 10 == 0 || num_acks == BENCH_MAX_ACKS) {
+    drops++;
+    return;
+  }
+  acks[num_acks] = rcv_nxt;
+  ack_wnds[num_acks] = (u16_t)(rcv_edge - rcv_nxt);
+  num_acks++;
+}
+
+/** The lossy peer takes a piece of data, or not, and ACKs it */
+static void
+bench_lossy_piece(u32_t seqno, u32_t len)
+{
+  u32_t end = seqno + len;
+
+  if (bench_rand() % 10 == 0) {
+    drops++;
+    return;
+  }
+  if (TCP_SEQ_GT(end, rcv_edge)) {
+    end = rcv_edge;
+  }
+  if (TCP_SEQ_LEQ(seqno, rcv_nxt) && TCP_SEQ_GT(end, rcv_nxt)) {
+    rcv_nxt = end;
+  }
+  bench_lossy_ack();
+}
+
+/**
+ * The application of the lossy peer reads once per tick: nothing, so
+ * that the window closes as data comes in, some or all of it. As
+ * receivers do against silly windows, the right edge of the window only
+ * moves on by an MSS or more, and then a window update is sent.
+ */
+static void
+bench_lossy_read(void)
+{
+  u32_t edge;
+
+  switch (bench_rand() % 4) {
+  case 0:
+    edge = rcv_nxt + 0xffff;
+    break;
+  case 1:
+    edge = rcv_nxt + bench_rand() % (3 * TCP_MSS) + 1;
+    break;
+  default:
+    return;
+  }
+  if (TCP_SEQ_GEQ(edge, rcv_edge + TCP_MSS)) {
+    rcv_edge = edge;
+    bench_lossy_ack();
+  }
+}
+
+/** Netif output: the peer, keeps track of what has been received */
+static err_t
+bench_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  u8_t hdr[BENCH_FRAME_LEN];
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)&hdr[IP_HLEN];
+  u16_t gso_size = 0;
+  u32_t seqno, len;
+
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+#if TCP_GSO
+  gso_size = p->gso_size;
+  if (gso_size != 0) {
+    gso_frames++;
+  }
+#endif /* TCP_GSO */
+  frames++;
+  if (pbuf_copy_partial(p, hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+    return ERR_OK;
+  }
+  seqno = ntohl(tcphdr->seqno);
+  len = p->tot_len - IP_HLEN - TCPH_HDRLEN(tcphdr) * 4;
+  if (TCPH_FLAGS(tcphdr) & TCP_SYN) {
+    server_iss = seqno;
+    snd_max = seqno + 1;
+    return ERR_OK;
+  }
+  if (len == 0) {
+    return ERR_OK;
+  }
+  if (lossy) {
+    u32_t off, piece = gso_size != 0 ? gso_size : len;
+
+    bench_check_packet(p, gso_size);
+    for (off = 0; off < len; off += piece) {
+      bench_lossy_piece(seqno + off, LWIP_MIN(piece, len - off));
+    }
+    return ERR_OK;
+  }
+  if (seqno != snd_max) {
+    bench_fail("sequence gap", seqno);
+  }
+  if (checking) {
+    bench_check_packet(p, gso_size);
+  }
+  snd_max = seqno + len;
+  return ERR_OK;
+}
+
+static err_t
+bench_netif_init(struct netif *netif)
+{
+  netif->output = bench_output;
+  netif->mtu = BENCH_MTU;
+  return ERR_OK;
+}
+
+/** Builds an IPv4 + TCP segment from the peer, a SYN offers an MSS of TCP_MSS */
+static u16_t
+bench_frame(u8_t flags, u32_t seqno, u32_t ackno, u16_t wnd, u8_t *out)
+{
+  u16_t optlen = (flags & TCP_SYN) ? 4 : 0;
+  struct pbuf *p = pbuf_alloc(PBUF_IP, TCP_HLEN + optlen, PBUF_RAM);
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)p->payload;
+  struct ip_hdr *iphdr;
+  u16_t len;
+
+  memset(tcphdr, 0, TCP_HLEN);
+  tcphdr->src = htons(remote_port);
+  tcphdr->dest = htons(BENCH_SERVER_PORT);
+  tcphdr->seqno = htonl(seqno);
+  tcphdr->ackno = htonl(ackno);
+  TCPH_HDRLEN_FLAGS_SET(tcphdr, (TCP_HLEN + optlen) / 4, flags);
+  tcphdr->wnd = htons(wnd);
+  if (optlen != 0) {
+    u8_t *opt = (u8_t *)tcphdr + TCP_HLEN;
+    opt[0] = 2;
+    opt[1] = 4;
+    opt[2] = TCP_MSS >> 8;
+    opt[3] = TCP_MSS & 0xff;
+  }
+  tcphdr->chksum = inet_chksum_pseudo(p, &remote_ip, &local_ip, IP_PROTO_TCP, p->tot_len);
+
+  pbuf_header(p, IP_HLEN);
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHLTOS_SET(iphdr, 4, IP_HLEN / 4, 0);
+  IPH_LEN_SET(iphdr, htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_TCP);
+  ip_addr_copy(iphdr->src, remote_ip);
+  ip_addr_copy(iphdr->dest, local_ip);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  len = pbuf_copy_partial(p, out, p->tot_len, 0);
+  pbuf_free(p);
+  return len;
+}
+
+/** Hands a frame to the stack like a driver would */
+static void
+bench_input(const u8_t *frame, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+
+  LWIP_ASSERT("bench_input: pbuf pool empty", p != NULL);
+  pbuf_take(p, frame, len);
+  bench_netif.input(p, &bench_netif);
+}
+
+static void
+bench_err(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  accepted = NULL;
+}
+
+static err_t
+bench_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  accepted = newpcb;
+  tcp_err(newpcb, bench_err);
+  return ERR_OK;
+}
+
+/** SYN, SYN-ACK, ACK from a new remote port */
+static int
+bench_open(void)
+{
+  u8_t frame[BENCH_FRAME_LEN + 4];
+
+  remote_port++;
+  accepted = NULL;
+  written = 0;
+  bench_input(frame, bench_frame(TCP_SYN, BENCH_CLIENT_ISS, 0, 0xffff, frame));
+  bench_input(frame, bench_frame(TCP_ACK, BENCH_CLIENT_ISS + 1, server_iss + 1, 0xffff, frame));
+  return accepted != NULL && accepted->state == ESTABLISHED;
+}
+
+/** Writes bytes more of the pattern, until all of it is acknowledged */
+static int
+bench_send(u32_t bytes)
+{
+  u8_t frame[BENCH_FRAME_LEN];
+  u32_t end = written + bytes;
+  u16_t len;
+
+  while (!failed && (written < end || accepted->unsent != NULL)) {
+    while (written < end && (len = LWIP_MIN(tcp_sndbuf(accepted), BENCH_WRITE_LEN)) > 0) {
+      len = (u16_t)LWIP_MIN(len, end - written);
+      if (tcp_write(accepted, &pattern[written % BENCH_PATTERN_LEN], len, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+        break;
+      }
+      written += len;
+    }
+    tcp_output(accepted);
+    if (accepted->unacked == NULL) {
+      printf("FAIL nothing sent\n");
+      return 0;
+    }
+    bench_frame(TCP_ACK, BENCH_CLIENT_ISS + 1, snd_max, 0xffff, frame);
+    bench_input(frame, sizeof(frame));
+  }
+  return !failed && snd_max - server_iss - 1 == written;
+}
+
+/** One connection to the lossy peer, until all of the data is acknowledged */
+static int
+bench_lossy(const char *name, u32_t seed, u8_t apiflags)
+{
+  u8_t frame[BENCH_FRAME_LEN];
+  u32_t pending[BENCH_MAX_ACKS];
+  u16_t pending_wnds[BENCH_MAX_ACKS];
+  u32_t end, ticks;
+  u16_t len, i, n;
+
+  if (!bench_open()) {
+    printf("FAIL cannot open a connection\n");
+    return 0;
+  }
+  lossy = checking = 1;
+  failed = 0;
+  rnd_state = seed;
+  rcv_nxt = server_iss + 1;
+  rcv_edge = rcv_nxt + 0xffff;
+  drops = frames = gso_frames = 0;
+  num_acks = 0;
+  end = rcv_nxt + BENCH_LOSSY_BYTES;
+
+  for (ticks = 0; !failed && accepted != NULL && ticks < BENCH_LOSSY_TICKS; ticks++) {
+    while (written < BENCH_LOSSY_BYTES && (len = LWIP_MIN(tcp_sndbuf(accepted), BENCH_WRITE_LEN)) > 0) {
+      len = (u16_t)LWIP_MIN(len, BENCH_LOSSY_BYTES - written);
+      if (tcp_write(accepted, &pattern[written % BENCH_PATTERN_LEN], len, apiflags) != ERR_OK) {
+        break;
+      }
+      written += len;
+    }
+    tcp_output(accepted);
+    bench_lossy_read();
+    /* ACKs queued from now on are taken in the next tick */
+    n = num_acks;
+    memcpy(pending, acks, n * sizeof(pending[0]));
+    memcpy(pending_wnds, ack_wnds, n * sizeof(pending_wnds[0]));
+    num_acks = 0;
+    for (i = 0; i < n && accepted != NULL; i++) {
+      bench_frame(TCP_ACK, BENCH_CLIENT_ISS + 1, pending[i], pending_wnds[i], frame);
+      bench_input(frame, sizeof(frame));
+    }
+    if (accepted == NULL) {
+      break;
+    }
+    if (rcv_nxt == end && accepted->unacked == NULL && accepted->unsent == NULL) {
+      break;
+    }
+    tcp_tmr();
+  }
+  lossy = checking = 0;
+  if (accepted == NULL) {
+    printf("FAIL %s, seed %u: connection dropped at %u of %u bytes\n", name, (unsigned)seed,
+           (unsigned)(rcv_nxt - server_iss - 1), (unsigned)BENCH_LOSSY_BYTES);
+    return 0;
+  }
+  if (failed) {
+    printf("FAIL %s, seed %u\n", name, (unsigned)seed);
+  } else if (rcv_nxt != end) {
+    printf("FAIL %s, seed %u: stalled at %u of %u bytes\n", name, (unsigned)seed,
+           (unsigned)(rcv_nxt - server_iss - 1), (unsigned)BENCH_LOSSY_BYTES);
+  } else if ((accepted->snd_queuelen != 0 || tcp_sndbuf(accepted) != TCP_SND_BUF)) {
+    printf("FAIL %s, seed %u: send queue not empty after the last ACK\n", name, (unsigned)seed);
+  } else {
+    printf("%-24s seed %u: %u MB in %u ticks, %u packets, %u dropped, %u large\n", name,
+           (unsigned)seed, (unsigned)(BENCH_LOSSY_BYTES >> 20), (unsigned)ticks,
+           (unsigned)frames, (unsigned)drops, (unsigned)gso_frames);
+    tcp_abort(accepted);
+    return 1;
+  }
+  tcp_abort(accepted);
+  return 0;
+}
+
+/** The lossy peer with a few seeds, data copied and by reference */
+static int
+bench_lossy_runs(const char *name)
+{
+  char buf[40];
+  u32_t seed;
+  int ok = 1;
+
+  for (seed = 1; seed <= BENCH_LOSSY_SEEDS; seed++) {
+    snprintf(buf, sizeof(buf), "%s, copy", name);
+    ok = bench_lossy(buf, seed, TCP_WRITE_FLAG_COPY) && ok;
+    snprintf(buf, sizeof(buf), "%s, ref", name);
+    ok = bench_lossy(buf, seed, 0) && ok;
+  }
+  return ok;
+}
+
+/** One connection: checked first, then measured */
+static int
+bench_run(const char *name)
+{
+  struct timespec start, end;
+  u32_t check_frames;
+  double ns;
+
+  if (!bench_open()) {
+    printf("FAIL cannot open a connection\n");
+    return 0;
+  }
+  checking = 1;
+  frames = gso_frames = 0;
+  if (!bench_send(BENCH_CHECK_BYTES)) {
+    return 0;
+  }
+  check_frames = frames;
+  checking = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!bench_send(BENCH_BYTES)) {
+    return 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+  printf("%-24s %u MB, %.3f ns/byte, %.1f bytes/packet, %u of %u packets large\n", name,
+         (unsigned)(BENCH_BYTES >> 20), ns / BENCH_BYTES,
+         (double)BENCH_BYTES / (frames - check_frames), (unsigned)gso_frames, (unsigned)frames);
+  tcp_abort(accepted);
+  return 1;
+}
+
+int
+main(void)
+{
+  ip_addr_t netmask, gw;
+  struct tcp_pcb *pcb;
+  u32_t i;
+  int ok;
+
+  for (i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = (u8_t)(i % BENCH_PATTERN_LEN);
+  }
+  lwip_init();
+  IP4_ADDR(&local_ip, 10, 0, 0, 1);
+  IP4_ADDR(&remote_ip, 10, 0, 0, 2);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 0, 0, 0, 0);
+  netif_add(&bench_netif, &local_ip, &netmask, &gw, NULL, bench_netif_init, ip_input);
+  netif_set_default(&bench_netif);
+  netif_set_up(&bench_netif);
+
+  pcb = tcp_new();
+  tcp_bind(pcb, IP_ADDR_ANY, BENCH_SERVER_PORT);
+  pcb = tcp_listen(pcb);
+  tcp_accept(pcb, bench_accept);
+
+  printf("TCP_GSO %d, TCP_SND_BUF %d\n", TCP_GSO, TCP_SND_BUF);
+  /* measured first, before the lossy runs leave the heap fragmented */
+#if TCP_GSO
+  ok = bench_run("large segments, no TSO");
+  bench_netif.gso_max_size = 0xffff;
+  ok = bench_run("large segments, TSO") && ok;
+  ok = bench_lossy_runs("lossy, TSO") && ok;
+  bench_netif.gso_max_size = 0;
+  ok = bench_lossy_runs("lossy, no TSO") && ok;
+#else /* TCP_GSO */
+  ok = bench_run("MSS segments");
+  ok = bench_lossy_runs("lossy, MSS segments") && ok;
+#endif /* TCP_GSO */
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
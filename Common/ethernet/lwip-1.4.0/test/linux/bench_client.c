@@ -0,0 +1,336 @@
+/*
+ * bench_client.c - TCP benchmarks against an echo server on port 7:
+ *
+ * - throughput: blocks of BENCH_BLOCK_LEN bytes of a pattern are sent
+ *   and read back, and every byte read back is checked;
+ * - latency: BENCH_LATENCY_LEN byte messages are sent one at a time,
+ *   and the round trip times are sorted for the average, median and
+ *   99th percentile;
+ * - connection scaling: for 1 to BENCH_MAX_CONNS connections, the time
+ *   to open them all and the time per small message round trip, with the
+ *   messages going round robin over the open connections.
+ *
+ * The same file is built two ways:
+ * - with -DBENCH_CLIENT_LWIP, into linux_echo, which calls
+ *   bench_client_run() from a thread of its own with the lwip_* socket
+ *   calls, against its own echo server over the loopback netif;
+ * - without, as a program of its own on the host sockets, against
+ *   linux_echo on a TAP or AF_PACKET netif:
+ *     gcc -O2 -o bench_client bench_client.c
+ *     ./bench_client 192.168.77.2 [megabytes [tap0]]
+ *   Given the host interface, it also prints the frames and bytes the
+ *   host got on it, to show the frame size lwIP sent (with TCP_GSO and
+ *   a TAP device, larger than the MTU).
+ *
+ * It returns (or exits with) 0 when all of the data came back intact.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef BENCH_CLIENT_LWIP
+
+#include "lwip/sockets.h"
+#include "lwip/inet.h"
+
+#define bench_socket           lwip_socket
+#define bench_connect          lwip_connect
+#define bench_send             lwip_send
+#define bench_recv             lwip_recv
+#define bench_close            lwip_close
+#define bench_setsockopt       lwip_setsockopt
+
+#else /* BENCH_CLIENT_LWIP */
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define bench_socket           socket
+#define bench_connect          connect
+#define bench_send             send
+#define bench_recv             recv
+#define bench_close            close
+#define bench_setsockopt       setsockopt
+
+#endif /* BENCH_CLIENT_LWIP */
+
+#define BENCH_ECHO_PORT        7
+#define BENCH_BLOCK_LEN        16384         /* Below TCP_WND, so sending a whole block never blocks both ends */
+#define BENCH_PATTERN_LEN      251           /* Prime, so no block or segment size lines up with it */
+#define BENCH_LATENCY_LEN      64
+#define BENCH_LATENCY_ROUNDS   10000
+#define BENCH_MAX_CONNS        32
+#define BENCH_SCALING_ROUNDS   4096
+
+int bench_client_run(const char *addr, unsigned long bytes);
+
+static struct sockaddr_in server_addr;
+static unsigned char pattern[BENCH_PATTERN_LEN + BENCH_BLOCK_LEN];
+static unsigned char block[BENCH_BLOCK_LEN];
+static unsigned long round_trips[BENCH_LATENCY_ROUNDS];
+
+static unsigned long
+bench_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000000000UL + (unsigned long)now.tv_nsec;
+}
+
+/**
+ * Opens a connection to the echo server, -1 on failure. Each block or
+ * message waits for its echo, so Nagle would hold back its last segment
+ * until the delayed ACK of the one before.
+ */
+static int
+bench_open(void)
+{
+  int s = bench_socket(AF_INET, SOCK_STREAM, 0), nodelay = 1;
+
+  if (s < 0) {
+    return -1;
+  }
+  if (bench_connect(s, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
+    bench_close(s);
+    return -1;
+  }
+  bench_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  return s;
+}
+
+/** Sends all of buf, 0 on success */
+static int
+bench_send_all(int s, const unsigned char *buf, size_t len)
+{
+  while (len > 0) {
+    int n = bench_send(s, buf, len, 0);
+
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/** Reads exactly len bytes, 0 on success */
+static int
+bench_recv_all(int s, unsigned char *buf, size_t len)
+{
+  while (len > 0) {
+    int n = bench_recv(s, buf, len, 0);
+
+    if (n <= 0) {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/** Sends a message and waits for its echo, 0 on success */
+static int
+bench_round_trip(int s, unsigned char *msg)
+{
+  unsigned char echo[BENCH_LATENCY_LEN];
+
+  if ((bench_send_all(s, msg, BENCH_LATENCY_LEN) != 0) ||
+      (bench_recv_all(s, echo, BENCH_LATENCY_LEN) != 0)) {
+    return -1;
+  }
+  return memcmp(msg, echo, BENCH_LATENCY_LEN) == 0 ? 0 : -1;
+}
+
+static int
+bench_throughput(unsigned long bytes)
+{
+  unsigned long sent = 0, start, ns;
+  int s = bench_open();
+
+  if (s < 0) {
+    printf("throughput: connect failed\n");
+    return -1;
+  }
+  start = bench_ns();
+  while (sent < bytes) {
+    const unsigned char *data = &pattern[sent % BENCH_PATTERN_LEN];
+
+    if ((bench_send_all(s, data, BENCH_BLOCK_LEN) != 0) ||
+        (bench_recv_all(s, block, BENCH_BLOCK_LEN) != 0)) {
+      printf("throughput: connection lost after %lu bytes\n", sent);
+      bench_close(s);
+      return -1;
+    }
+    if (memcmp(block, data, BENCH_BLOCK_LEN) != 0) {
+      printf("throughput: data differs after %lu bytes\n", sent);
+      bench_close(s);
+      return -1;
+    }
+    sent += BENCH_BLOCK_LEN;
+  }
+  ns = bench_ns() - start;
+  bench_close(s);
+  printf("throughput: %lu bytes each way in %lu ms, %.1f MB/s\n",
+         sent, ns / 1000000UL, (double)sent * 1000.0 / (double)ns);
+  return 0;
+}
+
+static int
+bench_cmp_ulong(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static int
+bench_latency(void)
+{
+  unsigned long total = 0;
+  int i, s = bench_open();
+
+  if (s < 0) {
+    printf("latency: connect failed\n");
+    return -1;
+  }
+  for (i = 0; i < BENCH_LATENCY_ROUNDS; i++) {
+    unsigned long start = bench_ns();
+
+    if (bench_round_trip(s, &pattern[i % BENCH_PATTERN_LEN]) != 0) {
+      printf("latency: round trip %d failed\n", i);
+      bench_close(s);
+      return -1;
+    }
+    round_trips[i] = bench_ns() - start;
+    total += round_trips[i];
+  }
+  bench_close(s);
+  qsort(round_trips, BENCH_LATENCY_ROUNDS, sizeof(round_trips[0]), bench_cmp_ulong);
+  printf("latency: %d byte round trip avg %lu us, median %lu us, p99 %lu us\n",
+         BENCH_LATENCY_LEN, total / BENCH_LATENCY_ROUNDS / 1000UL,
+         round_trips[BENCH_LATENCY_ROUNDS / 2] / 1000UL,
+         round_trips[BENCH_LATENCY_ROUNDS * 99 / 100] / 1000UL);
+  return 0;
+}
+
+static int
+bench_scaling(void)
+{
+  int conns[BENCH_MAX_CONNS];
+  int n, i, result = 0;
+
+  for (n = 1; (n <= BENCH_MAX_CONNS) && (result == 0); n *= 2) {
+    unsigned long start = bench_ns(), open_ns, rtt_ns;
+    int opened;
+
+    for (opened = 0; opened < n; opened++) {
+      conns[opened] = bench_open();
+      if (conns[opened] < 0) {
+        printf("scaling: connect %d of %d failed\n", opened + 1, n);
+        result = -1;
+        break;
+      }
+    }
+    open_ns = bench_ns() - start;
+    start = bench_ns();
+    for (i = 0; (i < BENCH_SCALING_ROUNDS) && (result == 0); i++) {
+      if (bench_round_trip(conns[i % n], &pattern[i % BENCH_PATTERN_LEN]) != 0) {
+        printf("scaling: round trip %d on %d connections failed\n", i, n);
+        result = -1;
+      }
+    }
+    rtt_ns = bench_ns() - start;
+    for (i = 0; i < opened; i++) {
+      bench_close(conns[i]);
+    }
+    if (result == 0) {
+      printf("scaling: %2d connections opened in %lu us each, round trip %lu us\n",
+             n, open_ns / (unsigned long)n / 1000UL, rtt_ns / BENCH_SCALING_ROUNDS / 1000UL);
+    }
+  }
+  return result;
+}
+
+/**
+ * Runs the three benchmarks against the echo server at addr (dotted
+ * decimal), with bytes sent each way for the throughput.
+ *
+ * @return 0 if all of them passed
+ */
+int
+bench_client_run(const char *addr, unsigned long bytes)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = (unsigned char)(i % BENCH_PATTERN_LEN);
+  }
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(BENCH_ECHO_PORT);
+  server_addr.sin_addr.s_addr = inet_addr(addr);
+
+  if ((bench_throughput(bytes) != 0) || (bench_latency() != 0) || (bench_scaling() != 0)) {
+    return -1;
+  }
+  return 0;
+}
+
+#ifndef BENCH_CLIENT_LWIP
+
+/** Prints a counter of the host interface dev */
+static void
+bench_print_counter(const char *dev, const char *name, unsigned long *value)
+{
+  char path[128];
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", dev, name);
+  f = fopen(path, "r");
+  if ((f == NULL) || (fscanf(f, "%lu", value) != 1)) {
+    *value = 0;
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned long bytes = 64UL << 20, frames0 = 0, bytes0 = 0, frames1, bytes1;
+  int result;
+
+  if (argc < 2) {
+    printf("usage: %s address [megabytes [interface]]\n", argv[0]);
+    return 2;
+  }
+  if (argc > 2) {
+    bytes = strtoul(argv[2], NULL, 0) << 20;
+  }
+  if (argc > 3) {
+    bench_print_counter(argv[3], "rx_packets", &frames0);
+    bench_print_counter(argv[3], "rx_bytes", &bytes0);
+  }
+  result = bench_client_run(argv[1], bytes);
+  if (argc > 3) {
+    bench_print_counter(argv[3], "rx_packets", &frames1);
+    bench_print_counter(argv[3], "rx_bytes", &bytes1);
+    if (frames1 > frames0) {
+      printf("%s: %lu frames received, %lu bytes each on average\n", argv[3],
+             frames1 - frames0, (bytes1 - bytes0) / (frames1 - frames0));
+    }
+  }
+  printf("%s\n", result == 0 ? "PASS" : "FAIL");
+  return result == 0 ? 0 : 1;
+}
+
+#endif /* BENCH_CLIENT_LWIP */
@@ -0,0 +1,153 @@
+/*
+ * linux_echo.c - TCP echo server on port 7 on the Linux port of lwIP,
+ * with a thread per connection on the socket API, and the benchmarks of
+ * bench_client.c.
+ *
+ * Without arguments, the benchmarks run in the same process against
+ * 127.0.0.1 over the loopback netif, which needs no privileges (for CI),
+ * and the exit status tells if they passed:
+ *   ./linux_echo
+ *
+ * Given a device, the server also listens on 192.168.77.2/24 on the TAP
+ * device (netifLINUX_USE_TAP 1, the default, which needs CAP_NET_ADMIN
+ * and 192.168.77.1/24 on the host side) or the existing interface
+ * (netifLINUX_USE_TAP 0, for AF_PACKET, which needs CAP_NET_RAW) of that
+ * name, for the given number of seconds or until killed, and the
+ * benchmarks are run from the host with bench_client:
+ *   ./linux_echo tap0 [seconds] &
+ *   ip addr add 192.168.77.1/24 dev tap0 && ip link set tap0 up
+ *   ./bench_client 192.168.77.2 64 tap0
+ *
+ * Build and run from this folder, with or without TCP_GSO:
+ *   gcc -O2 -I. -I../../ports/linux/include -I../../src/include -I../../src/include/ipv4 [-DTCP_GSO=1]
+ *       -DBENCH_CLIENT_LWIP -o linux_echo linux_echo.c bench_client.c
+ *       $(ls ../../src/core/{,ipv4/}[a-z]*.c ../../src/api/[a-z]*.c ../../ports/linux/[a-z]*.c)
+ *       ../../src/netif/etharp.c -lpthread
+ *   gcc -O2 -o bench_client bench_client.c
+ *   ./linux_echo
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/sockets.h"
+#include "lwip/stats.h"
+#include "netif/etharp.h"
+
+#define ECHO_PORT              7
+#define ECHO_BUF_LEN           4096
+#define ECHO_BACKLOG           8
+#define ECHO_LOOPBACK_BYTES    (64UL << 20)  /* Sent each way by the in-process throughput run */
+
+err_t ethernetif_init(struct netif *netif);
+int bench_client_run(const char *addr, unsigned long bytes);
+
+static struct netif echo_netif;
+static sys_sem_t echo_ready;
+
+/** Echoes one connection back to its sender until it is closed */
+static void
+echo_connection(void *arg)
+{
+  int s = (int)(long)arg, nodelay = 1;
+  char buf[ECHO_BUF_LEN];
+  int n;
+
+  /* The latency runs send one small message at a time */
+  lwip_setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  while ((n = lwip_recv(s, buf, sizeof(buf), 0)) > 0) {
+    int sent = 0;
+
+    while (sent < n) {
+      int r = lwip_send(s, buf + sent, n - sent, 0);
+
+      if (r <= 0) {
+        lwip_close(s);
+        return;
+      }
+      sent += r;
+    }
+  }
+  lwip_close(s);
+}
+
+/** Accepts the connections, a thread for each */
+static void
+echo_server(void *arg)
+{
+  struct sockaddr_in addr;
+  int s = lwip_socket(AF_INET, SOCK_STREAM, 0);
+
+  LWIP_UNUSED_ARG(arg);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(ECHO_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  LWIP_ASSERT("echo_server: no socket", s >= 0);
+  if ((lwip_bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+      (lwip_listen(s, ECHO_BACKLOG) != 0)) {
+    printf("echo_server: cannot listen on port %d\n", ECHO_PORT);
+    exit(1);
+  }
+  sys_sem_signal(&echo_ready);
+
+  for (;;) {
+    int c = lwip_accept(s, NULL, NULL);
+
+    if (c >= 0) {
+      sys_thread_new("echo", echo_connection, (void *)(long)c, DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+    }
+  }
+}
+
+static void
+echo_tcpip_ready(void *arg)
+{
+  sys_sem_signal((sys_sem_t *)arg);
+}
+
+int
+main(int argc, char **argv)
+{
+  ip_addr_t ipaddr, netmask, gw;
+  int result;
+
+  sys_sem_new(&echo_ready, 0);
+  tcpip_init(echo_tcpip_ready, &echo_ready);
+  sys_sem_wait(&echo_ready);
+
+  if (argc > 1) {
+    IP4_ADDR(&ipaddr, 192, 168, 77, 2);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gw, 192, 168, 77, 1);
+    if (netif_add(&echo_netif, &ipaddr, &netmask, &gw, argv[1], ethernetif_init, tcpip_input) == NULL) {
+      printf("cannot open %s\n", argv[1]);
+      return 1;
+    }
+    netif_set_default(&echo_netif);
+    netif_set_up(&echo_netif);
+  }
+
+  sys_thread_new("echo_server", echo_server, NULL, DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  sys_sem_wait(&echo_ready);
+
+  if (argc > 1) {
+    printf("echo server on 192.168.77.2 port %d on %s\n", ECHO_PORT, argv[1]);
+    if (argc > 2) {
+      sleep((unsigned)atoi(argv[2]));
+    } else {
+      for (;;) {
+        pause();
+      }
+    }
+    stats_display();
+    return 0;
+  }
+
+  result = bench_client_run("127.0.0.1", ECHO_LOOPBACK_BYTES);
+  printf("%s\n", result == 0 ? "PASS" : "FAIL");
+  return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/*
+ * lwIP options of the Linux echo server and socket benchmarks: the
+ * tcpip thread and the socket API on POSIX threads (ports/linux), the
+ * loopback netif for the in-process run and the TAP or AF_PACKET netif
+ * of ports/linux/ethernetif.c for the runs against the host. TCP_GSO and
+ * netifLINUX_USE_TAP are left to the command line.
+ */
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+#define NO_SYS                          0
+#define SYS_LIGHTWEIGHT_PROT            1
+#define LWIP_SOCKET                     1
+#define LWIP_NETCONN                    1
+#define LWIP_COMPAT_SOCKETS             0
+#define LWIP_POSIX_SOCKETS_IO_NAMES     0
+#define LWIP_HAVE_LOOPIF                1
+#define LWIP_NETIF_LOOPBACK             1
+#define LWIP_STATS                      1
+#define LINK_STATS                      1
+#define LWIP_STATS_DISPLAY              1
+#define LWIP_CHECKSUM_ON_COPY           1
+
+#define MEM_ALIGNMENT                   8
+#define MEM_SIZE                        (512 * 1024)
+#define PBUF_POOL_SIZE                  512
+
+/* Both ends of the connection scaling run, plus the listener */
+#define MEMP_NUM_NETCONN                80
+#define MEMP_NUM_TCP_PCB                80
+#define MEMP_NUM_TCP_SEG                512
+#define MEMP_NUM_PBUF                   256
+
+#define LWIP_TCP                        1
+#define TCP_MSS                         1460
+#define TCP_WND                         (16 * TCP_MSS)
+#define TCP_SND_BUF                     (16 * TCP_MSS)
+#define TCP_SND_QUEUELEN                (4 * TCP_SND_BUF / TCP_MSS)
+
+/* A message for each frame queued to the tcpip thread */
+#define TCPIP_MBOX_SIZE                 256
+#define MEMP_NUM_TCPIP_MSG_INPKT        TCPIP_MBOX_SIZE
+#define DEFAULT_TCP_RECVMBOX_SIZE       64
+/* Connections waiting for lwip_accept(): on one CPU, the connection
+   scaling run opens them faster than the server thread takes them */
+#define DEFAULT_ACCEPTMBOX_SIZE         64
+#define DEFAULT_RAW_RECVMBOX_SIZE       8
+#define DEFAULT_UDP_RECVMBOX_SIZE       8
+
+#endif /* __LWIPOPTS_H__ */
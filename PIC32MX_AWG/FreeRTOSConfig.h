@@ -54,7 +54,7 @@
 #define configISR_STACK_SIZE					( 250 )
 #define configTOTAL_HEAP_SIZE					( ( size_t ) 28000 )
 #define configMAX_TASK_NAME_LEN					( 8 )
-#define configUSE_TRACE_FACILITY				0
+#define configUSE_TRACE_FACILITY				1
 #define configUSE_16_BIT_TICKS					0
 #define configIDLE_SHOULD_YIELD					1
 #define configUSE_MUTEXES						1
@@ -64,7 +64,7 @@
 #define configUSE_MALLOC_FAILED_HOOK			1
 #define configUSE_APPLICATION_TASK_TAG			0
 #define configUSE_COUNTING_SEMAPHORES			1
-#define configGENERATE_RUN_TIME_STATS			0
+#define configGENERATE_RUN_TIME_STATS			1
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 			0
@@ -93,6 +93,11 @@ to exclude the API function. */
 #ifndef __LANGUAGE_ASSEMBLY
 	void vAssertCalled( const char *pcFileName, unsigned long ulLine );
 	#define configASSERT( x ) if( ( x ) == 0 ) vAssertCalled( __FILE__, __LINE__ )
+
+	/* Run time stats in core timer ticks (SYSCLK/2), free running, no setup.
+	See Stats/stats.h. */
+	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+	#define portGET_RUN_TIME_COUNTER_VALUE() _CP0_GET_COUNT()
 #endif
 
 /* The priority at which the tick interrupt runs.  This should probably be
@@ -104,5 +109,17 @@ be called.  Only API functions that end in ...FromISR() can be used within
 interrupts. */
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY	0x03
 
+/* Trace recorder: kernel trace macros and the ISR wrappers record events
+to a RAM buffer, see Trace/trace.h.  Needs configUSE_TRACE_FACILITY.  Off by
+default: each record disables interrupts, on every context switch and every
+wrapped ISR, which adds jitter to the playback.  To turn it on define
+traceRECORDER_ENABLE=1 in the compiler and assembler macros of the project
+(or set it to 1 below); mainAwgTRACE_STREAM in mainAWG.c then selects the
+r command snapshot or the streaming task. */
+#ifndef traceRECORDER_ENABLE
+#define traceRECORDER_ENABLE					0
+#endif
+#include "../Trace/trace.h"
+
 
 #endif /* FREERTOS_CONFIG_H */
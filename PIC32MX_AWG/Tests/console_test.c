@@ -0,0 +1,159 @@
+/*
+ * File:   console_test.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host test of the UART console of mainAWG.c (console.c), with
+ *           ConsoleRxIsr() as the UART1 ISR of the register model
+ *           (Sim/sfr.h) at 115200 baud and this test as the Interface
+ *           task. Command lines sent on the RX pin must reach the
+ *           Interface task whole and leave the console in command mode,
+ *           also library names with 'l' or 'L' in them. Only the line
+ *           "l" or "L" starts an upload: the frames that follow, of any
+ *           byte value, must all reach the upload stream in order and
+ *           none the command queue, until ConsoleUploadEnd().
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -I../../Sim -o console_test console_test.c ../console.c ../../UART/uart.c \
+ *           ../../Sim/sfr.c ../../Sim/rtos.c && ./console_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "sfr.h"
+#include "../../UART/uart.h"
+#include "../console.h"
+
+#define testBAUDRATE 115200
+#define testWAIT pdMS_TO_TICKS(5) /* Silence that ends a read, about 50 bytes at the line rate */
+#define testUPLOAD_STREAM_SIZE 1024 /* mainAwgUPLOAD_STREAM_SIZE */
+#define testFRAME_SIZE 64
+
+static const char *pcLines[] = {
+    "W3pulse", "W4Lull", "W5level.1", "s", "l1",
+};
+
+#define testNUM_LINES (sizeof(pcLines)/sizeof(pcLines[0]))
+
+static QueueHandle_t xInput;
+static StreamBufferHandle_t xUpload;
+
+static void prvUartIsr(void){
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    ConsoleRxIsr(&xHigherPriorityTaskWoken);
+}
+
+/* Sends pcLine and '\r' on the RX pin */
+static void prvSendLine(const char *pcLine){
+    static uint8_t ucLine[consoleLINE_SIZE + 1]; /* Read by the register model until sent */
+    size_t xLength = strlen(pcLine);
+
+    memcpy(ucLine, pcLine, xLength);
+    ucLine[xLength] = '\r';
+    SfrUartReceive(ucLine, xLength + 1);
+}
+
+/* The Interface task: takes bytes from the queue until a line ends.
+ * Returns its consoleLINE_XXX, or consoleLINE_IGNORED if the host went
+ * silent first. */
+static uint8_t prvReadLine(void){
+    uint8_t ucByte;
+    uint8_t ucLine;
+
+    while (xQueueReceive(xInput, &ucByte, testWAIT) == pdTRUE) {
+        ucLine = ConsoleLineAdd(ucByte);
+        if (ucLine == consoleLINE_COMMAND || ucLine == consoleLINE_UPLOAD)
+            return ucLine;
+    }
+    return consoleLINE_IGNORED;
+}
+
+/* Lines with the upload letter in a name or with arguments are commands */
+static uint8_t prvTestLine(const char *pcLine){
+    uint8_t ucLine;
+
+    prvSendLine(pcLine);
+    ucLine = prvReadLine();
+    if (ucLine != consoleLINE_COMMAND || strcmp((const char *)xConsole.ucLine, pcLine) != 0 ||
+        xConsole.xUploading || !xStreamBufferIsEmpty(xUpload)) {
+        printf("FAIL line %s: read as \"%s\", %s\n", pcLine, (const char *)xConsole.ucLine,
+                xConsole.xUploading ? "upload mode" : "command mode");
+        ConsoleLineClear();
+        return 0;
+    }
+    ConsoleLineClear();
+    printf("PASS line %s: command mode\n", pcLine);
+    return 1;
+}
+
+/* The upload line, then a frame holding every byte value that could be
+ * mistaken for a command, then a command after ConsoleUploadEnd() */
+static uint8_t prvTestUpload(const char *pcLine){
+    uint8_t ucFrame[testFRAME_SIZE];
+    uint8_t ucReceived[testFRAME_SIZE];
+    size_t xReceived = 0;
+    size_t xRead;
+    uint8_t ucIterator;
+
+    for (ucIterator = 0; ucIterator < testFRAME_SIZE; ucIterator++)
+        ucFrame[ucIterator] = "l\rL1s\r"[ucIterator % 6] + (ucIterator/6)*29;
+    ucFrame[0] = 0xA5; /* mainAwgUPLOAD_SYNC */
+
+    prvSendLine(pcLine);
+    if (prvReadLine() != consoleLINE_UPLOAD || !xConsole.xUploading || xConsole.ucLength != 0) {
+        printf("FAIL upload %s: not in upload mode\n", pcLine);
+        return 0;
+    }
+    SfrUartReceive(ucFrame, testFRAME_SIZE);
+    while (xReceived < testFRAME_SIZE) {
+        xRead = xStreamBufferReceive(xUpload, &ucReceived[xReceived], testFRAME_SIZE - xReceived, testWAIT);
+        if (xRead == 0)
+            break;
+        xReceived += xRead;
+    }
+    if (xReceived != testFRAME_SIZE || memcmp(ucReceived, ucFrame, testFRAME_SIZE) != 0 || uxQueueMessagesWaiting(xInput) != 0) {
+        printf("FAIL upload %s: %u of %u frame bytes streamed, %u queued as commands\n", pcLine, (unsigned)xReceived,
+                testFRAME_SIZE, (unsigned)uxQueueMessagesWaiting(xInput));
+        return 0;
+    }
+
+    ConsoleUploadEnd();
+    prvSendLine("s");
+    if (prvReadLine() != consoleLINE_COMMAND || strcmp((const char *)xConsole.ucLine, "s") != 0) {
+        printf("FAIL upload %s: no command mode after the upload\n", pcLine);
+        return 0;
+    }
+    ConsoleLineClear();
+    printf("PASS upload %s: %u frame bytes streamed, back to command mode\n", pcLine, testFRAME_SIZE);
+    return 1;
+}
+
+int main(void){
+    uint8_t ucIterator;
+    uint8_t ucFailed = 0;
+
+    SfrSetIsr(sfrVECTOR_UART1, prvUartIsr);
+    if (SfrOpen(NULL) != SFR_SUCCESS || UartInit(configPERIPHERAL_CLOCK_HZ, testBAUDRATE) != UART_SUCCESS) {
+        printf("FAIL: UART init\n");
+        return 1;
+    }
+    U1STAbits.URXISEL = 0; /* Interrupt on each new byte, as pvInterface() */
+    IEC0bits.U1RXIE = 1;
+    xInput = xQueueCreate(consoleLINE_SIZE, sizeof(uint8_t));
+    xUpload = xStreamBufferCreate(testUPLOAD_STREAM_SIZE, 1);
+    ConsoleInit(xInput, xUpload);
+
+    for (ucIterator = 0; ucIterator < testNUM_LINES; ucIterator++) {
+        if (!prvTestLine(pcLines[ucIterator]))
+            ucFailed++;
+    }
+    if (!prvTestUpload("l"))
+        ucFailed++;
+    if (!prvTestUpload("L"))
+        ucFailed++;
+    SfrClose();
+
+    printf("%s: %u of %u checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed, (unsigned)(testNUM_LINES + 2));
+    return ucFailed ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * File:   spectral_analysis.c
+ * Author: Diogo Vala
+ *
+ * Overview: Measures a duty stream file, one OC1R value per line, as
+ *           captured from the board or dumped from SfrOcCapture() of
+ *           the register model (Sim/sfr.h). Optional limits make it a
+ *           pass/fail check.
+ *
+ *           gcc -Wall -O2 -o spectral_analysis spectral_analysis.c spectrum.c -lm
+ *           ./spectral_analysis duty_stream.txt [-p ticks] [-t us] [-s periods]
+ *                   [-sfdr dB] [-thd dB] [-snr dB] [-jitter ns]
+ *
+ *           -p      PWM period in timer ticks, PR2+1 (default 256)
+ *           -t      RC filter time constant in us (default 10, 1k / 10n)
+ *           -s      PWM periods skipped at the start (default 10 tau)
+ *           -sfdr, -snr      Minimum accepted value
+ *           -thd, -jitter    Maximum accepted value
+ *
+ *           Exit code 0 if every limit is met, 1 if one is not, 2 on
+ *           errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spectrum.h"
+
+#define analysisDEFAULT_PERIOD 256 /* PR2 of mainAwgPWM_FREQUENCY, plus 1 */
+#define analysisDEFAULT_TAU_US 10.0
+#define analysisMAX_SAMPLES 4000000
+
+/* Reads the duty stream, returns the number of values or 0 */
+static uint32_t prvLoad(const char *pcFile, uint16_t **ppusDuty){
+    FILE *pxFile = fopen(pcFile, "r");
+    uint32_t ulCount = 0;
+    uint32_t ulSize = 4096;
+    unsigned uValue;
+    uint16_t *pusDuty = malloc(ulSize*sizeof(uint16_t));
+
+    if (pxFile == NULL || pusDuty == NULL) {
+        if (pxFile != NULL)
+            fclose(pxFile);
+        free(pusDuty);
+        return 0;
+    }
+    while (ulCount < analysisMAX_SAMPLES && fscanf(pxFile, "%u", &uValue) == 1) {
+        if (ulCount == ulSize) {
+            uint16_t *pusGrown = realloc(pusDuty, 2*ulSize*sizeof(uint16_t));
+            if (pusGrown == NULL)
+                break;
+            pusDuty = pusGrown;
+            ulSize *= 2;
+        }
+        pusDuty[ulCount++] = (uint16_t)uValue;
+    }
+    fclose(pxFile);
+    *ppusDuty = pusDuty;
+    return ulCount;
+}
+
+/* Prints one limit check, returns 0 if it fails */
+static uint8_t prvCheck(const char *pcName, double dValue, double dLimit, uint8_t ucMinimum){
+    uint8_t ucPass = ucMinimum ? (dValue >= dLimit) : (dValue <= dLimit);
+
+    printf("%s %s %.2f (%s %.2f)\n", ucPass ? "PASS" : "FAIL", pcName, dValue, ucMinimum ? ">=" : "<=", dLimit);
+    return ucPass;
+}
+
+int main(int argc, char *argv[]){
+    SpectrumConfig_t xConfig = {analysisDEFAULT_PERIOD, analysisDEFAULT_TAU_US*1e-6, 0};
+    SpectrumResult_t xResult;
+    uint16_t *pusDuty = NULL;
+    uint32_t ulCount;
+    double dSfdr = NAN, dThd = NAN, dSnr = NAN, dJitter = NAN;
+    int32_t lSkip = -1;
+    uint8_t ucPass = 1;
+    int iArg;
+    int8_t cStatus;
+
+    if (argc < 2) {
+        printf("Usage: %s duty_stream.txt [-p ticks] [-t us] [-s periods] [-sfdr dB] [-thd dB] [-snr dB] [-jitter ns]\n", argv[0]);
+        return 2;
+    }
+    for (iArg = 2; iArg + 1 < argc; iArg += 2) {
+        double dValue = atof(argv[iArg + 1]);
+
+        if (strcmp(argv[iArg], "-p") == 0)
+            xConfig.usPeriod = (uint16_t)dValue;
+        else if (strcmp(argv[iArg], "-t") == 0)
+            xConfig.dTau = dValue*1e-6;
+        else if (strcmp(argv[iArg], "-s") == 0)
+            lSkip = (int32_t)dValue;
+        else if (strcmp(argv[iArg], "-sfdr") == 0)
+            dSfdr = dValue;
+        else if (strcmp(argv[iArg], "-thd") == 0)
+            dThd = dValue;
+        else if (strcmp(argv[iArg], "-snr") == 0)
+            dSnr = dValue;
+        else if (strcmp(argv[iArg], "-jitter") == 0)
+            dJitter = dValue;
+        else {
+            printf("Unknown option %s\n", argv[iArg]);
+            return 2;
+        }
+    }
+    if (iArg != argc) {
+        printf("Option %s has no value\n", argv[iArg]);
+        return 2;
+    }
+    if (xConfig.usPeriod == 0 || xConfig.dTau <= 0) {
+        printf("Invalid PWM period or time constant\n");
+        return 2;
+    }
+    xConfig.ulSkip = (lSkip >= 0) ? (uint32_t)lSkip
+            : (uint32_t)ceil(10*xConfig.dTau*spectrumPBCLOCK/xConfig.usPeriod);
+
+    ulCount = prvLoad(argv[1], &pusDuty);
+    if (ulCount == 0) {
+        printf("Cannot read %s\n", argv[1]);
+        return 2;
+    }
+
+    cStatus = SpectrumAnalyze(pusDuty, ulCount, &xConfig, &xResult);
+    free(pusDuty);
+    if (cStatus == SPECTRUM_TOO_SHORT) {
+        printf("%u values, at least %u needed\n", (unsigned)ulCount, (unsigned)(xConfig.ulSkip + spectrumMIN_FFT));
+        return 2;
+    } else if (cStatus != SPECTRUM_SUCCESS) {
+        printf("No signal in %s\n", argv[1]);
+        return 2;
+    }
+
+    printf("%s: %u PWM periods, FFT of %u, RC %.1f us\n", argv[1], (unsigned)ulCount,
+            (unsigned)xResult.ulSamples, xConfig.dTau*1e6);
+    printf("Fundamental %.3f Hz, %.4f of full scale\n", xResult.dFrequency, xResult.dAmplitude);
+    printf("THD %.2f dB (%.3f%%)\n", xResult.dThd, 100*pow(10, xResult.dThd/20));
+    printf("SFDR %.2f dB\nSNR %.2f dB\nSINAD %.2f dB\n", xResult.dSfdr, xResult.dSnr, xResult.dSinad);
+    printf("Period jitter %.3f ns RMS over %u periods\n", xResult.dJitter*1e9, (unsigned)xResult.ulPeriods);
+    printf("PWM ripple %.4f of full scale\n", xResult.dRipple);
+
+    if (!isnan(dSfdr))
+        ucPass &= prvCheck("SFDR", xResult.dSfdr, dSfdr, 1);
+    if (!isnan(dThd))
+        ucPass &= prvCheck("THD", xResult.dThd, dThd, 0);
+    if (!isnan(dSnr))
+        ucPass &= prvCheck("SNR", xResult.dSnr, dSnr, 1);
+    if (!isnan(dJitter))
+        ucPass &= prvCheck("Jitter", xResult.dJitter*1e9, dJitter, 0);
+
+    return ucPass ? 0 : 1;
+}
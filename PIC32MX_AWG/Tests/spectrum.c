@@ -0,0 +1,227 @@
+/*
+ * File:   spectrum.c
+ * Author: Diogo Vala
+ *
+ * Overview: Signal quality of an OC1 duty stream (host only)
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "spectrum.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define spectrumHYSTERESIS 0.1 /* Crossing detector re-arms this far below the level, fraction of peak to peak */
+#define spectrumFLOOR 1e-30 /* Keeps the dB values finite for an ideal signal */
+
+/* Bin classes */
+enum { BIN_FREE, BIN_DC, BIN_FUNDAMENTAL, BIN_HARMONIC };
+
+/* In place radix 2 FFT, ulSize a power of 2 */
+static void prvFft(double *pdRe, double *pdIm, uint32_t ulSize){
+    uint32_t i, j, k, ulLength;
+    double dTmp;
+
+    for (i = 1, j = 0; i < ulSize; i++) { /* Bit reversed order */
+        for (k = ulSize >> 1; j & k; k >>= 1)
+            j ^= k;
+        j |= k;
+        if (i < j) {
+            dTmp = pdRe[i]; pdRe[i] = pdRe[j]; pdRe[j] = dTmp;
+            dTmp = pdIm[i]; pdIm[i] = pdIm[j]; pdIm[j] = dTmp;
+        }
+    }
+
+    for (ulLength = 2; ulLength <= ulSize; ulLength <<= 1) {
+        double dAngle = -2*M_PI/ulLength;
+        for (i = 0; i < ulSize; i += ulLength) {
+            for (k = 0; k < ulLength/2; k++) {
+                double dWRe = cos(dAngle*k);
+                double dWIm = sin(dAngle*k);
+                double *pdARe = &pdRe[i + k], *pdAIm = &pdIm[i + k];
+                double *pdBRe = &pdRe[i + k + ulLength/2], *pdBIm = &pdIm[i + k + ulLength/2];
+                double dRe = *pdBRe*dWRe - *pdBIm*dWIm;
+                double dIm = *pdBRe*dWIm + *pdBIm*dWRe;
+
+                *pdBRe = *pdARe - dRe;
+                *pdBIm = *pdAIm - dIm;
+                *pdARe += dRe;
+                *pdAIm += dIm;
+            }
+        }
+    }
+}
+
+/* Marks ulCenter +- spectrumLOBE_BINS as ucClass where still free, returns their power */
+static double prvClaim(const double *pdPower, uint8_t *pucClass, uint32_t ulBins, uint32_t ulCenter, uint8_t ucClass){
+    double dSum = 0;
+    uint32_t k;
+    uint32_t ulFirst = (ulCenter > spectrumLOBE_BINS) ? ulCenter - spectrumLOBE_BINS : 0;
+
+    for (k = ulFirst; k <= ulCenter + spectrumLOBE_BINS && k < ulBins; k++) {
+        if (pucClass[k] == BIN_FREE) {
+            pucClass[k] = ucClass;
+            dSum += pdPower[k];
+        }
+    }
+    return dSum;
+}
+
+/* PWM output through the RC filter, one tick at a time. Fills pdMean with
+ * the average of each PWM period from ulFirst on, and the ripple. */
+static void prvReconstruct(const uint16_t *pusDuty, uint32_t ulCount, const SpectrumConfig_t *pxConfig,
+        double dDecay, uint32_t ulFirst, double *pdMean, double *pdRipple){
+    double dOut = 0;
+    double dSum, dLow, dHigh, dInput;
+    uint32_t ulPwm;
+    uint16_t usTick;
+
+    *pdRipple = 0;
+    for (ulPwm = 0; ulPwm < ulCount; ulPwm++) {
+        dSum = 0;
+        dLow = dHigh = dOut;
+        for (usTick = 0; usTick < pxConfig->usPeriod; usTick++) {
+            dInput = (usTick < pusDuty[ulPwm]) ? 1.0 : 0.0; /* High until TMR2 matches OC1R */
+            dOut = dInput + (dOut - dInput)*dDecay;
+            dSum += dOut;
+            if (dOut < dLow)
+                dLow = dOut;
+            if (dOut > dHigh)
+                dHigh = dOut;
+        }
+        if (ulPwm >= ulFirst)
+            pdMean[ulPwm - ulFirst] = dSum/pxConfig->usPeriod;
+        if (ulPwm >= pxConfig->ulSkip && dHigh - dLow > *pdRipple)
+            *pdRipple = dHigh - dLow;
+    }
+}
+
+/* Times the rising crossings of dLevel in the PWM period averages,
+ * interpolated between periods */
+static void prvJitter(const double *pdMean, uint32_t ulSize, uint16_t usPeriod,
+        double dLevel, double dHysteresis, SpectrumResult_t *pxResult){
+    double dTime, dLast = -1, dInterval;
+    double dSum = 0, dSquares = 0;
+    uint8_t ucArmed = 0;
+    uint32_t ulIntervals = 0;
+    uint32_t k;
+
+    for (k = 1; k < ulSize; k++) {
+        if (pdMean[k] < dLevel - dHysteresis) {
+            ucArmed = 1;
+        } else if (ucArmed && pdMean[k - 1] < dLevel && pdMean[k] >= dLevel) {
+            ucArmed = 0;
+            dTime = (k - 1 + (dLevel - pdMean[k - 1])/(pdMean[k] - pdMean[k - 1]))*usPeriod; /* Timer ticks */
+            if (dLast >= 0) {
+                dInterval = dTime - dLast;
+                dSum += dInterval;
+                dSquares += dInterval*dInterval;
+                ulIntervals++;
+            }
+            dLast = dTime;
+        }
+    }
+
+    pxResult->ulPeriods = ulIntervals;
+    pxResult->dJitter = 0;
+    if (ulIntervals > 1) {
+        double dMean = dSum/ulIntervals;
+        double dVariance = dSquares/ulIntervals - dMean*dMean;
+
+        pxResult->dJitter = (dVariance > 0) ? sqrt(dVariance)/spectrumPBCLOCK : 0;
+    }
+}
+
+int8_t SpectrumAnalyze(const uint16_t *pusDuty, uint32_t ulCount, const SpectrumConfig_t *pxConfig,
+        SpectrumResult_t *pxResult){
+    uint32_t ulSize = spectrumMAX_FFT;
+    uint32_t ulBins, ulFirst, k, ulPeak = 0;
+    double *pdRe, *pdIm, *pdPower;
+    uint8_t *pucClass;
+    double dDecay = exp(-1.0/(pxConfig->dTau*spectrumPBCLOCK));
+    double dMean = 0, dMin, dMax, dWindow, dWindowEnergy = 0;
+    double dFundamental, dHarmonics = 0, dNoise = 0, dSpur = spectrumFLOOR, dCentroid = 0, dBin;
+    uint8_t ucHarmonic;
+
+    if (pxConfig->usPeriod == 0 || ulCount < pxConfig->ulSkip + spectrumMIN_FFT)
+        return SPECTRUM_TOO_SHORT;
+    while (ulSize > ulCount - pxConfig->ulSkip)
+        ulSize >>= 1;
+    ulFirst = ulCount - ulSize; /* The last samples, furthest from the start transient */
+    ulBins = ulSize/2 + 1;
+
+    pdRe = malloc(ulSize*sizeof(double));
+    pdIm = calloc(ulSize, sizeof(double));
+    pdPower = malloc(ulBins*sizeof(double));
+    pucClass = calloc(ulBins, 1);
+    if (pdRe == NULL || pdIm == NULL || pdPower == NULL || pucClass == NULL) {
+        free(pdRe); free(pdIm); free(pdPower); free(pucClass);
+        return SPECTRUM_NO_MEMORY;
+    }
+
+    prvReconstruct(pusDuty, ulCount, pxConfig, dDecay, ulFirst, pdRe, &pxResult->dRipple);
+
+    dMin = dMax = pdRe[0];
+    for (k = 0; k < ulSize; k++) {
+        dMean += pdRe[k];
+        if (pdRe[k] < dMin)
+            dMin = pdRe[k];
+        if (pdRe[k] > dMax)
+            dMax = pdRe[k];
+    }
+    dMean /= ulSize;
+    if (dMax - dMin < 1e-9) {
+        free(pdRe); free(pdIm); free(pdPower); free(pucClass);
+        return SPECTRUM_NO_SIGNAL;
+    }
+    prvJitter(pdRe, ulSize, pxConfig->usPeriod, dMean, spectrumHYSTERESIS*(dMax - dMin), pxResult);
+
+    for (k = 0; k < ulSize; k++) { /* 4 term Blackman-Harris, -92 dB side lobes */
+        double dPhase = 2*M_PI*k/ulSize;
+        dWindow = 0.35875 - 0.48829*cos(dPhase) + 0.14128*cos(2*dPhase) - 0.01168*cos(3*dPhase);
+        pdRe[k] = (pdRe[k] - dMean)*dWindow;
+        dWindowEnergy += dWindow*dWindow;
+    }
+    prvFft(pdRe, pdIm, ulSize);
+    for (k = 0; k < ulBins; k++)
+        pdPower[k] = pdRe[k]*pdRe[k] + pdIm[k]*pdIm[k];
+
+    prvClaim(pdPower, pucClass, ulBins, 0, BIN_DC);
+    for (k = 0; k < ulBins; k++) {
+        if (pucClass[k] == BIN_FREE && (ulPeak == 0 || pdPower[k] > pdPower[ulPeak]))
+            ulPeak = k;
+    }
+    dFundamental = prvClaim(pdPower, pucClass, ulBins, ulPeak, BIN_FUNDAMENTAL);
+    for (k = 0; k < ulBins; k++) {
+        if (pucClass[k] == BIN_FUNDAMENTAL)
+            dCentroid += k*pdPower[k];
+    }
+    dCentroid /= dFundamental;
+
+    for (ucHarmonic = 2; ucHarmonic <= spectrumHARMONICS; ucHarmonic++) {
+        dBin = fmod(dCentroid*ucHarmonic, ulSize); /* Folded into 0 - Nyquist */
+        if (dBin > ulSize/2)
+            dBin = ulSize - dBin;
+        dHarmonics += prvClaim(pdPower, pucClass, ulBins, (uint32_t)(dBin + 0.5), BIN_HARMONIC);
+    }
+
+    for (k = 0; k < ulBins; k++) {
+        if (pucClass[k] == BIN_FREE)
+            dNoise += pdPower[k];
+        if ((pucClass[k] == BIN_FREE || pucClass[k] == BIN_HARMONIC) && pdPower[k] > dSpur)
+            dSpur = pdPower[k];
+    }
+
+    pxResult->ulSamples = ulSize;
+    pxResult->dFrequency = dCentroid*spectrumPBCLOCK/pxConfig->usPeriod/ulSize;
+    pxResult->dAmplitude = sqrt(4*dFundamental/(ulSize*dWindowEnergy)); /* Parseval, one sided */
+    pxResult->dThd = 10*log10((dHarmonics + spectrumFLOOR)/dFundamental);
+    pxResult->dSfdr = 10*log10(pdPower[ulPeak]/dSpur);
+    pxResult->dSnr = 10*log10(dFundamental/(dNoise + spectrumFLOOR));
+    pxResult->dSinad = 10*log10(dFundamental/(dNoise + dHarmonics + spectrumFLOOR));
+
+    free(pdRe); free(pdIm); free(pdPower); free(pucClass);
+    return SPECTRUM_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/*
+ * File:   spectrum.h
+ * Author: Diogo Vala
+ *
+ * Overview: Signal quality of an OC1 duty stream (host only). The duty
+ *           stream, one OC1R value per PWM period, is turned into the
+ *           PWM output and filtered by a first order RC, then measured
+ *           with a windowed FFT (THD, SFDR, SNR, SINAD) and by timing the
+ *           rising crossings of the mean level (period jitter), on the
+ *           PWM period averages.
+ */
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+
+// Define return codes
+#define SPECTRUM_SUCCESS 0
+#define SPECTRUM_TOO_SHORT -1
+#define SPECTRUM_NO_MEMORY -2
+#define SPECTRUM_NO_SIGNAL -3
+
+#define spectrumPBCLOCK 40000000.0 /* PWM timer clock (Hz) */
+#define spectrumMIN_FFT 256 /* Shortest analysis, in PWM periods */
+#define spectrumMAX_FFT 65536
+#define spectrumHARMONICS 10 /* Highest harmonic counted in the THD */
+#define spectrumLOBE_BINS 4 /* Half width of a tone with the Blackman-Harris window */
+
+/* Analog side of the output */
+typedef struct {
+    uint16_t usPeriod; /* PWM period in timer ticks, PR2+1 */
+    double dTau; /* RC time constant (s) */
+    uint32_t ulSkip; /* PWM periods ignored at the start (filter settling) */
+} SpectrumConfig_t;
+
+typedef struct {
+    double dFrequency; /* Fundamental (Hz) */
+    double dAmplitude; /* Fundamental peak, fraction of full scale */
+    double dThd; /* dB, harmonics 2 to spectrumHARMONICS over the fundamental */
+    double dSfdr; /* dB, fundamental over the largest other bin */
+    double dSnr; /* dB, fundamental over everything but DC and harmonics */
+    double dSinad; /* dB, fundamental over everything but DC */
+    double dJitter; /* RMS deviation of the period (s) */
+    double dRipple; /* Peak to peak ripple within a PWM period, fraction of full scale */
+    uint32_t ulSamples; /* FFT length, in PWM periods */
+    uint32_t ulPeriods; /* Periods timed for the jitter */
+} SpectrumResult_t;
+
+/********************************************************************
+ * Function: 	 SpectrumAnalyze()
+ * Input: 		 pusDuty - OC1R of each PWM period
+ *               ulCount - Number of PWM periods
+ *               pxConfig - PWM period and RC filter
+ * Output:       pxResult - Measurements
+ * Returns:      SPECTRUM_SUCCESS if the stream could be measured.
+ *               SPECTRUM_XXX error codes in case of failure.
+ * Overview:     The filter output is averaged over each PWM period and
+ *               the last power of 2 of those samples (at most
+ *               spectrumMAX_FFT) go through the FFT. The fundamental is
+ *               the largest tone; harmonics above Nyquist are folded.
+ * Note:		 Needs several signal periods in the FFT for the tones
+ *               to separate, spectrumLOBE_BINS*2 bins at least.
+ ********************************************************************/
+int8_t SpectrumAnalyze(const uint16_t *pusDuty, uint32_t ulCount, const SpectrumConfig_t *pxConfig,
+        SpectrumResult_t *pxResult);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * File:   waveform_bench.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host benchmark of the integer sine generator (waveform.c)
+ *           against the double precision sin()/ceil() loop it replaced
+ *           in pvWaveformGenerator(). Both must give the same samples
+ *           for every amplitude and duty of the A and D commands, for
+ *           every peak up to 12 bit PWM, and validate_sine.txt.
+ *           The timings are the host's, which has an FPU: on the
+ *           PIC32MX the double precision loop runs in soft-float and
+ *           the gap is much wider.
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -o waveform_bench waveform_bench.c ../waveform.c -lm && ./waveform_bench
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "../waveform.h"
+
+#define benchMAX_DUTY 254 /* Peak value of the A command at 3.3 V */
+#define benchMAX_PEAK 4095 /* 12 bit PWM */
+#define benchRUNS 20000 /* Periods generated for each timing */
+
+static volatile uint16_t usOut[waveformSIZE];
+static uint16_t usReference[waveformSIZE];
+
+/* The WAVE_SINE loop of pvWaveformGenerator() before waveform.c */
+static void prvSineReference(uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex){
+    uint16_t usIterator;
+
+    for (usIterator = 0; usIterator < waveformSIZE; usIterator++) {
+        pusOut[usIterator] = usMax/2;
+        if (usIterator < usDutyIndex/2)
+            pusOut[usIterator] = (uint16_t)ceil(((float)usMax/2*sin((2*M_PI*(usIterator+1))/waveformSIZE)+usMax/2));
+        if (usIterator > waveformSIZE/2 && usIterator < (waveformSIZE/2 + usDutyIndex/2))
+            pusOut[usIterator] = (uint16_t)ceil(((float)usMax/2*sin((2*M_PI*(usIterator+1))/waveformSIZE)+usMax/2));
+    }
+}
+
+/* Index of the first differing sample, waveformSIZE if none */
+static uint16_t prvDiffer(void){
+    uint16_t usIterator;
+
+    for (usIterator = 0; usIterator < waveformSIZE; usIterator++)
+        if (usOut[usIterator] != usReference[usIterator])
+            break;
+    return usIterator;
+}
+
+/* Compares both generators for usMax, on every duty of the D command if ucDuties */
+static uint8_t prvCheck(uint16_t usMax, uint8_t ucDuties){
+    uint16_t usDutyIndex, usSample;
+    uint8_t ucDuty;
+
+    for (ucDuty = ucDuties ? 0 : 100; ucDuty <= 100; ucDuty++) {
+        usDutyIndex = waveformSIZE*ucDuty/100; /* pvInterface() */
+        WaveformSine(usOut, usMax, usDutyIndex);
+        prvSineReference(usReference, usMax, usDutyIndex);
+        usSample = prvDiffer();
+        if (usSample != waveformSIZE) {
+            printf("FAIL peak %u duty %u%%: sample %u is %u, expected %u\n", usMax, ucDuty, usSample,
+                    usOut[usSample], usReference[usSample]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Reads waveformSIZE values, returns 0 if the file is short */
+static uint8_t prvLoad(const char *pcFile, uint16_t *pusOut){
+    FILE *pxFile = fopen(pcFile, "r");
+    uint16_t usCount = 0;
+    unsigned uValue;
+
+    if (pxFile == NULL)
+        return 0;
+    while (usCount < waveformSIZE && fscanf(pxFile, "%u", &uValue) == 1)
+        pusOut[usCount++] = (uint16_t)uValue;
+    fclose(pxFile);
+    return usCount == waveformSIZE;
+}
+
+static double prvNow(void){
+    struct timespec xTime;
+
+    clock_gettime(CLOCK_MONOTONIC, &xTime);
+    return xTime.tv_sec + xTime.tv_nsec*1e-9;
+}
+
+int main(void){
+    double dStart, dInteger, dDouble;
+    uint32_t ulRun;
+    uint16_t usMax;
+    uint16_t usSample;
+    uint8_t ucFailed = 0;
+
+    /* Every amplitude and duty the commands can set */
+    for (usMax = 0; usMax <= benchMAX_DUTY; usMax++) {
+        if (!prvCheck(usMax, 1)) {
+            ucFailed++;
+            break;
+        }
+    }
+    /* Every peak of the PWM resolutions, 100% duty */
+    for (usMax = 0; usMax <= benchMAX_PEAK; usMax++) {
+        if (!prvCheck(usMax, 0)) {
+            ucFailed++;
+            break;
+        }
+    }
+    if (!prvLoad("validate_sine.txt", usReference)) {
+        printf("FAIL validate_sine.txt: missing or short\n");
+        ucFailed++;
+    }
+    else {
+        WaveformSine(usOut, benchMAX_DUTY, waveformSIZE);
+        usSample = prvDiffer();
+        if (usSample != waveformSIZE) {
+            printf("FAIL validate_sine.txt: sample %u is %u, expected %u\n", usSample, usOut[usSample], usReference[usSample]);
+            ucFailed++;
+        }
+    }
+
+    dStart = prvNow();
+    for (ulRun = 0; ulRun < benchRUNS; ulRun++)
+        WaveformSine(usOut, ulRun % (benchMAX_DUTY + 1), waveformSIZE);
+    dInteger = prvNow() - dStart;
+    dStart = prvNow();
+    for (ulRun = 0; ulRun < benchRUNS; ulRun++)
+        prvSineReference(usReference, ulRun % (benchMAX_DUTY + 1), waveformSIZE);
+    dDouble = prvNow() - dStart;
+    printf("Sine period of %u samples: integer %.2f us, double sin()/ceil() %.2f us, %.1fx\n", waveformSIZE,
+            dInteger*1e6/benchRUNS, dDouble*1e6/benchRUNS, dDouble/dInteger);
+
+    printf("%s: %u of 3 checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed);
+    return ucFailed ? 1 : 0;
+}
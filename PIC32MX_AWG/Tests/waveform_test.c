@@ -0,0 +1,945 @@
+/*
+ * File:   waveform_test.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host test of the waveform generation and playback. Checks
+ *           the generated periods against the validate_*.txt vectors
+ *           (plotted by Waveform_validation.m), then plays them with
+ *           playback.c and the Timer 2, Timer 3, OC and DMA drivers on
+ *           the register model (Sim/sfr.h), PlaybackDmaIsr() and
+ *           PlaybackTriggerIsr() running as the DMA0 and INT2 ISRs, and
+ *           checks OC1R, OC2R and the RE8 marker of every PWM period.
+ *           Every output must swap buffers on the same sample, a buffer
+ *           taken back while pending must not be swapped in, and a
+ *           sequence of tables at different sample rates must switch on
+ *           period boundaries without losing or repeating samples while
+ *           output 2 swaps its own buffer. A burst must play once per
+ *           INT2 rising edge and leave the outputs at 0. The
+ *           generator rewriting a buffer while the other plays must
+ *           never tear a period as long as the DMA0 ISR runs within one
+ *           sample period of the block end. The signal quality of the
+ *           filtered output (spectrum.h) must stay within the
+ *           xQualities[] limits. Last, DDS playback must follow an
+ *           ideal phase accumulator sample by sample across a retune,
+ *           a buffer swap on the accumulator wrap and a sequence, with
+ *           the marker in step, and its spectrum must match the table
+ *           playback of the same validate_*.txt vectors.
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -I../../Sim -o waveform_test waveform_test.c spectrum.c ../playback.c ../waveform.c \
+ *           ../timer2.c ../timer3.c ../oc.c ../dma.c ../../Sim/sfr.c ../../Sim/rtos.c -lm && ./waveform_test
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <xc.h>
+#include "sfr.h"
+#include "../timer2.h"
+#include "../playback.h"
+#include "spectrum.h"
+
+#define testPWM_FREQUENCY(bits) (sfrPBCLOCK >> (bits)) /* mainAwgPWM_FREQUENCY */
+#define testMAX_DUTY 254 /* Peak value of the vectors */
+#define testVECTOR_BITS 8 /* The vectors are OC1RS values at this resolution */
+#define testOUTPUTS 2
+#define testOUTPUT2_PHASE (waveformSIZE/4) /* 90 Deg, I/Q */
+#define testTABLE_FREQUENCY(divider) (testPWM_FREQUENCY(testVECTOR_BITS)*playbackFREQUENCY_SCALE/(waveformSIZE*(divider))) /* Sample rate of the PWM frequency / divider */
+#define testSEGMENTS 3
+#define testSEQUENCE_SWAP_AT 1000 /* Samples of the sequence before output 2 is rewritten */
+#define testBURST_IDLE 100 /* PWM periods checked before the first trigger and after each burst */
+#define testRC_TAU(bits) (10e-6*(1 << ((bits) - 8))) /* Output filter, 1k / 10n at 8 bits, scaled with the PWM period */
+#define testQUALITY_CYCLES 30 /* Signal periods played for each measurement */
+#define testMAX_DIVIDER 4
+#define testMAX_JITTER 1e-9 /* Table playback has a fixed period */
+#define testSWAP_COMMANDS 12
+#define testSWAP_WRITE_TICKS 300 /* PBCLK ticks per sample written, a buffer takes more than a period */
+#define testSWAP_PERIODS 40 /* Covers every command */
+#define testDDS_SAMPLE_RATE testPWM_FREQUENCY(testVECTOR_BITS) /* mainAwgDDS_SAMPLE_RATE */
+#define testDDS_FREQUENCY 123456 /* 1234.56 Hz */
+#define testDDS_NEW_FREQUENCY 98765 /* 987.65 Hz */
+#define testDDS_EXACT_PERIODS 20000
+#define testDDS_CHANGE_AT 7777 /* Samples before the retune */
+#define testDDS_SWAP_AT 13333 /* Samples before the new buffer is pended */
+#define testDDS_SEQUENCE_PERIODS 5000 /* More than 4 loops of xDdsSegments[] */
+#define testDDS_MAX_LOSS 1.0 /* dB, DDS against table playback */
+#define testCAPTURE_SIZE (testQUALITY_CYCLES*testMAX_DIVIDER*waveformSIZE + testMAX_DIVIDER)
+
+#if playbackNUM_CHANNELS != testOUTPUTS
+#error "Build playback.c with two outputs"
+#endif
+
+enum { TEST_SINE, TEST_SQUARE, TEST_TRIANGLE, TEST_NONE };
+
+/* One reference vector and the generator call that must match it */
+typedef struct {
+    const char *pcFile;
+    uint8_t ucType; /* TEST_NONE: not generated (arbitrary upload) */
+    uint16_t usDutyIndex;
+} TestVector_t;
+
+static const TestVector_t xVectors[] = {
+    {"validate_sine.txt", TEST_SINE, waveformSIZE}, /* 100% duty */
+    {"validate_square.txt", TEST_SQUARE, waveformSIZE/2},
+    {"validate_triangle.txt", TEST_TRIANGLE, waveformSIZE/2},
+    {"validate_square_duty.txt", TEST_SQUARE, waveformSIZE*80/100},
+    {"validate_triangle_duty.txt", TEST_TRIANGLE, waveformSIZE},
+    {"validate_arbitrary.txt", TEST_NONE, 0},
+};
+
+#define testNUM_VECTORS (sizeof(xVectors)/sizeof(xVectors[0]))
+
+/* Signal quality limits of a vector generated at full scale and played at
+ * the PWM frequency / ucDivider. A few dB below the current values, a
+ * faster generator must not lose more. */
+typedef struct {
+    const char *pcName;
+    uint8_t ucVector; /* Index in xVectors[], one with a generator */
+    uint8_t ucBits; /* mainAwgPWM_BITS */
+    uint8_t ucDivider; /* 1 to testMAX_DIVIDER */
+    double dMinSfdr;
+    double dMaxThd;
+    double dMinSnr;
+} TestQuality_t;
+
+static const TestQuality_t xQualities[] = {
+    {"sine", 0, 8, 1, 45.0, -44.0, 48.0},
+    {"sine", 0, 8, 4, 52.0, -48.0, 46.0},
+    {"square", 1, 8, 1, 8.5, -7.0, 13.0},
+    {"triangle", 2, 8, 1, 18.0, -17.5, 36.0},
+    {"triangle", 2, 8, 4, 18.0, -17.5, 35.0},
+    {"sine", 0, 12, 1, 45.0, -44.0, 62.0},
+};
+
+#define testNUM_QUALITIES (sizeof(xQualities)/sizeof(xQualities[0]))
+
+/* DDS spectrum against the table playback of a reference vector */
+typedef struct {
+    uint8_t ucVector; /* Index in xVectors[] */
+    uint8_t ucDivider; /* Table playback at the PWM frequency / ucDivider */
+} TestDds_t;
+
+static const TestDds_t xDdsSpectra[] = {
+    {0, 1}, {0, 4}, {1, 1}, {2, 1}, {2, 4}, {3, 1}, {4, 1},
+};
+
+#define testNUM_DDS_SPECTRA (sizeof(xDdsSpectra)/sizeof(xDdsSpectra[0]))
+
+/* Segment of the DDS sequence */
+typedef struct {
+    uint8_t ucVector; /* Index in xVectors[] */
+    uint16_t usRepeats;
+    uint32_t ulFrequency; /* In 1/playbackFREQUENCY_SCALE Hz */
+} TestDdsSegment_t;
+
+static const TestDdsSegment_t xDdsSegments[] = {
+    {0, 2, 123456}, {2, 1, 246912}, {1, 3, 61728},
+};
+
+#define testNUM_DDS_SEGMENTS (sizeof(xDdsSegments)/sizeof(xDdsSegments[0]))
+
+static SfrOcSample_t xCapture[testCAPTURE_SIZE]; /* OC registers and LATE of every PWM period */
+
+/* Reads waveformSIZE values, returns 0 if the file is short */
+static uint8_t prvLoad(const char *pcFile, uint16_t *pusOut){
+    FILE *pxFile = fopen(pcFile, "r");
+    uint16_t usCount = 0;
+    unsigned uValue;
+
+    if (pxFile == NULL)
+        return 0;
+    while (usCount < waveformSIZE && fscanf(pxFile, "%u", &uValue) == 1)
+        pusOut[usCount++] = (uint16_t)uValue;
+    fclose(pxFile);
+    return usCount == waveformSIZE;
+}
+
+/* Compares usCount values, prints the first difference */
+static uint8_t prvCompare(const char *pcName, const uint16_t *pusGot, const uint16_t *pusExpected, uint16_t usCount){
+    uint16_t usIterator;
+
+    for (usIterator = 0; usIterator < usCount; usIterator++) {
+        if (pusGot[usIterator] != pusExpected[usIterator]) {
+            printf("FAIL %s: sample %u is %u, expected %u\n", pcName, usIterator,
+                    pusGot[usIterator], pusExpected[usIterator]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Generates the period of a vector with peak usMax, returns 0 if it has no generator */
+static uint8_t prvGenerate(const TestVector_t *pxVector, uint16_t usMax, uint16_t *pusOut){
+    switch (pxVector->ucType) {
+        case TEST_SINE:
+            WaveformSine(pusOut, usMax, pxVector->usDutyIndex);
+            return 1;
+        case TEST_SQUARE:
+            WaveformSquare(pusOut, usMax, pxVector->usDutyIndex);
+            return 1;
+        case TEST_TRIANGLE:
+            WaveformTriangle(pusOut, usMax, pxVector->usDutyIndex);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* pusTable advanced by usPhase samples, like prvGenerateChannel() of mainAWG.c */
+static void prvRotate(const uint16_t *pusTable, uint16_t usPhase, uint16_t *pusOut){
+    uint16_t usIterator;
+
+    for (usIterator = 0; usIterator < waveformSIZE; usIterator++)
+        pusOut[usIterator] = pusTable[(usIterator + usPhase) % waveformSIZE];
+}
+
+static uint8_t prvTestGenerator(const TestVector_t *pxVector, const uint16_t *pusExpected){
+    uint16_t usOut[waveformSIZE];
+
+    if (!prvGenerate(pxVector, testMAX_DUTY, usOut))
+        return 1;
+    return prvCompare(pxVector->pcFile, usOut, pusExpected, waveformSIZE);
+}
+
+/* Power on, then the outputs and the playback set up like mainAWG():
+ * OC1 and OC2 in PWM mode on Timer 2 with ucBits of resolution */
+static uint8_t prvOpen(uint8_t ucBits, uint8_t ucMode){
+    uint8_t ucOutput;
+
+    if (SfrOpen(NULL) != SFR_SUCCESS)
+        return 0;
+    SfrOcCapture(NULL, 0);
+    SfrSetIsr(sfrVECTOR_DMA0, PlaybackDmaIsr);
+    SfrSetIsr(sfrVECTOR_INT2, PlaybackTriggerIsr);
+
+    if (Timer2Config(testPWM_FREQUENCY(ucBits)) != 0)
+        return 0;
+    for (ucOutput = 1; ucOutput <= testOUTPUTS; ucOutput++) {
+        OCConfig(ucOutput, 2);
+        OCControl(ucOutput, ocSTART);
+    }
+    Timer2Start();
+
+    if (PlaybackInit(ucMode, testPWM_FREQUENCY(ucBits)) != PLAYBACK_SUCCESS)
+        return 0;
+    IFS1bits.DMA0IF = 0;
+    IEC1bits.DMA0IE = 1;
+    INTCONbits.INT2EP = 1; /* Rising edge */
+    return 1;
+}
+
+/* Captures from the start of a PWM period. Timer 3 started next, at the
+ * PWM frequency / divider, leaves divider periods of the initial OCxRS
+ * before the first sample. */
+static void prvCaptureStart(void){
+    while (TMR2 != 0)
+        ;
+    SfrOcCapture(xCapture, testCAPTURE_SIZE);
+}
+
+/* pvWaveformGenerator(): writes pusTables[n] into output n+1 of the
+ * buffer that is not playing, ulWriteTicks PBCLK ticks per sample, then
+ * pends it, or starts the playback with it */
+static void prvWrite(const uint16_t *pusTables[testOUTPUTS], const Timer3Period_t *pxPeriod, uint32_t ulWriteTicks){
+    uint8_t ucBuffer = PlaybackWriteBegin();
+    uint16_t usIterator;
+    uint8_t ucOutput;
+
+    for (usIterator = 0; usIterator < waveformSIZE; usIterator++) {
+        for (ucOutput = 0; ucOutput < testOUTPUTS; ucOutput++)
+            xPlayback.usBuffers[ucBuffer][ucOutput][usIterator] = pusTables[ucOutput][usIterator];
+        SfrRun(ulWriteTicks);
+    }
+    PlaybackWriteEnd(ucBuffer, pxPeriod);
+}
+
+/* OCxR of output ucOutput (0 is OC1) in ulCount captured periods from
+ * ulFirst, returns 0 if they were not all captured */
+static uint8_t prvStream(uint8_t ucOutput, uint32_t ulFirst, uint32_t ulCount, uint16_t *pusOut){
+    uint32_t ulPeriod;
+
+    if (ulFirst + ulCount > xSfr.ulOcPeriods || ulFirst + ulCount > testCAPTURE_SIZE)
+        return 0;
+    for (ulPeriod = 0; ulPeriod < ulCount; ulPeriod++)
+        pusOut[ulPeriod] = xCapture[ulFirst + ulPeriod].usR[ucOutput];
+    return 1;
+}
+
+/* RE8 in captured period ulPeriod */
+static uint8_t prvMarker(uint32_t ulPeriod){
+    return (xCapture[ulPeriod].usLatE & _LATE_LATE8_MASK) != 0;
+}
+
+/* Plays pusTable on every output with ucBits of PWM resolution, Timer 3
+ * at the PWM frequency / ucDivider, and captures ulPeriods */
+static uint8_t prvPlay(const uint16_t *pusTable, uint8_t ucBits, uint8_t ucDivider, uint32_t ulPeriods){
+    const uint16_t *pusTables[testOUTPUTS] = {pusTable, pusTable};
+    Timer3Period_t xPeriod;
+
+    if (!prvOpen(ucBits, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(ucBits)/ucDivider, &xPeriod) != 0)
+        return 0;
+    prvCaptureStart();
+    prvWrite(pusTables, &xPeriod, 0);
+    SfrRunOcPeriods(ulPeriods);
+    return 1;
+}
+
+/* Plays pusFirst, one sample per PWM period, and pends pusSecond at once:
+ * it must follow on the next period boundary */
+static uint8_t prvTestPlayback(const char *pcName, const uint16_t *pusFirst, const uint16_t *pusSecond){
+    const uint16_t *pusFirsts[testOUTPUTS] = {pusFirst, pusFirst};
+    const uint16_t *pusSeconds[testOUTPUTS] = {pusSecond, pusSecond};
+    uint16_t usExpected[2*waveformSIZE];
+    uint16_t usStream[2*waveformSIZE];
+    uint16_t usIterator;
+    Timer3Period_t xPeriod;
+
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(testVECTOR_BITS), &xPeriod) != 0) {
+        printf("FAIL %s: playback not configured\n", pcName);
+        return 0;
+    }
+    prvCaptureStart();
+    prvWrite(pusFirsts, &xPeriod, 0);
+    prvWrite(pusSeconds, &xPeriod, 0);
+    SfrRunOcPeriods(1 + 2*waveformSIZE);
+
+    /* The first period still has the initial OC1RS */
+    if (!prvStream(0, 1, 2*waveformSIZE, usStream)) {
+        printf("FAIL %s: short capture\n", pcName);
+        return 0;
+    }
+    for (usIterator = 0; usIterator < 2*waveformSIZE; usIterator++)
+        usExpected[usIterator] = (usIterator < waveformSIZE) ? pusFirst[usIterator] : pusSecond[usIterator - waveformSIZE];
+    return prvCompare(pcName, usStream, usExpected, 2*waveformSIZE);
+}
+
+/* Plays a sine on OC1 and the same sine 90 Deg ahead on OC2, then swaps
+ * in a square and a triangle. In every PWM period both OCxR must hold
+ * the same sample of their own table, and RE8 must be high for the
+ * first playbackMARKER_WIDTH+1 samples of each period. */
+static uint8_t prvTestOutputs(void){
+    static uint16_t usTables[2][testOUTPUTS][waveformSIZE]; /* Buffer, output, sample */
+    const uint16_t *pusFirsts[testOUTPUTS] = {usTables[0][0], usTables[0][1]};
+    const uint16_t *pusSeconds[testOUTPUTS] = {usTables[1][0], usTables[1][1]};
+    uint16_t usExpected;
+    uint16_t usSample;
+    uint32_t ulPeriod;
+    uint8_t ucOutput;
+    Timer3Period_t xPeriod;
+
+    WaveformSine(usTables[0][0], testMAX_DUTY, waveformSIZE);
+    prvRotate(usTables[0][0], testOUTPUT2_PHASE, usTables[0][1]);
+    WaveformSquare(usTables[1][0], testMAX_DUTY, waveformSIZE/2);
+    WaveformTriangle(usTables[1][1], testMAX_DUTY, waveformSIZE/2);
+
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(testVECTOR_BITS), &xPeriod) != 0) {
+        printf("FAIL outputs: playback not configured\n");
+        return 0;
+    }
+    prvCaptureStart();
+    prvWrite(pusFirsts, &xPeriod, 0);
+    prvWrite(pusSeconds, &xPeriod, 0);
+    SfrRunOcPeriods(1 + 2*waveformSIZE);
+
+    for (ulPeriod = 0; ulPeriod < 2*waveformSIZE; ulPeriod++) { /* After the initial OCxRS */
+        usSample = ulPeriod % waveformSIZE;
+        for (ucOutput = 0; ucOutput < testOUTPUTS; ucOutput++) {
+            usExpected = usTables[ulPeriod/waveformSIZE][ucOutput][usSample];
+            if (xCapture[1 + ulPeriod].usR[ucOutput] != usExpected) {
+                printf("FAIL outputs: OC%u sample %u is %u, expected %u\n", ucOutput + 1, (unsigned)ulPeriod,
+                        xCapture[1 + ulPeriod].usR[ucOutput], usExpected);
+                return 0;
+            }
+        }
+        if (prvMarker(1 + ulPeriod) != (usSample <= playbackMARKER_WIDTH)) {
+            printf("FAIL outputs: marker %s at sample %u\n", prvMarker(1 + ulPeriod) ? "high" : "low", (unsigned)ulPeriod);
+            return 0;
+        }
+    }
+    printf("PASS outputs: OC1, OC2 and the marker swap on the same sample\n");
+    return 1;
+}
+
+/* Plays sine x2, square x1 at half the sample rate and triangle x1 on
+ * output 1, twice. Each sample must be held for the divider of its
+ * segment, except the last one of a segment: the timer is reloaded when
+ * it is transferred, so it is held for the divider of the next segment.
+ * Output 2 plays its buffer at the same sample index, and the generator
+ * rewrites it after testSEQUENCE_SWAP_AT samples: the new one must start
+ * on the next period boundary of the sequence. */
+static uint8_t prvTestSequence(void){
+    static uint16_t usTables[testSEGMENTS][waveformSIZE];
+    static uint16_t usOutput2[2][waveformSIZE]; /* Before and after the swap */
+    static uint16_t usExpected[2*5*waveformSIZE];
+    static uint16_t usIndex[2*5*waveformSIZE]; /* Sample index of each PWM period */
+    static uint16_t usStream[2*5*waveformSIZE];
+    static const uint16_t usRepeats[testSEGMENTS] = {2, 1, 1};
+    static const uint8_t ucDividers[testSEGMENTS] = {1, 2, 1};
+    const uint16_t *pusStart[testOUTPUTS] = {usTables[0], usOutput2[0]};
+    const uint16_t *pusSwap[testOUTPUTS] = {usTables[0], usOutput2[1]}; /* Output 1 is not played while sequencing */
+    uint32_t ulCount = 0;
+    uint32_t ulPended, ulStart, ulPeriod;
+    uint16_t usIterator;
+    uint8_t ucSegment;
+    uint8_t ucLoop;
+    uint8_t ucRepeat;
+    uint8_t ucHold;
+    uint8_t ucNext;
+    uint8_t ucPass = 1;
+    Timer3Period_t xPeriod;
+
+    WaveformSine(usTables[0], testMAX_DUTY, waveformSIZE);
+    WaveformSquare(usTables[1], testMAX_DUTY, waveformSIZE/2);
+    WaveformTriangle(usTables[2], testMAX_DUTY, waveformSIZE/2);
+    WaveformTriangle(usOutput2[0], testMAX_DUTY/2, waveformSIZE);
+    WaveformSine(usOutput2[1], testMAX_DUTY/2, waveformSIZE/2);
+
+    for (ucLoop = 0; ucLoop < 2; ucLoop++)
+        for (ucSegment = 0; ucSegment < testSEGMENTS; ucSegment++)
+            for (ucRepeat = 0; ucRepeat < usRepeats[ucSegment]; ucRepeat++) {
+                ucNext = (ucRepeat + 1 < usRepeats[ucSegment]) ? ucSegment : (ucSegment + 1) % testSEGMENTS;
+                for (usIterator = 0; usIterator < waveformSIZE; usIterator++)
+                    for (ucHold = 0; ucHold < ucDividers[usIterator + 1 < waveformSIZE ? ucSegment : ucNext]; ucHold++) {
+                        usIndex[ulCount] = usIterator;
+                        usExpected[ulCount++] = usTables[ucSegment][usIterator];
+                    }
+            }
+
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(testVECTOR_BITS), &xPeriod) != 0) {
+        printf("FAIL sequence: playback not configured\n");
+        return 0;
+    }
+    for (ucSegment = 0; ucSegment < testSEGMENTS; ucSegment++) {
+        if (PlaybackSequenceAdd(usTables[ucSegment], usRepeats[ucSegment], testTABLE_FREQUENCY(ucDividers[ucSegment]),
+                ucSegment) != PLAYBACK_SUCCESS) {
+            printf("FAIL sequence: segment %u not added\n", ucSegment + 1);
+            return 0;
+        }
+    }
+    prvWrite(pusStart, &xPeriod, 0); /* Outputs playing when the sequencer starts */
+    prvCaptureStart();
+    PlaybackSequenceStart(SEQUENCE_LOOP);
+    SfrRunOcPeriods(1 + testSEQUENCE_SWAP_AT);
+    prvWrite(pusSwap, &xPeriod, 0);
+    ulPended = xSfr.ulOcPeriods - 1;
+    SfrRunOcPeriods(1 + ulCount - xSfr.ulOcPeriods);
+
+    /* The first period still has the initial OC1RS */
+    if (!prvStream(0, 1, ulCount, usStream)) {
+        printf("FAIL sequence: short capture\n");
+        return 0;
+    }
+    if (!prvCompare("sequence", usStream, usExpected, ulCount))
+        ucPass = 0;
+    else
+        printf("PASS sequence: %u samples, 2 loops of 3 segments\n", (unsigned)ulCount);
+
+    /* Output 2 follows the index of output 1 and swaps on a period start within a period of the write */
+    prvStream(1, 1, ulCount, usStream);
+    for (ulStart = ulPended; ulStart < ulCount && ulStart <= ulPended + 2*waveformSIZE + 1; ulStart++) {
+        if (usIndex[ulStart] != 0 || usIndex[ulStart - 1] == 0)
+            continue; /* Not the first sample of a period */
+        for (ulPeriod = 0; ulPeriod < ulCount; ulPeriod++)
+            if (usStream[ulPeriod] != usOutput2[ulPeriod >= ulStart][usIndex[ulPeriod]])
+                break;
+        if (ulPeriod == ulCount)
+            break;
+    }
+    if (ulStart == ulCount || ulStart > ulPended + 2*waveformSIZE + 1) {
+        printf("FAIL sequence output 2: no swap on a period start after the write at sample %u\n", (unsigned)ulPended);
+        return 0;
+    }
+    printf("PASS sequence output 2: written at sample %u, swapped in at %u\n", (unsigned)ulPended, (unsigned)ulStart);
+    return ucPass;
+}
+
+/* Pends a buffer and takes it back with PlaybackWriteBegin() before the
+ * period ends, like a generator command that arrives while the previous
+ * one is pending. The DMA0 ISR must not swap it in while it is being
+ * rewritten, and must swap the rewritten one in on the period boundary
+ * after PlaybackWriteEnd(). */
+static uint8_t prvTestHandoff(void){
+    static uint16_t usTables[3][waveformSIZE]; /* Playing, pended and taken back, rewritten */
+    uint16_t usStream[4*waveformSIZE];
+    uint16_t usExpected[4*waveformSIZE];
+    const uint16_t *pusTables[testOUTPUTS];
+    uint32_t ulPended, ulSample;
+    uint16_t usIterator;
+    uint8_t ucBuffer;
+    Timer3Period_t xPeriod;
+
+    WaveformSine(usTables[0], testMAX_DUTY, waveformSIZE);
+    WaveformSquare(usTables[1], testMAX_DUTY, waveformSIZE/2);
+    WaveformTriangle(usTables[2], testMAX_DUTY, waveformSIZE/2);
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(testVECTOR_BITS), &xPeriod) != 0) {
+        printf("FAIL handoff: playback not configured\n");
+        return 0;
+    }
+    prvCaptureStart();
+    pusTables[0] = pusTables[1] = usTables[0];
+    prvWrite(pusTables, &xPeriod, 0);
+    SfrRunOcPeriods(waveformSIZE/2);
+    pusTables[0] = pusTables[1] = usTables[1];
+    prvWrite(pusTables, &xPeriod, 0); /* Pended half way through the first period */
+
+    /* Taken back before the block ends, rewritten over two periods */
+    ucBuffer = PlaybackWriteBegin();
+    for (usIterator = 0; usIterator < waveformSIZE; usIterator++) {
+        xPlayback.usBuffers[ucBuffer][0][usIterator] = xPlayback.usBuffers[ucBuffer][1][usIterator] = usTables[2][usIterator];
+        SfrRunOcPeriods(2);
+    }
+    PlaybackWriteEnd(ucBuffer, &xPeriod);
+    ulPended = xSfr.ulOcPeriods - 1;
+    SfrRunOcPeriods(1 + 4*waveformSIZE - xSfr.ulOcPeriods);
+
+    /* The rewrite ends on a period boundary, the first sample after it can not be swapped any more */
+    for (ulSample = 0; ulSample < 4*waveformSIZE; ulSample++)
+        usExpected[ulSample] = usTables[(ulSample < (ulPended/waveformSIZE + 1)*waveformSIZE) ? 0 : 2][ulSample % waveformSIZE];
+    if (!prvStream(0, 1, 4*waveformSIZE, usStream) || !prvCompare("handoff OC1", usStream, usExpected, 4*waveformSIZE) ||
+        !prvStream(1, 1, 4*waveformSIZE, usStream) || !prvCompare("handoff OC2", usStream, usExpected, 4*waveformSIZE))
+        return 0;
+    printf("PASS handoff: buffer taken back while pending, rewritten one swapped in after sample %u\n", (unsigned)ulPended);
+    return 1;
+}
+
+/* Checks testBURST_IDLE periods from ulFirst with both outputs at 0 and the marker low */
+static uint8_t prvBurstIdle(uint32_t ulFirst){
+    uint32_t ulPeriod;
+
+    for (ulPeriod = ulFirst; ulPeriod < ulFirst + testBURST_IDLE; ulPeriod++) {
+        if (xCapture[ulPeriod].usR[0] != 0 || xCapture[ulPeriod].usR[1] != 0 || prvMarker(ulPeriod)) {
+            printf("FAIL burst: output in idle period %u\n", (unsigned)ulPeriod);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Arms a burst of a sine then a triangle and triggers it twice with INT2,
+ * after a falling edge that must be ignored. Each burst must start
+ * within two PWM periods of the rising edge, play both segments once
+ * with the marker on output 1, and leave every output at 0. */
+static uint8_t prvTestBurst(void){
+    static uint16_t usTables[2][waveformSIZE];
+    uint32_t ulEdge, ulStart, ulPeriod;
+    uint16_t usSample;
+    uint8_t ucBurst;
+    uint8_t ucSegment;
+
+    WaveformSine(usTables[0], testMAX_DUTY, waveformSIZE);
+    WaveformTriangle(usTables[1], testMAX_DUTY, waveformSIZE/2);
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE)) {
+        printf("FAIL burst: playback not configured\n");
+        return 0;
+    }
+    for (ucSegment = 0; ucSegment < 2; ucSegment++) {
+        if (PlaybackSequenceAdd(usTables[ucSegment], 1, testTABLE_FREQUENCY(1), ucSegment) != PLAYBACK_SUCCESS) {
+            printf("FAIL burst: segment %u not added\n", ucSegment + 1);
+            return 0;
+        }
+    }
+
+    prvCaptureStart();
+    PlaybackSequenceStart(SEQUENCE_BURST);
+    SfrRunOcPeriods(testBURST_IDLE);
+    SfrInt2Edge(0);
+    SfrRunOcPeriods(testBURST_IDLE);
+    if (!prvBurstIdle(0))
+        return 0;
+
+    for (ucBurst = 0; ucBurst < 2; ucBurst++) {
+        ulEdge = xSfr.ulOcPeriods;
+        SfrInt2Edge(1);
+        SfrRunOcPeriods(2 + 2*waveformSIZE + testBURST_IDLE);
+
+        for (ulStart = ulEdge; ulStart <= ulEdge + 2 && !prvMarker(ulStart); ulStart++)
+            ;
+        if (ulStart > ulEdge + 2) {
+            printf("FAIL burst %u: no marker within 2 periods of the trigger\n", ucBurst + 1);
+            return 0;
+        }
+        for (ulPeriod = 0; ulPeriod < 2*waveformSIZE; ulPeriod++) {
+            usSample = ulPeriod % waveformSIZE;
+            if (xCapture[ulStart + ulPeriod].usR[0] != usTables[ulPeriod/waveformSIZE][usSample] ||
+                prvMarker(ulStart + ulPeriod) != (usSample <= playbackMARKER_WIDTH)) {
+                printf("FAIL burst %u: sample %u\n", ucBurst + 1, (unsigned)ulPeriod);
+                return 0;
+            }
+        }
+        if (!prvBurstIdle(ulStart + 2*waveformSIZE))
+            return 0;
+    }
+    if (xPlayback.ulBursts != 2 || !xPlayback.xBurstIdle) {
+        printf("FAIL burst: %u bursts played, expected 2\n", (unsigned)xPlayback.ulBursts);
+        return 0;
+    }
+    printf("PASS burst: 2 bursts on rising edges, falling edge ignored\n");
+    return 1;
+}
+
+/* Runs testSWAP_COMMANDS generator commands against table playback with
+ * the DMA0 ISR entered ulLatency PBCLK ticks after the block complete
+ * event. Each command writes the other buffer one sample every
+ * testSWAP_WRITE_TICKS and pends it. Returns the number of periods that
+ * are not one whole table, or that play a table more than one period
+ * after it was pended. */
+static uint32_t prvSwapRun(uint32_t ulLatency, uint32_t *pulSwaps){
+    static uint16_t usTables[testSWAP_COMMANDS][waveformSIZE];
+    static uint16_t usStream[testSWAP_PERIODS*waveformSIZE + 1];
+    const uint16_t *pusTables[testOUTPUTS];
+    uint32_t ulPended[testSWAP_COMMANDS]; /* Captured periods when each table was pended */
+    uint32_t ulRandom = 1;
+    uint32_t ulBad = 0;
+    uint32_t ulPeriod, ulStart;
+    uint16_t usIterator;
+    uint8_t ucCommand, ucTable, ucPlaying = 0;
+    Timer3Period_t xPeriod;
+
+    for (ucCommand = 0; ucCommand < testSWAP_COMMANDS; ucCommand++)
+        prvGenerate(&xVectors[ucCommand % 3], testMAX_DUTY - 16*ucCommand, usTables[ucCommand]); /* Every table differs */
+
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_TABLE) || Timer3CalcPeriod(testPWM_FREQUENCY(testVECTOR_BITS), &xPeriod) != 0)
+        return testSWAP_PERIODS;
+    xSfr.ulIsrLatency = ulLatency;
+    prvCaptureStart();
+    pusTables[0] = pusTables[1] = usTables[0];
+    prvWrite(pusTables, &xPeriod, 0);
+    ulPended[0] = 0;
+
+    for (ucCommand = 1; ucCommand < testSWAP_COMMANDS; ucCommand++) {
+        ulRandom = ulRandom*1664525 + 1013904223; /* Commands at any point of the period, some faster than it */
+        SfrRun((ulRandom >> 8) % (2*waveformSIZE*testSWAP_WRITE_TICKS));
+        pusTables[0] = pusTables[1] = usTables[ucCommand];
+        prvWrite(pusTables, &xPeriod, testSWAP_WRITE_TICKS);
+        ulPended[ucCommand] = xSfr.ulOcPeriods;
+    }
+    if (xSfr.ulOcPeriods < testSWAP_PERIODS*waveformSIZE + 1)
+        SfrRunOcPeriods(testSWAP_PERIODS*waveformSIZE + 1 - xSfr.ulOcPeriods);
+
+    /* The first period is the initial OC1RS, the tables start after it */
+    if (!prvStream(0, 0, testSWAP_PERIODS*waveformSIZE + 1, usStream))
+        return testSWAP_PERIODS;
+    *pulSwaps = 0;
+    for (ulPeriod = 0; ulPeriod < testSWAP_PERIODS; ulPeriod++) {
+        ulStart = 1 + ulPeriod*waveformSIZE;
+        for (ucTable = ucPlaying; ucTable < testSWAP_COMMANDS; ucTable++) {
+            for (usIterator = 0; usIterator < waveformSIZE; usIterator++)
+                if (usStream[ulStart + usIterator] != usTables[ucTable][usIterator])
+                    break;
+            if (usIterator == waveformSIZE)
+                break;
+        }
+        if (ucTable == testSWAP_COMMANDS) {
+            ulBad++; /* Torn, or an older table played again */
+            continue;
+        }
+        if (ucTable != ucPlaying) {
+            (*pulSwaps)++;
+            if (ulStart - ulPended[ucTable] > waveformSIZE + 1)
+                ulBad++; /* Not on the next period boundary */
+            ucPlaying = ucTable;
+        }
+    }
+    if (ucPlaying != testSWAP_COMMANDS - 1)
+        ulBad++; /* The last command must be playing */
+    return ulBad;
+}
+
+/* The generator rewrites a buffer over more than one period while the
+ * other one plays. With the DMA0 ISR entered within a sample period of
+ * the block complete event every period must be one whole table,
+ * starting on the period boundary after it was pended. One sample
+ * period of latency lets the next Timer 3 trigger stream sample 0 of
+ * the old buffer, which must show as torn periods. */
+static uint8_t prvTestSwap(void){
+    uint32_t ulSamplePeriod = sfrPBCLOCK/testPWM_FREQUENCY(testVECTOR_BITS); /* Timer 3 at the PWM frequency */
+    uint32_t ulLatencies[] = {0, ulSamplePeriod/4, ulSamplePeriod/2, ulSamplePeriod};
+    uint32_t ulBad, ulSwaps = 0;
+    uint8_t ucLatency;
+    uint8_t ucPass = 1;
+
+    for (ucLatency = 0; ucLatency < sizeof(ulLatencies)/sizeof(ulLatencies[0]); ucLatency++) {
+        ulBad = prvSwapRun(ulLatencies[ucLatency], &ulSwaps);
+        if ((ulLatencies[ucLatency] < ulSamplePeriod) != (ulBad == 0))
+            ucPass = 0;
+        printf("%s swap, ISR latency %u ticks: %u bad of %u periods, %u swaps\n",
+                ((ulLatencies[ucLatency] < ulSamplePeriod) == (ulBad == 0)) ? "PASS" : "FAIL",
+                (unsigned)ulLatencies[ucLatency], (unsigned)ulBad, testSWAP_PERIODS, (unsigned)ulSwaps);
+    }
+    return ucPass;
+}
+
+/* Plays a generated period continuously and measures the filtered output */
+static uint8_t prvTestQuality(const TestQuality_t *pxQuality){
+    static uint16_t usStream[testQUALITY_CYCLES*testMAX_DIVIDER*waveformSIZE];
+    uint32_t ulPeriods = testQUALITY_CYCLES*pxQuality->ucDivider*waveformSIZE;
+    SpectrumConfig_t xConfig = {0, testRC_TAU(pxQuality->ucBits), 0};
+    SpectrumResult_t xResult;
+    uint16_t usWaveform[waveformSIZE];
+    uint16_t usMax = (1 << pxQuality->ucBits) - 1; /* PR2 of testPWM_FREQUENCY() */
+    uint8_t ucPass;
+
+    prvGenerate(&xVectors[pxQuality->ucVector], usMax, usWaveform);
+
+    if (prvPlay(usWaveform, pxQuality->ucBits, pxQuality->ucDivider, ulPeriods)) {
+        xConfig.usPeriod = OCMaxCompare(1) + 1; /* PR2+1 */
+        xConfig.ulSkip = 10*xConfig.dTau*spectrumPBCLOCK/xConfig.usPeriod;
+    }
+    if (xConfig.usPeriod != usMax + 1 || !prvStream(0, 0, ulPeriods, usStream) ||
+        SpectrumAnalyze(usStream, ulPeriods, &xConfig, &xResult) != SPECTRUM_SUCCESS) {
+        printf("FAIL %s %u bit /%u: no duty stream to measure\n", pxQuality->pcName, pxQuality->ucBits,
+                pxQuality->ucDivider);
+        return 0;
+    }
+
+    ucPass = xResult.dSfdr >= pxQuality->dMinSfdr && xResult.dThd <= pxQuality->dMaxThd &&
+            xResult.dSnr >= pxQuality->dMinSnr && xResult.dJitter <= testMAX_JITTER;
+    printf("%s %s %u bit %.1f Hz: THD %.2f dB, SFDR %.2f dB, SNR %.2f dB, jitter %.1f ns\n", ucPass ? "PASS" : "FAIL",
+            pxQuality->pcName, pxQuality->ucBits, xResult.dFrequency, xResult.dThd, xResult.dSfdr, xResult.dSnr, xResult.dJitter*1e9);
+    return ucPass;
+}
+
+/* Reference tuning word for a frequency in 1/playbackFREQUENCY_SCALE Hz */
+static uint32_t prvDdsTuningWord(uint32_t ulFrequency){
+    return (uint32_t)(((uint64_t)ulFrequency << 32) / ((uint64_t)testDDS_SAMPLE_RATE*playbackFREQUENCY_SCALE));
+}
+
+/* Table index of sample n of a phase continuous DDS, retuned from sample ulSwitch on */
+static uint16_t prvDdsIndex(uint32_t ulSample, uint32_t ulSwitch, uint32_t ulStep, uint32_t ulNewStep){
+    uint32_t ulPhase = (ulSample <= ulSwitch) ? ulSample*ulStep : ulSwitch*ulStep + (ulSample - ulSwitch)*ulNewStep;
+
+    return ((uint64_t)ulPhase*waveformSIZE) >> 32;
+}
+
+/* Plays pusTable on every output by DDS at ulFrequency, in
+ * 1/playbackFREQUENCY_SCALE Hz, and captures ulPeriods */
+static uint8_t prvDdsPlay(const uint16_t *pusTable, uint32_t ulFrequency, uint32_t ulPeriods){
+    const uint16_t *pusTables[testOUTPUTS] = {pusTable, pusTable};
+    Timer3Period_t xPeriod;
+
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_DDS) || PlaybackSetFrequency(ulFrequency, &xPeriod) != PLAYBACK_SUCCESS)
+        return 0;
+    prvCaptureStart();
+    prvWrite(pusTables, &xPeriod, 0);
+    SfrRunOcPeriods(ulPeriods);
+    return 1;
+}
+
+/* Plays the sine vector on OC1 and the same sine 90 Deg ahead on OC2 at
+ * 1234.56 Hz, retunes to 987.65 Hz like the F command, and later pends
+ * the triangle and square vectors. Every sample must be the table entry
+ * of an ideal 32 bit phase accumulator, which makes the 0.01 Hz steps
+ * exact, and the new tuning word must take over on a ring refill with
+ * no phase jump. The new tables must start on the first accumulator
+ * wrap that was not in the ring yet, on both outputs, and the marker
+ * ring must follow the table index of every sample. */
+static uint8_t prvTestDdsExact(const uint16_t usVectors[][waveformSIZE]){
+    static uint16_t usIndex[testDDS_EXACT_PERIODS];
+    uint16_t usSine90[waveformSIZE];
+    const uint16_t *pusFirsts[testOUTPUTS] = {usVectors[0], usSine90};
+    const uint16_t *pusSeconds[testOUTPUTS] = {usVectors[2], usVectors[1]};
+    const uint16_t *pusTable;
+    uint32_t ulStep = prvDdsTuningWord(testDDS_FREQUENCY);
+    uint32_t ulNewStep = prvDdsTuningWord(testDDS_NEW_FREQUENCY);
+    uint32_t ulMaxDelay = playbackDDS_RING_SIZE + (uint32_t)(UINT32_MAX/ulNewStep) + 2; /* Ring, then one period */
+    uint32_t ulSwitch, ulSample, ulSwap, ulPended;
+    uint8_t ucOutput;
+    Timer3Period_t xPeriod;
+
+    prvRotate(usVectors[0], testOUTPUT2_PHASE, usSine90);
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_DDS) || PlaybackSetFrequency(testDDS_FREQUENCY, &xPeriod) != PLAYBACK_SUCCESS) {
+        printf("FAIL DDS exact: playback not configured\n");
+        return 0;
+    }
+    prvCaptureStart();
+    prvWrite(pusFirsts, &xPeriod, 0);
+    SfrRunOcPeriods(1 + testDDS_CHANGE_AT);
+    PlaybackSetFrequency(testDDS_NEW_FREQUENCY, &xPeriod);
+    SfrRunOcPeriods(testDDS_SWAP_AT - testDDS_CHANGE_AT);
+    ulPended = xSfr.ulOcPeriods - 1;
+    prvWrite(pusSeconds, &xPeriod, 0);
+    SfrRunOcPeriods(testDDS_EXACT_PERIODS + 1 - xSfr.ulOcPeriods);
+
+    /* The first period is the initial OC1RS. The retune lands on a refill, at a ring half */
+    for (ulSwitch = testDDS_CHANGE_AT - testDDS_CHANGE_AT % (playbackDDS_RING_SIZE/2);
+         ulSwitch <= testDDS_CHANGE_AT + 2*playbackDDS_RING_SIZE; ulSwitch += playbackDDS_RING_SIZE/2) {
+        for (ulSample = 0; ulSample < ulPended; ulSample++)
+            if (xCapture[1 + ulSample].usR[0] != usVectors[0][prvDdsIndex(ulSample, ulSwitch, ulStep, ulNewStep)])
+                break;
+        if (ulSample == ulPended)
+            break;
+    }
+    if (ulSwitch > testDDS_CHANGE_AT + 2*playbackDDS_RING_SIZE) {
+        printf("FAIL DDS exact: no phase continuous retune near sample %u matches the stream\n", testDDS_CHANGE_AT);
+        return 0;
+    }
+    printf("PASS DDS exact: retuned at sample %u of the write at %u, steps of %.1f uHz\n",
+            (unsigned)ulSwitch, testDDS_CHANGE_AT, testDDS_SAMPLE_RATE*1e6/4294967296.0);
+
+    /* The new tables start on a wrap, the index going back down */
+    for (ulSample = 0; ulSample < testDDS_EXACT_PERIODS; ulSample++)
+        usIndex[ulSample] = prvDdsIndex(ulSample, ulSwitch, ulStep, ulNewStep);
+    for (ulSwap = ulPended + 1; ulSwap < testDDS_EXACT_PERIODS && ulSwap <= ulPended + ulMaxDelay; ulSwap++) {
+        if (usIndex[ulSwap] >= usIndex[ulSwap - 1])
+            continue;
+        for (ulSample = 0; ulSample < testDDS_EXACT_PERIODS; ulSample++) {
+            for (ucOutput = 0; ucOutput < testOUTPUTS; ucOutput++) {
+                pusTable = (ulSample < ulSwap) ? pusFirsts[ucOutput] : pusSeconds[ucOutput];
+                if (xCapture[1 + ulSample].usR[ucOutput] != pusTable[usIndex[ulSample]])
+                    break;
+            }
+            if (ucOutput != testOUTPUTS || prvMarker(1 + ulSample) != (usIndex[ulSample] <= playbackMARKER_WIDTH))
+                break;
+        }
+        if (ulSample == testDDS_EXACT_PERIODS)
+            break;
+    }
+    if (ulSwap == testDDS_EXACT_PERIODS || ulSwap > ulPended + ulMaxDelay) {
+        printf("FAIL DDS swap: no wrap within %u samples of the write at %u swaps both outputs with the marker in step\n",
+                (unsigned)ulMaxDelay, (unsigned)ulPended);
+        return 0;
+    }
+    printf("PASS DDS swap: written at sample %u, swapped in on the wrap at %u, OC2 and the marker in step\n",
+            (unsigned)ulPended, (unsigned)ulSwap);
+    return 1;
+}
+
+/* Loops xDdsSegments[] by DDS, output 2 keeping its sine 90 Deg ahead.
+ * Every sample must match a phase accumulator that takes the tuning
+ * word of the next segment on the wrap that ends the last period of a
+ * segment, and the ISR must carry that tuning word from one ring refill
+ * to the next. */
+static uint8_t prvTestDdsSequence(const uint16_t usVectors[][waveformSIZE]){
+    uint16_t usSine90[waveformSIZE];
+    const uint16_t *pusTables[testOUTPUTS] = {usVectors[0], usSine90};
+    uint32_t ulSteps[testNUM_DDS_SEGMENTS];
+    uint32_t ulPhase = 0;
+    uint32_t ulSample;
+    uint16_t usIndex;
+    uint16_t usRepeatsLeft;
+    uint8_t ucSegment;
+    Timer3Period_t xPeriod;
+
+    prvRotate(usVectors[0], testOUTPUT2_PHASE, usSine90);
+    if (!prvOpen(testVECTOR_BITS, playbackMODE_DDS) || PlaybackSetFrequency(testDDS_FREQUENCY, &xPeriod) != PLAYBACK_SUCCESS) {
+        printf("FAIL DDS sequence: playback not configured\n");
+        return 0;
+    }
+    for (ucSegment = 0; ucSegment < testNUM_DDS_SEGMENTS; ucSegment++) {
+        ulSteps[ucSegment] = prvDdsTuningWord(xDdsSegments[ucSegment].ulFrequency);
+        if (PlaybackSequenceAdd(usVectors[xDdsSegments[ucSegment].ucVector], xDdsSegments[ucSegment].usRepeats,
+                xDdsSegments[ucSegment].ulFrequency, ucSegment) != PLAYBACK_SUCCESS ||
+            xPlayback.xSegments[ucSegment].ulTuningWord != ulSteps[ucSegment]) {
+            printf("FAIL DDS sequence: segment %u not added with its tuning word\n", ucSegment + 1);
+            return 0;
+        }
+    }
+    prvWrite(pusTables, &xPeriod, 0); /* Outputs playing when the sequencer starts */
+    prvCaptureStart();
+    PlaybackSequenceStart(SEQUENCE_LOOP);
+    SfrRunOcPeriods(1 + testDDS_SEQUENCE_PERIODS);
+
+    /* The first period is the initial OC1RS */
+    ucSegment = 0;
+    usRepeatsLeft = xDdsSegments[0].usRepeats;
+    for (ulSample = 0; ulSample < testDDS_SEQUENCE_PERIODS; ulSample++) {
+        usIndex = ((uint64_t)ulPhase*waveformSIZE) >> 32;
+        if (xCapture[1 + ulSample].usR[0] != usVectors[xDdsSegments[ucSegment].ucVector][usIndex] ||
+            xCapture[1 + ulSample].usR[1] != usSine90[usIndex] || prvMarker(1 + ulSample) != (usIndex <= playbackMARKER_WIDTH)) {
+            printf("FAIL DDS sequence: sample %u, segment %u, index %u\n", (unsigned)ulSample, ucSegment + 1, usIndex);
+            return 0;
+        }
+        ulPhase += ulSteps[ucSegment];
+        if (ulPhase < ulSteps[ucSegment] && --usRepeatsLeft == 0) { /* Wrapped at the end of the segment */
+            ucSegment = (ucSegment + 1) % testNUM_DDS_SEGMENTS;
+            usRepeatsLeft = xDdsSegments[ucSegment].usRepeats;
+        }
+    }
+    if (xPlayback.ulTuningWord != ulSteps[xPlayback.ucSegment]) {
+        printf("FAIL DDS sequence: tuning word %u left in segment %u\n", (unsigned)xPlayback.ulTuningWord, xPlayback.ucSegment + 1);
+        return 0;
+    }
+    printf("PASS DDS sequence: %u samples of %u segments\n", testDDS_SEQUENCE_PERIODS, (unsigned)testNUM_DDS_SEGMENTS);
+    return 1;
+}
+
+/* Measures an 8 bit duty stream of ulPeriods from the capture */
+static uint8_t prvMeasure(uint32_t ulPeriods, SpectrumResult_t *pxResult){
+    static uint16_t usStream[testQUALITY_CYCLES*testMAX_DIVIDER*waveformSIZE];
+    SpectrumConfig_t xConfig = {1 << testVECTOR_BITS, testRC_TAU(testVECTOR_BITS), 0};
+
+    xConfig.ulSkip = 10*xConfig.dTau*spectrumPBCLOCK/xConfig.usPeriod;
+    return prvStream(0, 0, ulPeriods, usStream) && SpectrumAnalyze(usStream, ulPeriods, &xConfig, pxResult) == SPECTRUM_SUCCESS;
+}
+
+/* Plays a validate_*.txt vector from the table, at the PWM frequency /
+ * ucDivider, and by DDS at the nearest 0.01 Hz. The DDS output must be
+ * as clean as the table playback of the same reference. */
+static uint8_t prvTestDdsSpectrum(const TestDds_t *pxDds, const uint16_t *pusVector){
+    uint32_t ulPeriods = testQUALITY_CYCLES*pxDds->ucDivider*waveformSIZE;
+    uint32_t ulFrequency = testTABLE_FREQUENCY(pxDds->ucDivider);
+    SpectrumResult_t xTable, xDds;
+    uint8_t ucPass;
+
+    if (!prvPlay(pusVector, testVECTOR_BITS, pxDds->ucDivider, ulPeriods) || !prvMeasure(ulPeriods, &xTable) ||
+        !prvDdsPlay(pusVector, ulFrequency, ulPeriods) || !prvMeasure(ulPeriods, &xDds)) {
+        printf("FAIL DDS %s /%u: no duty stream to measure\n", xVectors[pxDds->ucVector].pcFile, pxDds->ucDivider);
+        return 0;
+    }
+
+    ucPass = xDds.dThd <= xTable.dThd + testDDS_MAX_LOSS && xDds.dSfdr >= xTable.dSfdr - testDDS_MAX_LOSS &&
+            xDds.dSnr >= xTable.dSnr - testDDS_MAX_LOSS;
+    printf("%s DDS %s %.2f Hz: THD %.2f dB, SFDR %.2f dB, SNR %.2f dB, table %.2f Hz: %.2f, %.2f, %.2f dB\n",
+            ucPass ? "PASS" : "FAIL", xVectors[pxDds->ucVector].pcFile, ulFrequency/(double)playbackFREQUENCY_SCALE,
+            xDds.dThd, xDds.dSfdr, xDds.dSnr, xTable.dFrequency, xTable.dThd, xTable.dSfdr, xTable.dSnr);
+    return ucPass;
+}
+
+int main(void){
+    static uint16_t usVectors[testNUM_VECTORS][waveformSIZE];
+    uint8_t ucVector;
+    uint8_t ucFailed = 0;
+
+    for (ucVector = 0; ucVector < testNUM_VECTORS; ucVector++) {
+        if (!prvLoad(xVectors[ucVector].pcFile, usVectors[ucVector])) {
+            printf("FAIL %s: missing or short\n", xVectors[ucVector].pcFile);
+            return 1;
+        }
+    }
+
+    for (ucVector = 0; ucVector < testNUM_VECTORS; ucVector++) {
+        if (!prvTestGenerator(&xVectors[ucVector], usVectors[ucVector]))
+            ucFailed++;
+        /* Followed by the next vector, the buffer swap must not lose or repeat samples */
+        if (!prvTestPlayback(xVectors[ucVector].pcFile, usVectors[ucVector], usVectors[(ucVector + 1) % testNUM_VECTORS]))
+            ucFailed++;
+    }
+
+    if (!prvTestOutputs())
+        ucFailed++;
+    if (!prvTestSequence())
+        ucFailed += 2;
+    if (!prvTestHandoff())
+        ucFailed++;
+    if (!prvTestBurst())
+        ucFailed++;
+    if (!prvTestSwap())
+        ucFailed++;
+
+    for (ucVector = 0; ucVector < testNUM_QUALITIES; ucVector++) {
+        if (!prvTestQuality(&xQualities[ucVector]))
+            ucFailed++;
+    }
+
+    if (!prvTestDdsExact(usVectors))
+        ucFailed += 2;
+    if (!prvTestDdsSequence(usVectors))
+        ucFailed++;
+    for (ucVector = 0; ucVector < testNUM_DDS_SPECTRA; ucVector++) {
+        if (!prvTestDdsSpectrum(&xDdsSpectra[ucVector], usVectors[xDdsSpectra[ucVector].ucVector]))
+            ucFailed++;
+    }
+
+    printf("%s: %u of %u checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed,
+            (unsigned)(2*testNUM_VECTORS + 6 + testNUM_QUALITIES + 3 + testNUM_DDS_SPECTRA));
+    return ucFailed ? 1 : 0;
+}
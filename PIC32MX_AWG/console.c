@@ -0,0 +1,102 @@
+/*
+ * File:   console.c
+ * Author: Diogo Vala
+ *
+ * Overview: UART console of mainAWG.c, command lines and upload routing
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+#include "console.h"
+
+Console_t xConsole;
+
+/* Bytes that can be part of a command */
+static bool prvIsCommandByte(uint8_t ucByte)
+{
+    return (ucByte >= '0' && ucByte <= '9') || (ucByte >= 'A' && ucByte <= 'Z') ||
+            (ucByte >= 'a' && ucByte <= 'z') || ucByte == '.';
+}
+
+void ConsoleInit(QueueHandle_t xInput, StreamBufferHandle_t xUpload)
+{
+    memset(&xConsole, 0, sizeof(xConsole));
+    xConsole.xInput = xInput;
+    xConsole.xUpload = xUpload;
+}
+
+void ConsoleRxIsr(BaseType_t *pxHigherPriorityTaskWoken)
+{
+    uint8_t ucRxBytes[consoleRX_FIFO_SIZE]; /* Bytes read from the RX FIFO */
+    uint8_t ucCount = 0;
+    uint8_t ucIterator;
+
+    if(U1STAbits.OERR || U1STAbits.FERR || U1STAbits.PERR) /* Error checking */
+    {
+        (void)U1RXREG; /* Read to clear FERR/PERR */
+        U1STAbits.OERR = 0; /* Clear OERR to keep receiving */
+    }
+    while(U1STAbits.URXDA && ucCount < sizeof(ucRxBytes))
+    {
+        ucRxBytes[ucCount++] = U1ARXREG; /* Get data from UART RX FIFO */
+    }
+
+    IFS0bits.U1RXIF = 0; /* clear the RX interrupt flag */
+
+    /* The Interface task switches to upload mode once it has taken the
+     * whole "l" line from xInput, and the host waits for its reply before
+     * the first frame, so no frame byte is sent to xInput. */
+    if(xConsole.xUploading)
+    {
+        if(xStreamBufferSendFromISR(xConsole.xUpload, ucRxBytes, ucCount, pxHigherPriorityTaskWoken) != ucCount)
+        {
+            printf("\rERROR: UPLOAD STREAM FULL.\n");
+        }
+        return;
+    }
+    for(ucIterator = 0; ucIterator < ucCount; ucIterator++)
+    {
+        if(xQueueSendFromISR(xConsole.xInput, (void*)&ucRxBytes[ucIterator], pxHigherPriorityTaskWoken) != pdTRUE)
+        {
+            printf("\rERROR: INPUT QUEUE FULL.\n");
+        }
+    }
+}
+
+uint8_t ConsoleLineAdd(uint8_t ucByte)
+{
+    if(prvIsCommandByte(ucByte))
+    {
+        xConsole.ucLine[xConsole.ucLength++] = ucByte;
+        if(xConsole.ucLength >= consoleLINE_SIZE-1) /* Buffer limit */
+        {
+            ConsoleLineClear();
+            return consoleLINE_OVERFLOW;
+        }
+        return consoleLINE_ADDED;
+    }
+    if(ucByte != '\r')
+    {
+        return consoleLINE_IGNORED;
+    }
+
+    if(xConsole.ucLength == 1 && (xConsole.ucLine[0] == 'l' || xConsole.ucLine[0] == 'L'))
+    {
+        ConsoleLineClear();
+        xConsole.xUploading = true; /* Next inputs are upload frames, send them to LoadWave task */
+        return consoleLINE_UPLOAD;
+    }
+    return consoleLINE_COMMAND;
+}
+
+void ConsoleLineClear(void)
+{
+    xConsole.ucLength = 0;
+    memset(xConsole.ucLine, '\0', consoleLINE_SIZE);
+}
+
+void ConsoleUploadEnd(void)
+{
+    xConsole.xUploading = false; /* Next inputs are commands, send them to interface task */
+}
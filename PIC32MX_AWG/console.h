@@ -0,0 +1,89 @@
+/*
+ * File:   console.h
+ * Author: Diogo Vala
+ *
+ * Overview: UART console of mainAWG.c. The UART ISR sends the received
+ *           bytes to the Interface task, which builds them into command
+ *           lines, or during an arbitrary wave upload to the LoadWave
+ *           task. Only the complete line "l" starts an upload, so names
+ *           and arguments can hold any letter. Built by the firmware and
+ *           by Tests/console_test.c.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "stream_buffer.h"
+
+#define consoleLINE_SIZE 24 /* Bytes of a command line and its '\0', N7R65535F20000.00 fits */
+#define consoleRX_FIFO_SIZE 8 /* Bytes drained from the RX FIFO per interrupt */
+
+/* Returns of ConsoleLineAdd() */
+#define consoleLINE_IGNORED 0 /* Not part of a command */
+#define consoleLINE_ADDED 1 /* Added to the line, to be echoed */
+#define consoleLINE_OVERFLOW 2 /* Line too long, discarded */
+#define consoleLINE_COMMAND 3 /* Line complete in xConsole.ucLine */
+#define consoleLINE_UPLOAD 4 /* Upload line, the next bytes go to the upload stream */
+
+/* State of the console */
+typedef struct {
+    QueueHandle_t xInput; /* Command bytes, to the Interface task */
+    StreamBufferHandle_t xUpload; /* Upload bytes, to the LoadWave task */
+    volatile bool xUploading; /* Upload in progress, set by ConsoleLineAdd() */
+    uint8_t ucLine[consoleLINE_SIZE]; /* Line being built, '\0' terminated */
+    uint8_t ucLength;
+} Console_t;
+
+extern Console_t xConsole;
+
+/********************************************************************
+ * Function: 	 ConsoleInit()
+ * Input: 		 xInput - Queue of uint8_t, to the Interface task
+ *               xUpload - Stream buffer, to the LoadWave task
+ * Overview:     Starts in command mode with an empty line.
+ ********************************************************************/
+void ConsoleInit(QueueHandle_t xInput, StreamBufferHandle_t xUpload);
+
+/********************************************************************
+ * Function: 	 ConsoleRxIsr()
+ * Precondition: ConsoleInit() called
+ * Input: 		 pxHigherPriorityTaskWoken - Set if a task was woken
+ * Overview:     Drains the RX FIFO, clears the receive errors and
+ *               U1RXIF. In command mode each byte is sent to xInput,
+ *               during an upload they are all sent to xUpload. No byte
+ *               value is reserved, so samples can take any value.
+ * Note:		 To be called from the UART ISR, which ends with
+ *               portEND_SWITCHING_ISR().
+ ********************************************************************/
+void ConsoleRxIsr(BaseType_t *pxHigherPriorityTaskWoken);
+
+/********************************************************************
+ * Function: 	 ConsoleLineAdd()
+ * Precondition: ConsoleInit() called. Only called by the Interface task.
+ * Input: 		 ucByte - Byte received from xInput
+ * Returns:      consoleLINE_XXX
+ * Overview:     Digits, letters and '.' are added to the line, '\r'
+ *               ends it. The line "l" or "L" starts an upload: the
+ *               next bytes the ISR receives go to xUpload, and the line
+ *               is cleared. Any other line is left in xConsole.ucLine
+ *               for the caller, see ConsoleLineClear().
+ ********************************************************************/
+uint8_t ConsoleLineAdd(uint8_t ucByte);
+
+/********************************************************************
+ * Function: 	 ConsoleLineClear()
+ * Overview:     Empties the line, once the command is done.
+ ********************************************************************/
+void ConsoleLineClear(void);
+
+/********************************************************************
+ * Function: 	 ConsoleUploadEnd()
+ * Overview:     Back to command mode, the next bytes go to xInput.
+ ********************************************************************/
+void ConsoleUploadEnd(void);
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * File:   dma.c
+ * Author: Diogo Vala
+ *
+ * Overview: Configures DMA channels
+ */
+
+#include <xc.h>
+#include <stdlib.h>
+#include <sys/kmem.h>
+#include "dma.h"
+
+/* Every SFR is followed by its CLR, SET and INV registers */
+typedef struct {
+    volatile uint32_t reg;
+    volatile uint32_t clr;
+    volatile uint32_t set;
+    volatile uint32_t inv;
+} DmaReg_t;
+
+/* Register block of one channel. Channel blocks are contiguous, starting at DCH0CON */
+typedef struct {
+    DmaReg_t CON;
+    DmaReg_t ECON;
+    DmaReg_t INT;
+    DmaReg_t SSA;
+    DmaReg_t DSA;
+    DmaReg_t SSIZ;
+    DmaReg_t DSIZ;
+    DmaReg_t SPTR;
+    DmaReg_t DPTR;
+    DmaReg_t CSIZ;
+    DmaReg_t CPTR;
+    DmaReg_t DAT;
+} DmaChannel_t;
+
+#define dmaCHANNEL(n) ((DmaChannel_t *)&DCH0CON + (n))
+
+void DMAControl(uint8_t dmarun){
+    if (dmarun) {
+        DMACONbits.ON = 1; // Enable DMA controller
+    } else {
+        DMACONbits.ON = 0; // Disable DMA controller
+    }
+}
+
+int8_t DMAChannelConfig(uint8_t channel, uint8_t priority, uint8_t startIrq, uint8_t autoEnable){
+
+    DmaChannel_t *pxChannel;
+
+    if (channel >= dmaNUM_CHANNELS)
+        return DMA_INVALID_CHANNEL;
+
+    pxChannel = dmaCHANNEL(channel);
+
+    pxChannel->CON.clr = _DCH0CON_CHEN_MASK; // Disable channel
+    pxChannel->CON.reg = (priority << _DCH0CON_CHPRI_POSITION) & _DCH0CON_CHPRI_MASK;
+    if (autoEnable)
+        pxChannel->CON.set = _DCH0CON_CHAEN_MASK; // Re-enable after block transfer
+
+    pxChannel->ECON.reg = ((uint32_t)startIrq << _DCH0ECON_CHSIRQ_POSITION) | _DCH0ECON_SIRQEN_MASK; // Cell transfer on startIrq
+    pxChannel->INT.reg = 0; // No channel interrupts, clear flags
+
+    return DMA_SUCCESS;
+}
+
+int8_t DMAChannelSetTransfer(uint8_t channel, const volatile void *src, uint16_t srcSize,
+        volatile void *dst, uint16_t dstSize, uint16_t cellSize){
+
+    DmaChannel_t *pxChannel;
+
+    if (channel >= dmaNUM_CHANNELS)
+        return DMA_INVALID_CHANNEL;
+    if (srcSize == 0 || dstSize == 0 || cellSize == 0)
+        return DMA_INVALID_SIZE;
+#if dmaMAX_TRANSFER_SIZE < 65535
+    if (srcSize > dmaMAX_TRANSFER_SIZE || dstSize > dmaMAX_TRANSFER_SIZE || cellSize > dmaMAX_TRANSFER_SIZE)
+        return DMA_INVALID_SIZE;
+#endif
+
+    pxChannel = dmaCHANNEL(channel);
+
+    pxChannel->SSA.reg = KVA_TO_PA(src); // DMA works with physical addresses
+    pxChannel->DSA.reg = KVA_TO_PA(dst);
+    pxChannel->SSIZ.reg = srcSize;
+    pxChannel->DSIZ.reg = dstSize;
+    pxChannel->CSIZ.reg = cellSize;
+
+    return DMA_SUCCESS;
+}
+
+void DMAChannelControl(uint8_t channel, uint8_t dmarun){
+    if (channel >= dmaNUM_CHANNELS)
+        return;
+
+    if (dmarun) {
+        dmaCHANNEL(channel)->CON.set = _DCH0CON_CHEN_MASK; // Enable channel
+    } else {
+        dmaCHANNEL(channel)->CON.clr = _DCH0CON_CHEN_MASK; // Disable channel
+    }
+}
+
+void DMAChannelAbort(uint8_t channel){
+    DmaChannel_t *pxChannel;
+
+    if (channel >= dmaNUM_CHANNELS)
+        return;
+
+    pxChannel = dmaCHANNEL(channel);
+    pxChannel->ECON.set = _DCH0ECON_CABORT_MASK; // Abort transfer, reset pointers
+    while(pxChannel->ECON.reg & _DCH0ECON_CABORT_MASK); // Cleared by hardware
+}
+
+void DMAChannelSetSource(uint8_t channel, const volatile void *src){
+    if (channel >= dmaNUM_CHANNELS)
+        return;
+
+    dmaCHANNEL(channel)->SSA.reg = KVA_TO_PA(src);
+}
+
+void DMAChannelInterruptConfig(uint8_t channel, uint8_t events){
+    if (channel >= dmaNUM_CHANNELS)
+        return;
+
+    dmaCHANNEL(channel)->INT.reg = (uint32_t)events << 16; // Enable events, clear flags
+}
+
+uint8_t DMAChannelReadEvents(uint8_t channel){
+    DmaChannel_t *pxChannel;
+    uint8_t ucEvents;
+
+    if (channel >= dmaNUM_CHANNELS)
+        return 0;
+
+    pxChannel = dmaCHANNEL(channel);
+    ucEvents = pxChannel->INT.reg & 0xFF;
+    pxChannel->INT.clr = ucEvents; // Clear the events that were read
+    return ucEvents;
+}
@@ -0,0 +1,121 @@
+/*
+ * File:   dma.h
+ * Author: Diogo Vala
+ *
+ * Overview: Configure DMA channels
+ */
+
+#ifndef DMA_H
+#define DMA_H
+
+#include <stdint.h>
+
+// Define return codes
+#define DMA_SUCCESS 0
+#define DMA_INVALID_CHANNEL -1
+#define DMA_INVALID_SIZE -2
+
+#define dmaSTART 1
+#define dmaSTOP 0
+#if defined(__32MX360F512L__) || defined(__32MX460F512L__)
+#define dmaNUM_CHANNELS 4
+#define dmaMAX_TRANSFER_SIZE 256 /* 8 bit size registers, 0 is 256 bytes (PIC32MX3xx/4xx) */
+#else
+#define dmaNUM_CHANNELS 8
+#define dmaMAX_TRANSFER_SIZE 65535 /* 16 bit size registers (PIC32MX5xx/6xx/7xx) */
+#endif
+
+/* Channel events, DCHxINT flag bits (enable bits are 16 positions up) */
+#define dmaEVT_BLOCK_DONE 0x08 /* CHBCIF: Block transfer complete */
+#define dmaEVT_SRC_HALF 0x40 /* CHSHIF: Source pointer reached the middle of the source */
+
+/********************************************************************
+ * Function: 	 DMAControl()
+ * Precondition:
+ * Input: 		 dmarun : {1 start - 0 stop}
+ * Overview:     Enables/Disables the DMA controller
+ ********************************************************************/
+void DMAControl(uint8_t dmarun);
+
+/********************************************************************
+ * Function: 	 DMAChannelConfig()
+ * Precondition: DMA channel must be disabled
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ *               priority - 0 (lowest) to 3 (highest)
+ *               startIrq - IRQ number that triggers each cell transfer
+ *                          (_XXX_IRQ from the device header)
+ *               autoEnable - 1 to re-enable the channel after each
+ *                          block (circular mode)
+ * Returns:      DMA_SUCCESS if configuration successful.
+ *               DMA_XXX error codes in case of failure.
+ * Overview:     Configures a channel for interrupt triggered transfers.
+ ********************************************************************/
+int8_t DMAChannelConfig(uint8_t channel, uint8_t priority, uint8_t startIrq, uint8_t autoEnable);
+
+/********************************************************************
+ * Function: 	 DMAChannelSetTransfer()
+ * Precondition: DMA channel must be disabled
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ *               src, srcSize - Source buffer and size in bytes
+ *               dst, dstSize - Destination and size in bytes
+ *               cellSize - Bytes moved on each trigger
+ *               Sizes are 1 to dmaMAX_TRANSFER_SIZE
+ * Returns:      DMA_SUCCESS if configuration successful.
+ *               DMA_XXX error codes in case of failure.
+ * Overview:     Sets source/destination of the channel. Addresses are
+ *               converted to physical addresses.
+ ********************************************************************/
+int8_t DMAChannelSetTransfer(uint8_t channel, const volatile void *src, uint16_t srcSize,
+        volatile void *dst, uint16_t dstSize, uint16_t cellSize);
+
+/********************************************************************
+ * Function: 	 DMAChannelControl()
+ * Precondition: DMA channel should be previously configured
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ *               dmarun : {1 start - 0 stop}
+ * Overview:     Enables/Disables the channel. Transfers resume from
+ *               the current source/destination pointers.
+ ********************************************************************/
+void DMAChannelControl(uint8_t channel, uint8_t dmarun);
+
+/********************************************************************
+ * Function: 	 DMAChannelAbort()
+ * Precondition: DMA channel should be previously configured
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ * Overview:     Aborts the current transfer and resets the channel
+ *               pointers to the start of the source/destination.
+ ********************************************************************/
+void DMAChannelAbort(uint8_t channel);
+
+/********************************************************************
+ * Function: 	 DMAChannelSetSource()
+ * Precondition: DMA channel should be previously configured
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ *               src - New source buffer, same size as the current one
+ * Overview:     Replaces the source buffer. Can be called while the
+ *               channel is enabled, e.g. on the block complete event,
+ *               to swap buffers between blocks.
+ ********************************************************************/
+void DMAChannelSetSource(uint8_t channel, const volatile void *src);
+
+/********************************************************************
+ * Function: 	 DMAChannelInterruptConfig()
+ * Precondition: DMA channel should be previously configured
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ *               events - dmaEVT_XXX mask of events that interrupt
+ * Overview:     Selects the channel events that set DMAxIF. Pending
+ *               event flags are cleared. The interrupt itself must be
+ *               enabled in IECx.
+ ********************************************************************/
+void DMAChannelInterruptConfig(uint8_t channel, uint8_t events);
+
+/********************************************************************
+ * Function: 	 DMAChannelReadEvents()
+ * Precondition: DMA channel should be previously configured
+ * Input: 		 channel  - 0 to dmaNUM_CHANNELS-1
+ * Returns:      dmaEVT_XXX mask of pending events. They are cleared.
+ * Overview:     To be used in the channel ISR, before clearing DMAxIF.
+ ********************************************************************/
+uint8_t DMAChannelReadEvents(uint8_t channel);
+
+#endif
@@ -10,64 +10,153 @@
 /* Standard includes. */
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include <stdbool.h>
 
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "task.h"
+#include "stream_buffer.h"
 #include <sys/attribs.h>
 
 /* App includes */
 #include "../UART/uart.h"
+#include "../Stats/stats.h"
+#include "../Trace/trace.h"
 #include "timer2.h"
 #include "timer3.h"
-#include "oc1.h"
+#include "oc.h"
+#include "dma.h"
+#include "waveform.h"
+#include "playback.h"
+#include "console.h"
 
 #define DEBUGGING 0 /* To test each task's behaviour */
+#define mainAwgPLAYBACK_DDS 1 /* 0: Timer 3 at mainAwgWAVEFORM_SIZE*frequency ; 1: Fixed sample rate with phase accumulator (DDS), see playback.h */
 
 /* Priorities of the demo application tasks (high numb. -> high prio.) */
 #define mainAWGTASK_LOADWAVEFORM_PRIORITY           ( tskIDLE_PRIORITY + 3 )
 #define mainAWGTASK_INTERFACE_PRIORITY              ( tskIDLE_PRIORITY + 1 )
 #define mainAWGTASK_WAVEFORM_GENERATOR_PRIORITY	    ( tskIDLE_PRIORITY + 2 )
+#define mainAWGTASK_SEQUENCER_PRIORITY              ( tskIDLE_PRIORITY + 2 )
+#define mainAWGTASK_STATS_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
+#define mainAWGTASK_TRACE_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
 
 /* PWM signal to be applied to filter*/
-#define mainAwgPWM_FREQUENCY 158102 /* Frequency that sets PR2 to 254 (duty steps) - 1 , for exact duty cycle steps */
-#define mainAwgSELECTED_TIMER 2 /* Timer 2 as source for OC1 */
+#define mainAwgPWM_BITS 8 /* Output resolution, 8 - 12 bits. PR2 = 2^mainAwgPWM_BITS - 1, each extra bit halves the PWM frequency */
+#define mainAwgPWM_FREQUENCY (configPERIPHERAL_CLOCK_HZ >> mainAwgPWM_BITS) /* 156 kHz at 8 bits, 9.8 kHz at 12 bits */
+#define mainAwgSELECTED_TIMER 2 /* Timer 2 as source for every OCx, their PWM periods start together */
+#if mainAwgPWM_BITS < 8 || mainAwgPWM_BITS > 12
+#error "mainAwgPWM_BITS must be 8 to 12, WaveformSine() is bit exact up to 12 bits"
+#endif
 
-#define mainAwgWAVEFORM_SIZE 400 /* Number of duty cycle samples per period of output signal*/
+/* Outputs, OC1 (RD0) to OCn (RDn-1). They share the frequency and the
+ * sample clock, each one has its own waveform, amplitude, phase and duty */
+#define mainAwgNUM_CHANNELS playbackNUM_CHANNELS /* 1 - ocNUM_MODULES */
+
+#define mainAwgWAVEFORM_SIZE playbackWAVEFORM_SIZE /* Number of duty cycle samples per period of output signal*/
+
+/* Direct digital synthesis */
+#define mainAwgDDS_SAMPLE_RATE mainAwgPWM_FREQUENCY /* One new OCxRS value per PWM period */
 
 /* Max vars of system */
-#define mainAwgMAX_FREQUENCY 300 /* 0 - 300 Hz*/
+#if mainAwgPLAYBACK_DDS
+#define mainAwgMAX_FREQUENCY (mainAwgDDS_SAMPLE_RATE/7 < 20000 ? mainAwgDDS_SAMPLE_RATE/7 : 20000) /* 0 - 20 kHz, at least 7 samples per period */
+#else
+#define mainAwgMAX_FREQUENCY (mainAwgPWM_FREQUENCY/mainAwgWAVEFORM_SIZE) /* 0 - 390 Hz at 8 bits, OCxRS is only latched once per PWM period */
+#endif
+#define mainAwgFREQUENCY_DECIMALS 2 /* Frequency resolution of 0.01 Hz */
+#define mainAwgFREQUENCY_SCALE playbackFREQUENCY_SCALE /* 10^mainAwgFREQUENCY_DECIMALS */
 #define mainAwgMAX_AMPLITUDE 33 /* 0 - 3.3 V */
 #define mainAwgMAX_PHASE 360 /* 0 - 360 Deg */
 #define mainAwgMAX_DUTY 100 /* 0 - 100 % */
 
-#define mainAwgINPUT_BUFFER_SIZE 6 /* Max number of bytes to add to input buffer */
+#define mainAwgINPUT_BUFFER_SIZE consoleLINE_SIZE /* Bytes queued for the Interface task */
+#define mainAwgUART_TX_RING_SIZE 512 /* printf() output waiting for the UART, the menu fits */
+
+#define mainAwgRUN_STATS 0 /* 1: Print CPU time per task and ISR, stack and heap every mainAwgRUN_STATS_PERIOD_MS */
+#define mainAwgRUN_STATS_PERIOD_MS 5000
+#define mainAwgSTATS_ISR_PLAYBACK 0 /* ISR slots */
+#define mainAwgSTATS_ISR_UART 1
+#define mainAwgSTATS_ISR_TRIGGER 2
+
+#define mainAwgTRACE_STREAM 0 /* 0: Trace snapshot, sent by the r command ; 1: Trace streamed every mainAwgTRACE_STREAM_PERIOD_MS */
+#define mainAwgTRACE_STREAM_PERIOD_MS 100
+
+/* Arbitrary waveform upload, see pvLoadWaveform() for the frame format */
+#define mainAwgARB_MAX_SAMPLES 4096 /* Largest table that can be uploaded, resampled to mainAwgWAVEFORM_SIZE */
+#define mainAwgUPLOAD_SYNC 0xA5 /* First byte of every frame */
+#define mainAwgUPLOAD_START 'S' /* Payload: number of samples (uint16, little endian) */
+#define mainAwgUPLOAD_DATA 'D' /* Payload: next samples of the table */
+#define mainAwgUPLOAD_END 'E' /* No payload, the table is complete */
+#define mainAwgUPLOAD_ACK 0x06
+#define mainAwgUPLOAD_NAK 0x15
+#define mainAwgUPLOAD_READY 0x11 /* XON, sent after the "l" line, the host then sends the start frame */
+#define mainAwgUPLOAD_HEADER_SIZE 4 /* Type, sequence, length (uint16, little endian) */
+#define mainAwgUPLOAD_MAX_PAYLOAD 256 /* Max bytes in one data frame */
+#define mainAwgUPLOAD_STREAM_SIZE 1024 /* Room for a full frame while the previous one is checked */
+#define mainAwgUPLOAD_TIMEOUT pdMS_TO_TICKS(1000) /* Silence that aborts an upload */
+
+/* Sequencer, see pvSequencer() */
+#define mainAwgLIBRARY_SIZE 8 /* Waveform tables, slots 0 - 7 */
+#define mainAwgLIBRARY_NAME_SIZE 9 /* Up to 8 characters */
+#define mainAwgMAX_REPEATS 65535 /* Periods of one segment */
+#define mainAwgSEQUENCER_QUEUE_SIZE 4
+#define mainAwgTRIGGER_PRIORITY 3 /* INT2 (RE9), rising edge. Same as DMA0, they share the playback state */
+
+/* Settings of one output */
+typedef struct {
+    uint8_t ucWavetype; /* WaveForm_t */
+    uint8_t ucAmplitude; /* Desired output signal Amplitude 0-33 (0-3.3V) */
+    uint16_t usPhase; /* Desired output signal phase, from the marker */
+    uint8_t ucDuty; /* Desired output signal duty cycle ( for square and triangle) */
+    uint16_t usPhaseIndex; /* First sample of the period, according to usPhase */
+    uint16_t usMaxCompare; /* Peak OCxRS value according to ucAmplitude */
+} AwgChannel_t;
 
 /* User defined variables */
-static volatile uint8_t ucWavetype; /* 0: sine; 1: square; 2: sawtooth*/
-static volatile uint16_t usFrequency = 0; /* Desired output signal frequency*/
-static volatile uint8_t ucWaveAmplitude = 0; /* Desired output signal Amplitude 0-33 (0-3.3V) */
-static volatile uint16_t usPhase = 0; /* Desired output signal phase*/
-static volatile uint8_t usDuty = 50; /* Desired output signal duty cycle ( for square and triangle) */
+static volatile uint32_t ulFrequency = 0; /* Desired output signal frequency, in 1/mainAwgFREQUENCY_SCALE Hz, shared by every output */
+static volatile AwgChannel_t xChannels[mainAwgNUM_CHANNELS]; /* Output n is OCn+1 */
 
 /* Arrays to store duty cycle samples */
-static volatile uint8_t usWaveform[mainAwgWAVEFORM_SIZE] = {0}; /* Array to store waveform duty cycle samples */
-static volatile uint8_t usArbitraryWaveform[mainAwgWAVEFORM_SIZE] = {0}; /* Array to store arbitrary waveform */
+static volatile uint8_t usArbitraryWaveform[mainAwgARB_MAX_SAMPLES] = {0}; /* Array to store arbitrary waveform */
+static volatile uint16_t usArbWaveSize = mainAwgWAVEFORM_SIZE; /* Number of samples in usArbitraryWaveform[] */
+static uint8_t ucUploadStaging[mainAwgARB_MAX_SAMPLES]; /* Samples of the upload in progress, only used by the LoadWave task */
+static uint8_t ucUploadPayload[mainAwgUPLOAD_MAX_PAYLOAD]; /* Payload of the frame being checked */
+
+/* Library entry, one period of OC1RS values */
+typedef struct {
+    char cName[mainAwgLIBRARY_NAME_SIZE]; /* Empty if the slot is free */
+    const volatile uint16_t *pusTable; /* mainAwgWAVEFORM_SIZE samples, RAM or flash */
+} AwgWaveform_t;
 
-/* Internal logic */
-static volatile uint16_t usPhaseIndex = 0; /* Starting index for the duty cycle samples, according to desired phase*/
-static volatile uint16_t usWaveIndex = 0; /* Index of usWaveform[] to send to OC1 */
-static volatile uint16_t usArbWaveIndex = 0; /* Index of arbitrary wave array */
-static volatile uint8_t usMaxDutycycle = 0; /* Maximum value of duty cycle according to desired amplitude */
+/* Sequencer state */
+static AwgWaveform_t xLibrary[mainAwgLIBRARY_SIZE];
+static uint16_t usLibraryTables[mainAwgLIBRARY_SIZE][mainAwgWAVEFORM_SIZE]; /* RAM slots, written by the 'w' command */
 
-static volatile bool ucIsCommand = true; /* To distinguish between normal command or waveform file input*/
+/* Sequencer commands, from the Interface task */
+enum SequencerOp_t{
+    SEQUENCER_SAVE, /* Output 1 period into library slot ucSlot, named cName */
+    SEQUENCER_ADD, /* Segment (ucSlot, usRepeats, ulFrequency) at the end of the list */
+    SEQUENCER_CLEAR, /* Empty segment list */
+    SEQUENCER_LOOP,
+    SEQUENCER_BURST,
+    SEQUENCER_HALT, /* Back to SEQUENCE_OFF */
+    SEQUENCER_LIST /* Print the library and the segment list */
+};
+
+typedef struct {
+    uint8_t ucOp; /* SequencerOp_t */
+    uint8_t ucSlot;
+    uint16_t usRepeats;
+    uint32_t ulFrequency;
+    char cName[mainAwgLIBRARY_NAME_SIZE];
+} SequencerCommand_t;
 
 /* Queue Handles */
 QueueHandle_t xInputQueue = NULL;
-QueueHandle_t xArbWaveInputQueue = NULL;
+QueueHandle_t xSequencerQueue = NULL; /* SequencerCommand_t, from the Interface task to the Sequencer task */
+StreamBufferHandle_t xUploadStream = NULL; /* Raw upload bytes, from the UART ISR to the LoadWave task */
 
 /* Wave types */
 enum WaveForm_t{
@@ -85,45 +174,289 @@ static TaskHandle_t xSequencer = NULL, xInterface = NULL, xWaveformGenerator= NU
  * Prototypes and tasks
  */
 
+/* Converts the decimal string pucStr ("ddddd.dd") into 1/mainAwgFREQUENCY_SCALE Hz
+ * 
+ * Extra decimals are ignored. Values above mainAwgMAX_FREQUENCY are returned
+ * as they are, so they fail the range check.
+ */
+static uint32_t prvParseFrequency(const uint8_t *pucStr)
+{
+    uint32_t ulValue = 0;
+    uint8_t ucDecimals = 0;
+    bool xIsFraction = false;
+    
+    while(*pucStr != '\0' && ulValue <= (uint32_t)mainAwgMAX_FREQUENCY*mainAwgFREQUENCY_SCALE)
+    {
+        if(*pucStr == '.')
+        {
+            xIsFraction = true;
+        }
+        else if(*pucStr >= '0' && *pucStr <= '9')
+        {
+            if(xIsFraction)
+            {
+                if(ucDecimals == mainAwgFREQUENCY_DECIMALS)
+                {
+                    break;
+                }
+                ucDecimals++;
+            }
+            ulValue = ulValue*10 + (*pucStr-'0');
+        }
+        else
+        {
+            break;
+        }
+        pucStr++;
+    }
+    
+    for(; ucDecimals < mainAwgFREQUENCY_DECIMALS; ucDecimals++)
+    {
+        ulValue *= 10;
+    }
+    return ulValue;
+}
+
+/* CRC-16/CCITT (polynomial 0x1021), continuing from usCrc. Starts at 0xFFFF */
+static uint16_t prvCrc16(uint16_t usCrc, const uint8_t *pucData, uint16_t usLength)
+{
+    uint8_t ucBit;
+    
+    while(usLength--)
+    {
+        usCrc ^= (uint16_t)(*pucData++) << 8;
+        for(ucBit = 0; ucBit < 8; ucBit++)
+        {
+            usCrc = (usCrc & 0x8000) ? (usCrc << 1) ^ 0x1021 : usCrc << 1;
+        }
+    }
+    return usCrc;
+}
+
+/* Reads usLength upload bytes into pucData, or discards them if pucData is NULL
+ * 
+ * Returns false if the host stops sending for mainAwgUPLOAD_TIMEOUT.
+ */
+static bool prvUploadReceive(uint8_t *pucData, uint16_t usLength)
+{
+    uint8_t ucTrash[16];
+    size_t xReceived;
+    
+    while(usLength > 0)
+    {
+        if(pucData == NULL)
+        {
+            xReceived = xStreamBufferReceive(xUploadStream, ucTrash, usLength < sizeof(ucTrash) ? usLength : sizeof(ucTrash), mainAwgUPLOAD_TIMEOUT);
+        }
+        else
+        {
+            xReceived = xStreamBufferReceive(xUploadStream, pucData, usLength, mainAwgUPLOAD_TIMEOUT);
+            pucData += xReceived;
+        }
+        if(xReceived == 0)
+        {
+            return false;
+        }
+        usLength -= xReceived;
+    }
+    return true;
+}
+
+/* Replies to the frame with sequence number ucSeq */
+static void prvUploadReply(uint8_t ucReply, uint8_t ucSeq)
+{
+    uint8_t ucFrame[2] = {ucReply, ucSeq};
+    
+    UartWrite(ucFrame, sizeof(ucFrame), portMAX_DELAY);
+}
+
+/* Replaces the arbitrary waveform with the usSamples uploaded ones
+ * 
+ * The generator task resamples usArbitraryWaveform[], so it must not run
+ * in the middle of the copy. Interrupts are left on.
+ */
+static void prvUploadCommit(uint16_t usSamples)
+{
+    uint16_t usIterator;
+    
+    vTaskSuspendAll();
+    for(usIterator = 0; usIterator < usSamples; usIterator++)
+    {
+        usArbitraryWaveform[usIterator] = ucUploadStaging[usIterator];
+    }
+    usArbWaveSize = usSamples;
+    xTaskResumeAll();
+}
+
 /* Task called when system is receiving an arbitrary waveform file 
  * 
- * Takes each byte from UART and stores them in usArbitraryWaveform[].
- * Executes upon the existence of a byte in Queue
+ * The "l" line starts an upload session, see ConsoleLineAdd(). The
+ * Interface task answers it with mainAwgUPLOAD_READY, and from then on the
+ * UART ISR forwards every byte to xUploadStream and this task parses them
+ * as frames:
+ * 
+ *   0xA5 | type | seq | len (2) | payload (len) | CRC16 (2)
+ * 
+ * The CRC covers type, seq, len and payload. Multi-byte fields are little
+ * endian. Every frame is answered with ACK or NAK followed by its seq, and
+ * the host only sends the next frame after the ACK, so the stream buffer
+ * never overflows. A frame with the seq of the last ACKed one is a
+ * retransmission and is ACKed again without being stored twice. That is
+ * checked before the frame itself: once the last data frame is stored, a
+ * copy of it would not fit in the announced length anymore.
+ * 
+ *   S - Start, payload is the number of samples (1 - mainAwgARB_MAX_SAMPLES)
+ *   D - Data, up to mainAwgUPLOAD_MAX_PAYLOAD samples, stored in
+ *       ucUploadStaging[]
+ *   E - End, ACKed if all announced samples arrived. They are copied to
+ *       usArbitraryWaveform[], so a failed upload leaves the waveform as it
+ *       was. Back to command mode.
+ * 
+ * The session is aborted if the host is silent for mainAwgUPLOAD_TIMEOUT.
  */
 void pvLoadWaveform( void *pvParam)
 {
-    uint8_t ucRxInput = '\0';
+    uint8_t ucSync;
+    uint8_t ucHeader[mainAwgUPLOAD_HEADER_SIZE];
+    uint8_t ucCrc[2];
+    uint8_t *pucPayload;
+    uint16_t usLength;
+    uint16_t usExpected = 0; /* Samples announced by the start frame */
+    uint16_t usReceived = 0; /* Samples staged so far */
+    uint8_t ucLastSeq = 0; /* Sequence number of the last ACKed frame */
+    bool xSession = false; /* A start frame was ACKed */
+    bool xValid;
             
     while(1)
     {
-        xQueueReceive( xArbWaveInputQueue, (uint8_t*)&ucRxInput, portMAX_DELAY);
+        if(xStreamBufferReceive(xUploadStream, &ucSync, 1, mainAwgUPLOAD_TIMEOUT) == 0)
+        {
+            if(xConsole.xUploading) /* Host went silent, back to command mode */
+            {
+                xSession = false;
+                ConsoleUploadEnd();
+                printf("\rUpload timeout.\n");
+            }
+            continue;
+        }
+        if(ucSync != mainAwgUPLOAD_SYNC)
+        {
+            continue; /* Resynchronize on the next frame */
+        }
+        if(!prvUploadReceive(ucHeader, mainAwgUPLOAD_HEADER_SIZE))
+        {
+            continue;
+        }
+        usLength = ucHeader[2] | (ucHeader[3] << 8);
         
-        Timer3Stop();
+        /* Every payload is checked before it is used, longer ones are discarded */
+        pucPayload = usLength <= mainAwgUPLOAD_MAX_PAYLOAD ? ucUploadPayload : NULL;
+        if(!prvUploadReceive(pucPayload, usLength) || !prvUploadReceive(ucCrc, sizeof(ucCrc)))
+        {
+            continue;
+        }
+        if(pucPayload == NULL || 
+           prvCrc16(prvCrc16(0xFFFF, ucHeader, mainAwgUPLOAD_HEADER_SIZE), pucPayload, usLength) != (ucCrc[0] | (ucCrc[1] << 8)))
+        {
+            prvUploadReply(mainAwgUPLOAD_NAK, ucHeader[1]);
+            continue;
+        }
         
-        usArbitraryWaveform[usArbWaveIndex]=ucRxInput;
-        usArbWaveIndex++;
+        if(ucHeader[0] != mainAwgUPLOAD_START && xSession && ucHeader[1] == ucLastSeq) /* ACK was lost, host sent it again */
+        {
+            prvUploadReply(mainAwgUPLOAD_ACK, ucHeader[1]);
+            continue;
+        }
         
-        #if DEBUGGING
-        printf("\r\n%d", ucRxInput);
-        #endif
+        xValid = false;
+        switch(ucHeader[0]){
+            case mainAwgUPLOAD_START:
+                if(usLength != 2)
+                {
+                    break;
+                }
+                usExpected = ucUploadPayload[0] | (ucUploadPayload[1] << 8);
+                if(usExpected == 0 || usExpected > mainAwgARB_MAX_SAMPLES)
+                {
+                    break;
+                }
+                usReceived = 0;
+                xSession = true;
+                xValid = true;
+                break;
+                
+            case mainAwgUPLOAD_DATA:
+                if(!xSession || usReceived + usLength > usExpected)
+                {
+                    break;
+                }
+                memcpy(&ucUploadStaging[usReceived], ucUploadPayload, usLength);
+                usReceived += usLength;
+                xValid = true;
+                break;
+                
+            case mainAwgUPLOAD_END:
+                if(!xSession || usLength != 0 || usReceived != usExpected)
+                {
+                    break;
+                }
+                prvUploadCommit(usReceived);
+                xSession = false;
+                xValid = true;
+                break;
+        }
+        
+        if(!xValid)
+        {
+            prvUploadReply(mainAwgUPLOAD_NAK, ucHeader[1]);
+            continue;
+        }
+        ucLastSeq = ucHeader[1];
+        prvUploadReply(mainAwgUPLOAD_ACK, ucHeader[1]);
+        
+        if(ucHeader[0] == mainAwgUPLOAD_END)
+        {
+            ConsoleUploadEnd();
+            #if DEBUGGING
+            printf("\r\nSamples Received: %d", usArbWaveSize);
+            #endif
+        }
     }
 }
 
+/* Sets the waveform of output ucChannel */
+static void prvSetWavetype(uint8_t ucChannel, uint8_t ucWavetype, const char *pcName)
+{
+    xChannels[ucChannel].ucWavetype = ucWavetype;
+    printf("\rOut %u Wave: %s\n", ucChannel+1, pcName);
+}
+
 /* Task called when a new byte is received from UART
  * 
  * Evaluates each byte and constructs a command sequence.
  * Updates system variables according to the command sequence.
  * Executes upon the existence of a byte in Queue
+ * 
+ * A command can start with the output it applies to, 1 to
+ * mainAwgNUM_CHANNELS ("2s", "2V15", "2P090"). Without it, it applies to
+ * output 1. The frequency is shared by every output.
+ * Sequencer commands are forwarded to the Sequencer task.
  */
 void pvInterface(void *pvParam)
 {    
-    static uint8_t ucBuffer[mainAwgINPUT_BUFFER_SIZE]={'0'};
-    static uint8_t ucBufIdx=0;
-        
+    uint8_t *pucLine = xConsole.ucLine; /* Command line, see ConsoleLineAdd() */
     uint8_t  ucRxInput = '\0';
+    uint8_t  ucLine; /* consoleLINE_XXX */
+    uint8_t  ucReady = mainAwgUPLOAD_READY;
     uint8_t  ucCommand = '\0'; 
+    uint8_t *pucArgs; /* Command parameters */
+    uint8_t  ucChannel; /* Output the command applies to */
+    volatile AwgChannel_t *pxChannel;
+    SequencerCommand_t xSequencerCommand;
+    bool xToSequencer; /* Command is forwarded to the Sequencer task */
     
-    uint32_t usNewFrequency;
+    uint32_t ulNewFrequency;
+    uint32_t ulNewRepeats;
     uint32_t ucNewWaveAmplitude;
     uint32_t usNewPhase;
     uint32_t usNewDuty;
@@ -133,233 +466,429 @@ void pvInterface(void *pvParam)
         xQueueReceive( xInputQueue, (uint8_t*)&ucRxInput, portMAX_DELAY);
         
         /* Put valid bytes into input buffer */
-        if((ucRxInput >= '0'  && ucRxInput <= '9' ) || (ucRxInput >= 'A'  && ucRxInput <= 'Z' )\
-                || (ucRxInput >= 'a'  && ucRxInput <= 'z' )){
+        ucLine = ConsoleLineAdd(ucRxInput);
+        if(ucLine == consoleLINE_ADDED || ucLine == consoleLINE_OVERFLOW){
             
             printf("%c", ucRxInput);
-            ucBuffer[ucBufIdx]=ucRxInput; /* Add to buffer */
-            ucBufIdx++;
-            if(ucBufIdx>=mainAwgINPUT_BUFFER_SIZE-1){ /* Buffer limit */
-                ucBufIdx=0;
-                memset(ucBuffer, '\0', mainAwgINPUT_BUFFER_SIZE);
+            if(ucLine == consoleLINE_OVERFLOW){ /* Buffer limit */
                 printf("\rInvalid command.\n");
             }  
         }
+        /* The ISR now sends the frames to the LoadWave task */
+        else if(ucLine == consoleLINE_UPLOAD)
+        {
+            printf("\r\n\n");
+            UartWrite(&ucReady, 1, portMAX_DELAY);
+        }
         /* On New line, evaluate buffer and update variables */
-        else if(ucRxInput=='\r')
+        else if(ucLine == consoleLINE_COMMAND)
         {
             printf("\r\n\n");
             
-            ucCommand=ucBuffer[0]; /* First byte of the buffer indicates the command */
-            
-            Timer3Stop(); /* Stop wave output */
-            
-            if(OC1SetDutyCycle(0) != 0)
+            ucCommand=pucLine[0]; /* First byte of the buffer indicates the command */
+            pucArgs=&pucLine[1];
+            ucChannel=0;
+            if(ucCommand >= '1' && ucCommand < '1'+mainAwgNUM_CHANNELS) /* Output number, then the command */
             {
-                printf("\r\nError changing OC1RS.");
-                while(1);
+                ucChannel=ucCommand-'1';
+                ucCommand=pucLine[1];
+                pucArgs=&pucLine[2];
             }
+            pxChannel = &xChannels[ucChannel];
+            xToSequencer = false;
+            memset(&xSequencerCommand, 0, sizeof(xSequencerCommand));
             
             switch(ucCommand){
                 case 'f':
                 case 'F':
-                    usNewFrequency=(ucBuffer[1]-'0')*100+(ucBuffer[2]-'0')*10+(ucBuffer[3]-'0');
+                    ulNewFrequency=prvParseFrequency(pucArgs);
+                    if(ulNewFrequency == 0)
+                    {
+                        for(ucChannel = 0; ucChannel < mainAwgNUM_CHANNELS; ucChannel++)
+                        {
+                            xChannels[ucChannel].ucWavetype=WAVE_OFF;
+                        }
+                    }
+                    else if(ulNewFrequency<=(uint32_t)mainAwgMAX_FREQUENCY*mainAwgFREQUENCY_SCALE)
+                    {
+                        ulFrequency=ulNewFrequency;
+                        printf("\rFreq: %u.%02u Hz\n", ulFrequency/mainAwgFREQUENCY_SCALE, ulFrequency%mainAwgFREQUENCY_SCALE);
+                    }
+                    else
+                    {
+                        printf("\rInvalid frequency.\n");
+                    }
                     break;
                 case 'v':
                 case 'V':
-                    ucNewWaveAmplitude=(ucBuffer[1]-'0')*10+(ucBuffer[2]-'0');
+                    ucNewWaveAmplitude=(pucArgs[0]-'0')*10+(pucArgs[1]-'0');
+                    if(ucNewWaveAmplitude == 0)
+                    {
+                        pxChannel->ucWavetype=WAVE_OFF;
+                    }
+                    else if(ucNewWaveAmplitude<=mainAwgMAX_AMPLITUDE)
+                    {
+                        pxChannel->ucAmplitude = (uint8_t)ucNewWaveAmplitude;
+                        pxChannel->usMaxCompare = (uint32_t)pxChannel->ucAmplitude*OCMaxCompare(ucChannel+1)/mainAwgMAX_AMPLITUDE;
+                        printf("\rOut %u Amp: %d.%d V\n", ucChannel+1, pxChannel->ucAmplitude/10, pxChannel->ucAmplitude%10);
+                    }
+                    else
+                    {
+                        printf("\rInvalid amplitude.\n");
+                    }
                     break;
                 case 'p':
                 case 'P':
-                    usNewPhase = (ucBuffer[1]-'0')*100+(ucBuffer[2]-'0')*10+(ucBuffer[3]-'0');
+                    usNewPhase = (pucArgs[0]-'0')*100+(pucArgs[1]-'0')*10+(pucArgs[2]-'0');
+                    if(usNewPhase<=mainAwgMAX_PHASE)
+                    {
+                        if(usNewPhase==mainAwgMAX_PHASE)
+                        {
+                            usNewPhase=0;
+                        }
+                        pxChannel->usPhase = (uint16_t)usNewPhase;
+                        pxChannel->usPhaseIndex = pxChannel->usPhase*mainAwgWAVEFORM_SIZE/mainAwgMAX_PHASE;
+                        printf("\rOut %u Phase: %d Deg\n", ucChannel+1, pxChannel->usPhase);
+                    }
+                    else
+                    {
+                        printf("\rInvalid phase.\n");
+                    }
                     break;
                 case 'd':
                 case 'D':
-                    usNewDuty = (ucBuffer[1]-'0')*100+(ucBuffer[2]-'0')*10+(ucBuffer[3]-'0');
+                    usNewDuty = (pucArgs[0]-'0')*100+(pucArgs[1]-'0')*10+(pucArgs[2]-'0');
+                    if(usNewDuty<=mainAwgMAX_DUTY)
+                    {
+                        pxChannel->ucDuty = (uint8_t)usNewDuty;
+                        printf("\rOut %u Duty: %d %%\n\n", ucChannel+1, pxChannel->ucDuty); 
+                    }
+                    else
+                    {
+                        printf("\rInvalid duty.\n");
+                    }
                     break;
                 case 's':
                 case 'S':
-                    ucWavetype=WAVE_SINE;
-                    printf("\rWave: Sine\n");
+                    prvSetWavetype(ucChannel, WAVE_SINE, "Sine");
                     break;
                 case 't':
                 case'T':
-                    ucWavetype=WAVE_TRIANGLE;
-                    printf("\rWave: Triangle\n");
+                    prvSetWavetype(ucChannel, WAVE_TRIANGLE, "Triangle");
                     break; 
                 case 'q':
                 case 'Q':
-                    ucWavetype=WAVE_SQUARE;
-                    printf("\rWave: Square\n");
+                    prvSetWavetype(ucChannel, WAVE_SQUARE, "Square");
                     break;
                 case 'a':
                 case 'A':
-                    ucWavetype=WAVE_ARBITRARY;
-                    printf("\rWave: Arbitrary\n");
+                    prvSetWavetype(ucChannel, WAVE_ARBITRARY, "Arbitrary");
                     break;
                 case 'o':
                 case 'O':
-                    ucWavetype=WAVE_OFF;
-                    printf("\rWave: Off\n");
+                    prvSetWavetype(ucChannel, WAVE_OFF, "Off");
+                    break;
+                case 'w':
+                case 'W':
+                    xSequencerCommand.ucOp = SEQUENCER_SAVE;
+                    xSequencerCommand.ucSlot = pucArgs[0]-'0';
+                    strncpy(xSequencerCommand.cName, (const char *)&pucArgs[1], mainAwgLIBRARY_NAME_SIZE-1);
+                    xToSequencer = true;
+                    break;
+                case 'n':
+                case 'N':
+                    xSequencerCommand.ucOp = SEQUENCER_ADD;
+                    xSequencerCommand.ucSlot = pucArgs[0]-'0';
+                    pucArgs++;
+                    ulNewRepeats = 0;
+                    if(*pucArgs == 'r' || *pucArgs == 'R')
+                    {
+                        while(*++pucArgs >= '0' && *pucArgs <= '9' && ulNewRepeats <= mainAwgMAX_REPEATS)
+                        {
+                            ulNewRepeats = ulNewRepeats*10 + (*pucArgs-'0');
+                        }
+                    }
+                    xSequencerCommand.usRepeats = (ulNewRepeats <= mainAwgMAX_REPEATS) ? (uint16_t)ulNewRepeats : 0;
+                    if(*pucArgs == 'f' || *pucArgs == 'F')
+                    {
+                        xSequencerCommand.ulFrequency = prvParseFrequency(pucArgs+1);
+                    }
+                    xToSequencer = true;
+                    break;
+                case 'c':
+                case 'C':
+                    xSequencerCommand.ucOp = SEQUENCER_CLEAR;
+                    xToSequencer = true;
+                    break;
+                case 'g':
+                case 'G':
+                    xSequencerCommand.ucOp = SEQUENCER_LOOP;
+                    xToSequencer = true;
                     break;
+                case 'b':
+                case 'B':
+                    xSequencerCommand.ucOp = SEQUENCER_BURST;
+                    xToSequencer = true;
+                    break;
+                case 'h':
+                case 'H':
+                    xSequencerCommand.ucOp = SEQUENCER_HALT;
+                    xToSequencer = true;
+                    break;
+                case 'i':
+                case 'I':
+                    xSequencerCommand.ucOp = SEQUENCER_LIST;
+                    xToSequencer = true;
+                    break;
+                #if traceRECORDER_ENABLE && !mainAwgTRACE_STREAM
+                case 'r':
+                case 'R':
+                    TraceDump(); /* Binary frames, decode with Trace/trace_decode.m */
+                    break;
+                #endif
                 default:
                     printf("\rInvalid Command.\n");
                     break;
             }
             /* Empty input buffer */
-            ucBufIdx=0;
-            memset(ucBuffer, '\0', mainAwgINPUT_BUFFER_SIZE);
-           
-            /* Check validity of new parameters */
-            if(usNewFrequency == 0)
-            {
-                ucWavetype=WAVE_OFF;
-            }
-            else if(usNewFrequency<=mainAwgMAX_FREQUENCY)
-            {
-                usFrequency=(uint16_t)usNewFrequency;
-                printf("\rFreq: %d Hz\n", usFrequency);
-            }
-            else
-            {
-                printf("\rInvalid frequency.\n");
-            }
-
-            if(ucNewWaveAmplitude == 0)
-            {
-                ucWavetype=WAVE_OFF;
-            }
-            else if(ucNewWaveAmplitude<=mainAwgMAX_AMPLITUDE)
-            {
-                ucWaveAmplitude = (uint8_t)ucNewWaveAmplitude;
-                usMaxDutycycle = ucWaveAmplitude*oc1MAX_DUTYCYCLE/mainAwgMAX_AMPLITUDE;
-                printf("\rAmp: %d.%d V\n", ucWaveAmplitude/10,ucWaveAmplitude%10);
-            }
-            else
-            {
-                printf("\rInvalid amplitude.\n");
-            }
-
-            if(usNewPhase<=mainAwgMAX_PHASE)
+            ConsoleLineClear();
+            
+            if(xToSequencer)
             {
-                if(usNewPhase==mainAwgMAX_PHASE)
+                if(xQueueSend(xSequencerQueue, &xSequencerCommand, 0) != pdTRUE)
                 {
-                    usNewPhase=0;
+                    printf("\rSequencer busy.\n");
                 }
-                usPhase = (uint16_t)usNewPhase;
-                usPhaseIndex = usPhase*mainAwgWAVEFORM_SIZE/mainAwgMAX_PHASE;
-                printf("\rPhase: %d Deg\n", usPhase);
             }
             else
             {
-                printf("\rInvalid phase.\n");
+                xTaskNotifyGive(xWaveformGenerator);
             }
+        }
+    }
+}
+
+/* Generates one period of the waveform of pxChannel into pusPeriod, as OCxRS values,
+ * starting at the marker */
+static void prvGeneratePeriod(volatile AwgChannel_t *pxChannel, uint16_t *pusPeriod)
+{
+    uint16_t usMaxCompare = pxChannel->usMaxCompare;
+    uint16_t usDutyIndex=(pxChannel->ucDuty*mainAwgWAVEFORM_SIZE/mainAwgMAX_DUTY); /* Index corresponding to the desired duty cycle's transition zone */
+    uint16_t usIterator;
+    
+    switch(pxChannel->ucWavetype){
+        case WAVE_SINE: 
+            WaveformSine(pusPeriod, usMaxCompare, usDutyIndex);
+            break;
             
-            if(usNewDuty<=mainAwgMAX_DUTY)
-            {
-                usDuty = (uint8_t)usNewDuty;
-                printf("\rDuty: %d %%\n\n", usDuty); 
-            }
-            else
+        case WAVE_SQUARE:
+            WaveformSquare(pusPeriod, usMaxCompare, usDutyIndex);
+            break;
+            
+        case WAVE_TRIANGLE:
+            WaveformTriangle(pusPeriod, usMaxCompare, usDutyIndex);
+            break;
+            
+        case WAVE_ARBITRARY:
+            for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++) /* Resampled to one period */
             {
-                printf("\rInvalid duty.\n");
+                pusPeriod[usIterator]=(uint16_t)((uint32_t)usArbitraryWaveform[(uint32_t)usIterator*usArbWaveSize/mainAwgWAVEFORM_SIZE]*usMaxCompare/ocMAX_DUTYCYCLE);
             }
+            break;
             
-            xTaskNotifyGive(xWaveformGenerator);
+        default: /* WAVE_OFF */
+            memset(pusPeriod, 0, mainAwgWAVEFORM_SIZE*sizeof(pusPeriod[0]));
+            break;
+    }
+}
+
+/* Generates one period of output ucChannel into pusSamples, as OCxRS values
+ * 
+ * The period is rotated to start usPhaseIndex samples in, so each output
+ * is shifted by its own phase from the marker, which rises on sample 0.
+ */
+static void prvGenerateChannel(uint8_t ucChannel, volatile uint16_t *pusSamples)
+{
+    static uint16_t usPeriod[mainAwgWAVEFORM_SIZE]; /* Unrotated period, only used by the generator task */
+    volatile AwgChannel_t *pxChannel = &xChannels[ucChannel];
+    uint16_t usIterator;
+    uint16_t usIndex;
+    
+    prvGeneratePeriod(pxChannel, usPeriod);
+    
+    usIndex = pxChannel->usPhaseIndex;
+    for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+    {
+        pusSamples[usIterator] = usPeriod[usIndex];
+        if(++usIndex == mainAwgWAVEFORM_SIZE)
+        {
+            usIndex = 0;
         }
     }
+    
+    #if DEBUGGING
+    printf("\r\nOut %u Wave Samples:", ucChannel+1);
+    for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+    {
+        printf("\r\n%d", pusSamples[usIterator]);
+    }
+    #endif
 }
 
-/* Task called to generate usWaveform[] array of samples for desired output signal 
+/* Task called to generate the OCxRS samples of the desired output signals 
  * 
- * Generates one period of the signal with the desired amplitude
+ * Generates one period of every output with its own waveform, amplitude
+ * and phase, as OCxRS values, straight into the playback buffer that is
+ * not being streamed. The DMA ISR swaps it in for every output at the end
+ * of the current period, so the output never stops and the outputs stay
+ * phase locked.
+ * While sequencing, output 1 is played from the library, see pvSequencer().
  * Executes on notification from the Interface Task
  */
 void pvWaveformGenerator(void *pvParam)
 {
-    uint16_t usIterator;
+    uint8_t ucNext; /* Playback buffer to write */
+    uint8_t ucChannel;
+    Timer3Period_t xPeriod;
     
     while(1) {
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        uint16_t usDutyIndex=(usDuty*mainAwgWAVEFORM_SIZE/mainAwgMAX_DUTY); /* Index corresponding to the desired duty cycle's transition zone */
+        /* Sample rate, set by the segments while sequencing */
+        if(xPlayback.ucSequenceMode == SEQUENCE_OFF)
+        {
+            if(ulFrequency == 0)
+            {
+                PlaybackStop();
+                continue;
+            }
+            if(PlaybackSetFrequency(ulFrequency, &xPeriod) != PLAYBACK_SUCCESS)
+            {
+                printf("\r\nError configuring Timer 3.");
+                while(1);
+            }
+        }
+        
+        ucNext = PlaybackWriteBegin();
+        for(ucChannel = 0; ucChannel < mainAwgNUM_CHANNELS; ucChannel++)
+        {
+            prvGenerateChannel(ucChannel, xPlayback.usBuffers[ucNext][ucChannel]);
+        }
+        PlaybackWriteEnd(ucNext, &xPeriod);
+    }
+}
+
+/* Task that plays sequences of waveforms from the library
+ * 
+ * The library holds mainAwgLIBRARY_SIZE named tables of one period of
+ * OCxRS values. Slots 0 - 2 start with full scale sine, square and
+ * triangle, and 'w' saves the current waveform of output 1 into a slot.
+ * Entries are pointers, so a slot can also refer to a const table in flash.
+ * 
+ * A segment plays a library table for a number of periods at its own
+ * frequency. Its table pointer and sample rate (or tuning word) are worked
+ * out when it is added, so the playback ISRs switch segments at the end
+ * of a period by swapping pointers (playback.c), and no table
+ * is regenerated. Output 1 plays the sequence, outputs 2 to n keep their
+ * own waveforms at the sample rate of the segment.
+ * 
+ * In burst mode every rising edge on INT2 (RE9) plays the list once from
+ * the start. Triggers during a burst are ignored.
+ * Executes on commands from the Interface task
+ */
+void pvSequencer(void *pvParam)
+{
+    SequencerCommand_t xCommand;
+    const PlaybackSegment_t *pxSegment;
+    int8_t cResult;
+    uint8_t ucIterator;
+    
+    while(1) {
+        xQueueReceive(xSequencerQueue, &xCommand, portMAX_DELAY);
         
-        switch(ucWavetype){
-            case WAVE_SINE: 
-                for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+        if(xPlayback.ucSequenceMode != SEQUENCE_OFF && 
+           (xCommand.ucOp == SEQUENCER_SAVE || xCommand.ucOp == SEQUENCER_ADD || xCommand.ucOp == SEQUENCER_CLEAR))
+        {
+            printf("\rHalt the sequencer first.\n"); /* Tables and segments are read by the playback ISRs */
+            continue;
+        }
+        
+        switch(xCommand.ucOp){
+            case SEQUENCER_SAVE:
+                if(xCommand.ucSlot >= mainAwgLIBRARY_SIZE || xCommand.cName[0] == '\0')
                 {
-                    usWaveform[usIterator]=usMaxDutycycle/2;
-                    if(usIterator < usDutyIndex/2)
-                    {
-                        usWaveform[usIterator]=usWaveform[usIterator]=(uint8_t)ceil(((float)usMaxDutycycle/2*sin((2*M_PI*(usIterator+1))/mainAwgWAVEFORM_SIZE)+usMaxDutycycle/2));
-                    }
-                    if(usIterator > mainAwgWAVEFORM_SIZE/2 && usIterator < (mainAwgWAVEFORM_SIZE/2 + usDutyIndex/2))
-                    {
-                        usWaveform[usIterator]=usWaveform[usIterator]=(uint8_t)ceil(((float)usMaxDutycycle/2*sin((2*M_PI*(usIterator+1))/mainAwgWAVEFORM_SIZE)+usMaxDutycycle/2));
-                    }
+                    printf("\rInvalid slot.\n");
+                    break;
                 }
+                prvGeneratePeriod(&xChannels[0], usLibraryTables[xCommand.ucSlot]);
+                xLibrary[xCommand.ucSlot].pusTable = usLibraryTables[xCommand.ucSlot];
+                strcpy(xLibrary[xCommand.ucSlot].cName, xCommand.cName);
+                printf("\rSlot %u: %s\n", xCommand.ucSlot, xCommand.cName);
                 break;
                 
-            case WAVE_SQUARE:
-                for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+            case SEQUENCER_ADD:
+                if(xCommand.ucSlot >= mainAwgLIBRARY_SIZE || xLibrary[xCommand.ucSlot].pusTable == NULL)
                 {
-                    if(usIterator < usDutyIndex)
-                    {
-                        usWaveform[usIterator]=usMaxDutycycle;
-                    }
-                    else
-                    {
-                        usWaveform[usIterator]=0;
-                    }
+                    printf("\rInvalid slot.\n");
+                    break;
                 }
-                break;
-                
-            case WAVE_TRIANGLE:
-                for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+                if(xCommand.usRepeats == 0 || xCommand.ulFrequency == 0 || 
+                   xCommand.ulFrequency > (uint32_t)mainAwgMAX_FREQUENCY*mainAwgFREQUENCY_SCALE)
                 {
-                    if(usIterator < usDutyIndex)
-                    {
-                        usWaveform[usIterator]=(uint8_t)(usIterator*usMaxDutycycle/usDutyIndex);
-                    }
-                    else
-                    {
-                        usWaveform[usIterator]=usMaxDutycycle-usMaxDutycycle*(usIterator-usDutyIndex)/(mainAwgWAVEFORM_SIZE-usDutyIndex);
-                    }
-                    
+                    printf("\rInvalid segment.\n");
+                    break;
                 }
+                cResult = PlaybackSequenceAdd(xLibrary[xCommand.ucSlot].pusTable, xCommand.usRepeats, xCommand.ulFrequency, xCommand.ucSlot);
+                if(cResult != PLAYBACK_SUCCESS)
+                {
+                    printf(cResult == PLAYBACK_SEQUENCE_FULL ? "\rSequence full.\n" : "\rInvalid frequency.\n");
+                    break;
+                }
+                pxSegment = &xPlayback.xSegments[xPlayback.ucNumSegments-1];
+                printf("\rSegment %u: %s x%u, %u.%02u Hz\n", xPlayback.ucNumSegments, xLibrary[xCommand.ucSlot].cName, 
+                        pxSegment->usRepeats, pxSegment->ulFrequency/mainAwgFREQUENCY_SCALE, pxSegment->ulFrequency%mainAwgFREQUENCY_SCALE);
                 break;
                 
-            case WAVE_ARBITRARY:
-                for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+            case SEQUENCER_CLEAR:
+                PlaybackSequenceClear();
+                printf("\rSequence cleared.\n");
+                break;
+                
+            case SEQUENCER_LOOP:
+            case SEQUENCER_BURST:
+                if(xPlayback.ucNumSegments == 0)
                 {
-                    usWaveform[usIterator]=(uint8_t)(usArbitraryWaveform[usIterator]*ucWaveAmplitude/mainAwgMAX_AMPLITUDE);
+                    printf("\rSequence empty.\n");
+                    break;
                 }
+                PlaybackSequenceStart(xCommand.ucOp == SEQUENCER_LOOP ? SEQUENCE_LOOP : SEQUENCE_BURST);
+                printf(xCommand.ucOp == SEQUENCER_LOOP ? "\rSequence running.\n" : "\rBurst armed, trigger on RE9.\n");
                 break;
                 
-            case WAVE_OFF:
-                for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
+            case SEQUENCER_HALT:
+                PlaybackSequenceHalt();
+                printf("\rSequence halted, %u bursts.\n", xPlayback.ulBursts);
+                xTaskNotifyGive(xWaveformGenerator); /* Back to the output settings */
+                break;
+                
+            case SEQUENCER_LIST:
+                printf("\rLibrary:\n");
+                for(ucIterator = 0; ucIterator < mainAwgLIBRARY_SIZE; ucIterator++)
                 {
-                    usWaveform[usIterator]=0;
+                    if(xLibrary[ucIterator].pusTable != NULL)
+                    {
+                        printf("\r %u %s\n", ucIterator, xLibrary[ucIterator].cName);
+                    }
+                }
+                printf("\rSequence:\n");
+                for(ucIterator = 0; ucIterator < xPlayback.ucNumSegments; ucIterator++)
+                {
+                    pxSegment = &xPlayback.xSegments[ucIterator];
+                    printf("\r %u %s x%u, %u.%02u Hz\n", ucIterator+1, xLibrary[pxSegment->ucWaveform].cName, 
+                            pxSegment->usRepeats, pxSegment->ulFrequency/mainAwgFREQUENCY_SCALE, pxSegment->ulFrequency%mainAwgFREQUENCY_SCALE);
                 }
                 break;
         }
-        
-        #if DEBUGGING
-        printf("\r\nWave Samples:");
-        for(usIterator = 0; usIterator < mainAwgWAVEFORM_SIZE; usIterator++)
-        {
-            printf("\r\n%d", usWaveform[usIterator]);
-        }
-        #endif
-        
-        /* Update Timer 3 */
-        if(Timer3Config(mainAwgWAVEFORM_SIZE*usFrequency) != 0)
-        {
-            printf("\r\nError configuring Timer 3.");
-            while(1);
-        }
-        Timer3InterruptConfig(1);
-        Timer3Start();
     }
 }
 
@@ -369,8 +898,10 @@ void pvWaveformGenerator(void *pvParam)
 int mainAWG( void )
 {
     /* ISRs */
-    void __attribute__( (interrupt(IPL2AUTO), vector(_TIMER_3_VECTOR))) vT3InterruptWrapper(void);
-    void __attribute__( (interrupt(IPL4AUTO), vector(_UART_1_VECTOR))) vU1InterruptWrapper(void);
+    void __attribute__( (interrupt(IPL2AUTO), vector(_UART_1_VECTOR))) vU1InterruptWrapper(void);
+    void __attribute__( (interrupt(IPL3AUTO), vector(_DMA_0_VECTOR))) vDMA0InterruptWrapper(void);
+    void __attribute__( (interrupt(IPL3AUTO), vector(_EXTERNAL_2_VECTOR))) vINT2InterruptWrapper(void);
+    uint8_t ucChannel;
     
     /* PWM Timer and OC */
     if(Timer2Config(mainAwgPWM_FREQUENCY) != 0)
@@ -378,35 +909,69 @@ int mainAWG( void )
         printf("\r\nError configuring Timer 2.");
         while(1);
     }
-    if(OC1Config(mainAwgSELECTED_TIMER) != 0)
+    for(ucChannel = 0; ucChannel < mainAwgNUM_CHANNELS; ucChannel++)
     {
-        printf("\r\nError configuring OC1.");
-        while(1);
+        if(OCConfig(ucChannel+1, mainAwgSELECTED_TIMER) != OC_SUCCESS)
+        {
+            printf("\r\nError configuring OC%u.", ucChannel+1);
+            while(1);
+        }
+        OCControl(ucChannel+1, ocSTART);
+        xChannels[ucChannel].ucDuty = 50;
     }
-    OC1Control(oc1START);
     Timer2Start();
     
-    if(OC1SetDutyCycle(0) != 0)
+    /* Sequencer library, full scale */
+    WaveformSine(usLibraryTables[0], OCMaxCompare(1), mainAwgWAVEFORM_SIZE/2);
+    WaveformSquare(usLibraryTables[1], OCMaxCompare(1), mainAwgWAVEFORM_SIZE/2);
+    WaveformTriangle(usLibraryTables[2], OCMaxCompare(1), mainAwgWAVEFORM_SIZE/2);
+    strcpy(xLibrary[0].cName, "SINE");
+    strcpy(xLibrary[1].cName, "SQUARE");
+    strcpy(xLibrary[2].cName, "TRIANGLE");
+    for(ucChannel = 0; ucChannel < 3; ucChannel++)
     {
-        printf("\r\nError changing OC1RS.");
-        while(1);
+        xLibrary[ucChannel].pusTable = usLibraryTables[ucChannel];
     }
      
-    /* Set RD0 as digital output (OC1) */
-    TRISDbits.TRISD0 = 0;
-    PORTDbits.RD0 = 0;
+    /* Set RD0 to RDn-1 as digital outputs (OC1 to OCn) */
+    TRISDCLR = (1 << mainAwgNUM_CHANNELS) - 1;
+    LATDCLR = (1 << mainAwgNUM_CHANNELS) - 1;
     
     /* Set RE8 as digital output (External Marker) */
     TRISEbits.TRISE8 = 0;
     PORTEbits.RE8 = 0;
     
+    /* Waveform playback, see playback.h */
+    if(PlaybackInit(mainAwgPLAYBACK_DDS ? playbackMODE_DDS : playbackMODE_TABLE, mainAwgDDS_SAMPLE_RATE) != PLAYBACK_SUCCESS)
+    {
+        printf("\r\nError configuring the waveform playback.");
+        while(1);
+    }
+    IPC9bits.DMA0IP = 3; /* Interrupt priority, must not exceed configMAX_SYSCALL_INTERRUPT_PRIORITY */
+    StatsIsrName(mainAwgSTATS_ISR_PLAYBACK, "Playback");
+    IFS1bits.DMA0IF = 0; /* Clear the DMA0 interrupt flag */
+    IEC1bits.DMA0IE = 1; /* Enable end of period interrupts */
+    
+    /* Burst trigger: INT2 on RE9, enabled by the sequencer when a burst is armed */
+    TRISEbits.TRISE9 = 1;
+    INTCONbits.INT2EP = 1; /* Rising edge */
+    IPC2bits.INT2IP = mainAwgTRIGGER_PRIORITY;
+    StatsIsrName(mainAwgSTATS_ISR_TRIGGER, "Trigger");
+    IFS0bits.INT2IF = 0;
+    IEC0bits.INT2IE = 0;
+    
 	/* Init UART and redirect tdin/stdot/stderr to UART */
     if(UartInit(configPERIPHERAL_CLOCK_HZ, 115200) != UART_SUCCESS) {
         printf("\r\nError configuring UART");
         while(1);
     }
+    if(UartBufferedInit(mainAwgUART_TX_RING_SIZE, 0) != UART_SUCCESS) { /* TX only, RX is routed by vU1InterruptHandler() */
+        printf("\r\nError configuring UART TX ring");
+        while(1);
+    }
+    StatsIsrName(mainAwgSTATS_ISR_UART, "UART");
     U1STAbits.URXISEL = 0; /* Interrupt on each new byte */
-    IPC6bits.U1IP = 4; /* Interrupt priority */
+    IPC6bits.U1IP = 2; /* Interrupt priority, below DMA0 and configMAX_SYSCALL_INTERRUPT_PRIORITY */
     IEC0bits.U1RXIE = 1; /* Enable receive interupts */
     IFS0bits.U1RXIF = 0; /* Clear the rx interrupt flag */
     __XC_UART = 1; /* Redirect stdin/stdout/stderr to UART1 */
@@ -415,20 +980,47 @@ int mainAWG( void )
     printf("\033[2J");
     printf("\rArbitrary Waveform Generator - Diogo Vala & Beatriz Silva\n");
     printf("\rCommands: \n");
-    printf("\rs (sine); t(triangle); q(square); a(arbitrary)\n");
-    printf("\rFrequency: Fxxx -> 000-300\n");
+    printf("\rs (sine); t(triangle); q(square); a(arbitrary); o(off)\n");
+    printf("\rl (upload arbitrary waveform, up to %d samples)\n", mainAwgARB_MAX_SAMPLES);
+    printf("\rFrequency: Fxxx.xx -> 0-%u Hz\n", (unsigned)mainAwgMAX_FREQUENCY);
     printf("\rAmplitude: Vxx -> 00-33\n");
     printf("\rPhase: Pxxx -> 000-360\n");
     printf("\rDuty: Dxxx -> 000-100\n");
+    printf("\rOutput: prefix 1-%d (e.g. 2s, 2V15, 2P090), output 1 if none\n", mainAwgNUM_CHANNELS);
+    printf("\rLibrary: Wn<name> -> save output 1 to slot 0-%d\n", mainAwgLIBRARY_SIZE-1);
+    printf("\rSequence: NnRxxxxxFxxx.xx (add); c(clear); g(loop); b(burst on RE9); h(halt); i(list)\n");
+    #if traceRECORDER_ENABLE && !mainAwgTRACE_STREAM
+    printf("\rr (dump the trace buffer)\n");
+    #endif
     
     /* Queue Creation */
     xInputQueue = xQueueCreate(mainAwgINPUT_BUFFER_SIZE, sizeof(uint8_t));
-    xArbWaveInputQueue = xQueueCreate(mainAwgWAVEFORM_SIZE, sizeof(uint8_t));
+    xUploadStream = xStreamBufferCreate(mainAwgUPLOAD_STREAM_SIZE, 1);
+    ConsoleInit(xInputQueue, xUploadStream);
+    xSequencerQueue = xQueueCreate(mainAwgSEQUENCER_QUEUE_SIZE, sizeof(SequencerCommand_t));
     
     /* Create the tasks defined within this file. */
     xTaskCreate( pvLoadWaveform, ( const signed char * const ) "LoadWave", configMINIMAL_STACK_SIZE, NULL, mainAWGTASK_LOADWAVEFORM_PRIORITY, &xLoadWave );
     xTaskCreate( pvInterface, ( const signed char * const ) "Interface", configMINIMAL_STACK_SIZE, NULL, mainAWGTASK_INTERFACE_PRIORITY, &xInterface );
     xTaskCreate( pvWaveformGenerator, ( const signed char * const ) "WaveformGenerator", configMINIMAL_STACK_SIZE, NULL, mainAWGTASK_WAVEFORM_GENERATOR_PRIORITY, &xWaveformGenerator );
+    xTaskCreate( pvSequencer, ( const signed char * const ) "Sequencer", configMINIMAL_STACK_SIZE, NULL, mainAWGTASK_SEQUENCER_PRIORITY, &xSequencer );
+    #if traceRECORDER_ENABLE && mainAwgTRACE_STREAM
+    TraceStart(traceMODE_STREAM);
+    if(TraceStreamStart(mainAWGTASK_TRACE_PRIORITY, mainAwgTRACE_STREAM_PERIOD_MS) != TRACE_SUCCESS)
+    {
+        printf("\r\nError creating the trace task");
+        while(1);
+    }
+    #elif traceRECORDER_ENABLE
+    TraceStart(traceMODE_SNAPSHOT);
+    #endif
+    #if mainAwgRUN_STATS
+    if(StatsStart(mainAWGTASK_STATS_PRIORITY, mainAwgRUN_STATS_PERIOD_MS) != STATS_SUCCESS)
+    {
+        printf("\r\nError creating the stats task");
+        while(1);
+    }
+    #endif
     
     /* Finally start the scheduler. */
 	vTaskStartScheduler();   
@@ -438,116 +1030,38 @@ int mainAWG( void )
 	return 0;
 }
 
-/* Timer3 ISR 
- * 
- * Updates the duty cycle value to be applied to OC1
- * External marker is set to 1 at the start of the period and
- * set back to 0 after mainAwgMARKER_WIDTH samples.
- * 
- * Frequency of timer 3 is mainAwgWAVEFORM_SIZE*ucFrequency,
- * updates upon every new command.
- * 
-*/
-void vT3InterruptHandler(void)
+/* DMA0 ISR, see PlaybackDmaIsr() */
+void vDMA0InterruptHandler(void)
 {
-    static const uint16_t mainAwgMARKER_WIDTH = mainAwgWAVEFORM_SIZE/20; /* Number of samples that the marker stays HIGH*/
-    
-    /* Update duty cycle */
-    if(OC1SetDutyCycle(usWaveform[usWaveIndex]) != 0)
-    {
-        printf("\r\nError changing OC1RS.");
-        while(1);
-    }
+    uint32_t ulEnter = statsISR_ENTER();
     
-    #if DEBUGGING
-    printf("\r\nByte Received: %d", usWaveform[usWaveIndex]);
-    #endif
-    
-    /* External Marker */
-    if((usWaveIndex >= usPhaseIndex) && (usWaveIndex <= (usPhaseIndex+mainAwgMARKER_WIDTH)))
-    {
-        LATEbits.LATE8 = 1;
-    }
-    else
-    {
-        LATEbits.LATE8 = 0;
-    }
-    
-    usWaveIndex++;
-    
-    /* Repeat period */
-    if(usWaveIndex>=mainAwgWAVEFORM_SIZE)
-    {
-        usWaveIndex=0;
-    }
+    PlaybackDmaIsr();
+    StatsIsrExit(mainAwgSTATS_ISR_PLAYBACK, ulEnter);
+}
+
+/* INT2 ISR, burst trigger, see PlaybackTriggerIsr() */
+void vINT2InterruptHandler(void)
+{
+    uint32_t ulEnter = statsISR_ENTER();
     
-    Timer3ResetInterruptFlag();
+    PlaybackTriggerIsr();
+    StatsIsrExit(mainAwgSTATS_ISR_TRIGGER, ulEnter);
 }
 
 /* UART ISR 
  * 
- * Receives serial inputs byte by byte.
- *  
- * Checks if the input is 'l', that signifies the start of an arbitrary wave
- * input.
- * Checks if the input is 0xFF, that signifies the end of transfer for the
- * arbitrary wave
- * 
- * Sends the received byte to either the Interface or LoadWave task, according
- * to a flag, via two queues.
+ * Refills the TX FIFO from the driver's TX ring, so printf() does not
+ * busy wait, and drains the RX FIFO to the Interface task, or to the
+ * LoadWave task during an upload, see ConsoleRxIsr().
  */
 void vU1InterruptHandler(void) {
    
-    /* Received byte */
-    uint8_t ucTxInput=0;
-    uint8_t ucTrash;
-    bool ucHasRxed = false; /* True if a valid byte was received */
+    uint32_t ulEnter = statsISR_ENTER();
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
     
-    if(U1STAbits.OERR ||U1STAbits.FERR || U1STAbits.PERR) /* Error checking */
-	{
-		ucTrash = U1RXREG; /* Read to clear FERR/PERR */
-		U1STAbits.OERR = 0; /* Clear OERR to keep receiving */
-	}
-	if(U1STAbits.URXDA)
-	{
-		ucTxInput = U1ARXREG; /* Get data from UART RX FIFO */
-        ucHasRxed=true; /* Byte was received */ 
-	}
+    UartInterruptHandler(&xHigherPriorityTaskWoken); /* TX ring */
+    ConsoleRxIsr(&xHigherPriorityTaskWoken);
     
-    #if DEBUGGING
-    printf("\r\nByte Received: %d", ucTxInput);
-    #endif
-    
-    if(ucTxInput=='l')
-    {
-        ucIsCommand=false; /* Next inputs will not be commands, send them to LoadWave task */
-        usArbWaveIndex = 0; /* Set usArbitraryWaveform[] to index 0 to load new wave*/
-    }
-    else if(ucTxInput==0xFF) /* End of wave input */
-    {
-        Timer3Start();
-        ucIsCommand=true; /* Next inputs are commands, send them to interface task */
-        #if DEBUGGING
-        printf("\r\nSamples Received: %d", usArbWaveIndex);
-        #endif
-    }
-    
-    IFS0bits.U1RXIF = 0; /* clear the RX interrupt flag */
-    
-    if(ucHasRxed){
-        if(ucIsCommand)
-        {
-            if(xQueueSendFromISR(xInputQueue, (void*)&ucTxInput, NULL) != pdTRUE )
-            {
-                printf("\rERROR: INPUT QUEUE FULL.\n");
-            }
-        }
-        else
-        {
-            if(xQueueSendFromISR(xArbWaveInputQueue, (void*)&ucTxInput, NULL) != pdTRUE )
-            {
-                printf("\rERROR: ARBITRARY WAVE QUEUE FULL.\n");
-            }
-        }
-    }
-}
\ No newline at end of file
+    StatsIsrExit(mainAwgSTATS_ISR_UART, ulEnter);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
@@ -0,0 +1,99 @@
+/*
+ * File:   oc.c
+ * Author: Diogo Vala
+ *
+ * Overview: Configures the output compare modules OC1 to OC5
+ */
+
+#include <xc.h>
+#include <stdlib.h>
+#include "oc.h"
+
+/* Every SFR is followed by its CLR, SET and INV registers */
+typedef struct {
+    volatile uint32_t reg;
+    volatile uint32_t clr;
+    volatile uint32_t set;
+    volatile uint32_t inv;
+} OcReg_t;
+
+/* Register block of one module. Modules are 0x200 bytes apart, starting at OC1CON */
+typedef struct {
+    OcReg_t CON;
+    OcReg_t R;
+    OcReg_t RS;
+    uint8_t reserved[0x200 - 3*sizeof(OcReg_t)];
+} OcModule_t;
+
+#define ocMODULE(n) ((OcModule_t *)&OC1CON + (n) - 1)
+
+static uint8_t PRx[ocNUM_MODULES]; /* Source timer of each module, 0 if not configured */
+
+int8_t OCConfig(uint8_t module, uint8_t timer){
+    OcModule_t *pxModule;
+
+    if (module == 0 || module > ocNUM_MODULES)
+        return OC_INVALID_MODULE;
+    if (timer != 2 && timer != 3)
+        return OC_CLOCK_SOURCE_NOT_SUP;
+
+    pxModule = ocMODULE(module);
+    PRx[module - 1] = timer;
+    pxModule->CON.clr = _OC1CON_ON_MASK; // Stop while reconfiguring
+    pxModule->CON.reg = (6 << _OC1CON_OCM_POSITION) // OCM = 0b110 : PWM mode
+            | ((timer - 2) << _OC1CON_OCTSEL_POSITION); // Timer is clock source of OCM
+    pxModule->RS.reg = 0; // Initial OCxR value
+    return OC_SUCCESS;
+}
+
+void OCControl(uint8_t module, uint8_t ocrun){
+    if (module == 0 || module > ocNUM_MODULES)
+        return;
+
+    if (ocrun) {
+        ocMODULE(module)->CON.set = _OC1CON_ON_MASK; // Enable OCx
+    } else {
+        ocMODULE(module)->CON.clr = _OC1CON_ON_MASK; // Disable OCx
+    }
+}
+
+uint16_t OCMaxCompare(uint8_t module){
+    if (module == 0 || module > ocNUM_MODULES)
+        return 0;
+
+    if (PRx[module - 1] == 2) {
+        return PR2;
+    } else if (PRx[module - 1] == 3) {
+        return PR3;
+    } else {
+        return 0;
+    }
+}
+
+int8_t OCSetDutyCycle(uint8_t module, uint16_t dutycycle){
+    uint16_t usMax = OCMaxCompare(module);
+
+    if (usMax == 0)
+        return OC_NOT_CONFIGURED;
+
+    ocMODULE(module)->RS.reg = (uint32_t)usMax * dutycycle / ocMAX_DUTYCYCLE;
+    return OC_SUCCESS;
+}
+
+uint16_t OCDutyToCompare(uint8_t module, uint16_t dutycycle){
+    return (uint32_t)OCMaxCompare(module) * dutycycle / ocMAX_DUTYCYCLE;
+}
+
+void OCSetCompare(uint8_t module, uint16_t compare){
+    if (module == 0 || module > ocNUM_MODULES)
+        return;
+
+    ocMODULE(module)->RS.reg = compare;
+}
+
+volatile void *OCCompareRegister(uint8_t module){
+    if (module == 0 || module > ocNUM_MODULES)
+        return NULL;
+
+    return &ocMODULE(module)->RS.reg;
+}
@@ -0,0 +1,99 @@
+/*
+ * File:   oc.h
+ * Author: Diogo Vala
+ *
+ * Overview: Configure the output compare modules OC1 to OC5
+ */
+
+#ifndef OC_H
+#define OC_H
+
+#include <stdint.h>
+
+// Define return codes
+#define OC_SUCCESS 0
+#define OC_CLOCK_SOURCE_NOT_SUP -1
+#define OC_NOT_CONFIGURED -2
+#define OC_INVALID_MODULE -3
+
+#define ocSTART 1
+#define ocSTOP 0
+#define ocNUM_MODULES 5 /* OC1 (RD0) to OC5 (RD4) */
+#define ocMAX_DUTYCYCLE 254
+
+/********************************************************************
+ * Function: 	 OCConfig()
+ * Precondition: Source timer should be previously configured.
+ * Input: 		 module - 1 to ocNUM_MODULES
+ *               timer - 2 for Timer2 ; 3 for Timer3
+ * Returns:      OC_SUCCESS if configuration successful.
+ *               OC_XXX error codes in case of failure.
+ * Side Effects: OC mode is set to 6 by default or must be manually
+ *               configured.
+ * Overview:     Configures an OC module. Modules on the same timer
+ *               start their PWM periods together.
+ ********************************************************************/
+int8_t OCConfig(uint8_t module, uint8_t timer);
+
+/********************************************************************
+ * Function: 	 OCControl()
+ * Precondition: OC module should be previously configured.
+ * Input: 		 module - 1 to ocNUM_MODULES
+ *               ocrun : {1 start - 0 stop}
+ * Overview:     Starts/Stops an OC module
+ ********************************************************************/
+void OCControl(uint8_t module, uint8_t ocrun);
+
+/********************************************************************
+ * Function: 	 OCSetDutyCycle()
+ * Precondition: Timer should be previously configured
+ * Input: 		 module - 1 to ocNUM_MODULES
+ *               dutycycle {0-ocMAX_DUTYCYCLE}
+ * Returns:      OC_NOT_CONFIGURED if the module is not configured
+ *               correctly before calling this function.
+ * Overview:
+ * Note:		 The dutycycle range can be adjusted manually
+ ********************************************************************/
+int8_t OCSetDutyCycle(uint8_t module, uint16_t dutycycle);
+
+/********************************************************************
+ * Function: 	 OCDutyToCompare()
+ * Precondition: OC module and its timer should be previously configured
+ * Input: 		 module - 1 to ocNUM_MODULES
+ *               dutycycle {0-ocMAX_DUTYCYCLE}
+ * Returns:      OCxRS value for the given dutycycle, 0 if the module
+ *               is not configured.
+ * Overview:     Scales a dutycycle to the source timer period, so it
+ *               can be written to OCxRS directly (e.g. by DMA).
+ ********************************************************************/
+uint16_t OCDutyToCompare(uint8_t module, uint16_t dutycycle);
+
+/********************************************************************
+ * Function: 	 OCMaxCompare()
+ * Precondition: OC module and its timer should be previously configured
+ * Input: 		 module - 1 to ocNUM_MODULES
+ * Returns:      Period register of the source timer, the OCxRS value
+ *               for full scale. 0 if the module is not configured.
+ * Overview:     Lets a generator scale its samples to OCxRS values
+ *               once, instead of a divide per sample.
+ ********************************************************************/
+uint16_t OCMaxCompare(uint8_t module);
+
+/********************************************************************
+ * Function: 	 OCSetCompare()
+ * Precondition: OC module should be previously configured
+ * Input: 		 module - 1 to ocNUM_MODULES
+ *               compare {0-OCMaxCompare()}
+ * Overview:     Writes OCxRS, used from the next timer period.
+ ********************************************************************/
+void OCSetCompare(uint8_t module, uint16_t compare);
+
+/********************************************************************
+ * Function: 	 OCCompareRegister()
+ * Input: 		 module - 1 to ocNUM_MODULES
+ * Returns:      Address of OCxRS, NULL for an invalid module.
+ * Overview:     DMA destination for streamed compare values.
+ ********************************************************************/
+volatile void *OCCompareRegister(uint8_t module);
+
+#endif
@@ -0,0 +1,504 @@
+/*
+ * File:   playback.c
+ * Author: Diogo Vala
+ *
+ * Overview: Waveform playback, buffer swap and sequencer of mainAWG.c
+ */
+
+#include <string.h>
+#include <xc.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "playback.h"
+
+Playback_t xPlayback;
+
+static const uint8_t ucOutputDma[ocNUM_MODULES] = playbackDMA_OUTPUT_CHANNELS;
+static const uint16_t usIdleTable[playbackWAVEFORM_SIZE] = {0}; /* Outputs between bursts */
+
+/* Table streamed by output ucChannel from playback buffer ucBuffer
+ *
+ * While sequencing, output 1 plays the table of the current segment and
+ * every output rests at 0 between bursts.
+ */
+static const volatile uint16_t *prvOutputTable(uint8_t ucBuffer, uint8_t ucChannel)
+{
+    if(xPlayback.ucSequenceMode != SEQUENCE_OFF)
+    {
+        if(xPlayback.xBurstIdle)
+        {
+            return usIdleTable;
+        }
+        if(ucChannel == 0)
+        {
+            return xPlayback.xSegments[xPlayback.ucSegment].pusTable;
+        }
+    }
+    return xPlayback.usBuffers[ucBuffer][ucChannel];
+}
+
+/* Back to the first period of the first segment */
+static void prvSequenceRewind(void)
+{
+    xPlayback.ucSegment = 0;
+    xPlayback.usRepeatsLeft = xPlayback.xSegments[0].usRepeats;
+    xPlayback.ulTuningWord = xPlayback.xSegments[0].ulTuningWord;
+}
+
+/* End of one period of the sequence, called from the playback ISRs
+ *
+ * Returns true if the next period belongs to another segment. After the
+ * last segment the list starts again, or in burst mode the outputs go
+ * idle until the next trigger.
+ */
+static bool prvSequencePeriodEnd(void)
+{
+    if(--xPlayback.usRepeatsLeft > 0)
+    {
+        return false;
+    }
+    if(++xPlayback.ucSegment == xPlayback.ucNumSegments)
+    {
+        xPlayback.ucSegment = 0;
+        if(xPlayback.ucSequenceMode == SEQUENCE_BURST)
+        {
+            xPlayback.xBurstIdle = true;
+            xPlayback.ulBursts++;
+        }
+    }
+    xPlayback.usRepeatsLeft = xPlayback.xSegments[xPlayback.ucSegment].usRepeats;
+    return true;
+}
+
+/* Tuning word for a frequency in 1/playbackFREQUENCY_SCALE Hz */
+static uint32_t prvDdsTuningWord(uint32_t ulFrequency)
+{
+    return (uint32_t)(((uint64_t)ulFrequency << 32) / ((uint64_t)xPlayback.ulDdsSampleRate*playbackFREQUENCY_SCALE));
+}
+
+/* Refills half of the DDS ring, starting at usFirst
+ *
+ * The top of the phase accumulator indexes the active playback buffer.
+ * Every output reads the same index, so they stay phase locked.
+ * A pending buffer is swapped in when the accumulator wraps, which is
+ * the start of a new period, so table changes are sample accurate.
+ * The sequencer moves to its next segment on the same wrap, by changing
+ * the table pointer and the tuning word.
+ * Called from the DMA0 ISR, or before the DMA is started.
+ */
+static void prvDdsFill(uint16_t usFirst)
+{
+    const volatile uint16_t *pusTables[playbackNUM_CHANNELS];
+    uint16_t usSample;
+    uint16_t usIndex;
+    uint8_t ucChannel;
+    uint32_t ulPhase = xPlayback.ulPhaseAccumulator;
+    uint32_t ulStep = xPlayback.ulTuningWord;
+    uint8_t ucBuffer = xPlayback.ucActiveBuffer;
+
+    for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+    {
+        pusTables[ucChannel] = prvOutputTable(ucBuffer, ucChannel);
+    }
+
+    for(usSample = usFirst; usSample < usFirst + playbackDDS_RING_SIZE/2; usSample++)
+    {
+        usIndex = (uint16_t)(((uint64_t)ulPhase*playbackWAVEFORM_SIZE) >> 32); /* Single MULTU */
+        for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+        {
+            xPlayback.usDdsRing[ucChannel][usSample] = pusTables[ucChannel][usIndex];
+        }
+        if(pusTables[0] == usIdleTable) /* Between bursts */
+        {
+            xPlayback.xDdsMarkerRing[usSample].ulClr = _LATE_LATE8_MASK;
+            xPlayback.xDdsMarkerRing[usSample].ulSet = 0;
+        }
+        else
+        {
+            xPlayback.xDdsMarkerRing[usSample] = xPlayback.xMarker[ucBuffer][usIndex];
+        }
+
+        ulPhase += ulStep;
+        if(ulPhase < ulStep) /* Wrapped */
+        {
+            if(xPlayback.ucSequenceMode != SEQUENCE_OFF && !xPlayback.xBurstIdle && prvSequencePeriodEnd())
+            {
+                ulStep = xPlayback.xSegments[xPlayback.ucSegment].ulTuningWord;
+            }
+            if(xPlayback.ucSwapPending)
+            {
+                ucBuffer = !ucBuffer;
+                xPlayback.ucSwapPending = false;
+            }
+            for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+            {
+                pusTables[ucChannel] = prvOutputTable(ucBuffer, ucChannel);
+            }
+        }
+    }
+
+    xPlayback.ulPhaseAccumulator = ulPhase;
+    xPlayback.ulTuningWord = ulStep;
+    xPlayback.ucActiveBuffer = ucBuffer;
+}
+
+/* Builds the marker table of buffer ucBuffer
+ *
+ * External marker is set to 1 at usStart and set back to 0 after
+ * playbackMARKER_WIDTH samples, or at the end of the period.
+ * The outputs are shifted by their phase from it.
+ * Only RE8 is written, so the rest of PORTE is left untouched by the DMA.
+ */
+static void prvBuildMarker(uint8_t ucBuffer, uint16_t usStart)
+{
+    uint16_t usIterator;
+
+    for(usIterator = 0; usIterator < playbackWAVEFORM_SIZE; usIterator++)
+    {
+        if((usIterator >= usStart) && (usIterator <= (usStart+playbackMARKER_WIDTH)))
+        {
+            xPlayback.xMarker[ucBuffer][usIterator].ulClr = 0;
+            xPlayback.xMarker[ucBuffer][usIterator].ulSet = _LATE_LATE8_MASK;
+        }
+        else
+        {
+            xPlayback.xMarker[ucBuffer][usIterator].ulClr = _LATE_LATE8_MASK;
+            xPlayback.xMarker[ucBuffer][usIterator].ulSet = 0;
+        }
+    }
+}
+
+int8_t PlaybackInit(uint8_t ucMode, uint32_t ulDdsSampleRate)
+{
+    uint8_t ucChannel;
+    uint8_t ucDma;
+    uint8_t ucPriority;
+    uint8_t ucBuffer;
+    int8_t cResult = DMA_SUCCESS;
+
+    memset(&xPlayback, 0, sizeof(xPlayback));
+    xPlayback.ucMode = ucMode;
+    xPlayback.ulDdsSampleRate = ulDdsSampleRate;
+
+    /* Timer 3 triggers one OCxRS write per output and one LATECLR/LATESET
+     * write per sample. Output 1 has the lowest priority, so every block is
+     * done when its channel interrupts at the end of the period. */
+    if(Timer3Config(0) != 0)
+    {
+        return PLAYBACK_TIMER_ERROR;
+    }
+    DMAControl(dmaSTART);
+    for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+    {
+        ucDma = ucOutputDma[ucChannel];
+        ucPriority = (ucChannel == 0) ? playbackDMA_WAVE_PRIORITY : playbackDMA_WAVE_PRIORITY+1;
+        cResult |= DMAChannelConfig(ucDma, ucPriority, _TIMER_3_IRQ, 1);
+        if(ucMode == playbackMODE_DDS)
+        {
+            cResult |= DMAChannelSetTransfer(ucDma, xPlayback.usDdsRing[ucChannel], sizeof(xPlayback.usDdsRing[0]),
+                    OCCompareRegister(ucChannel+1), sizeof(xPlayback.usDdsRing[0][0]), sizeof(xPlayback.usDdsRing[0][0]));
+        }
+        else
+        {
+            cResult |= DMAChannelSetTransfer(ucDma, xPlayback.usBuffers[0][ucChannel], sizeof(xPlayback.usBuffers[0][0]),
+                    OCCompareRegister(ucChannel+1), sizeof(xPlayback.usBuffers[0][0][0]), sizeof(xPlayback.usBuffers[0][0][0]));
+        }
+    }
+
+    for(ucBuffer = 0; ucBuffer < playbackNUM_BUFFERS; ucBuffer++)
+    {
+        prvBuildMarker(ucBuffer, 0); /* Start of every period, the outputs are shifted from it by their phase */
+    }
+    cResult |= DMAChannelConfig(playbackDMA_MARKER_CHANNEL, 3, _TIMER_3_IRQ, 1);
+    if(ucMode == playbackMODE_DDS)
+    {
+        cResult |= DMAChannelSetTransfer(playbackDMA_MARKER_CHANNEL, xPlayback.xDdsMarkerRing, sizeof(xPlayback.xDdsMarkerRing),
+                &LATECLR, sizeof(PlaybackMarker_t), sizeof(PlaybackMarker_t));
+        DMAChannelInterruptConfig(playbackDMA_WAVE_CHANNEL, dmaEVT_SRC_HALF | dmaEVT_BLOCK_DONE);
+    }
+    else
+    {
+        cResult |= DMAChannelSetTransfer(playbackDMA_MARKER_CHANNEL, xPlayback.xMarker[0], sizeof(xPlayback.xMarker[0]),
+                &LATECLR, sizeof(PlaybackMarker_t), sizeof(PlaybackMarker_t));
+        DMAChannelInterruptConfig(playbackDMA_WAVE_CHANNEL, dmaEVT_BLOCK_DONE);
+    }
+    return (cResult == DMA_SUCCESS) ? PLAYBACK_SUCCESS : PLAYBACK_DMA_ERROR;
+}
+
+void PlaybackStop(void)
+{
+    uint8_t ucChannel;
+
+    Timer3Stop();
+    xPlayback.ucRunning = false;
+    for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+    {
+        DMAChannelAbort(ucOutputDma[ucChannel]);
+        OCSetCompare(ucChannel+1, 0);
+    }
+    DMAChannelAbort(playbackDMA_MARKER_CHANNEL);
+    LATECLR = _LATE_LATE8_MASK;
+}
+
+void PlaybackStart(uint8_t ucBuffer, const Timer3Period_t *pxPeriod)
+{
+    uint8_t ucChannel;
+
+    xPlayback.ucActiveBuffer = ucBuffer;
+    xPlayback.xActivePeriod = *pxPeriod;
+    if(xPlayback.ucMode == playbackMODE_DDS)
+    {
+        xPlayback.ulPhaseAccumulator = 0;
+        prvDdsFill(0);
+        prvDdsFill(playbackDDS_RING_SIZE/2);
+    }
+    else
+    {
+        for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+        {
+            DMAChannelSetSource(ucOutputDma[ucChannel], prvOutputTable(ucBuffer, ucChannel));
+        }
+        DMAChannelSetSource(playbackDMA_MARKER_CHANNEL, xPlayback.xMarker[ucBuffer]);
+    }
+    Timer3SetPeriod(pxPeriod);
+
+    for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+    {
+        DMAChannelControl(ucOutputDma[ucChannel], dmaSTART);
+    }
+    DMAChannelControl(playbackDMA_MARKER_CHANNEL, dmaSTART);
+    xPlayback.ucRunning = true;
+    Timer3Start();
+}
+
+int8_t PlaybackSetFrequency(uint32_t ulFrequency, Timer3Period_t *pxPeriod)
+{
+    uint32_t ulSampleRate;
+
+    if(xPlayback.ucMode == playbackMODE_DDS)
+    {
+        ulSampleRate = xPlayback.ulDdsSampleRate;
+    }
+    else
+    {
+        ulSampleRate = playbackWAVEFORM_SIZE*ulFrequency/playbackFREQUENCY_SCALE;
+    }
+    if(Timer3CalcPeriod(ulSampleRate, pxPeriod) != 0)
+    {
+        return PLAYBACK_INVALID_FREQUENCY;
+    }
+    if(xPlayback.ucMode == playbackMODE_DDS)
+    {
+        xPlayback.ulTuningWord = prvDdsTuningWord(ulFrequency); /* Phase continuous, used from the next ring refill */
+    }
+    return PLAYBACK_SUCCESS;
+}
+
+uint8_t PlaybackWriteBegin(void)
+{
+    uint8_t ucBuffer;
+
+    /* A pending buffer must not be swapped in while it is rewritten */
+    taskENTER_CRITICAL();
+    xPlayback.ucSwapPending = false;
+    ucBuffer = !xPlayback.ucActiveBuffer;
+    taskEXIT_CRITICAL();
+    return ucBuffer;
+}
+
+void PlaybackWriteEnd(uint8_t ucBuffer, const Timer3Period_t *pxPeriod)
+{
+    if(xPlayback.ucSequenceMode != SEQUENCE_OFF)
+    {
+        taskENTER_CRITICAL();
+        xPlayback.ucSwapPending = true; /* Outputs 2 to n, at the end of the current period */
+        taskEXIT_CRITICAL();
+    }
+    else if(xPlayback.ucRunning)
+    {
+        taskENTER_CRITICAL();
+        xPlayback.xPendingPeriod = *pxPeriod;
+        xPlayback.ucSwapPending = true; /* Applied at the end of the current period */
+        taskEXIT_CRITICAL();
+    }
+    else
+    {
+        PlaybackStart(ucBuffer, pxPeriod);
+    }
+}
+
+int8_t PlaybackSequenceAdd(const volatile uint16_t *pusTable, uint16_t usRepeats, uint32_t ulFrequency, uint8_t ucWaveform)
+{
+    PlaybackSegment_t *pxSegment;
+    uint32_t ulSampleRate;
+
+    if(xPlayback.ucNumSegments == playbackMAX_SEGMENTS)
+    {
+        return PLAYBACK_SEQUENCE_FULL;
+    }
+    pxSegment = &xPlayback.xSegments[xPlayback.ucNumSegments];
+    if(xPlayback.ucMode == playbackMODE_DDS)
+    {
+        pxSegment->ulTuningWord = prvDdsTuningWord(ulFrequency);
+        ulSampleRate = xPlayback.ulDdsSampleRate;
+    }
+    else
+    {
+        ulSampleRate = playbackWAVEFORM_SIZE*ulFrequency/playbackFREQUENCY_SCALE;
+    }
+    if(Timer3CalcPeriod(ulSampleRate, &pxSegment->xPeriod) != 0)
+    {
+        return PLAYBACK_INVALID_FREQUENCY;
+    }
+    pxSegment->pusTable = pusTable;
+    pxSegment->usRepeats = usRepeats;
+    pxSegment->ulFrequency = ulFrequency;
+    pxSegment->ucWaveform = ucWaveform;
+    xPlayback.ucNumSegments++;
+    return PLAYBACK_SUCCESS;
+}
+
+void PlaybackSequenceClear(void)
+{
+    xPlayback.ucNumSegments = 0;
+}
+
+void PlaybackSequenceStart(uint8_t ucMode)
+{
+    IEC0bits.INT2IE = 0;
+    PlaybackStop();
+
+    taskENTER_CRITICAL();
+    xPlayback.ucSequenceMode = ucMode;
+    prvSequenceRewind();
+    xPlayback.xBurstIdle = (ucMode == SEQUENCE_BURST);
+    xPlayback.ulBursts = 0;
+    taskEXIT_CRITICAL();
+
+    if(ucMode == SEQUENCE_LOOP)
+    {
+        PlaybackStart(xPlayback.ucActiveBuffer, &xPlayback.xSegments[0].xPeriod);
+    }
+    else /* Outputs stay at 0 until the first trigger */
+    {
+        IFS0bits.INT2IF = 0;
+        IEC0bits.INT2IE = 1;
+    }
+}
+
+void PlaybackSequenceHalt(void)
+{
+    IEC0bits.INT2IE = 0;
+    PlaybackStop();
+    taskENTER_CRITICAL();
+    xPlayback.ucSequenceMode = SEQUENCE_OFF;
+    xPlayback.xBurstIdle = false;
+    taskEXIT_CRITICAL();
+}
+
+/* DMA0 ISR
+ *
+ * Table playback: runs once per period of the output signal, when the
+ * waveform channel has streamed the whole playback buffer.
+ * If the generator has a new buffer ready, every DMA channel is pointed
+ * to it and Timer 3 is loaded with its sample rate. The first sample of
+ * the new buffer is transferred on the next Timer 3 trigger, so the ISR
+ * must re-point the DMA sources (DCHxSSA) within one sample period of
+ * the block end: held off longer, that trigger streams sample 0 of the
+ * old buffer and the period tears. At the highest sample rate, the PWM
+ * frequency, that is 2^mainAwgPWM_BITS PBCLK cycles, so higher priority
+ * ISRs and critical sections must stay shorter. Tests/waveform_test.c
+ * checks both sides.
+ * While sequencing, output 1 is pointed to the table of the next segment
+ * and Timer 3 is loaded with the segment's sample rate instead. PR3 is
+ * not double buffered, so the last sample of a segment is held for the
+ * sample period of the next one. When a burst ends every output streams
+ * usIdleTable until the next trigger.
+ *
+ * DDS playback: runs every playbackDDS_RING_SIZE/2 samples and refills the
+ * half of the ring that the DMA has just streamed.
+*/
+void PlaybackDmaIsr(void)
+{
+    uint8_t ucEvents = DMAChannelReadEvents(playbackDMA_WAVE_CHANNEL);
+    uint8_t ucChannel;
+    bool xNewSegment = false;
+    bool xNewSource = false; /* Tables of the next period changed */
+    const Timer3Period_t *pxPeriod = NULL; /* Sample rate of the next period, if it changes */
+
+    if(xPlayback.ucMode == playbackMODE_DDS)
+    {
+        if(ucEvents & dmaEVT_SRC_HALF)
+        {
+            prvDdsFill(0);
+        }
+        if(ucEvents & dmaEVT_BLOCK_DONE)
+        {
+            prvDdsFill(playbackDDS_RING_SIZE/2);
+        }
+    }
+    else if(ucEvents & dmaEVT_BLOCK_DONE)
+    {
+        if(xPlayback.ucSequenceMode != SEQUENCE_OFF && !xPlayback.xBurstIdle)
+        {
+            xNewSegment = prvSequencePeriodEnd();
+            if(xNewSegment)
+            {
+                xNewSource = true;
+                pxPeriod = &xPlayback.xSegments[xPlayback.ucSegment].xPeriod;
+            }
+        }
+        if(xPlayback.ucSwapPending)
+        {
+            xPlayback.ucActiveBuffer = !xPlayback.ucActiveBuffer;
+            xPlayback.ucSwapPending = false;
+            xNewSource = true;
+            if(xPlayback.ucSequenceMode == SEQUENCE_OFF)
+            {
+                pxPeriod = &xPlayback.xPendingPeriod;
+            }
+        }
+
+        if(xNewSource)
+        {
+            for(ucChannel = 0; ucChannel < playbackNUM_CHANNELS; ucChannel++)
+            {
+                DMAChannelSetSource(ucOutputDma[ucChannel], prvOutputTable(xPlayback.ucActiveBuffer, ucChannel));
+            }
+            DMAChannelSetSource(playbackDMA_MARKER_CHANNEL, xPlayback.xMarker[xPlayback.ucActiveBuffer]);
+        }
+        if(xNewSegment && xPlayback.xBurstIdle) /* End of the burst, marker stays low */
+        {
+            DMAChannelAbort(playbackDMA_MARKER_CHANNEL);
+            LATECLR = _LATE_LATE8_MASK;
+        }
+
+        /* Only reload the timer on a frequency change, TMR3 is reset */
+        if(pxPeriod != NULL && (pxPeriod->pr != xPlayback.xActivePeriod.pr || pxPeriod->tckps != xPlayback.xActivePeriod.tckps))
+        {
+            Timer3SetPeriod(pxPeriod);
+            xPlayback.xActivePeriod = *pxPeriod;
+        }
+    }
+
+    IFS1bits.DMA0IF = 0; /* Clear the DMA0 interrupt flag */
+}
+
+/* INT2 ISR
+ *
+ * Burst trigger. Playback is restarted from the first segment, so the
+ * first sample always comes one Timer 3 period after the edge.
+ * Same priority as DMA0, so the playback state is never changed under it.
+*/
+void PlaybackTriggerIsr(void)
+{
+    if(xPlayback.ucSequenceMode == SEQUENCE_BURST && xPlayback.xBurstIdle)
+    {
+        PlaybackStop();
+        prvSequenceRewind();
+        xPlayback.xBurstIdle = false;
+        PlaybackStart(xPlayback.ucActiveBuffer, &xPlayback.xSegments[0].xPeriod);
+    }
+
+    IFS0bits.INT2IF = 0; /* Clear the INT2 interrupt flag */
+}
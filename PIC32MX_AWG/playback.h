@@ -0,0 +1,227 @@
+/*
+ * File:   playback.h
+ * Author: Diogo Vala
+ *
+ * Overview: Waveform playback of mainAWG.c. Timer 3 triggers one DMA
+ *           cell per output into OCxRS and one into LATECLR/LATESET
+ *           for the marker on RE8, streamed from the playback buffers
+ *           (table mode) or from rings refilled by a phase accumulator
+ *           (DDS mode). Holds the buffer swap and sequencer state that
+ *           the tasks share with the DMA0 and INT2 ISRs, whose bodies
+ *           are PlaybackDmaIsr() and PlaybackTriggerIsr(). Built by the
+ *           firmware and by Tests/waveform_test.c.
+ */
+
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer3.h"
+#include "oc.h"
+#include "dma.h"
+#include "waveform.h"
+
+// Define return codes
+#define PLAYBACK_SUCCESS 0
+#define PLAYBACK_TIMER_ERROR -1
+#define PLAYBACK_DMA_ERROR -2
+#define PLAYBACK_INVALID_FREQUENCY -3
+#define PLAYBACK_SEQUENCE_FULL -4
+
+#define playbackMODE_TABLE 0 /* Timer 3 at playbackWAVEFORM_SIZE*frequency */
+#define playbackMODE_DDS 1 /* Fixed sample rate with phase accumulator */
+
+/* Outputs, OC1 (RD0) to OCn (RDn-1). They share the frequency and the sample clock */
+#ifndef playbackNUM_CHANNELS
+#define playbackNUM_CHANNELS 2 /* 1 - ocNUM_MODULES */
+#endif
+#if playbackNUM_CHANNELS < 1 || playbackNUM_CHANNELS > ocNUM_MODULES
+#error "playbackNUM_CHANNELS must be 1 to ocNUM_MODULES"
+#endif
+
+#define playbackWAVEFORM_SIZE waveformSIZE /* Samples per period of the output signal */
+#define playbackMARKER_WIDTH (playbackWAVEFORM_SIZE/20) /* Samples that the marker stays high */
+#define playbackNUM_BUFFERS 2 /* One is played while the other is written */
+
+/* DMA channels, every one triggered by Timer 3 */
+#define playbackDMA_WAVE_CHANNEL 0 /* Streams output 1 into OC1RS, its ISR swaps the buffers of every output */
+#define playbackDMA_MARKER_CHANNEL 1 /* Streams the marker (or the DDS marker ring) into LATECLR/LATESET */
+#define playbackDMA_OUTPUT_CHANNELS {playbackDMA_WAVE_CHANNEL, 3, 4, 5, 6} /* DMA channel of each output, 2 is left to the UART */
+#define playbackDMA_WAVE_PRIORITY 1 /* Output 1, one below the other outputs and two below the marker, so its block ends last */
+#define playbackDMA_LAST_CHANNEL (playbackNUM_CHANNELS > 1 ? playbackNUM_CHANNELS + 1 : playbackDMA_MARKER_CHANNEL) /* Highest channel in use */
+#define playbackDMA_MARKER_BYTES 8 /* sizeof(PlaybackMarker_t), LATECLR and LATESET */
+
+#define playbackDDS_RING_SIZE 128 /* Samples streamed by DMA, refilled half at a time */
+#define playbackFREQUENCY_SCALE 100 /* Frequencies are in 1/playbackFREQUENCY_SCALE Hz */
+
+#define playbackMAX_SEGMENTS 16
+
+/* The table mode marker is the largest DMA block */
+#if playbackDMA_LAST_CHANNEL >= dmaNUM_CHANNELS || playbackWAVEFORM_SIZE*playbackDMA_MARKER_BYTES > dmaMAX_TRANSFER_SIZE
+#error "The DMA controller of this device is too small for the playback, build for a PIC32MX5xx/6xx/7xx"
+#endif
+
+/* External marker sample, one DMA cell writes LATECLR and then LATESET */
+typedef struct {
+    uint32_t ulClr;
+    uint32_t ulSet;
+} PlaybackMarker_t;
+
+/* One step of the sequence, resolved when it is added so the DMA0 ISR
+ * only swaps pointers and timer values */
+typedef struct {
+    const volatile uint16_t *pusTable; /* Output 1 table */
+    uint16_t usRepeats; /* Periods played, at least 1 */
+    uint32_t ulFrequency; /* In 1/playbackFREQUENCY_SCALE Hz */
+    Timer3Period_t xPeriod; /* Sample rate */
+    uint32_t ulTuningWord; /* DDS mode */
+    uint8_t ucWaveform; /* Library slot, for the listing */
+} PlaybackSegment_t;
+
+/* Sequencer modes */
+enum SequenceMode_t{
+    SEQUENCE_OFF, /* Outputs play the playback buffers */
+    SEQUENCE_LOOP, /* Segment list played over and over */
+    SEQUENCE_BURST /* Segment list played once on each trigger */
+};
+
+/* State of the playback */
+typedef struct {
+    volatile uint16_t usBuffers[playbackNUM_BUFFERS][playbackNUM_CHANNELS][playbackWAVEFORM_SIZE]; /* OCxRS values, see PlaybackWriteBegin() */
+    volatile PlaybackMarker_t xMarker[playbackNUM_BUFFERS][playbackWAVEFORM_SIZE]; /* RE8 state of each sample */
+    volatile uint16_t usDdsRing[playbackNUM_CHANNELS][playbackDDS_RING_SIZE]; /* Refilled from the active buffer by the DMA0 ISR */
+    volatile PlaybackMarker_t xDdsMarkerRing[playbackDDS_RING_SIZE];
+    uint8_t ucMode; /* playbackMODE_XXX */
+    uint32_t ulDdsSampleRate;
+
+    /* Buffer swap */
+    volatile uint8_t ucActiveBuffer; /* Buffer being streamed */
+    volatile bool ucSwapPending; /* The other buffer is ready, swap at the end of the period */
+    volatile bool ucRunning;
+    Timer3Period_t xActivePeriod; /* Sample rate of the active buffer */
+    Timer3Period_t xPendingPeriod; /* Sample rate of the buffer to be swapped in */
+    uint32_t ulPhaseAccumulator; /* Position in the period, 2^32 is one period */
+    volatile uint32_t ulTuningWord; /* Phase increment per sample, frequency = ulTuningWord*ulDdsSampleRate/2^32 */
+
+    /* Sequencer */
+    PlaybackSegment_t xSegments[playbackMAX_SEGMENTS];
+    uint8_t ucNumSegments;
+    volatile uint8_t ucSequenceMode; /* SequenceMode_t */
+    volatile uint8_t ucSegment; /* Segment being played */
+    volatile uint16_t usRepeatsLeft; /* Periods of ucSegment still to play, this one included */
+    volatile bool xBurstIdle; /* Burst mode, waiting for the trigger */
+    volatile uint32_t ulBursts; /* Bursts played since the sequencer started */
+} Playback_t;
+
+extern Playback_t xPlayback;
+
+/********************************************************************
+ * Function: 	 PlaybackInit()
+ * Precondition: OC1 to OCn configured in PWM mode
+ * Input: 		 ucMode - playbackMODE_TABLE or playbackMODE_DDS
+ *               ulDdsSampleRate - DDS mode sample rate, in Hz
+ * Returns:      PLAYBACK_SUCCESS if configuration successful.
+ *               PLAYBACK_XXX error codes in case of failure.
+ * Overview:     Resets the state, configures Timer 3 and the DMA
+ *               channels and builds the markers. The DMA0 interrupt
+ *               priority and enable are left to the caller.
+ ********************************************************************/
+int8_t PlaybackInit(uint8_t ucMode, uint32_t ulDdsSampleRate);
+
+/********************************************************************
+ * Function: 	 PlaybackStop()
+ * Overview:     Stops the outputs at 0 and rewinds every DMA channel
+ *               to the first sample.
+ ********************************************************************/
+void PlaybackStop(void);
+
+/********************************************************************
+ * Function: 	 PlaybackStart()
+ * Precondition: PlaybackStop() called, or never started
+ * Input: 		 ucBuffer - Playback buffer to stream
+ *               pxPeriod - Sample rate, see PlaybackSetFrequency()
+ * Overview:     Starts streaming on every Timer 3 period.
+ ********************************************************************/
+void PlaybackStart(uint8_t ucBuffer, const Timer3Period_t *pxPeriod);
+
+/********************************************************************
+ * Function: 	 PlaybackSetFrequency()
+ * Input: 		 ulFrequency - In 1/playbackFREQUENCY_SCALE Hz
+ *               pxPeriod - Sample rate for it
+ * Returns:      PLAYBACK_SUCCESS, or PLAYBACK_INVALID_FREQUENCY if
+ *               Timer 3 cannot run at the sample rate.
+ * Overview:     In DDS mode the tuning word is changed at once, the
+ *               output moves to the new frequency on the next ring
+ *               refill without a phase jump.
+ ********************************************************************/
+int8_t PlaybackSetFrequency(uint32_t ulFrequency, Timer3Period_t *pxPeriod);
+
+/********************************************************************
+ * Function: 	 PlaybackWriteBegin()
+ * Returns:      Buffer that is not being streamed.
+ * Overview:     Cancels a pending swap, so the buffer is not swapped
+ *               in while it is rewritten.
+ ********************************************************************/
+uint8_t PlaybackWriteBegin(void);
+
+/********************************************************************
+ * Function: 	 PlaybackWriteEnd()
+ * Precondition: PlaybackWriteBegin() called
+ * Input: 		 ucBuffer - Buffer returned by PlaybackWriteBegin()
+ *               pxPeriod - Its sample rate, ignored while sequencing
+ * Overview:     Swaps the buffer in at the end of the current period,
+ *               for every output, or starts the playback with it.
+ *               While sequencing only outputs 2 to n play it.
+ ********************************************************************/
+void PlaybackWriteEnd(uint8_t ucBuffer, const Timer3Period_t *pxPeriod);
+
+/********************************************************************
+ * Function: 	 PlaybackSequenceAdd()
+ * Precondition: Sequencer halted
+ * Input: 		 pusTable - Output 1 table, must stay valid
+ *               usRepeats - Periods to play it, at least 1
+ *               ulFrequency - In 1/playbackFREQUENCY_SCALE Hz
+ *               ucWaveform - Library slot of the table
+ * Returns:      PLAYBACK_SUCCESS if the segment was added.
+ *               PLAYBACK_XXX error codes in case of failure.
+ ********************************************************************/
+int8_t PlaybackSequenceAdd(const volatile uint16_t *pusTable, uint16_t usRepeats, uint32_t ulFrequency, uint8_t ucWaveform);
+
+/********************************************************************
+ * Function: 	 PlaybackSequenceClear()
+ * Precondition: Sequencer halted
+ * Overview:     Empties the segment list.
+ ********************************************************************/
+void PlaybackSequenceClear(void);
+
+/********************************************************************
+ * Function: 	 PlaybackSequenceStart()
+ * Precondition: At least one segment
+ * Input: 		 ucMode - SEQUENCE_LOOP or SEQUENCE_BURST
+ * Overview:     Plays the segment list over and over, or once on each
+ *               rising edge of INT2. In burst mode the outputs stay at
+ *               0 until the first trigger.
+ ********************************************************************/
+void PlaybackSequenceStart(uint8_t ucMode);
+
+/********************************************************************
+ * Function: 	 PlaybackSequenceHalt()
+ * Overview:     Stops the outputs and goes back to SEQUENCE_OFF. The
+ *               next PlaybackWriteEnd() starts them again.
+ ********************************************************************/
+void PlaybackSequenceHalt(void);
+
+/********************************************************************
+ * Function: 	 PlaybackDmaIsr()
+ * Overview:     Body of the DMA0 ISR, clears DMA0IF.
+ ********************************************************************/
+void PlaybackDmaIsr(void);
+
+/********************************************************************
+ * Function: 	 PlaybackTriggerIsr()
+ * Overview:     Body of the INT2 ISR, clears INT2IF.
+ ********************************************************************/
+void PlaybackTriggerIsr(void);
+
+#endif
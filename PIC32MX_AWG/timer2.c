@@ -9,6 +9,7 @@
 #include <xc.h>
 #include <sys/attribs.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define PBCLOCK 40000000L
 #define TIMER2_FREQUENCY_NOT_SUP -1
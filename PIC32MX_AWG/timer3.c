@@ -16,38 +16,52 @@
 
 static void (*fp)(void);
 
-int8_t Timer3Config(uint32_t frequency){
+int8_t Timer3CalcPeriod(uint32_t frequency, Timer3Period_t *pxPeriod){
         
     static const uint16_t prescaler[] = {1, 2, 4, 8, 16, 32, 64, 256};
     static const uint8_t prescaler_size = sizeof prescaler;
-	
-    T3CONbits.TON = 0; // Stop timer
-    IFS0bits.T3IF = 0; // Reset interrupt flag
-    IPC3bits.T3IP = 4; // Interrupt Priority. Make sure it matches IPLx in ISR
-    IEC0bits.T3IE = 0; // Enable T2 interrupts
     
     uint8_t i = 0;
     uint32_t pr3 = 0;
-    if(frequency!=0){
-        while( i < prescaler_size ) {
-
-            pr3 = (PBCLOCK/(frequency*prescaler[i]))-1;
+    
+    if(frequency == 0)
+        return TIMER3_FREQUENCY_NOT_SUP;
+    
+    while( i < prescaler_size ) {
 
-            if( pr3 <= UINT16_MAX ) {
-                PR3 = pr3;
-                T3CONbits.TCKPS = i;// prescaler = 2^(n bits)
-                TMR3 = 0;
-                break;
-            }
-            i++;
+        pr3 = (PBCLOCK/(frequency*prescaler[i]))-1;
 
-            if (i == prescaler_size)
-                return TIMER3_FREQUENCY_NOT_SUP;
+        if( pr3 <= UINT16_MAX ) {
+            pxPeriod->pr = pr3;
+            pxPeriod->tckps = i;// prescaler = 2^(n bits)
+            return 0;
         }
+        i++;
     }
-    else
-    {
-        T3CONbits.TON = 0;
+    return TIMER3_FREQUENCY_NOT_SUP;
+}
+
+
+void Timer3SetPeriod(const Timer3Period_t *pxPeriod){
+    PR3 = pxPeriod->pr;
+    T3CONbits.TCKPS = pxPeriod->tckps;
+    TMR3 = 0;
+}
+
+
+int8_t Timer3Config(uint32_t frequency){
+    
+    Timer3Period_t xPeriod;
+	
+    T3CONbits.TON = 0; // Stop timer
+    IFS0bits.T3IF = 0; // Reset interrupt flag
+    IPC3bits.T3IP = 4; // Interrupt Priority. Make sure it matches IPLx in ISR
+    IEC0bits.T3IE = 0; // Enable T2 interrupts
+    
+    if(frequency!=0){
+        if(Timer3CalcPeriod(frequency, &xPeriod) != 0)
+            return TIMER3_FREQUENCY_NOT_SUP;
+        Timer3SetPeriod(&xPeriod);
     }
 	return 0;
 }
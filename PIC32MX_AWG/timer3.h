@@ -10,6 +10,12 @@
 
 #include <stdint.h>
 
+/* Timer 3 period registers for a given frequency */
+typedef struct {
+    uint16_t pr; /* PR3 value */
+    uint8_t tckps; /* T3CON.TCKPS prescaler selection */
+} Timer3Period_t;
+
 /** \brief Function to configure the timer 
 * @param [in] frequency The desired frequency (in Hz)
 * @return Error code (-1 if failed, 0 success)
@@ -17,6 +23,22 @@
 int8_t Timer3Config(uint32_t frequency);
 
 
+/** \brief Function to calculate the period registers for a frequency,
+* without touching the timer
+* @param [in] frequency The desired frequency (in Hz)
+* @param [out] pxPeriod PR3 and prescaler for the frequency
+* @return Error code (-1 if failed, 0 success)
+*/
+int8_t Timer3CalcPeriod(uint32_t frequency, Timer3Period_t *pxPeriod);
+
+
+/** \brief Function to load a period calculated by Timer3CalcPeriod().
+* Can be called while the timer runs (e.g. from an ISR)
+* @param [in] pxPeriod PR3 and prescaler to load
+*/
+void Timer3SetPeriod(const Timer3Period_t *pxPeriod);
+
+
 /** \brief Function to define the callback function to be used
 * @param [in] (*function)(void) Pointer to the desired function
 */
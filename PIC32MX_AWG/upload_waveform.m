@@ -0,0 +1,63 @@
+function upload_waveform(port, samples)
+% Uploads an arbitrary waveform to the AWG
+%
+% port    - open serial object (115200 8N1)
+% samples - vector of duty cycle samples, 0-255, up to 4096 of them
+%
+% Frames: 0xA5 | type | seq | len (2) | payload | CRC16 (2), little endian.
+% Each frame waits for ACK (0x06, seq) and is sent again on NAK or timeout.
+
+samples = uint8(samples(:)');
+chunk = 256;
+retries = 5;
+
+% The command is the line "l", answered by its echo and XON (0x11) once
+% the AWG takes frames
+fwrite(port, uint8(['l' 13]));
+byte = 0;
+while byte ~= 17
+    byte = fread(port, 1, 'uint8');
+    if isempty(byte)
+        error('upload_waveform: AWG not ready for the upload');
+    end
+end
+
+seq = 0;
+send_frame(port, 'S', seq, typecast(uint16(numel(samples)), 'uint8'), retries);
+for first = 1:chunk:numel(samples)
+    seq = mod(seq + 1, 256);
+    last = min(first + chunk - 1, numel(samples));
+    send_frame(port, 'D', seq, samples(first:last), retries);
+end
+seq = mod(seq + 1, 256);
+send_frame(port, 'E', seq, uint8([]), retries);
+end
+
+function send_frame(port, type, seq, payload, retries)
+body = [uint8(type), uint8(seq), typecast(uint16(numel(payload)), 'uint8'), payload];
+frame = [uint8(165), body, typecast(crc16(body), 'uint8')];
+
+for attempt = 1:retries
+    fwrite(port, frame, 'uint8');
+    reply = fread(port, 2, 'uint8');
+    if numel(reply) == 2 && reply(1) == 6 && reply(2) == seq
+        return;
+    end
+end
+error('upload_waveform: frame %d (%c) not acknowledged', seq, type);
+end
+
+function crc = crc16(data)
+% CRC-16/CCITT, polynomial 0x1021, initial value 0xFFFF
+crc = uint16(65535);
+for byte = data
+    crc = bitxor(crc, bitshift(uint16(byte), 8));
+    for bit = 1:8
+        if bitand(crc, 32768)
+            crc = bitxor(bitshift(crc, 1), uint16(4129));
+        else
+            crc = bitshift(crc, 1);
+        end
+    end
+end
+end
@@ -0,0 +1,112 @@
+/* 
+ * File:   waveform.c
+ * Author: Diogo Vala
+ *
+ * Overview: Integer waveform sample generation. No floating point, the
+ *           PIC32MX has no FPU.
+ */
+
+#include <stdbool.h>
+#include "waveform.h"
+
+#define waveformQUARTER (waveformSIZE/4)
+
+/* Half amplitude sine quarter wave, sin(2*pi*k/waveformSIZE)/2 in Q28 (k = 0..waveformQUARTER)
+ * 
+ * Entry 0 is 1 instead of 0: sin(M_PI) evaluates slightly above 0 in double
+ * precision, and the reference samples round that up.
+ */
+static const uint32_t ulSineQuarter[waveformQUARTER+1] = {
+    1, 2108200, 4215881, 6322521, 8427601, 10530602,
+    12631004, 14728290, 16821942, 18911443, 20996278, 23075933,
+    25149894, 27217650, 29278690, 31332506, 33378592, 35416441,
+    37445552, 39465424, 41475559, 43475460, 45464634, 47442590,
+    49408841, 51362901, 53304288, 55232522, 57147129, 59047636,
+    60933573, 62804477, 64659884, 66499337, 68322382, 70128570,
+    71917455, 73688595, 75441554, 77175899, 78891201, 80587038,
+    82262992, 83918649, 85553600, 87167442, 88759776, 90330210,
+    91878357, 93403834, 94906266, 96385280, 97840513, 99271605,
+    100678204, 102059961, 103416537, 104747596, 106052811, 107331858,
+    108584423, 109810196, 111008876, 112180165, 113323776, 114439426,
+    115526839, 116585748, 117615892, 118617015, 119588871, 120531221,
+    121443831, 122326477, 123178941, 124001012, 124792487, 125553172,
+    126282879, 126981427, 127648645, 128284367, 128888437, 129460705,
+    130001031, 130509281, 130985331, 131429061, 131840363, 132219136,
+    132565285, 132878726, 133159381, 133407181, 133622065, 133803980,
+    133952880, 134068730, 134151500, 134201170, 134217728
+};
+
+/* usMax*ulFraction, rounded down or up. ulFraction is Q28 (0 - waveformONE) */
+static inline uint16_t prvScale(uint32_t ulFraction, uint16_t usMax, bool xRoundUp)
+{
+    uint64_t ullProduct = (uint64_t)usMax*ulFraction; /* Single MULTU */
+    
+    if(xRoundUp)
+    {
+        ullProduct += waveformONE - 1;
+    }
+    return (uint16_t)(ullProduct >> waveformQ);
+}
+
+void WaveformSine(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex)
+{
+    uint16_t usIterator;
+    uint16_t usPhase; /* Table position of the sample, 1 - waveformSIZE */
+    uint16_t usOffset = usMax/2;
+    
+    for(usIterator = 0; usIterator < waveformSIZE; usIterator++)
+    {
+        pusOut[usIterator]=usOffset;
+        if(usIterator < usDutyIndex/2 || 
+           (usIterator > waveformSIZE/2 && usIterator < (waveformSIZE/2 + usDutyIndex/2)))
+        {
+            usPhase = usIterator+1;
+            if(usPhase <= waveformQUARTER)
+            {
+                pusOut[usIterator] = usOffset + prvScale(ulSineQuarter[usPhase], usMax, true);
+            }
+            else if(usPhase <= 2*waveformQUARTER)
+            {
+                pusOut[usIterator] = usOffset + prvScale(ulSineQuarter[2*waveformQUARTER-usPhase], usMax, true);
+            }
+            else if(usPhase <= 3*waveformQUARTER)
+            {
+                pusOut[usIterator] = usOffset - prvScale(ulSineQuarter[usPhase-2*waveformQUARTER], usMax, false);
+            }
+            else
+            {
+                pusOut[usIterator] = usOffset - prvScale(ulSineQuarter[waveformSIZE-usPhase], usMax, false);
+            }
+        }
+    }
+}
+
+void WaveformSquare(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex)
+{
+    uint16_t usIterator;
+    uint16_t usHigh = prvScale(waveformONE, usMax, false);
+    
+    for(usIterator = 0; usIterator < waveformSIZE; usIterator++)
+    {
+        pusOut[usIterator] = (usIterator < usDutyIndex) ? usHigh : 0;
+    }
+}
+
+void WaveformTriangle(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex)
+{
+    uint16_t usIterator;
+    
+    /* Integer ratios are already exact; a fixed point slope would need a 64 bit
+     * divide per sample to round the same way */
+    for(usIterator = 0; usIterator < waveformSIZE; usIterator++)
+    {
+        if(usIterator < usDutyIndex)
+        {
+            pusOut[usIterator]=(uint16_t)((uint32_t)usIterator*usMax/usDutyIndex);
+        }
+        else
+        {
+            pusOut[usIterator]=usMax-usMax*(usIterator-usDutyIndex)/(waveformSIZE-usDutyIndex);
+        }
+    }
+}
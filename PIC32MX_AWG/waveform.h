@@ -0,0 +1,49 @@
+/* 
+ * File:   waveform.h
+ * Author: Diogo Vala
+ *
+ * Overview: Integer waveform sample generation. Samples are OCxRS
+ *           compare values, ready to be streamed to the output compare.
+ */
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+
+#define waveformSIZE 400 /* Samples per period, the sine table is built for this size */
+#define waveformQ 28 /* Fractional bits of the scaling kernel, bit exact sine up to 12 bit peaks */
+#define waveformONE ((uint32_t)1 << waveformQ) /* 1.0 in the scaling kernel */
+
+/********************************************************************
+ * Function: 	 WaveformSine()
+ * Input: 		 pusOut - waveformSIZE samples
+ *               usMax - Peak value, the timer period for full scale
+ *               usDutyIndex - Samples of each half period that follow
+ *                         the sine, times 2. The rest stay at usMax/2.
+ * Overview:     Generates one sine period from a quarter wave table.
+ * Note:		 Bit exact with ceil(usMax/2.0*sin(2*pi*(i+1)/N)+usMax/2)
+ *               computed in double precision, for every usMax up to
+ *               4095 (12 bit PWM).
+ ********************************************************************/
+void WaveformSine(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex);
+
+/********************************************************************
+ * Function: 	 WaveformSquare()
+ * Input: 		 pusOut - waveformSIZE samples
+ *               usMax - Peak value, the timer period for full scale
+ *               usDutyIndex - Number of samples at usMax
+ * Overview:     Generates one square period.
+ ********************************************************************/
+void WaveformSquare(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex);
+
+/********************************************************************
+ * Function: 	 WaveformTriangle()
+ * Input: 		 pusOut - waveformSIZE samples
+ *               usMax - Peak value, the timer period for full scale
+ *               usDutyIndex - Sample where the rising edge ends
+ * Overview:     Generates one triangle period.
+ ********************************************************************/
+void WaveformTriangle(volatile uint16_t *pusOut, uint16_t usMax, uint16_t usDutyIndex);
+
+#endif
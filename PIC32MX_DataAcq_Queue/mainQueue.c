@@ -4,12 +4,23 @@
  * Diogo Vala 64671
  *
  *******************************************************************************
- * This program runs 3 tasks.
- * IPC is achieved using Queues.
- * Task ACQ takes samples from AN0. 
- * Task PROC takes each sample and sums them together. At 5 samples,
- * calculates average.
- * Task OUT takes the average and prints the result.
+ * This program runs a 3 stage block pipeline.
+ * IPC between stages is achieved using queues of block pointers.
+ * Stage ACQ is the ADC ISR. The ADC samples AN0 continuously, triggered by
+ * Timer 3, into blocks taken from a pool of preallocated buffers.
+ * Task PROC receives the block pointers, decimates the samples in place
+ * (CIC + compensation FIR, more bits than the ADC) and keeps running
+ * statistics of the result.
+ * Every 100 ms it attaches them to a block and passes it on.
+ * Task OUT prints the average and returns the block to the pool.
+ * The work of each stage is in Pipeline/stages.c, shared with the host test.
+ * Only block pointers move between stages. mainQueuePIPELINE_IPC selects the
+ * IPC, to compare the three mechanisms with the same pipeline.
+ * With mainQueueBENCHMARK set, task BENCH (PipelineBenchTask()) sweeps the ADC
+ * rate and prints the throughput, dropped blocks, context switches and link
+ * latencies instead.
+ * With mainQueueRUN_STATS set, the CPU time of each task and of the ADC ISR,
+ * stack and heap usage are printed every mainQueueRUN_STATS_PERIOD_MS.
  *  
  */
 
@@ -24,114 +35,136 @@
 
 /* App includes */
 #include "../UART/uart.h"
-
-/* The rate at which the data is sampled */
-#define mainQueueTASK_ACQ_PERIOD_MS 	( 100 / portTICK_RATE_MS )
+#include "../Pipeline/pipeline.h"
+#include "../Pipeline/decimate.h"
+#include "../Pipeline/stages.h"
+#include "../Stats/stats.h"
+#include "adc.h"
 
 /* Priorities of the demo application tasks (high numb. -> high prio.) */
-#define mainQueueTASK_ACQ_PRIORITY      ( tskIDLE_PRIORITY + 3 )
 #define mainQueueTASK_PROC_PRIORITY	    ( tskIDLE_PRIORITY + 2 )
 #define mainQueueTASK_OUT_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+#define mainQueueTASK_BENCH_PRIORITY	    ( tskIDLE_PRIORITY + 3 )
+#define mainQueueTASK_STATS_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+
+#define mainQueuePIPELINE_IPC pipelineIPC_QUEUE /* pipelineIPC_XXX used by both links */
+
+#define mainQueueADC_PIN 0 /* What Analog pin to use */
+#define mainQueueADC_RUN 1 /* 0- Disable ADC ; 1- Enable ADC */
+#define mainQueueADC_SAMPLE_RATE 200000 /* Conversions per second */
+#define mainQueueADC_SAMPLES_PER_IRQ 8 /* One ADC interrupt every 8 conversions */
+#define mainQueueADC_BLOCK_SIZE 1000 /* Samples per block (5 ms), multiple of mainQueueADC_SAMPLES_PER_IRQ */
+
+#define mainQueuePOOL_BLOCKS 4 /* Filled by ACQ, processed by PROC, printed by OUT, spare */
+#define mainQueueLINK_DEPTH 2 /* Blocks that can wait for PROC or OUT */
+#define mainQueuePROC_NUM_BLOCKS 20 /* Blocks per printed result (100 ms) */
+#define mainQueuePROC_LOG2_DECIMATION 4 /* Decimation by 16, 200 kS/s to 12.5 kS/s */
+
+#define mainQueueOUT_STRING_MAX_SIZE 40 /*Maximum string size to print result*/
+
+#define mainQueueBENCHMARK 0 /* 0- Print the temperature ; 1- Run the IPC benchmark */
+#define mainQueueBENCH_PERIOD_MS 2000 /* Measurement time of each rate */
+
+#define mainQueueRUN_STATS 0 /* 0- Off ; 1- Print the run time stats table */
+#define mainQueueRUN_STATS_PERIOD_MS 5000
+#define mainQueueSTATS_ISR_ADC 0 /* ISR slot of the ADC handler */
+
+/* Block pool */
+static uint16_t usSamples[mainQueuePOOL_BLOCKS*mainQueueADC_BLOCK_SIZE];
+static PipelineBlock_t xBlocks[mainQueuePOOL_BLOCKS];
+static PipelinePool_t xPool;
+
+/* Links between stages */
+static PipelineLink_t xAcqToProc;
+static PipelineLink_t xProcToOut;
+
+/* Stages */
+static StageAcq_t xAcqStage; /* ADC ISR */
+static StageProc_t xProcStage;
 
-#define mainQueueADC_RESOLUTION 10
-#define mainQueueADC_PIN 0
-#define mainQueueADC_RUN 1
-#define mainQueueADC_NUM_SAMPLES 1
-#define mainQueueMAX_TEMP 100
-#define mainQueuePROC_NUM_SAMPLES 5
-#define mainQueueOUT_STRING_MAX_SIZE 10
+/* Task handles */
+static TaskHandle_t xProc = NULL, xOut = NULL;
 
-#define mainQueueQUEUE_SAMPLES_SIZE 5
-#define mainQueueQUEUE_AVERAGES_SIZE 1
+#if mainQueueBENCHMARK
+/* ADC rates swept by the benchmark, conversions per second */
+static const uint32_t ulBenchRates[] = {50000, 100000, 200000, 300000, 400000, 500000};
 
-QueueHandle_t xSamplesQueue = NULL;
-QueueHandle_t xAveragesQueue = NULL;
+static int8_t prvBenchAdc(uint32_t ulRate);
 
-typedef struct {
-  uint16_t usADCAverage; /* Average of N samples */
-  uint16_t usADCAverage_FP; /* Floating point component of average */
-} xResult_t;
+static const PipelineBench_t xBench = {
+    &xAcqToProc, &xProcToOut, mainQueuePIPELINE_IPC, mainQueueADC_BLOCK_SIZE,
+    ulBenchRates, sizeof(ulBenchRates)/sizeof(ulBenchRates[0]), mainQueueBENCH_PERIOD_MS, prvBenchAdc, NULL
+};
+#endif
 
 /*
  * Prototypes and tasks
  */
 
-void pvAcq(void *pvParam)
+void pvProc(void *pvParam)
 {
-    static TickType_t xLastWakeTime;
-    static uint16_t usADCSample=0;
-    portBASE_TYPE xStatus;
-    
-    xSamplesQueue = xQueueCreate(mainQueueQUEUE_SAMPLES_SIZE, sizeof(usADCSample));
-
-    xLastWakeTime = xTaskGetTickCount();
+    PipelineBlock_t *pxBlock;
     
     while(1) {
-        
-        usADCSample =((getADCsample()+1)*mainQueueMAX_TEMP)>>mainQueueADC_RESOLUTION;
-        xStatus = xQueueSend(xSamplesQueue, (void *)&usADCSample, (TickType_t)0);
-        if(xStatus != pdPASS){
-            PrintStr("\r\nError: Could not send value to Samples queue.");
+        pxBlock = PipelineReceive(&xAcqToProc, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
         }
-        vTaskDelayUntil(&xLastWakeTime, mainQueueTASK_ACQ_PERIOD_MS);  
+        StageProcBlock(&xProcStage, pxBlock); /* Every mainQueuePROC_NUM_BLOCKS blocks, one goes to OUT */
     }
 }
 
-void pvProc(void *pvParam)
+void pvOut(void *pvParam)
 {
-    static uint8_t ucSample_count=0;
-    static uint16_t usRxedADCSample=0;
-    static xResult_t xResult;
-    portBASE_TYPE xStatus;
-    xAveragesQueue = xQueueCreate(mainQueueQUEUE_AVERAGES_SIZE, sizeof(xResult));
+    static uint8_t ucStr[mainQueueOUT_STRING_MAX_SIZE];
+    PipelineBlock_t *pxBlock;
     
     while(1) {
-        if(xSamplesQueue != NULL) {
-            if (xQueueReceive(xSamplesQueue, (uint16_t*)&usRxedADCSample, portMAX_DELAY) == pdPASS ) {
-                xResult.usADCAverage += usRxedADCSample;
-                ucSample_count++;
-                
-                if(ucSample_count == mainQueuePROC_NUM_SAMPLES){
-                    xResult.usADCAverage_FP = xResult.usADCAverage%mainQueuePROC_NUM_SAMPLES;
-                    xResult.usADCAverage /= mainQueuePROC_NUM_SAMPLES;
-                    ucSample_count=0;
-                    
-                    xStatus = xQueueSend(xAveragesQueue, (void *)&xResult, (TickType_t)0);
-                    if(xStatus != pdPASS){
-                        PrintStr("\r\nError: Could not send value to Averages queue.");
-                    }
-                    xResult.usADCAverage=0;
-                }
-            }
+        pxBlock = PipelineReceive(&xProcToOut, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
         }
+#if mainQueueBENCHMARK == 0 /* BENCH owns the UART */
+        StageOutFormat((char *)ucStr, mainQueueOUT_STRING_MAX_SIZE, pxBlock, xAcqToProc.ulDropped);
+        PipelineFree(&xPool, pxBlock);
+        PrintStr(ucStr);
+#else
+        PipelineFree(&xPool, pxBlock);
+#endif
     }
 }
 
-void pvOut(void *pvParam)
+#if mainQueueBENCHMARK
+/* Source of the benchmark: restarts the ADC at ulRate, stops it for 0 */
+static int8_t prvBenchAdc(uint32_t ulRate)
 {
-    static xResult_t xRxedResult;
-    static uint8_t ucStr[mainQueueOUT_STRING_MAX_SIZE];
-   
-    while(1) {
-        if(xAveragesQueue != NULL) {
-            if (xQueueReceive(xAveragesQueue, (xResult_t*)&xRxedResult, portMAX_DELAY) == pdPASS ) {
-                snprintf(ucStr,mainQueueOUT_STRING_MAX_SIZE,"\r\n%d.%d", xRxedResult.usADCAverage, xRxedResult.usADCAverage_FP);
-                PrintStr(ucStr);
-            }
-        }
+    adcScanControl(0);
+    if(ulRate == 0) {
+        return 0;
     }
+    if(adcScanConfig(0x01 << mainQueueADC_PIN, configPERIPHERAL_CLOCK_HZ, ulRate, mainQueueADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        return -1;
+    }
+    adcScanControl(1);
+    return 0;
 }
+#endif
 
 /*
  * Create the demo tasks then start the scheduler.
  */
 int mainQueue( void )
 {
+    void __attribute__( (interrupt(IPL3AUTO), vector(_ADC_VECTOR))) vADCInterruptWrapper(void);
+    
     TRISBbits.TRISB0 = 1; // Set AN0 to input mode
-    adcConfig(mainQueueADC_NUM_SAMPLES, mainQueueADC_PIN);
-    adcControl(mainQueueADC_RUN);
+    if(adcScanConfig(0x01 << mainQueueADC_PIN, configPERIPHERAL_CLOCK_HZ, mainQueueADC_SAMPLE_RATE, mainQueueADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    IPC6bits.AD1IP = 3; /* Interrupt priority, must not exceed configMAX_SYSCALL_INTERRUPT_PRIORITY */
+    StatsIsrName(mainQueueSTATS_ISR_ADC, "ADC");
 
-    
 	// Init UART and redirect tdin/stdot/stderr to UART
     if(UartInit(configPERIPHERAL_CLOCK_HZ, 115200) != UART_SUCCESS) {
         PORTAbits.RA3 = 1; // If Led active error initializing UART
@@ -141,14 +174,52 @@ int mainQueue( void )
      __XC_UART = 1; /* Redirect stdin/stdout/stderr to UART1*/
           
     /* Create the tasks defined within this file. */
-	xTaskCreate( pvAcq, ( const signed char * const ) "Acq", configMINIMAL_STACK_SIZE, NULL, mainQueueTASK_ACQ_PRIORITY, NULL );
-    xTaskCreate( pvProc, ( const signed char * const ) "Proc", configMINIMAL_STACK_SIZE, NULL, mainQueueTASK_PROC_PRIORITY, NULL );
-    xTaskCreate( pvOut, ( const signed char * const ) "Out", configMINIMAL_STACK_SIZE, NULL, mainQueueTASK_OUT_PRIORITY, NULL );
-
+    xTaskCreate( pvProc, ( const signed char * const ) "Proc", configMINIMAL_STACK_SIZE, NULL, mainQueueTASK_PROC_PRIORITY, &xProc );
+    xTaskCreate( pvOut, ( const signed char * const )  "Out",  configMINIMAL_STACK_SIZE, NULL, mainQueueTASK_OUT_PRIORITY, &xOut );
+#if mainQueueRUN_STATS
+    if(StatsStart(mainQueueTASK_STATS_PRIORITY, mainQueueRUN_STATS_PERIOD_MS) != STATS_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+#endif
+#if mainQueueBENCHMARK
+    xTaskCreate( PipelineBenchTask, ( const signed char * const ) "Bench", configMINIMAL_STACK_SIZE*2, (void *)&xBench, mainQueueTASK_BENCH_PRIORITY, NULL );
+#endif
+    
+    /* Pipeline, the consumers are needed by task notification links */
+    if(PipelinePoolInit(&xPool, xBlocks, usSamples, mainQueuePOOL_BLOCKS, mainQueueADC_BLOCK_SIZE) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xAcqToProc, mainQueuePIPELINE_IPC, mainQueueLINK_DEPTH, xProc) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xProcToOut, mainQueuePIPELINE_IPC, mainQueueLINK_DEPTH, xOut) != PIPELINE_SUCCESS ||
+       StageProcInit(&xProcStage, &xPool, &xProcToOut, mainQueuePROC_LOG2_DECIMATION, mainQueuePROC_NUM_BLOCKS) != DECIMATE_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    StageAcqInit(&xAcqStage, &xPool, &xAcqToProc, adcScanRead);
+    
+#if mainQueueBENCHMARK == 0 /* Otherwise BENCH starts the ADC at each rate */
+    adcScanControl(mainQueueADC_RUN); /* Interrupts are enabled by the scheduler */
+#endif
+ 
     /* Finally start the scheduler. */
 	vTaskStartScheduler();
 
 	/* Will only reach here if there is insufficient heap available to start
 	the scheduler. */
 	return 0;
-}
\ No newline at end of file
+}
+
+/* ADC ISR, stage ACQ
+ * 
+ * Runs every mainQueueADC_SAMPLES_PER_IRQ conversions and appends them to the
+ * current block, see StageAcqFromISR().
+ */
+void vADCInterruptHandler(void)
+{
+    uint32_t ulEnter = statsISR_ENTER();
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    StageAcqFromISR(&xAcqStage, &xHigherPriorityTaskWoken);
+    
+    StatsIsrExit(mainQueueSTATS_ISR_ADC, ulEnter);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
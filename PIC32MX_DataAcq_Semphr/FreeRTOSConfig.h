@@ -54,7 +54,7 @@
 #define configISR_STACK_SIZE					( 250 )
 #define configTOTAL_HEAP_SIZE					( ( size_t ) 28000 )
 #define configMAX_TASK_NAME_LEN					( 8 )
-#define configUSE_TRACE_FACILITY				0
+#define configUSE_TRACE_FACILITY				1
 #define configUSE_16_BIT_TICKS					0
 #define configIDLE_SHOULD_YIELD					1
 #define configUSE_MUTEXES						1
@@ -64,7 +64,7 @@
 #define configUSE_MALLOC_FAILED_HOOK			1
 #define configUSE_APPLICATION_TASK_TAG			0
 #define configUSE_COUNTING_SEMAPHORES			1
-#define configGENERATE_RUN_TIME_STATS			0
+#define configGENERATE_RUN_TIME_STATS			1
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 			0
@@ -93,6 +93,15 @@ to exclude the API function. */
 #ifndef __LANGUAGE_ASSEMBLY
 	void vAssertCalled( const char *pcFileName, unsigned long ulLine );
 	#define configASSERT( x ) if( ( x ) == 0 ) vAssertCalled( __FILE__, __LINE__ )
+
+	/* Run time stats in core timer ticks (SYSCLK/2), free running, no setup.
+	See Stats/stats.h. */
+	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+	#define portGET_RUN_TIME_COUNTER_VALUE() _CP0_GET_COUNT()
+
+	/* Context switch count, read by the pipeline benchmark. */
+	extern volatile uint32_t ulPipelineSwitches;
+	#define traceTASK_SWITCHED_IN() ulPipelineSwitches++
 #endif
 
 /* The priority at which the tick interrupt runs.  This should probably be
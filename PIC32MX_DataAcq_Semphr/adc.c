@@ -51,4 +51,87 @@ uint16_t getADCsample(){
     return ADC1BUF0;
 }
 
+int8_t adcScanConfig(uint16_t usChannels, uint32_t ulPbclock, uint32_t ulSampleRate, uint8_t ucSamplesPerIrq){
+
+    static const uint16_t usPrescaler[] = {1, 2, 4, 8, 16, 32, 64, 256}; /* Timer 3 TCKPS values */
+    uint32_t ulTadClocks; /* PBCLK periods per TAD */
+    uint32_t ulPeriod; /* PBCLK periods per conversion */
+    uint8_t ucTckps = 0;
+
+    if (usChannels == 0)
+        return adcADC_INVALID_PIN;
+    if (ucSamplesPerIrq < 1 || ucSamplesPerIrq > adcSCAN_BUFFER_SIZE)
+        return adcADC_INVALID_NUM_OF_SAMPLES;
+    if (ulSampleRate == 0)
+        return adcADC_INVALID_RATE;
+
+    /* TAD = 2*(ADCS+1)*TPB, shortest one above adcTAD_MIN_NS */
+    ulTadClocks = ((ulPbclock/1000)*adcTAD_MIN_NS + 999999)/1000000;
+    ulTadClocks = (ulTadClocks < 2) ? 2 : (ulTadClocks + 1) & ~1;
+
+    ulPeriod = ulPbclock/ulSampleRate;
+    if (ulPeriod < ulTadClocks*adcCONVERSION_TAD)
+        return adcADC_INVALID_RATE; /* Conversion does not fit in the period */
+    while (ulPeriod/usPrescaler[ucTckps] > 65536) {
+        if (++ucTckps == sizeof(usPrescaler)/sizeof(usPrescaler[0]))
+            return adcADC_INVALID_RATE;
+    }
+
+    AD1CON1bits.ON = 0;
+    DDPCONbits.JTAGEN = 0; /* Debugging port that takes control of ADC IO pins*/
+
+    /* Timer 3 sets the sample rate */
+    T3CON = 0;
+    TMR3 = 0;
+    T3CONbits.TCKPS = ucTckps;
+    PR3 = ulPeriod/usPrescaler[ucTckps] - 1;
+
+    AD1CON1 = 0;
+    AD1CON1bits.FORM = 0; /* Integer 16 bit output format*/
+    AD1CON1bits.SSRC = 2; /* Timer 3 period match ends sampling and starts conversion */
+    AD1CON1bits.ASAM = 1; /* Sampling restarts right after each conversion */
+    AD1CON2 = 0;
+    AD1CON2bits.VCFG = 0; /* VR+=AVdd; VR-=AVss | Use internal voltage reference*/
+    AD1CON2bits.CSCNA = 1; /* Scan the inputs selected in AD1CSSL */
+    AD1CON2bits.BUFM = 1; /* Two 8 word buffers, ADC1BUF0-7 and ADC1BUF8-F */
+    AD1CON2bits.SMPI = ucSamplesPerIrq - 1; /* Conversions per interrupt */
+    AD1CON3 = 0;
+    AD1CON3bits.ADRC = 0; /* ADC Clock is derived from PBCLK */
+    AD1CON3bits.ADCS = ulTadClocks/2 - 1;
+
+    AD1CSSL = usChannels; /* Inputs to scan */
+    AD1PCFGCLR = usChannels; /* Scanned inputs in analog mode */
+
+    IFS1CLR = _IFS1_AD1IF_MASK;
+
+    return adcADC_SUCCESS;
+}
+
+void adcScanControl(uint8_t adcrun){
+    if (adcrun == 1) {
+        IFS1CLR = _IFS1_AD1IF_MASK;
+        IEC1SET = _IEC1_AD1IE_MASK;
+        AD1CON1bits.ON = 1; /* Enable A/D module*/
+        T3CONbits.ON = 1; /* Start triggering conversions */
+    }
+    else {
+        T3CONbits.ON = 0;
+        AD1CON1bits.ON = 0; /* Disable A/D module*/
+        IEC1CLR = _IEC1_AD1IE_MASK;
+    }
+}
+
+uint8_t adcScanRead(uint16_t *pusDst){
+    /* ADC1BUFx are 16 bytes apart. BUFS: the ADC is filling ADC1BUF8-F */
+    volatile uint32_t *pulBuf = AD1CON2bits.BUFS ? &ADC1BUF0 : &ADC1BUF8;
+    uint8_t ucCount = AD1CON2bits.SMPI + 1;
+    uint8_t ucIterator;
+
+    for (ucIterator = 0; ucIterator < ucCount; ucIterator++)
+        pusDst[ucIterator] = pulBuf[ucIterator*4];
+
+    IFS1CLR = _IFS1_AD1IF_MASK;
+    return ucCount;
+}
+
 /***************************************End Of File****************************/
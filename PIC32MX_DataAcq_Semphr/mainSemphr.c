@@ -4,12 +4,23 @@
  * Diogo Vala 64671
  *
  *******************************************************************************
- * This program runs 3 tasks.
- * IPC is achieved using Semaphores.
- * Task ACQ takes samples from AN0. 
- * Task PROC takes each sample and sums them together. At 5 samples,
- * calculates average.
- * Task OUT takes the average and prints the result.
+ * This program runs a 3 stage block pipeline.
+ * IPC between stages is achieved using counting semaphores over block pointer rings.
+ * Stage ACQ is the ADC ISR. The ADC samples AN0 continuously, triggered by
+ * Timer 3, into blocks taken from a pool of preallocated buffers.
+ * Task PROC receives the block pointers, decimates the samples in place
+ * (CIC + compensation FIR, more bits than the ADC) and keeps running
+ * statistics of the result.
+ * Every 100 ms it attaches them to a block and passes it on.
+ * Task OUT prints the average and returns the block to the pool.
+ * The work of each stage is in Pipeline/stages.c, shared with the host test.
+ * Only block pointers move between stages. mainSemphrPIPELINE_IPC selects the
+ * IPC, to compare the three mechanisms with the same pipeline.
+ * With mainSemphrBENCHMARK set, task BENCH (PipelineBenchTask()) sweeps the ADC
+ * rate and prints the throughput, dropped blocks, context switches and link
+ * latencies instead.
+ * With mainSemphrRUN_STATS set, the CPU time of each task and of the ADC ISR,
+ * stack and heap usage are printed every mainSemphrRUN_STATS_PERIOD_MS.
  *  
  */
 
@@ -24,96 +35,136 @@
 
 /* App includes */
 #include "../UART/uart.h"
-
-/* The rate at which the data is sampled */
-#define mainSemphrDATA_ACQ_PERIOD_MS 	( 100 / portTICK_RATE_MS )
+#include "../Pipeline/pipeline.h"
+#include "../Pipeline/decimate.h"
+#include "../Pipeline/stages.h"
+#include "../Stats/stats.h"
+#include "adc.h"
 
 /* Priorities of the demo application tasks (high numb. -> high prio.) */
-#define mainSemphrTASK_ACQ_PRIORITY     ( tskIDLE_PRIORITY + 3 )
-#define mainSemphrTASK_PROC_PRIORITY    ( tskIDLE_PRIORITY + 2 )
-#define mainSemphrTASK_OUT_PRIORITY     ( tskIDLE_PRIORITY + 1 )
+#define mainSemphrTASK_PROC_PRIORITY	    ( tskIDLE_PRIORITY + 2 )
+#define mainSemphrTASK_OUT_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+#define mainSemphrTASK_BENCH_PRIORITY	    ( tskIDLE_PRIORITY + 3 )
+#define mainSemphrTASK_STATS_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+
+#define mainSemphrPIPELINE_IPC pipelineIPC_SEMPHR /* pipelineIPC_XXX used by both links */
 
-#define mainSemphrADC_RESOLUTION 10 /* ADC 10 bit resolution*/
 #define mainSemphrADC_PIN 0 /* What Analog pin to use */
 #define mainSemphrADC_RUN 1 /* 0- Disable ADC ; 1- Enable ADC */
-#define mainSemphrADC_NUM_SAMPLES 1 /* Number of samples taken by ADC at one time */
+#define mainSemphrADC_SAMPLE_RATE 200000 /* Conversions per second */
+#define mainSemphrADC_SAMPLES_PER_IRQ 8 /* One ADC interrupt every 8 conversions */
+#define mainSemphrADC_BLOCK_SIZE 1000 /* Samples per block (5 ms), multiple of mainSemphrADC_SAMPLES_PER_IRQ */
+
+#define mainSemphrPOOL_BLOCKS 4 /* Filled by ACQ, processed by PROC, printed by OUT, spare */
+#define mainSemphrLINK_DEPTH 2 /* Blocks that can wait for PROC or OUT */
+#define mainSemphrPROC_NUM_BLOCKS 20 /* Blocks per printed result (100 ms) */
+#define mainSemphrPROC_LOG2_DECIMATION 4 /* Decimation by 16, 200 kS/s to 12.5 kS/s */
+
+#define mainSemphrOUT_STRING_MAX_SIZE 40 /*Maximum string size to print result*/
+
+#define mainSemphrBENCHMARK 0 /* 0- Print the temperature ; 1- Run the IPC benchmark */
+#define mainSemphrBENCH_PERIOD_MS 2000 /* Measurement time of each rate */
+
+#define mainSemphrRUN_STATS 0 /* 0- Off ; 1- Print the run time stats table */
+#define mainSemphrRUN_STATS_PERIOD_MS 5000
+#define mainSemphrSTATS_ISR_ADC 0 /* ISR slot of the ADC handler */
+
+/* Block pool */
+static uint16_t usSamples[mainSemphrPOOL_BLOCKS*mainSemphrADC_BLOCK_SIZE];
+static PipelineBlock_t xBlocks[mainSemphrPOOL_BLOCKS];
+static PipelinePool_t xPool;
+
+/* Links between stages */
+static PipelineLink_t xAcqToProc;
+static PipelineLink_t xProcToOut;
+
+/* Stages */
+static StageAcq_t xAcqStage; /* ADC ISR */
+static StageProc_t xProcStage;
+
+/* Task handles */
+static TaskHandle_t xProc = NULL, xOut = NULL;
 
-#define mainSemphrMAX_TEMP 100 /* Maximum temperature */
-#define mainSemphrPROC_NUM_SAMPLES 5 /* Number of samples to average */
-#define mainSemphrOUT_STRING_MAX_SIZE 10 /*Maximum string size to print result*/
+#if mainSemphrBENCHMARK
+/* ADC rates swept by the benchmark, conversions per second */
+static const uint32_t ulBenchRates[] = {50000, 100000, 200000, 300000, 400000, 500000};
 
-SemaphoreHandle_t xSemaphore_Proc = NULL;
-SemaphoreHandle_t xSemaphore_Out = NULL;
+static int8_t prvBenchAdc(uint32_t ulRate);
 
-static volatile uint16_t usADCSample=0; /*Sample taken by ADC & converted to 0-100*/
-static volatile uint16_t usADCAverage=0; /* Average of N samples */
-static volatile uint8_t ucADCAverage_FP=0; /* Floating point component of average */
+static const PipelineBench_t xBench = {
+    &xAcqToProc, &xProcToOut, mainSemphrPIPELINE_IPC, mainSemphrADC_BLOCK_SIZE,
+    ulBenchRates, sizeof(ulBenchRates)/sizeof(ulBenchRates[0]), mainSemphrBENCH_PERIOD_MS, prvBenchAdc, NULL
+};
+#endif
 
 /*
  * Prototypes and tasks
  */
 
-void pvAcq(void *pvParam)
-{
-    static TickType_t xLastWakeTime = 0;
-    xSemaphore_Proc = xSemaphoreCreateBinary();
-    
-    xLastWakeTime = xTaskGetTickCount();
-    
-    while(1) {
-        
-        usADCSample=((getADCsample()+1)*mainSemphrMAX_TEMP)>>mainSemphrADC_RESOLUTION;
-        xSemaphoreGive(xSemaphore_Proc);
-        vTaskDelayUntil(&xLastWakeTime, mainSemphrDATA_ACQ_PERIOD_MS);  
-    }
-}
-
 void pvProc(void *pvParam)
 {
-    static uint8_t ucSample_count=0;
-    xSemaphore_Out = xSemaphoreCreateBinary();
+    PipelineBlock_t *pxBlock;
     
     while(1) {
-        if(xSemaphore_Proc != NULL) {
-            if (xSemaphoreTake(xSemaphore_Proc, portMAX_DELAY) == pdTRUE){ /* Blocked forever until SemaphoreGive*/
-                usADCAverage+=usADCSample;
-                ucSample_count++;
-                if(ucSample_count==mainSemphrPROC_NUM_SAMPLES){
-                    ucADCAverage_FP=usADCAverage%mainSemphrPROC_NUM_SAMPLES;
-                    usADCAverage/=mainSemphrPROC_NUM_SAMPLES;
-                    ucSample_count=0;
-                    xSemaphoreGive(xSemaphore_Out);
-                }
-            }
+        pxBlock = PipelineReceive(&xAcqToProc, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
         }
+        StageProcBlock(&xProcStage, pxBlock); /* Every mainSemphrPROC_NUM_BLOCKS blocks, one goes to OUT */
     }
 }
 
 void pvOut(void *pvParam)
 {
     static uint8_t ucStr[mainSemphrOUT_STRING_MAX_SIZE];
+    PipelineBlock_t *pxBlock;
     
     while(1) {
-        if(xSemaphore_Out != NULL) {
-            if (xSemaphoreTake(xSemaphore_Out, portMAX_DELAY) == pdTRUE){
-                snprintf(ucStr,mainSemphrOUT_STRING_MAX_SIZE,"\r\n%d.%1d", usADCAverage, ucADCAverage_FP);
-                PrintStr(ucStr);
-                usADCAverage=0;
-            }
+        pxBlock = PipelineReceive(&xProcToOut, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
         }
+#if mainSemphrBENCHMARK == 0 /* BENCH owns the UART */
+        StageOutFormat((char *)ucStr, mainSemphrOUT_STRING_MAX_SIZE, pxBlock, xAcqToProc.ulDropped);
+        PipelineFree(&xPool, pxBlock);
+        PrintStr(ucStr);
+#else
+        PipelineFree(&xPool, pxBlock);
+#endif
     }
 }
 
+#if mainSemphrBENCHMARK
+/* Source of the benchmark: restarts the ADC at ulRate, stops it for 0 */
+static int8_t prvBenchAdc(uint32_t ulRate)
+{
+    adcScanControl(0);
+    if(ulRate == 0) {
+        return 0;
+    }
+    if(adcScanConfig(0x01 << mainSemphrADC_PIN, configPERIPHERAL_CLOCK_HZ, ulRate, mainSemphrADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        return -1;
+    }
+    adcScanControl(1);
+    return 0;
+}
+#endif
+
 /*
  * Create the demo tasks then start the scheduler.
  */
 int mainSemphr( void )
 {
+    void __attribute__( (interrupt(IPL3AUTO), vector(_ADC_VECTOR))) vADCInterruptWrapper(void);
+    
     TRISBbits.TRISB0 = 1; // Set AN0 to input mode
-    adcConfig(mainSemphrADC_NUM_SAMPLES, mainSemphrADC_PIN);
-    adcControl(mainSemphrADC_RUN); /* Start ADC module */
+    if(adcScanConfig(0x01 << mainSemphrADC_PIN, configPERIPHERAL_CLOCK_HZ, mainSemphrADC_SAMPLE_RATE, mainSemphrADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    IPC6bits.AD1IP = 3; /* Interrupt priority, must not exceed configMAX_SYSCALL_INTERRUPT_PRIORITY */
+    StatsIsrName(mainSemphrSTATS_ISR_ADC, "ADC");
 
-    
 	// Init UART and redirect tdin/stdot/stderr to UART
     if(UartInit(configPERIPHERAL_CLOCK_HZ, 115200) != UART_SUCCESS) {
         PORTAbits.RA3 = 1; // If Led active error initializing UART
@@ -123,9 +174,31 @@ int mainSemphr( void )
      __XC_UART = 1; /* Redirect stdin/stdout/stderr to UART1*/
           
     /* Create the tasks defined within this file. */
-	xTaskCreate( pvAcq, ( const signed char * const )  "Acq",  configMINIMAL_STACK_SIZE, NULL, mainSemphrTASK_ACQ_PRIORITY, NULL );
-    xTaskCreate( pvProc, ( const signed char * const ) "Proc", configMINIMAL_STACK_SIZE, NULL, mainSemphrTASK_PROC_PRIORITY, NULL );
-    xTaskCreate( pvOut, ( const signed char * const )  "Out",  configMINIMAL_STACK_SIZE, NULL, mainSemphrTASK_OUT_PRIORITY, NULL );
+    xTaskCreate( pvProc, ( const signed char * const ) "Proc", configMINIMAL_STACK_SIZE, NULL, mainSemphrTASK_PROC_PRIORITY, &xProc );
+    xTaskCreate( pvOut, ( const signed char * const )  "Out",  configMINIMAL_STACK_SIZE, NULL, mainSemphrTASK_OUT_PRIORITY, &xOut );
+#if mainSemphrRUN_STATS
+    if(StatsStart(mainSemphrTASK_STATS_PRIORITY, mainSemphrRUN_STATS_PERIOD_MS) != STATS_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+#endif
+#if mainSemphrBENCHMARK
+    xTaskCreate( PipelineBenchTask, ( const signed char * const ) "Bench", configMINIMAL_STACK_SIZE*2, (void *)&xBench, mainSemphrTASK_BENCH_PRIORITY, NULL );
+#endif
+    
+    /* Pipeline, the consumers are needed by task notification links */
+    if(PipelinePoolInit(&xPool, xBlocks, usSamples, mainSemphrPOOL_BLOCKS, mainSemphrADC_BLOCK_SIZE) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xAcqToProc, mainSemphrPIPELINE_IPC, mainSemphrLINK_DEPTH, xProc) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xProcToOut, mainSemphrPIPELINE_IPC, mainSemphrLINK_DEPTH, xOut) != PIPELINE_SUCCESS ||
+       StageProcInit(&xProcStage, &xPool, &xProcToOut, mainSemphrPROC_LOG2_DECIMATION, mainSemphrPROC_NUM_BLOCKS) != DECIMATE_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    StageAcqInit(&xAcqStage, &xPool, &xAcqToProc, adcScanRead);
+    
+#if mainSemphrBENCHMARK == 0 /* Otherwise BENCH starts the ADC at each rate */
+    adcScanControl(mainSemphrADC_RUN); /* Interrupts are enabled by the scheduler */
+#endif
  
     /* Finally start the scheduler. */
 	vTaskStartScheduler();
@@ -133,4 +206,20 @@ int mainSemphr( void )
 	/* Will only reach here if there is insufficient heap available to start
 	the scheduler. */
 	return 0;
-}
\ No newline at end of file
+}
+
+/* ADC ISR, stage ACQ
+ * 
+ * Runs every mainSemphrADC_SAMPLES_PER_IRQ conversions and appends them to the
+ * current block, see StageAcqFromISR().
+ */
+void vADCInterruptHandler(void)
+{
+    uint32_t ulEnter = statsISR_ENTER();
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    StageAcqFromISR(&xAcqStage, &xHigherPriorityTaskWoken);
+    
+    StatsIsrExit(mainSemphrSTATS_ISR_ADC, ulEnter);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
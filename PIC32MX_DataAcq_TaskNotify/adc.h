@@ -14,6 +14,11 @@
 #define adcADC_SUCCESS 0
 #define adcADC_INVALID_NUM_OF_SAMPLES -1
 #define adcADC_INVALID_PIN -2;
+#define adcADC_INVALID_RATE -3
+
+#define adcSCAN_BUFFER_SIZE 8 /* Samples per half of ADC1BUF0-F in dual buffer mode */
+#define adcTAD_MIN_NS 65 /* Minimum ADC clock period */
+#define adcCONVERSION_TAD 14 /* 12 TAD conversion + 2 TAD minimum sampling */
 
 /********************************************************************
  * Function: 	 adcConfig()
@@ -63,3 +68,61 @@ int8_t adcControl(uint8_t adcrun);
  ********************************************************************/
 uint16_t getADCsample();
 
+
+
+/********************************************************************
+ * Function: 	 adcScanConfig()
+ * Precondition: Must configure TRIS of the scanned pins
+ * Input: 		 usChannels - Mask of the ANx inputs to scan (bit x = ANx)
+ *               ulPbclock - Peripheral bus clock (Hz)
+ *               ulSampleRate - Conversions per second, over all channels
+ *               ucSamplesPerIrq - Conversions per interrupt, 1 to
+ *                   adcSCAN_BUFFER_SIZE. A multiple of the number of
+ *                   scanned channels keeps the channels in order.
+ * Returns:      adcADC_SUCCESS if configuration successful.
+ *               adcADC_XXX error codes in case of failure
+ * Side Effects: Takes Timer 3
+ *               
+ * Overview:     Configures continuous acquisition. Timer 3 ends each
+ *               sampling and starts the conversion (SSRC=2), the
+ *               inputs are scanned (CSCNA) and the results alternate
+ *               between the two halves of ADC1BUF (BUFM).
+ *		
+ * Note:		 The ADC clock is derived from PBCLK. The interrupt
+ *               priority (IPC6 AD1IP) is set by the application.
+ * 
+ ********************************************************************/
+int8_t adcScanConfig(uint16_t usChannels, uint32_t ulPbclock, uint32_t ulSampleRate, uint8_t ucSamplesPerIrq);
+
+
+
+/********************************************************************
+ * Function: 	 adcScanControl()
+ * Precondition: adcScanConfig() called
+ * Input: 		 adcrun {0-stop; 1-start}
+ * Returns:      
+ * Side Effects: 
+ *               
+ * Overview:     Starts/Stops Timer 3, the ADC and its interrupt.
+ *		
+ * Note:		 
+ * 
+ ********************************************************************/
+void adcScanControl(uint8_t adcrun);
+
+
+
+/********************************************************************
+ * Function: 	 adcScanRead()
+ * Precondition: adcScanConfig() called
+ * Input: 		 pusDst - Room for ucSamplesPerIrq samples
+ * Returns:      Number of samples copied
+ * Side Effects: Clears AD1IF
+ *               
+ * Overview:     Copies the half of ADC1BUF that was just filled, while
+ *               the ADC fills the other one.
+ *		
+ * Note:		 To be called from the ADC ISR
+ * 
+ ********************************************************************/
+uint8_t adcScanRead(uint16_t *pusDst);
@@ -4,12 +4,23 @@
  * Diogo Vala 64671
  *
  *******************************************************************************
- * This program runs 3 tasks.
- * IPC is achieved using Task Notify
- * Task ACQ takes samples from AN0. 
- * Task PROC takes each sample and sums them together. At 5 samples,
- * calculates average.
- * Task OUT takes the average and prints the result.
+ * This program runs a 3 stage block pipeline.
+ * IPC between stages is achieved using task notifications over block pointer rings.
+ * Stage ACQ is the ADC ISR. The ADC samples AN0 continuously, triggered by
+ * Timer 3, into blocks taken from a pool of preallocated buffers.
+ * Task PROC receives the block pointers, decimates the samples in place
+ * (CIC + compensation FIR, more bits than the ADC) and keeps running
+ * statistics of the result.
+ * Every 100 ms it attaches them to a block and passes it on.
+ * Task OUT prints the average and returns the block to the pool.
+ * The work of each stage is in Pipeline/stages.c, shared with the host test.
+ * Only block pointers move between stages. mainTaskNotifyPIPELINE_IPC selects the
+ * IPC, to compare the three mechanisms with the same pipeline.
+ * With mainTaskNotifyBENCHMARK set, task BENCH (PipelineBenchTask()) sweeps the ADC
+ * rate and prints the throughput, dropped blocks, context switches and link
+ * latencies instead.
+ * With mainTaskNotifyRUN_STATS set, the CPU time of each task and of the ADC ISR,
+ * stack and heap usage are printed every mainTaskNotifyRUN_STATS_PERIOD_MS.
  *  
  */
 
@@ -24,88 +35,136 @@
 
 /* App includes */
 #include "../UART/uart.h"
-
-/* The rate at which the data is sampled */
-#define mainTaskNotifyTASK_ACQ_PERIOD_MS 	( 100 / portTICK_RATE_MS )
+#include "../Pipeline/pipeline.h"
+#include "../Pipeline/decimate.h"
+#include "../Pipeline/stages.h"
+#include "../Stats/stats.h"
+#include "adc.h"
 
 /* Priorities of the demo application tasks (high numb. -> high prio.) */
-#define mainTaskNotifyTASK_ACQ_PRIORITY     ( tskIDLE_PRIORITY + 3 )
-#define mainTaskNotifyTASK_PROC_PRIORITY    ( tskIDLE_PRIORITY + 2 )
+#define mainTaskNotifyTASK_PROC_PRIORITY	    ( tskIDLE_PRIORITY + 2 )
 #define mainTaskNotifyTASK_OUT_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+#define mainTaskNotifyTASK_BENCH_PRIORITY	    ( tskIDLE_PRIORITY + 3 )
+#define mainTaskNotifyTASK_STATS_PRIORITY	    ( tskIDLE_PRIORITY + 1 )
+
+#define mainTaskNotifyPIPELINE_IPC pipelineIPC_TASK_NOTIFY /* pipelineIPC_XXX used by both links */
 
-#define mainTaskNotifyADC_RESOLUTION 10
 #define mainTaskNotifyADC_PIN 0 /* What Analog pin to use */
 #define mainTaskNotifyADC_RUN 1 /* 0- Disable ADC ; 1- Enable ADC */
-#define mainTaskNotifyADC_NUM_SAMPLES 1 /* Number of samples taken by ADC at one time */
-#define mainTaskNotifyMAX_TEMP 100 /* Maximum temperature */
-#define mainTaskNotifyPROC_NUM_SAMPLES 5 /* Number of samples to average */
-#define mainTaskNotifyOUT_STRING_MAX_SIZE 10 /*Maximum string size to print result*/
+#define mainTaskNotifyADC_SAMPLE_RATE 200000 /* Conversions per second */
+#define mainTaskNotifyADC_SAMPLES_PER_IRQ 8 /* One ADC interrupt every 8 conversions */
+#define mainTaskNotifyADC_BLOCK_SIZE 1000 /* Samples per block (5 ms), multiple of mainTaskNotifyADC_SAMPLES_PER_IRQ */
+
+#define mainTaskNotifyPOOL_BLOCKS 4 /* Filled by ACQ, processed by PROC, printed by OUT, spare */
+#define mainTaskNotifyLINK_DEPTH 2 /* Blocks that can wait for PROC or OUT */
+#define mainTaskNotifyPROC_NUM_BLOCKS 20 /* Blocks per printed result (100 ms) */
+#define mainTaskNotifyPROC_LOG2_DECIMATION 4 /* Decimation by 16, 200 kS/s to 12.5 kS/s */
+
+#define mainTaskNotifyOUT_STRING_MAX_SIZE 40 /*Maximum string size to print result*/
+
+#define mainTaskNotifyBENCHMARK 0 /* 0- Print the temperature ; 1- Run the IPC benchmark */
+#define mainTaskNotifyBENCH_PERIOD_MS 2000 /* Measurement time of each rate */
+
+#define mainTaskNotifyRUN_STATS 0 /* 0- Off ; 1- Print the run time stats table */
+#define mainTaskNotifyRUN_STATS_PERIOD_MS 5000
+#define mainTaskNotifySTATS_ISR_ADC 0 /* ISR slot of the ADC handler */
 
-static volatile uint16_t usADCSample=0; /*Sample taken by ADC & converted to 0-100*/
-static volatile uint16_t usADCAverage=0; /* Average of N samples */
-static volatile uint8_t usADCAverage_FP=0; /* Floating point component of average */
+/* Block pool */
+static uint16_t usSamples[mainTaskNotifyPOOL_BLOCKS*mainTaskNotifyADC_BLOCK_SIZE];
+static PipelineBlock_t xBlocks[mainTaskNotifyPOOL_BLOCKS];
+static PipelinePool_t xPool;
+
+/* Links between stages */
+static PipelineLink_t xAcqToProc;
+static PipelineLink_t xProcToOut;
+
+/* Stages */
+static StageAcq_t xAcqStage; /* ADC ISR */
+static StageProc_t xProcStage;
 
 /* Task handles */
 static TaskHandle_t xProc = NULL, xOut = NULL;
 
+#if mainTaskNotifyBENCHMARK
+/* ADC rates swept by the benchmark, conversions per second */
+static const uint32_t ulBenchRates[] = {50000, 100000, 200000, 300000, 400000, 500000};
+
+static int8_t prvBenchAdc(uint32_t ulRate);
+
+static const PipelineBench_t xBench = {
+    &xAcqToProc, &xProcToOut, mainTaskNotifyPIPELINE_IPC, mainTaskNotifyADC_BLOCK_SIZE,
+    ulBenchRates, sizeof(ulBenchRates)/sizeof(ulBenchRates[0]), mainTaskNotifyBENCH_PERIOD_MS, prvBenchAdc, NULL
+};
+#endif
+
 /*
  * Prototypes and tasks
  */
 
-void pvAcq(void *pvParam)
-{
-    TickType_t xLastWakeTime;
-    
-    xLastWakeTime = xTaskGetTickCount();
-
-    while(1) {
-        
-        usADCSample=((getADCsample()+1)*mainTaskNotifyMAX_TEMP)>>mainTaskNotifyADC_RESOLUTION;
-        xTaskNotifyGive(xProc);
-        vTaskDelayUntil(&xLastWakeTime, mainTaskNotifyTASK_ACQ_PERIOD_MS);  
-    }
-}
-
 void pvProc(void *pvParam)
 {
-    static uint8_t usSample_count=0;
+    PipelineBlock_t *pxBlock;
     
-    while(1) 
-    {
-        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-        usADCAverage+=usADCSample;
-        usSample_count++;
-        if(usSample_count==mainTaskNotifyPROC_NUM_SAMPLES){
-            usADCAverage_FP=usADCAverage%mainTaskNotifyPROC_NUM_SAMPLES;
-            usADCAverage/=mainTaskNotifyPROC_NUM_SAMPLES;
-            usSample_count=0;   
-            xTaskNotifyGive(xOut);
+    while(1) {
+        pxBlock = PipelineReceive(&xAcqToProc, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
         }
+        StageProcBlock(&xProcStage, pxBlock); /* Every mainTaskNotifyPROC_NUM_BLOCKS blocks, one goes to OUT */
     }
 }
 
 void pvOut(void *pvParam)
 {
     static uint8_t ucStr[mainTaskNotifyOUT_STRING_MAX_SIZE];
+    PipelineBlock_t *pxBlock;
     
     while(1) {
-        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-        snprintf(ucStr,mainTaskNotifyOUT_STRING_MAX_SIZE,"\r\n%d.%1d", usADCAverage, usADCAverage_FP);
+        pxBlock = PipelineReceive(&xProcToOut, portMAX_DELAY);
+        if(pxBlock == NULL) {
+            continue;
+        }
+#if mainTaskNotifyBENCHMARK == 0 /* BENCH owns the UART */
+        StageOutFormat((char *)ucStr, mainTaskNotifyOUT_STRING_MAX_SIZE, pxBlock, xAcqToProc.ulDropped);
+        PipelineFree(&xPool, pxBlock);
         PrintStr(ucStr);
-        usADCAverage=0;
+#else
+        PipelineFree(&xPool, pxBlock);
+#endif
+    }
+}
+
+#if mainTaskNotifyBENCHMARK
+/* Source of the benchmark: restarts the ADC at ulRate, stops it for 0 */
+static int8_t prvBenchAdc(uint32_t ulRate)
+{
+    adcScanControl(0);
+    if(ulRate == 0) {
+        return 0;
     }
+    if(adcScanConfig(0x01 << mainTaskNotifyADC_PIN, configPERIPHERAL_CLOCK_HZ, ulRate, mainTaskNotifyADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        return -1;
+    }
+    adcScanControl(1);
+    return 0;
 }
+#endif
 
 /*
  * Create the demo tasks then start the scheduler.
  */
 int mainTaskNotify( void )
 {
+    void __attribute__( (interrupt(IPL3AUTO), vector(_ADC_VECTOR))) vADCInterruptWrapper(void);
+    
     TRISBbits.TRISB0 = 1; // Set AN0 to input mode
-    adcConfig(mainTaskNotifyADC_NUM_SAMPLES, mainTaskNotifyADC_PIN);
-    adcControl(mainTaskNotifyADC_RUN);
+    if(adcScanConfig(0x01 << mainTaskNotifyADC_PIN, configPERIPHERAL_CLOCK_HZ, mainTaskNotifyADC_SAMPLE_RATE, mainTaskNotifyADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    IPC6bits.AD1IP = 3; /* Interrupt priority, must not exceed configMAX_SYSCALL_INTERRUPT_PRIORITY */
+    StatsIsrName(mainTaskNotifySTATS_ISR_ADC, "ADC");
 
-    
 	// Init UART and redirect tdin/stdot/stderr to UART
     if(UartInit(configPERIPHERAL_CLOCK_HZ, 115200) != UART_SUCCESS) {
         PORTAbits.RA3 = 1; // If Led active error initializing UART
@@ -115,9 +174,31 @@ int mainTaskNotify( void )
      __XC_UART = 1; /* Redirect stdin/stdout/stderr to UART1*/
           
     /* Create the tasks defined within this file. */
-	xTaskCreate( pvAcq, ( const signed char * const )  "Acq",  configMINIMAL_STACK_SIZE, NULL, mainTaskNotifyTASK_ACQ_PRIORITY, NULL );
     xTaskCreate( pvProc, ( const signed char * const ) "Proc", configMINIMAL_STACK_SIZE, NULL, mainTaskNotifyTASK_PROC_PRIORITY, &xProc );
     xTaskCreate( pvOut, ( const signed char * const )  "Out",  configMINIMAL_STACK_SIZE, NULL, mainTaskNotifyTASK_OUT_PRIORITY, &xOut );
+#if mainTaskNotifyRUN_STATS
+    if(StatsStart(mainTaskNotifyTASK_STATS_PRIORITY, mainTaskNotifyRUN_STATS_PERIOD_MS) != STATS_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+#endif
+#if mainTaskNotifyBENCHMARK
+    xTaskCreate( PipelineBenchTask, ( const signed char * const ) "Bench", configMINIMAL_STACK_SIZE*2, (void *)&xBench, mainTaskNotifyTASK_BENCH_PRIORITY, NULL );
+#endif
+    
+    /* Pipeline, the consumers are needed by task notification links */
+    if(PipelinePoolInit(&xPool, xBlocks, usSamples, mainTaskNotifyPOOL_BLOCKS, mainTaskNotifyADC_BLOCK_SIZE) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xAcqToProc, mainTaskNotifyPIPELINE_IPC, mainTaskNotifyLINK_DEPTH, xProc) != PIPELINE_SUCCESS ||
+       PipelineLinkInit(&xProcToOut, mainTaskNotifyPIPELINE_IPC, mainTaskNotifyLINK_DEPTH, xOut) != PIPELINE_SUCCESS ||
+       StageProcInit(&xProcStage, &xPool, &xProcToOut, mainTaskNotifyPROC_LOG2_DECIMATION, mainTaskNotifyPROC_NUM_BLOCKS) != DECIMATE_SUCCESS) {
+        PORTAbits.RA3 = 1;
+        while(1);
+    }
+    StageAcqInit(&xAcqStage, &xPool, &xAcqToProc, adcScanRead);
+    
+#if mainTaskNotifyBENCHMARK == 0 /* Otherwise BENCH starts the ADC at each rate */
+    adcScanControl(mainTaskNotifyADC_RUN); /* Interrupts are enabled by the scheduler */
+#endif
  
     /* Finally start the scheduler. */
 	vTaskStartScheduler();
@@ -125,4 +206,20 @@ int mainTaskNotify( void )
 	/* Will only reach here if there is insufficient heap available to start
 	the scheduler. */
 	return 0;
-}
\ No newline at end of file
+}
+
+/* ADC ISR, stage ACQ
+ * 
+ * Runs every mainTaskNotifyADC_SAMPLES_PER_IRQ conversions and appends them to the
+ * current block, see StageAcqFromISR().
+ */
+void vADCInterruptHandler(void)
+{
+    uint32_t ulEnter = statsISR_ENTER();
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    StageAcqFromISR(&xAcqStage, &xHigherPriorityTaskWoken);
+    
+    StatsIsrExit(mainTaskNotifySTATS_ISR_ADC, ulEnter);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
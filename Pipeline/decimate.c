@@ -0,0 +1,129 @@
+/*
+ * File:   decimate.c
+ * Author: Diogo Vala
+ *
+ * Overview: CIC + compensation FIR decimator
+ */
+
+#include <stdlib.h>
+#include "decimate.h"
+
+#if decimateCIC_ORDER != 3
+#error "The CIC kernels are written for 3 stages"
+#endif
+
+/* Q15, sum 32768 (unity DC gain). Least squares fit of the inverse CIC
+ * droop (3 stages, ratio 16) up to 0.2 of the output rate, zero from 0.3
+ * up. The droop barely changes for ratios from 4 up. Symmetric, so the
+ * taps do not need to be reversed in the convolution. */
+static const int16_t sFirCoefficients[decimateFIR_TAPS] = {
+    -618, -469, 1275, 1355, -2400, -3570, 4834, 15977,
+    15977, 4834, -3570, -2400, 1355, 1275, -469, -618
+};
+
+int8_t DecimateInit(Decimator_t *pxDecimator, uint8_t ucLog2Ratio){
+    uint8_t ucIterator;
+
+    if (ucLog2Ratio > decimateMAX_LOG2_RATIO)
+        return DECIMATE_INVALID_RATIO;
+
+    pxDecimator->ucLog2Ratio = ucLog2Ratio;
+    pxDecimator->cShift = decimateCIC_ORDER*ucLog2Ratio + decimateIN_BITS - decimateOUT_BITS;
+    pxDecimator->usPhase = 0;
+    for (ucIterator = 0; ucIterator < decimateCIC_ORDER; ucIterator++) {
+        pxDecimator->ulIntegrator[ucIterator] = 0;
+        pxDecimator->ulComb[ucIterator] = 0;
+    }
+    for (ucIterator = 0; ucIterator < 2*decimateFIR_TAPS; ucIterator++)
+        pxDecimator->lHistory[ucIterator] = 0;
+    pxDecimator->ucHistory = 0;
+
+    return DECIMATE_SUCCESS;
+}
+
+/* Combs, gain scaling and FIR, once per CIC output */
+static uint16_t prvOutput(Decimator_t *pxDecimator, uint32_t ulSample){
+    uint32_t ulComb0, ulComb1, ulComb2;
+    int32_t lCic;
+    const int32_t *plTaps;
+    const int16_t *psCoefficients = sFirCoefficients;
+    int64_t llAccumulator = 0; /* MADD into HI/LO */
+    uint8_t ucTap;
+
+    /* Differences are exact modulo 2^32, whatever the integrators wrapped */
+    ulComb0 = ulSample - pxDecimator->ulComb[0];
+    pxDecimator->ulComb[0] = ulSample;
+    ulComb1 = ulComb0 - pxDecimator->ulComb[1];
+    pxDecimator->ulComb[1] = ulComb0;
+    ulComb2 = ulComb1 - pxDecimator->ulComb[2];
+    pxDecimator->ulComb[2] = ulComb1;
+
+    /* CIC gain is 2^(3*ucLog2Ratio), scale to decimateOUT_BITS, rounded */
+    if (pxDecimator->cShift > 0)
+        lCic = (int32_t)((ulComb2 + (1UL << (pxDecimator->cShift - 1))) >> pxDecimator->cShift);
+    else
+        lCic = (int32_t)(ulComb2 << -pxDecimator->cShift);
+
+    /* Newest sample at ucHistory and ucHistory + decimateFIR_TAPS, the
+     * last decimateFIR_TAPS samples start right after the first copy */
+    pxDecimator->lHistory[pxDecimator->ucHistory] = lCic;
+    pxDecimator->lHistory[pxDecimator->ucHistory + decimateFIR_TAPS] = lCic;
+    plTaps = &pxDecimator->lHistory[pxDecimator->ucHistory + 1];
+    if (++pxDecimator->ucHistory == decimateFIR_TAPS)
+        pxDecimator->ucHistory = 0;
+
+    for (ucTap = 0; ucTap < decimateFIR_TAPS; ucTap += 4) {
+        llAccumulator += (int64_t)plTaps[0]*psCoefficients[0];
+        llAccumulator += (int64_t)plTaps[1]*psCoefficients[1];
+        llAccumulator += (int64_t)plTaps[2]*psCoefficients[2];
+        llAccumulator += (int64_t)plTaps[3]*psCoefficients[3];
+        plTaps += 4;
+        psCoefficients += 4;
+    }
+
+    llAccumulator = (llAccumulator + (1L << (decimateFIR_SHIFT - 1))) >> decimateFIR_SHIFT;
+    if (llAccumulator < 0) /* The FIR overshoots on steps */
+        return 0;
+    if (llAccumulator > UINT16_MAX)
+        return UINT16_MAX;
+    return (uint16_t)llAccumulator;
+}
+
+uint16_t DecimateBlock(Decimator_t *pxDecimator, const uint16_t *pusIn, uint16_t *pusOut, uint16_t usCount){
+    uint16_t usRatio = 1U << pxDecimator->ucLog2Ratio;
+    uint16_t usRun;
+    uint16_t usOut = 0;
+    uint32_t ulInt0 = pxDecimator->ulIntegrator[0]; /* Kept in registers */
+    uint32_t ulInt1 = pxDecimator->ulIntegrator[1];
+    uint32_t ulInt2 = pxDecimator->ulIntegrator[2];
+
+    while (usCount > 0) {
+        /* Inputs up to the next output */
+        usRun = usRatio - pxDecimator->usPhase;
+        if (usRun > usCount)
+            usRun = usCount;
+        usCount -= usRun;
+        pxDecimator->usPhase += usRun;
+
+        for (; usRun >= 4; usRun -= 4) {
+            ulInt0 += pusIn[0]; ulInt1 += ulInt0; ulInt2 += ulInt1;
+            ulInt0 += pusIn[1]; ulInt1 += ulInt0; ulInt2 += ulInt1;
+            ulInt0 += pusIn[2]; ulInt1 += ulInt0; ulInt2 += ulInt1;
+            ulInt0 += pusIn[3]; ulInt1 += ulInt0; ulInt2 += ulInt1;
+            pusIn += 4;
+        }
+        for (; usRun > 0; usRun--) {
+            ulInt0 += *pusIn++; ulInt1 += ulInt0; ulInt2 += ulInt1;
+        }
+
+        if (pxDecimator->usPhase == usRatio) {
+            pxDecimator->usPhase = 0;
+            pusOut[usOut++] = prvOutput(pxDecimator, ulInt2); /* Inputs already read, safe in place */
+        }
+    }
+
+    pxDecimator->ulIntegrator[0] = ulInt0;
+    pxDecimator->ulIntegrator[1] = ulInt1;
+    pxDecimator->ulIntegrator[2] = ulInt2;
+    return usOut;
+}
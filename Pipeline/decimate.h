@@ -0,0 +1,70 @@
+/*
+ * File:   decimate.h
+ * Author: Diogo Vala
+ *
+ * Overview: Oversampling decimator for ADC blocks. A CIC filter
+ *           (decimateCIC_ORDER integrators and combs, differential
+ *           delay 1) reduces the rate by 2^ucLog2Ratio, then a fixed
+ *           point FIR compensates the CIC droop up to 0.2 of the
+ *           output rate and removes what is left from 0.3 of it up.
+ *           The output keeps decimateOUT_BITS bits, the extra bits
+ *           below the ADC LSB come from the averaging.
+ *           decimate_ref.m models it in Octave, Tests/decimate_test.c
+ *           checks it against a floating point reference.
+ */
+
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+
+// Define return codes
+#define DECIMATE_SUCCESS 0
+#define DECIMATE_INVALID_RATIO -1
+
+#define decimateCIC_ORDER 3
+#define decimateIN_BITS 10 /* ADC resolution */
+#define decimateOUT_BITS 16 /* Output full scale, 0 to 2^16-1 */
+#define decimateMAX_LOG2_RATIO 7 /* CIC gain 2^(3*7) on 10 bit samples fits 32 bits */
+#define decimateFIR_TAPS 16 /* Multiple of 4, the FIR loop is unrolled by 4 */
+#define decimateFIR_SHIFT 15 /* Q15 coefficients */
+
+/* Decimator state, kept between blocks */
+typedef struct {
+    uint8_t ucLog2Ratio;
+    int8_t cShift; /* Right shift from CIC gain to decimateOUT_BITS, negative for left */
+    uint16_t usPhase; /* Inputs since the last CIC output */
+    uint32_t ulIntegrator[decimateCIC_ORDER]; /* Wrap around, the combs undo it */
+    uint32_t ulComb[decimateCIC_ORDER]; /* Previous input of each comb */
+    int32_t lHistory[2*decimateFIR_TAPS]; /* FIR input, written twice so the taps are contiguous */
+    uint8_t ucHistory; /* Slot of the next FIR input */
+} Decimator_t;
+
+/********************************************************************
+ * Function: 	 DecimateInit()
+ * Precondition:
+ * Input: 		 pxDecimator - Decimator to initialize
+ *               ucLog2Ratio - Decimation ratio, 2^0 to
+ *                             2^decimateMAX_LOG2_RATIO
+ * Returns:      DECIMATE_SUCCESS if configuration successful.
+ *               DECIMATE_XXX error codes in case of failure.
+ * Overview:     Clears the filter state.
+ * Note:		 The first decimateFIR_TAPS outputs are the filter
+ *               settling from zero.
+ ********************************************************************/
+int8_t DecimateInit(Decimator_t *pxDecimator, uint8_t ucLog2Ratio);
+
+/********************************************************************
+ * Function: 	 DecimateBlock()
+ * Precondition: Decimator initialized
+ * Input: 		 pxDecimator - Decimator
+ *               pusIn - usCount decimateIN_BITS samples
+ *               pusOut - Output, usCount/2^ucLog2Ratio + 1 samples.
+ *                        Can be pusIn, outputs never overtake inputs.
+ * Returns:      Number of output samples
+ * Overview:     Filters a block. Blocks do not need to be a multiple of
+ *               the ratio, the phase carries over to the next block.
+ ********************************************************************/
+uint16_t DecimateBlock(Decimator_t *pxDecimator, const uint16_t *pusIn, uint16_t *pusOut, uint16_t usCount);
+
+#endif
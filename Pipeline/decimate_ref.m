@@ -0,0 +1,52 @@
+function y = decimate_ref(x, log2ratio)
+% Bit exact model of DecimateBlock() (decimate.c)
+%
+% x         - ADC samples, 0-1023, one continuous record
+% log2ratio - decimation ratio 2^log2ratio, 0 to 7
+% y         - output samples, 16 bit full scale (divide by 64 for ADC counts)
+%
+% Starts from a cleared decimator, like DecimateInit(). Splitting x in
+% blocks on the target gives the same output, the state carries over.
+% The first 16 outputs are the FIR settling from zero.
+
+coefficients = [-618 -469 1275 1355 -2400 -3570 4834 15977 ...
+                15977 4834 -3570 -2400 1355 1275 -469 -618];
+order = 3;
+ratio = 2^log2ratio;
+shift = order*log2ratio + 10 - 16;
+wrap = 2^32;
+
+integrator = zeros(1, order);
+comb = zeros(1, order);
+history = zeros(1, numel(coefficients));
+y = zeros(1, floor(numel(x)/ratio));
+
+for n = 1:numel(y)
+    % Integrators, modulo 2^32 like the uint32_t ones
+    for k = (n-1)*ratio + 1 : n*ratio
+        integrator(1) = mod(integrator(1) + x(k), wrap);
+        integrator(2) = mod(integrator(2) + integrator(1), wrap);
+        integrator(3) = mod(integrator(3) + integrator(2), wrap);
+    end
+
+    % Combs
+    sample = integrator(3);
+    for stage = 1:order
+        difference = mod(sample - comb(stage), wrap);
+        comb(stage) = sample;
+        sample = difference;
+    end
+
+    % Gain scaling with rounding
+    if shift > 0
+        sample = floor((sample + 2^(shift-1)) / 2^shift);
+    else
+        sample = sample * 2^-shift;
+    end
+
+    % FIR, Q15, rounded and saturated
+    history = [history(2:end) sample];
+    accumulator = floor((sum(history .* coefficients) + 2^14) / 2^15);
+    y(n) = min(max(accumulator, 0), 65535);
+end
+end
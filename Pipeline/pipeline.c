@@ -0,0 +1,315 @@
+/*
+ * File:   pipeline.c
+ * Author: Diogo Vala
+ *
+ * Overview: Block processing pipeline shared by the DataAcq projects
+ */
+
+#include <xc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pipeline.h"
+
+volatile uint32_t ulPipelineSwitches = 0;
+
+int8_t PipelinePoolInit(PipelinePool_t *pxPool, PipelineBlock_t *pxBlocks, uint16_t *pusSamples,
+        uint8_t ucBlocks, uint16_t usBlockSize){
+
+    uint8_t ucBlock;
+    PipelineBlock_t *pxBlock;
+
+    if (ucBlocks == 0 || usBlockSize == 0)
+        return PIPELINE_INVALID_SIZE;
+
+    pxPool->xFree = xQueueCreate(ucBlocks, sizeof(PipelineBlock_t *));
+    if (pxPool->xFree == NULL)
+        return PIPELINE_NO_MEMORY;
+    pxPool->usBlockSize = usBlockSize;
+
+    for (ucBlock = 0; ucBlock < ucBlocks; ucBlock++) {
+        pxBlock = &pxBlocks[ucBlock];
+        pxBlock->pusSamples = &pusSamples[(uint32_t)ucBlock*usBlockSize];
+        pxBlock->usCount = 0;
+        pxBlock->ulSequence = 0;
+        xQueueSend(pxPool->xFree, &pxBlock, 0);
+    }
+
+    return PIPELINE_SUCCESS;
+}
+
+PipelineBlock_t *PipelineAlloc(PipelinePool_t *pxPool, TickType_t xTicksToWait){
+    PipelineBlock_t *pxBlock;
+
+    if (xQueueReceive(pxPool->xFree, &pxBlock, xTicksToWait) != pdPASS)
+        return NULL;
+
+    pxBlock->usCount = 0;
+    return pxBlock;
+}
+
+PipelineBlock_t *PipelineAllocFromISR(PipelinePool_t *pxPool){
+    PipelineBlock_t *pxBlock;
+
+    if (xQueueReceiveFromISR(pxPool->xFree, &pxBlock, NULL) != pdPASS)
+        return NULL; /* No task waits on a send to the pool, no need to yield */
+
+    pxBlock->usCount = 0;
+    return pxBlock;
+}
+
+void PipelineFree(PipelinePool_t *pxPool, PipelineBlock_t *pxBlock){
+    xQueueSend(pxPool->xFree, &pxBlock, 0); /* Never full, the pool holds all blocks */
+}
+
+int8_t PipelineLinkInit(PipelineLink_t *pxLink, uint8_t ucIpc, uint8_t ucDepth, TaskHandle_t xConsumer){
+
+    if (ucDepth == 0 || ucDepth > pipelineMAX_DEPTH)
+        return PIPELINE_INVALID_SIZE;
+
+    pxLink->ucIpc = ucIpc;
+    pxLink->ucDepth = ucDepth;
+    pxLink->xQueue = NULL;
+    pxLink->xSemaphore = NULL;
+    pxLink->xConsumer = xConsumer;
+    RingInit(&pxLink->xRing, pxLink->pvSlots, ringSLOTS(ucDepth));
+    PipelineBenchReset(pxLink);
+
+    switch (ucIpc) {
+        case pipelineIPC_QUEUE:
+            pxLink->xQueue = xQueueCreate(ucDepth, sizeof(PipelineBlock_t *));
+            if (pxLink->xQueue == NULL)
+                return PIPELINE_NO_MEMORY;
+            break;
+
+        case pipelineIPC_SEMPHR:
+            pxLink->xSemaphore = xSemaphoreCreateCounting(ucDepth, 0);
+            if (pxLink->xSemaphore == NULL)
+                return PIPELINE_NO_MEMORY;
+            break;
+
+        case pipelineIPC_TASK_NOTIFY:
+            if (xConsumer == NULL)
+                return PIPELINE_INVALID_IPC;
+            break;
+
+        default:
+            return PIPELINE_INVALID_IPC;
+    }
+
+    return PIPELINE_SUCCESS;
+}
+
+BaseType_t PipelineSend(PipelineLink_t *pxLink, PipelineBlock_t *pxBlock){
+    BaseType_t xStatus;
+
+    pxBlock->ulStamp = pipelineTIMESTAMP();
+
+    if (pxLink->ucIpc == pipelineIPC_QUEUE) {
+        xStatus = xQueueSend(pxLink->xQueue, &pxBlock, 0);
+    } else {
+        xStatus = RingPut(&pxLink->xRing, pxBlock) ? pdPASS : pdFAIL;
+        if (xStatus == pdPASS) {
+            if (pxLink->ucIpc == pipelineIPC_SEMPHR)
+                xSemaphoreGive(pxLink->xSemaphore);
+            else
+                xTaskNotifyGive(pxLink->xConsumer);
+        }
+    }
+
+    if (xStatus == pdPASS)
+        pxLink->ulSent++;
+    else
+        pxLink->ulDropped++;
+    return xStatus;
+}
+
+BaseType_t PipelineSendFromISR(PipelineLink_t *pxLink, PipelineBlock_t *pxBlock, BaseType_t *pxHigherPriorityTaskWoken){
+    BaseType_t xStatus;
+
+    pxBlock->ulStamp = pipelineTIMESTAMP();
+
+    if (pxLink->ucIpc == pipelineIPC_QUEUE) {
+        xStatus = xQueueSendFromISR(pxLink->xQueue, &pxBlock, pxHigherPriorityTaskWoken);
+    } else {
+        xStatus = RingPut(&pxLink->xRing, pxBlock) ? pdPASS : pdFAIL;
+        if (xStatus == pdPASS) {
+            if (pxLink->ucIpc == pipelineIPC_SEMPHR)
+                xSemaphoreGiveFromISR(pxLink->xSemaphore, pxHigherPriorityTaskWoken);
+            else
+                vTaskNotifyGiveFromISR(pxLink->xConsumer, pxHigherPriorityTaskWoken);
+        }
+    }
+
+    if (xStatus == pdPASS)
+        pxLink->ulSent++;
+    else
+        pxLink->ulDropped++;
+    return xStatus;
+}
+
+/* Adds one send to receive latency to the histogram of the link */
+static void prvLatencyAdd(PipelineLatency_t *pxLatency, uint32_t ulTicks){
+    uint8_t ucBin = 0;
+    uint32_t ulRange = ulTicks >> pipelineHIST_SHIFT;
+
+    while (ulRange != 0 && ucBin < pipelineHIST_BINS - 1) {
+        ulRange >>= 1;
+        ucBin++;
+    }
+
+    pxLatency->ulBins[ucBin]++;
+    pxLatency->ulCount++;
+    pxLatency->ullSum += ulTicks;
+    if (ulTicks < pxLatency->ulMin)
+        pxLatency->ulMin = ulTicks;
+    if (ulTicks > pxLatency->ulMax)
+        pxLatency->ulMax = ulTicks;
+}
+
+PipelineBlock_t *PipelineReceive(PipelineLink_t *pxLink, TickType_t xTicksToWait){
+    PipelineBlock_t *pxBlock = NULL;
+
+    switch (pxLink->ucIpc) {
+        case pipelineIPC_QUEUE:
+            if (xQueueReceive(pxLink->xQueue, &pxBlock, xTicksToWait) != pdPASS)
+                pxBlock = NULL;
+            break;
+
+        case pipelineIPC_SEMPHR:
+            if (xSemaphoreTake(pxLink->xSemaphore, xTicksToWait) == pdTRUE)
+                pxBlock = RingGet(&pxLink->xRing);
+            break;
+
+        case pipelineIPC_TASK_NOTIFY:
+            if (ulTaskNotifyTake(pdFALSE, xTicksToWait) != 0) /* Decrement, one block per notification */
+                pxBlock = RingGet(&pxLink->xRing);
+            break;
+    }
+
+    if (pxBlock != NULL)
+        prvLatencyAdd(&pxLink->xLatency, pipelineTIMESTAMP() - pxBlock->ulStamp);
+    return pxBlock;
+}
+
+void PipelineStatsReset(PipelineStats_t *pxStats){
+    pxStats->ulCount = 0;
+    pxStats->ullSum = 0;
+    pxStats->ullSumSquares = 0;
+    pxStats->usMin = UINT16_MAX;
+    pxStats->usMax = 0;
+}
+
+void PipelineStatsUpdate(PipelineStats_t *pxStats, const PipelineBlock_t *pxBlock){
+    uint16_t usIterator;
+    uint16_t usSample;
+    uint32_t ulSum = 0; /* Per block sums fit 32 bits, fewer 64 bit additions */
+    uint64_t ullSumSquares = 0;
+
+    for (usIterator = 0; usIterator < pxBlock->usCount; usIterator++) {
+        usSample = pxBlock->pusSamples[usIterator];
+        ulSum += usSample;
+        ullSumSquares += (uint32_t)usSample*usSample;
+        if (usSample < pxStats->usMin)
+            pxStats->usMin = usSample;
+        if (usSample > pxStats->usMax)
+            pxStats->usMax = usSample;
+    }
+
+    pxStats->ulCount += pxBlock->usCount;
+    pxStats->ullSum += ulSum;
+    pxStats->ullSumSquares += ullSumSquares;
+}
+
+uint32_t PipelineStatsMean(const PipelineStats_t *pxStats, uint16_t usScale){
+    return (uint32_t)(pxStats->ullSum*usScale/pxStats->ulCount);
+}
+
+uint32_t PipelineStatsVariance(const PipelineStats_t *pxStats, uint16_t usScale){
+    uint64_t ullN = pxStats->ulCount;
+
+    /* (n*sum(x^2) - sum(x)^2)/n^2, no fractional mean */
+    return (uint32_t)((ullN*pxStats->ullSumSquares - pxStats->ullSum*pxStats->ullSum)*usScale/(ullN*ullN));
+}
+
+void PipelineBenchReset(PipelineLink_t *pxLink){
+    uint8_t ucBin;
+
+    taskENTER_CRITICAL(); /* The ISR may be sending */
+    pxLink->ulSent = 0;
+    pxLink->ulDropped = 0;
+    taskEXIT_CRITICAL();
+
+    pxLink->xLatency.ulCount = 0;
+    pxLink->xLatency.ulMin = UINT32_MAX;
+    pxLink->xLatency.ulMax = 0;
+    pxLink->xLatency.ullSum = 0;
+    for (ucBin = 0; ucBin < pipelineHIST_BINS; ucBin++)
+        pxLink->xLatency.ulBins[ucBin] = 0;
+}
+
+void PipelineBenchReport(const char *pcName, const PipelineLink_t *pxLink){
+    const PipelineLatency_t *pxLatency = &pxLink->xLatency;
+    uint32_t ulTicksPerUs = pipelineTIMESTAMP_HZ/1000000;
+    uint8_t ucBin;
+
+    printf("\r\n%s: %u sent, %u dropped", pcName, (unsigned)pxLink->ulSent, (unsigned)pxLink->ulDropped);
+    if (pxLatency->ulCount == 0)
+        return;
+
+    printf("\r\n  latency us: min %u mean %u max %u", (unsigned)(pxLatency->ulMin/ulTicksPerUs),
+            (unsigned)(pxLatency->ullSum/pxLatency->ulCount/ulTicksPerUs), (unsigned)(pxLatency->ulMax/ulTicksPerUs));
+    printf("\r\n  histogram (ticks < count):");
+    for (ucBin = 0; ucBin < pipelineHIST_BINS; ucBin++) {
+        if (pxLatency->ulBins[ucBin] == 0)
+            continue;
+        if (ucBin == pipelineHIST_BINS - 1)
+            printf(" inf:%u", (unsigned)pxLatency->ulBins[ucBin]);
+        else
+            printf(" %u:%u", 1u << (ucBin + pipelineHIST_SHIFT), (unsigned)pxLatency->ulBins[ucBin]);
+    }
+}
+
+void PipelineBench(const PipelineBench_t *pxBench){
+    PipelineBenchResult_t xResult;
+    uint32_t ulSwitches;
+    uint8_t ucRate;
+
+    printf("\r\nIPC benchmark, pipelineIPC %u, %u sample blocks", pxBench->ucIpc, pxBench->usBlockSize);
+
+    for (ucRate = 0; ucRate < pxBench->ucRates; ucRate++) {
+        xResult.ulRate = pxBench->pulRates[ucRate];
+        xResult.ulDelivered = 0;
+        xResult.ulDropped = 0;
+        xResult.ulSwitches = 0;
+
+        pxBench->pxSourceStart(0);
+        PipelineBenchReset(pxBench->pxAcqToProc);
+        PipelineBenchReset(pxBench->pxProcToOut);
+        ulSwitches = ulPipelineSwitches;
+        if (pxBench->pxSourceStart(xResult.ulRate) != 0) {
+            printf("\r\n%u S/s: rate not supported", (unsigned)xResult.ulRate);
+            xResult.ulRate = 0;
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(pxBench->ulPeriodMs));
+
+            xResult.ulSwitches = (ulPipelineSwitches - ulSwitches)*1000ULL/pxBench->ulPeriodMs;
+            xResult.ulDelivered = (uint64_t)pxBench->pxAcqToProc->ulSent*pxBench->usBlockSize*1000/pxBench->ulPeriodMs;
+            xResult.ulDropped = pxBench->pxAcqToProc->ulDropped;
+            printf("\r\n\r\n%u S/s: %u S/s delivered, %u switches/s", (unsigned)xResult.ulRate,
+                    (unsigned)xResult.ulDelivered, (unsigned)xResult.ulSwitches);
+            PipelineBenchReport("ACQ->PROC", pxBench->pxAcqToProc);
+            PipelineBenchReport("PROC->OUT", pxBench->pxProcToOut);
+        }
+
+        if (pxBench->pxResults != NULL)
+            pxBench->pxResults[ucRate] = xResult;
+    }
+
+    pxBench->pxSourceStart(0);
+    printf("\r\n\r\nDone");
+}
+
+void PipelineBenchTask(void *pvParameters){
+    PipelineBench((const PipelineBench_t *)pvParameters);
+    vTaskSuspend(NULL);
+}
@@ -0,0 +1,245 @@
+/*
+ * File:   pipeline.h
+ * Author: Diogo Vala
+ *
+ * Overview: Block processing pipeline shared by the DataAcq projects.
+ *           Sample blocks come from a pool of preallocated buffers and
+ *           only their pointers move between stages. The link between
+ *           two stages can use a queue, a semaphore or a task
+ *           notification, to compare the three IPC mechanisms.
+ *           Every link keeps a latency histogram, measured with the
+ *           core timer from send to receive.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "ring.h"
+
+// Define return codes
+#define PIPELINE_SUCCESS 0
+#define PIPELINE_INVALID_SIZE -1
+#define PIPELINE_INVALID_IPC -2
+#define PIPELINE_NO_MEMORY -3
+
+/* IPC used by a link */
+#define pipelineIPC_QUEUE 0 /* Queue of block pointers */
+#define pipelineIPC_SEMPHR 1 /* Pointer ring, counting semaphore */
+#define pipelineIPC_TASK_NOTIFY 2 /* Pointer ring, consumer task notification */
+
+#define pipelineMAX_DEPTH 8 /* Max blocks waiting in a link */
+
+/* Latency measurement */
+#ifndef pipelineTIMESTAMP
+#define pipelineTIMESTAMP() _CP0_GET_COUNT() /* Core timer, SYSCLK/2 */
+#define pipelineTIMESTAMP_HZ (configCPU_CLOCK_HZ/2)
+#endif
+#define pipelineHIST_BINS 16
+#define pipelineHIST_SHIFT 6 /* Bin 0: < 2^6 ticks, bin i: [2^(i+5), 2^(i+6)) ticks, last bin: the rest */
+
+/* Running statistics of the samples */
+typedef struct {
+    uint32_t ulCount; /* Samples */
+    uint64_t ullSum;
+    uint64_t ullSumSquares;
+    uint16_t usMin;
+    uint16_t usMax;
+} PipelineStats_t;
+
+/* Block of samples */
+typedef struct {
+    uint16_t *pusSamples;
+    uint16_t usCount; /* Valid samples */
+    uint32_t ulSequence; /* Set by the producer, gaps show dropped blocks */
+    uint32_t ulStamp; /* pipelineTIMESTAMP() when sent */
+    PipelineStats_t xStats; /* Filled by the stage that computes them */
+} PipelineBlock_t;
+
+/* Send to receive latency of a link, in pipelineTIMESTAMP() ticks */
+typedef struct {
+    uint32_t ulCount;
+    uint32_t ulMin;
+    uint32_t ulMax;
+    uint64_t ullSum;
+    uint32_t ulBins[pipelineHIST_BINS];
+} PipelineLatency_t;
+
+/* Pool of free blocks */
+typedef struct {
+    QueueHandle_t xFree; /* Pointers to the free blocks */
+    uint16_t usBlockSize; /* Samples per block */
+} PipelinePool_t;
+
+/* Link between two stages, one producer and one consumer */
+typedef struct {
+    uint8_t ucIpc; /* pipelineIPC_XXX */
+    uint8_t ucDepth;
+    QueueHandle_t xQueue; /* pipelineIPC_QUEUE */
+    SemaphoreHandle_t xSemaphore; /* pipelineIPC_SEMPHR */
+    TaskHandle_t xConsumer; /* pipelineIPC_TASK_NOTIFY */
+    Ring_t xRing; /* Semaphore and notify links, block pointers */
+    void * volatile pvSlots[ringSLOTS(pipelineMAX_DEPTH)];
+    volatile uint32_t ulSent;
+    volatile uint32_t ulDropped; /* Link full */
+    PipelineLatency_t xLatency; /* Updated by the consumer */
+} PipelineLink_t;
+
+/* Result of one rate of the benchmark */
+typedef struct {
+    uint32_t ulRate; /* Conversions per second, 0 if the source does not support it */
+    uint32_t ulDelivered; /* Samples per second sent to PROC */
+    uint32_t ulDropped; /* Blocks dropped by ACQ, PROC behind */
+    uint32_t ulSwitches; /* Context switches per second */
+} PipelineBenchResult_t;
+
+/* IPC benchmark of a three stage pipeline, ACQ -> PROC -> OUT */
+typedef struct {
+    PipelineLink_t *pxAcqToProc;
+    PipelineLink_t *pxProcToOut;
+    uint8_t ucIpc; /* pipelineIPC_XXX of the links, printed */
+    uint16_t usBlockSize; /* Samples per block */
+    const uint32_t *pulRates; /* Swept, conversions per second */
+    uint8_t ucRates;
+    uint32_t ulPeriodMs; /* Measurement time of each rate */
+    int8_t (*pxSourceStart)(uint32_t ulRate); /* Starts ACQ at ulRate, 0 on success. Stops it for 0. */
+    PipelineBenchResult_t *pxResults; /* ucRates results, NULL for none */
+} PipelineBench_t;
+
+extern volatile uint32_t ulPipelineSwitches; /* Context switches, counted by traceTASK_SWITCHED_IN() */
+
+/********************************************************************
+ * Function: 	 PipelinePoolInit()
+ * Precondition:
+ * Input: 		 pxPool - Pool to initialize
+ *               pxBlocks - ucBlocks block descriptors
+ *               pusSamples - ucBlocks*usBlockSize samples of storage
+ *               ucBlocks, usBlockSize - Number and size of the blocks
+ * Returns:      PIPELINE_SUCCESS if configuration successful.
+ *               PIPELINE_XXX error codes in case of failure.
+ * Overview:     Splits the storage into blocks, all of them free.
+ ********************************************************************/
+int8_t PipelinePoolInit(PipelinePool_t *pxPool, PipelineBlock_t *pxBlocks, uint16_t *pusSamples,
+        uint8_t ucBlocks, uint16_t usBlockSize);
+
+/********************************************************************
+ * Function: 	 PipelineAlloc() / PipelineAllocFromISR()
+ * Precondition: Pool initialized
+ * Input: 		 pxPool - Pool
+ *               xTicksToWait - Time to wait for a free block
+ * Returns:      Free block, with usCount = 0. NULL if there is none.
+ * Overview:     Takes a block from the pool.
+ ********************************************************************/
+PipelineBlock_t *PipelineAlloc(PipelinePool_t *pxPool, TickType_t xTicksToWait);
+PipelineBlock_t *PipelineAllocFromISR(PipelinePool_t *pxPool);
+
+/********************************************************************
+ * Function: 	 PipelineFree()
+ * Precondition: Block taken from pxPool
+ * Input: 		 pxPool - Pool
+ *               pxBlock - Block to return
+ * Overview:     Returns a block to the pool.
+ ********************************************************************/
+void PipelineFree(PipelinePool_t *pxPool, PipelineBlock_t *pxBlock);
+
+/********************************************************************
+ * Function: 	 PipelineLinkInit()
+ * Precondition: Consumer task created (pipelineIPC_TASK_NOTIFY)
+ * Input: 		 pxLink - Link to initialize
+ *               ucIpc - pipelineIPC_XXX
+ *               ucDepth - Blocks that can wait, 1 to pipelineMAX_DEPTH
+ *               xConsumer - Task that receives, for pipelineIPC_TASK_NOTIFY.
+ *                           Its notification is used by the link.
+ * Returns:      PIPELINE_SUCCESS if configuration successful.
+ *               PIPELINE_XXX error codes in case of failure.
+ * Overview:     Creates the IPC object of the link.
+ ********************************************************************/
+int8_t PipelineLinkInit(PipelineLink_t *pxLink, uint8_t ucIpc, uint8_t ucDepth, TaskHandle_t xConsumer);
+
+/********************************************************************
+ * Function: 	 PipelineSend() / PipelineSendFromISR()
+ * Precondition: Link initialized
+ * Input: 		 pxLink - Link
+ *               pxBlock - Block handed to the consumer
+ *               pxHigherPriorityTaskWoken - FromISR only
+ * Returns:      pdPASS, or pdFAIL if the link is full. The block is
+ *               not freed then, the producer still owns it.
+ * Overview:     Passes the block pointer to the next stage.
+ ********************************************************************/
+BaseType_t PipelineSend(PipelineLink_t *pxLink, PipelineBlock_t *pxBlock);
+BaseType_t PipelineSendFromISR(PipelineLink_t *pxLink, PipelineBlock_t *pxBlock, BaseType_t *pxHigherPriorityTaskWoken);
+
+/********************************************************************
+ * Function: 	 PipelineReceive()
+ * Precondition: Link initialized. Only called by the consumer task.
+ * Input: 		 pxLink - Link
+ *               xTicksToWait - Time to wait for a block
+ * Returns:      Next block, NULL on timeout.
+ * Overview:     Gets the oldest block sent through the link.
+ ********************************************************************/
+PipelineBlock_t *PipelineReceive(PipelineLink_t *pxLink, TickType_t xTicksToWait);
+
+/********************************************************************
+ * Function: 	 PipelineStatsReset() / PipelineStatsUpdate()
+ * Precondition:
+ * Input: 		 pxStats - Statistics
+ *               pxBlock - Samples to add
+ * Overview:     Running count, sum, sum of squares, min and max.
+ ********************************************************************/
+void PipelineStatsReset(PipelineStats_t *pxStats);
+void PipelineStatsUpdate(PipelineStats_t *pxStats, const PipelineBlock_t *pxBlock);
+
+/********************************************************************
+ * Function: 	 PipelineStatsMean() / PipelineStatsVariance()
+ * Precondition: pxStats->ulCount > 0
+ * Input: 		 pxStats - Statistics
+ *               usScale - Result scale, e.g. 10 for one decimal
+ * Returns:      Mean*usScale, and variance*usScale, rounded down.
+ ********************************************************************/
+uint32_t PipelineStatsMean(const PipelineStats_t *pxStats, uint16_t usScale);
+uint32_t PipelineStatsVariance(const PipelineStats_t *pxStats, uint16_t usScale);
+
+/********************************************************************
+ * Function: 	 PipelineBenchReset()
+ * Precondition: Link initialized
+ * Input: 		 pxLink - Link
+ * Overview:     Clears the sent/dropped counters and the latency
+ *               histogram, to start a measurement.
+ ********************************************************************/
+void PipelineBenchReset(PipelineLink_t *pxLink);
+
+/********************************************************************
+ * Function: 	 PipelineBenchReport()
+ * Precondition: stdout redirected to the UART
+ * Input: 		 pcName - Link name to print
+ *               pxLink - Link
+ * Overview:     Prints blocks sent/dropped, latency min/mean/max (us)
+ *               and the latency histogram.
+ * Note:		 Not atomic, the counters can move while printing.
+ ********************************************************************/
+void PipelineBenchReport(const char *pcName, const PipelineLink_t *pxLink);
+
+/********************************************************************
+ * Function: 	 PipelineBench()
+ * Precondition: Pipeline running, ACQ stopped. stdout redirected to
+ *               the UART.
+ * Input: 		 pxBench - Links, rates and source of the benchmark
+ * Overview:     Runs ACQ at each rate for ulPeriodMs and prints the
+ *               samples delivered to PROC, the context switches and
+ *               the report of both links. Stops ACQ when done.
+ ********************************************************************/
+void PipelineBench(const PipelineBench_t *pxBench);
+
+/********************************************************************
+ * Function: 	 PipelineBenchTask()
+ * Input: 		 pvParameters - const PipelineBench_t *
+ * Overview:     Task that runs PipelineBench() once, then suspends.
+ *               Create it above the priority of the pipeline tasks.
+ ********************************************************************/
+void PipelineBenchTask(void *pvParameters);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * File:   ring.h
+ * Author: Diogo Vala
+ *
+ * Overview: Lock-free single producer, single consumer ring of pointers.
+ *           The producer only writes the head and the consumer only
+ *           writes the tail, so an ISR and a task can share a ring
+ *           without critical sections. A put on a full ring fails and is
+ *           counted, it never blocks or overwrites. Header only, the
+ *           functions are inlined in the ISRs that use them.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Storage for a ring of n entries, one slot always empty */
+#define ringSLOTS(n) ((n) + 1)
+
+/* Ring of pointers */
+typedef struct {
+    void * volatile *ppvSlots; /* usSlots entries */
+    uint16_t usSlots;
+    volatile uint16_t usHead; /* Next slot to write, written by the producer */
+    volatile uint16_t usTail; /* Next slot to read, written by the consumer */
+    volatile uint32_t ulOverflows; /* Failed puts, written by the producer */
+} Ring_t;
+
+/* Prevents the compiler from moving memory accesses across it. The
+ * PIC32MX core is single issue and in order, no hardware barrier needed */
+#define ringBARRIER() __asm__ volatile ("" ::: "memory")
+
+/********************************************************************
+ * Function: 	 RingInit()
+ * Precondition: Neither side is using the ring
+ * Input: 		 pxRing - Ring to initialize
+ *               ppvSlots - Storage, ringSLOTS(capacity) entries
+ *               usSlots - Number of entries of ppvSlots, at least 2
+ * Overview:     Empties the ring and clears the overflow counter.
+ ********************************************************************/
+static inline void RingInit(Ring_t *pxRing, void * volatile *ppvSlots, uint16_t usSlots){
+    pxRing->ppvSlots = ppvSlots;
+    pxRing->usSlots = usSlots;
+    pxRing->usHead = 0;
+    pxRing->usTail = 0;
+    pxRing->ulOverflows = 0;
+}
+
+/********************************************************************
+ * Function: 	 RingPut()
+ * Precondition: Ring initialized. Only called by the producer.
+ * Input: 		 pxRing - Ring
+ *               pvItem - Pointer to add
+ * Returns:      1 if added, 0 if the ring is full (ulOverflows counts it)
+ ********************************************************************/
+static inline uint8_t RingPut(Ring_t *pxRing, void *pvItem){
+    uint16_t usHead = pxRing->usHead;
+    uint16_t usNext = (usHead + 1 == pxRing->usSlots) ? 0 : usHead + 1;
+
+    if (usNext == pxRing->usTail) {
+        pxRing->ulOverflows++;
+        return 0;
+    }
+
+    pxRing->ppvSlots[usHead] = pvItem;
+    ringBARRIER(); /* Publish after the entry is written */
+    pxRing->usHead = usNext;
+    return 1;
+}
+
+/********************************************************************
+ * Function: 	 RingGet()
+ * Precondition: Ring initialized. Only called by the consumer.
+ * Input: 		 pxRing - Ring
+ * Returns:      Oldest pointer, NULL if the ring is empty
+ ********************************************************************/
+static inline void *RingGet(Ring_t *pxRing){
+    uint16_t usTail = pxRing->usTail;
+    void *pvItem;
+
+    if (usTail == pxRing->usHead)
+        return NULL;
+
+    ringBARRIER(); /* Read the entry after seeing the head */
+    pvItem = pxRing->ppvSlots[usTail];
+    ringBARRIER(); /* Free the slot after reading it */
+    pxRing->usTail = (usTail + 1 == pxRing->usSlots) ? 0 : usTail + 1;
+    return pvItem;
+}
+
+/********************************************************************
+ * Function: 	 RingCount()
+ * Precondition: Ring initialized
+ * Input: 		 pxRing - Ring
+ * Returns:      Entries waiting. The other side can change it meanwhile,
+ *               so it is a lower bound for the consumer and an upper
+ *               bound for the producer.
+ ********************************************************************/
+static inline uint16_t RingCount(const Ring_t *pxRing){
+    uint16_t usHead = pxRing->usHead;
+    uint16_t usTail = pxRing->usTail;
+
+    return (usHead >= usTail) ? usHead - usTail : pxRing->usSlots - usTail + usHead;
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * File:   stages.c
+ * Author: Diogo Vala
+ *
+ * Overview: ACQ, PROC and OUT stages of the DataAcq pipeline
+ */
+
+#include <stdio.h>
+#include "stages.h"
+
+void StageAcqInit(StageAcq_t *pxAcq, PipelinePool_t *pxPool, PipelineLink_t *pxLink, uint8_t (*pxRead)(uint16_t *pusDst)){
+    pxAcq->pxPool = pxPool;
+    pxAcq->pxLink = pxLink;
+    pxAcq->pxRead = pxRead;
+    pxAcq->pxBlock = NULL;
+    pxAcq->ulSequence = 0;
+}
+
+void StageAcqFromISR(StageAcq_t *pxAcq, BaseType_t *pxHigherPriorityTaskWoken){
+    PipelineBlock_t *pxBlock = pxAcq->pxBlock;
+
+    if (pxBlock == NULL)
+        pxBlock = PipelineAllocFromISR(pxAcq->pxPool);
+    if (pxBlock == NULL) {
+        pxAcq->pxRead(pxAcq->usDiscard);
+        return;
+    }
+
+    pxBlock->usCount += pxAcq->pxRead(&pxBlock->pusSamples[pxBlock->usCount]);
+
+    if (pxBlock->usCount == pxAcq->pxPool->usBlockSize) {
+        pxBlock->ulSequence = pxAcq->ulSequence++;
+        if (PipelineSendFromISR(pxAcq->pxLink, pxBlock, pxHigherPriorityTaskWoken) == pdPASS)
+            pxBlock = PipelineAllocFromISR(pxAcq->pxPool);
+        else
+            pxBlock->usCount = 0;
+    }
+    pxAcq->pxBlock = pxBlock;
+}
+
+int8_t StageProcInit(StageProc_t *pxProc, PipelinePool_t *pxPool, PipelineLink_t *pxLink,
+        uint8_t ucLog2Ratio, uint8_t ucBlocks){
+
+    pxProc->pxPool = pxPool;
+    pxProc->pxLink = pxLink;
+    pxProc->ucBlocks = ucBlocks;
+    pxProc->ucCount = 0;
+    PipelineStatsReset(&pxProc->xStats);
+    return DecimateInit(&pxProc->xDecimator, ucLog2Ratio);
+}
+
+void StageProcBlock(StageProc_t *pxProc, PipelineBlock_t *pxBlock){
+    pxBlock->usCount = DecimateBlock(&pxProc->xDecimator, pxBlock->pusSamples, pxBlock->pusSamples, pxBlock->usCount);
+    PipelineStatsUpdate(&pxProc->xStats, pxBlock);
+
+    if (++pxProc->ucCount < pxProc->ucBlocks) {
+        PipelineFree(pxProc->pxPool, pxBlock);
+        return;
+    }
+
+    pxBlock->xStats = pxProc->xStats; /* Result travels with the last block */
+    if (PipelineSend(pxProc->pxLink, pxBlock) != pdPASS)
+        PipelineFree(pxProc->pxPool, pxBlock);
+    PipelineStatsReset(&pxProc->xStats);
+    pxProc->ucCount = 0;
+}
+
+uint16_t StageToTemp(uint32_t ulMean10){
+    return ((ulMean10 + (10 << (decimateOUT_BITS - decimateIN_BITS)))*stageMAX_TEMP) >> decimateOUT_BITS;
+}
+
+int StageOutFormat(char *pcStr, size_t xSize, const PipelineBlock_t *pxBlock, uint32_t ulDropped){
+    uint16_t usTemp = StageToTemp(PipelineStatsMean(&pxBlock->xStats, 10));
+
+    return snprintf(pcStr, xSize, "\r\n%d.%1d (%u dropped)", usTemp/10, usTemp%10, (unsigned)ulDropped);
+}
@@ -0,0 +1,117 @@
+/*
+ * File:   stages.h
+ * Author: Diogo Vala
+ *
+ * Overview: Stages of the DataAcq pipeline, shared by the three
+ *           projects and by Tests/dataacq_test.c. ACQ fills blocks
+ *           from the ADC ISR, PROC decimates them and attaches the
+ *           statistics of every ucBlocks of them to the last one, OUT
+ *           turns those into the printed temperature. The tasks and
+ *           the ISR of each mainXXX.c only wait on the links and
+ *           call these.
+ */
+
+#ifndef STAGES_H
+#define STAGES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pipeline.h"
+#include "decimate.h"
+
+#define stageMAX_READ 8 /* Largest read of the ACQ source, adcSCAN_BUFFER_SIZE */
+#define stageMAX_TEMP 100 /* Temperature at ADC full scale */
+
+/* Stage ACQ, run by the ADC ISR */
+typedef struct {
+    PipelinePool_t *pxPool;
+    PipelineLink_t *pxLink; /* To PROC */
+    uint8_t (*pxRead)(uint16_t *pusDst); /* Reads the conversions of one interrupt and clears its flag, adcScanRead() */
+    PipelineBlock_t *pxBlock; /* Block being filled */
+    uint32_t ulSequence;
+    uint16_t usDiscard[stageMAX_READ]; /* Samples read while the pool is empty */
+} StageAcq_t;
+
+/* Stage PROC */
+typedef struct {
+    PipelinePool_t *pxPool;
+    PipelineLink_t *pxLink; /* To OUT */
+    Decimator_t xDecimator;
+    PipelineStats_t xStats; /* Of the blocks since the last result */
+    uint8_t ucBlocks; /* Blocks per result */
+    uint8_t ucCount; /* Blocks in xStats */
+} StageProc_t;
+
+/********************************************************************
+ * Function: 	 StageAcqInit()
+ * Precondition: Pool and link initialized
+ * Input: 		 pxAcq - Stage to initialize
+ *               pxPool - Pool the blocks are taken from
+ *               pxLink - Link to PROC
+ *               pxRead - Source, reads up to stageMAX_READ samples
+ * Overview:     The first block is taken on the first interrupt.
+ ********************************************************************/
+void StageAcqInit(StageAcq_t *pxAcq, PipelinePool_t *pxPool, PipelineLink_t *pxLink, uint8_t (*pxRead)(uint16_t *pusDst));
+
+/********************************************************************
+ * Function: 	 StageAcqFromISR()
+ * Precondition: StageAcqInit() called
+ * Input: 		 pxAcq - Stage
+ *               pxHigherPriorityTaskWoken - Set if PROC was woken
+ * Overview:     Appends the new conversions to the current block. A
+ *               full block is sent to PROC and a new one is taken from
+ *               the pool. If PROC is behind, the block is refilled
+ *               instead, and if the pool is empty the samples are
+ *               discarded. The sequence number of the blocks shows
+ *               the gaps.
+ * Note:		 To be called from the ADC ISR, which ends with
+ *               portEND_SWITCHING_ISR().
+ ********************************************************************/
+void StageAcqFromISR(StageAcq_t *pxAcq, BaseType_t *pxHigherPriorityTaskWoken);
+
+/********************************************************************
+ * Function: 	 StageProcInit()
+ * Precondition: Pool and link initialized
+ * Input: 		 pxProc - Stage to initialize
+ *               pxPool - Pool the blocks go back to
+ *               pxLink - Link to OUT
+ *               ucLog2Ratio - Decimation ratio, see DecimateInit()
+ *               ucBlocks - Blocks per result, at least 1
+ * Returns:      DECIMATE_SUCCESS if configuration successful.
+ *               DECIMATE_XXX error codes in case of failure.
+ ********************************************************************/
+int8_t StageProcInit(StageProc_t *pxProc, PipelinePool_t *pxPool, PipelineLink_t *pxLink,
+        uint8_t ucLog2Ratio, uint8_t ucBlocks);
+
+/********************************************************************
+ * Function: 	 StageProcBlock()
+ * Precondition: StageProcInit() called. Only called by PROC.
+ * Input: 		 pxProc - Stage
+ *               pxBlock - Block received from ACQ
+ * Overview:     Decimates the block in place and adds it to the
+ *               statistics. The block of every ucBlocks-th call
+ *               carries them to OUT, or is freed if OUT is behind.
+ *               The others are freed.
+ ********************************************************************/
+void StageProcBlock(StageProc_t *pxProc, PipelineBlock_t *pxBlock);
+
+/********************************************************************
+ * Function: 	 StageToTemp()
+ * Input: 		 ulMean10 - Mean decimator output*10 (decimateOUT_BITS
+ *                          full scale)
+ * Returns:      Temperature in tenths of a degree, stageMAX_TEMP at
+ *               full scale.
+ ********************************************************************/
+uint16_t StageToTemp(uint32_t ulMean10);
+
+/********************************************************************
+ * Function: 	 StageOutFormat()
+ * Input: 		 pcStr, xSize - Destination string
+ *               pxBlock - Block received from PROC
+ *               ulDropped - Blocks dropped by ACQ so far
+ * Returns:      Length of the string, as snprintf().
+ * Overview:     Line printed by OUT, "\r\n<temperature> (n dropped)".
+ ********************************************************************/
+int StageOutFormat(char *pcStr, size_t xSize, const PipelineBlock_t *pxBlock, uint32_t ulDropped);
+
+#endif
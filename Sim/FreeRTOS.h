@@ -0,0 +1,47 @@
+/*
+ * File:   FreeRTOS.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host (Linux/POSIX) stand-in for the FreeRTOS kernel, the
+ *           subset used by the shared modules (Pipeline/, UART/). It
+ *           has no scheduler: the test is the only thread and acts as
+ *           each task in turn (RtosTaskSwitch()), the ISRs run from the
+ *           register model (sfr.h). A call that has to block runs the
+ *           model a PBCLK tick at a time until an ISR unblocks it or
+ *           the timeout expires, so ticks are simulated time.
+ *           Clocks and tick rate are those of the DataAcq FreeRTOSConfig.h.
+ */
+
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define configCPU_CLOCK_HZ (80000000UL)
+#define configPERIPHERAL_CLOCK_HZ (40000000UL)
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configMINIMAL_STACK_SIZE 190
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY 0x03
+#define tskIDLE_PRIORITY 0
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs)*configTICK_RATE_HZ)/(TickType_t)1000))
+#define portEND_SWITCHING_ISR(xSwitchRequired) ((void)(xSwitchRequired)) /* The ISR returns to the same caller */
+#define portYIELD_FROM_ISR(xSwitchRequired) portEND_SWITCHING_ISR(xSwitchRequired)
+
+#define rtosDEADLOCK_TICKS (10*configTICK_RATE_HZ) /* portMAX_DELAY waits abort after 10 s */
+
+void *pvPortMalloc(size_t xSize);
+void vPortFree(void *pv);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * File:   queue.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the FreeRTOS queue API (FreeRTOS.h)
+ */
+
+#ifndef SIM_QUEUE_H
+#define SIM_QUEUE_H
+
+#include "FreeRTOS.h"
+
+typedef struct RtosQueue *QueueHandle_t;
+
+#define xQueueSend(xQueue, pvItemToQueue, xTicksToWait) xQueueGenericSend(xQueue, pvItemToQueue, xTicksToWait)
+#define xQueueSendToBack(xQueue, pvItemToQueue, xTicksToWait) xQueueGenericSend(xQueue, pvItemToQueue, xTicksToWait)
+#define xQueueSendFromISR(xQueue, pvItemToQueue, pxHigherPriorityTaskWoken) \
+        xQueueGenericSendFromISR(xQueue, pvItemToQueue, pxHigherPriorityTaskWoken)
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize);
+void vQueueDelete(QueueHandle_t xQueue);
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken);
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+
+#endif
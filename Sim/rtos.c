@@ -0,0 +1,396 @@
+/*
+ * File:   rtos.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the FreeRTOS queues, semaphores, stream
+ *           buffers and task notifications (FreeRTOS.h), on the
+ *           register model time
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "sfr.h"
+
+#define rtosPB_PER_TICK (configPERIPHERAL_CLOCK_HZ/configTICK_RATE_HZ)
+
+struct RtosTask {
+    const char *pcName;
+    volatile uint32_t ulNotify;
+};
+
+struct RtosQueue {
+    uint8_t *pucItems; /* NULL for a semaphore */
+    UBaseType_t uxLength;
+    UBaseType_t uxItemSize;
+    UBaseType_t uxHead;
+    volatile UBaseType_t uxCount;
+};
+
+struct RtosStreamBuffer {
+    uint8_t *pucData;
+    size_t xSize;
+    size_t xTrigger;
+    size_t xHead;
+    volatile size_t xCount;
+};
+
+static struct RtosTask xMain = {"main", 0};
+static TaskHandle_t xCurrent = &xMain;
+static void (*pxBackground)(void) = NULL; /* RtosSetBackground() */
+
+void *pvPortMalloc(size_t xSize){
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv){
+    free(pv);
+}
+
+/* One PBCLK tick of a blocked task: the background tasks, then the model */
+static void prvBlockedTick(void){
+    TaskHandle_t xBlocked = xCurrent;
+
+    if (pxBackground != NULL) {
+        pxBackground();
+        xCurrent = xBlocked;
+    }
+    SfrRun(1);
+}
+
+/* Runs the model until pxReady() is true or xTicksToWait expire. Returns
+ * pdTRUE if ready. An ISR never waits. */
+static BaseType_t prvWait(BaseType_t (*pxReady)(const void *), const void *pvArg, TickType_t xTicksToWait){
+    uint64_t ullLimit;
+    TickType_t xTicks = (xTicksToWait == portMAX_DELAY) ? rtosDEADLOCK_TICKS : xTicksToWait;
+
+    if (pxReady(pvArg))
+        return pdTRUE;
+    if (xTicksToWait == 0 || xSfr.ucInIsr)
+        return pdFALSE;
+
+    ullLimit = xSfr.ullTicks + (uint64_t)xTicks*rtosPB_PER_TICK;
+    while (!pxReady(pvArg)) {
+        if (xSfr.ullTicks >= ullLimit) {
+            if (xTicksToWait == portMAX_DELAY) {
+                fprintf(stderr, "rtos: task %s blocked for %u ticks, nothing will wake it\n", xCurrent->pcName,
+                        (unsigned)xTicks);
+                abort();
+            }
+            return pdFALSE;
+        }
+        prvBlockedTick();
+    }
+    return pdTRUE;
+}
+
+/*
+ * Tasks
+ */
+
+TaskHandle_t RtosTaskCreate(const char *pcName){
+    TaskHandle_t xTask = pvPortMalloc(sizeof(*xTask));
+
+    if (xTask != NULL) {
+        xTask->pcName = pcName;
+        xTask->ulNotify = 0;
+    }
+    return xTask;
+}
+
+void RtosTaskSwitch(TaskHandle_t xTask){
+    xCurrent = (xTask != NULL) ? xTask : &xMain;
+}
+
+void RtosSetBackground(void (*pxTasks)(void)){
+    pxBackground = pxTasks;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void){
+    return xCurrent;
+}
+
+BaseType_t xTaskGetSchedulerState(void){
+    return taskSCHEDULER_RUNNING;
+}
+
+TickType_t xTaskGetTickCount(void){
+    return (TickType_t)(xSfr.ullTicks/rtosPB_PER_TICK);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay){
+    uint64_t ullEnd = xSfr.ullTicks + (uint64_t)xTicksToDelay*rtosPB_PER_TICK;
+
+    if (pxBackground == NULL) {
+        while (xTicksToDelay--)
+            SfrRun(rtosPB_PER_TICK);
+        return;
+    }
+    while (xSfr.ullTicks < ullEnd)
+        prvBlockedTick();
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend){
+    (void)xTaskToSuspend; /* Nothing resumes it, the caller goes back to the test */
+}
+
+void vTaskEnterCritical(void){
+    SfrCritical(1);
+}
+
+void vTaskExitCritical(void){
+    SfrCritical(0);
+}
+
+BaseType_t xTaskGenericNotifyGive(TaskHandle_t xTaskToNotify){
+    xTaskToNotify->ulNotify++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken){
+    xTaskToNotify->ulNotify++;
+    if (pxHigherPriorityTaskWoken != NULL)
+        *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+static BaseType_t prvNotified(const void *pvTask){
+    return ((const struct RtosTask *)pvTask)->ulNotify != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait){
+    TaskHandle_t xTask = xCurrent;
+    uint32_t ulValue;
+
+    prvWait(prvNotified, xTask, xTicksToWait);
+    ulValue = xTask->ulNotify;
+    if (ulValue != 0)
+        xTask->ulNotify = xClearCountOnExit ? 0 : ulValue - 1;
+    return ulValue;
+}
+
+/*
+ * Queues and semaphores
+ */
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize){
+    QueueHandle_t xQueue;
+
+    if (uxQueueLength == 0)
+        return NULL;
+    xQueue = pvPortMalloc(sizeof(*xQueue));
+    if (xQueue == NULL)
+        return NULL;
+
+    xQueue->pucItems = NULL;
+    if (uxItemSize > 0) {
+        xQueue->pucItems = pvPortMalloc(uxQueueLength*uxItemSize);
+        if (xQueue->pucItems == NULL) {
+            vPortFree(xQueue);
+            return NULL;
+        }
+    }
+    xQueue->uxLength = uxQueueLength;
+    xQueue->uxItemSize = uxItemSize;
+    xQueue->uxHead = 0;
+    xQueue->uxCount = 0;
+    return xQueue;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount){
+    QueueHandle_t xQueue;
+
+    if (uxInitialCount > uxMaxCount)
+        return NULL;
+    xQueue = xQueueCreate(uxMaxCount, 0);
+    if (xQueue != NULL)
+        xQueue->uxCount = uxInitialCount;
+    return xQueue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue){
+    vPortFree(xQueue->pucItems);
+    vPortFree(xQueue);
+}
+
+static BaseType_t prvQueueHasSpace(const void *pvQueue){
+    const struct RtosQueue *pxQueue = pvQueue;
+
+    return pxQueue->uxCount < pxQueue->uxLength;
+}
+
+static BaseType_t prvQueueHasItem(const void *pvQueue){
+    return ((const struct RtosQueue *)pvQueue)->uxCount > 0;
+}
+
+static BaseType_t prvQueuePut(QueueHandle_t xQueue, const void *pvItemToQueue){
+    if (xQueue->uxCount == xQueue->uxLength)
+        return pdFAIL;
+    if (xQueue->uxItemSize > 0)
+        memcpy(&xQueue->pucItems[((xQueue->uxHead + xQueue->uxCount) % xQueue->uxLength)*xQueue->uxItemSize],
+                pvItemToQueue, xQueue->uxItemSize);
+    xQueue->uxCount++;
+    return pdPASS;
+}
+
+static BaseType_t prvQueueGet(QueueHandle_t xQueue, void *pvBuffer){
+    if (xQueue->uxCount == 0)
+        return pdFAIL;
+    if (xQueue->uxItemSize > 0 && pvBuffer != NULL)
+        memcpy(pvBuffer, &xQueue->pucItems[xQueue->uxHead*xQueue->uxItemSize], xQueue->uxItemSize);
+    xQueue->uxHead = (xQueue->uxHead + 1) % xQueue->uxLength;
+    xQueue->uxCount--;
+    return pdPASS;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait){
+    if (!prvWait(prvQueueHasSpace, xQueue, xTicksToWait))
+        return pdFAIL;
+    return prvQueuePut(xQueue, pvItemToQueue);
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken){
+    BaseType_t xStatus = prvQueuePut(xQueue, pvItemToQueue);
+
+    if (xStatus == pdPASS && pxHigherPriorityTaskWoken != NULL)
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    return xStatus;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait){
+    if (!prvWait(prvQueueHasItem, xQueue, xTicksToWait))
+        return pdFAIL;
+    return prvQueueGet(xQueue, pvBuffer);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void *pvBuffer, BaseType_t *pxHigherPriorityTaskWoken){
+    (void)pxHigherPriorityTaskWoken; /* Nothing waits to send */
+    return prvQueueGet(xQueue, pvBuffer);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue){
+    return xQueue->uxCount;
+}
+
+/*
+ * Stream buffers
+ */
+
+StreamBufferHandle_t xStreamBufferCreate(size_t xBufferSizeBytes, size_t xTriggerLevelBytes){
+    StreamBufferHandle_t xStream;
+
+    if (xBufferSizeBytes == 0)
+        return NULL;
+    xStream = pvPortMalloc(sizeof(*xStream));
+    if (xStream == NULL)
+        return NULL;
+    xStream->pucData = pvPortMalloc(xBufferSizeBytes);
+    if (xStream->pucData == NULL) {
+        vPortFree(xStream);
+        return NULL;
+    }
+    xStream->xSize = xBufferSizeBytes;
+    xStream->xTrigger = (xTriggerLevelBytes == 0) ? 1 : xTriggerLevelBytes;
+    xStream->xHead = 0;
+    xStream->xCount = 0;
+    return xStream;
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t xStreamBuffer){
+    vPortFree(xStreamBuffer->pucData);
+    vPortFree(xStreamBuffer);
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t xStreamBuffer){
+    return xStreamBuffer->xCount;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t xStreamBuffer){
+    return xStreamBuffer->xSize - xStreamBuffer->xCount;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t xStreamBuffer){
+    return xStreamBuffer->xCount == 0;
+}
+
+static size_t prvStreamWrite(StreamBufferHandle_t xStream, const uint8_t *pucData, size_t xLength){
+    size_t xCopied;
+
+    if (xLength > xStream->xSize - xStream->xCount)
+        xLength = xStream->xSize - xStream->xCount;
+    for (xCopied = 0; xCopied < xLength; xCopied++)
+        xStream->pucData[(xStream->xHead + xStream->xCount + xCopied) % xStream->xSize] = pucData[xCopied];
+    xStream->xCount += xLength;
+    return xLength;
+}
+
+static size_t prvStreamRead(StreamBufferHandle_t xStream, uint8_t *pucData, size_t xLength){
+    size_t xCopied;
+
+    if (xLength > xStream->xCount)
+        xLength = xStream->xCount;
+    for (xCopied = 0; xCopied < xLength; xCopied++)
+        pucData[xCopied] = xStream->pucData[(xStream->xHead + xCopied) % xStream->xSize];
+    xStream->xHead = (xStream->xHead + xLength) % xStream->xSize;
+    xStream->xCount -= xLength;
+    return xLength;
+}
+
+/* Space wanted by a blocked send, bytes wanted by a blocked receive */
+typedef struct {
+    StreamBufferHandle_t xStream;
+    size_t xWanted;
+} RtosStreamWait_t;
+
+static BaseType_t prvStreamHasSpace(const void *pvWait){
+    const RtosStreamWait_t *pxWait = pvWait;
+
+    return xStreamBufferSpacesAvailable(pxWait->xStream) >= pxWait->xWanted;
+}
+
+static BaseType_t prvStreamHasData(const void *pvWait){
+    const RtosStreamWait_t *pxWait = pvWait;
+
+    return xStreamBufferBytesAvailable(pxWait->xStream) >= pxWait->xWanted;
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+        TickType_t xTicksToWait){
+    RtosStreamWait_t xWait = {xStreamBuffer, xDataLengthBytes};
+
+    /* Waits for room for all of it, then copies what fits */
+    if (xWait.xWanted > xStreamBuffer->xSize)
+        xWait.xWanted = xStreamBuffer->xSize;
+    prvWait(prvStreamHasSpace, &xWait, xTicksToWait);
+    return prvStreamWrite(xStreamBuffer, pvTxData, xDataLengthBytes);
+}
+
+size_t xStreamBufferSendFromISR(StreamBufferHandle_t xStreamBuffer, const void *pvTxData, size_t xDataLengthBytes,
+        BaseType_t *pxHigherPriorityTaskWoken){
+    size_t xSent = prvStreamWrite(xStreamBuffer, pvTxData, xDataLengthBytes);
+
+    if (xSent > 0 && pxHigherPriorityTaskWoken != NULL)
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    return xSent;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+        TickType_t xTicksToWait){
+    RtosStreamWait_t xWait = {xStreamBuffer, xStreamBuffer->xTrigger};
+
+    prvWait(prvStreamHasData, &xWait, xTicksToWait);
+    return prvStreamRead(xStreamBuffer, pvRxData, xBufferLengthBytes);
+}
+
+size_t xStreamBufferReceiveFromISR(StreamBufferHandle_t xStreamBuffer, void *pvRxData, size_t xBufferLengthBytes,
+        BaseType_t *pxHigherPriorityTaskWoken){
+    size_t xReceived = prvStreamRead(xStreamBuffer, pvRxData, xBufferLengthBytes);
+
+    if (xReceived > 0 && pxHigherPriorityTaskWoken != NULL)
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    return xReceived;
+}
@@ -0,0 +1,28 @@
+/*
+ * File:   semphr.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the FreeRTOS semaphore API (FreeRTOS.h).
+ *           Semaphores are queues of empty items, mutexes have no
+ *           priority inheritance since nothing else runs.
+ */
+
+#ifndef SIM_SEMPHR_H
+#define SIM_SEMPHR_H
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateCounting(uxMaxCount, uxInitialCount) xQueueCreateCountingSemaphore(uxMaxCount, uxInitialCount)
+#define xSemaphoreCreateBinary() xQueueCreateCountingSemaphore(1, 0)
+#define xSemaphoreCreateMutex() xQueueCreateCountingSemaphore(1, 1)
+#define xSemaphoreGive(xSemaphore) xQueueGenericSend(xSemaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken) \
+        xQueueGenericSendFromISR(xSemaphore, NULL, pxHigherPriorityTaskWoken)
+#define xSemaphoreTake(xSemaphore, xBlockTime) xQueueReceive(xSemaphore, NULL, xBlockTime)
+#define vSemaphoreDelete(xSemaphore) vQueueDelete(xSemaphore)
+
+QueueHandle_t xQueueCreateCountingSemaphore(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount);
+
+#endif
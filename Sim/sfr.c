@@ -0,0 +1,613 @@
+/*
+ * File:   sfr.c
+ * Author: Diogo Vala
+ *
+ * Overview: PBCLK tick model of the timers, the ADC, UART1, the OC
+ *           modules and the DMA, ISR calls
+ */
+
+#include <string.h>
+#include "sfr.h"
+
+/* Model side view of a register, without the tick of SfrAccess() */
+#define prvREG(name) (prvSync(&xSfr##name)->ulValue)
+#define prvBITS(name) (*(volatile __##name##bits_t *)SfrBits(prvSync(&xSfr##name)))
+
+static const uint16_t usPrescaler[] = {1, 2, 4, 8, 16, 32, 64, 256};
+static const uint8_t ucRxThreshold[] = {1, 4, 6, 6}; /* URXISEL: any, half, 3/4 full */
+
+/* Registers of a DMA channel, in xSfrDCH[] order */
+#define prvDCH_CON 0
+#define prvDCH_ECON 1
+#define prvDCH_INT 2
+#define prvDCH_SSA 3
+#define prvDCH_DSA 4
+#define prvDCH_SSIZ 5
+#define prvDCH_DSIZ 6
+#define prvDCH_SPTR 7 /* Bytes read of the block */
+#define prvDCH_DPTR 8 /* Bytes written of the block */
+#define prvDCH_CSIZ 9
+
+#define prvOCM_PWM 6 /* OCM = 0b110, PWM without fault pin */
+#define prvPHYSICAL_BASE 0x10000000UL /* First SfrPhysical() address, 64 KB each */
+
+Sfr_t xSfr;
+
+SfrReg_t xSfrDDPCON;
+SfrReg_t xSfrINTCON, xSfrIFS0, xSfrIFS1, xSfrIEC0, xSfrIEC1, xSfrIPC2, xSfrIPC3, xSfrIPC6, xSfrIPC9;
+SfrReg_t xSfrT2CON, xSfrTMR2, xSfrPR2;
+SfrReg_t xSfrT3CON, xSfrTMR3, xSfrPR3;
+SfrOc_t xSfrOC[sfrNUM_OC];
+SfrReg_t xSfrDMACON;
+SfrReg_t xSfrDCH[sfrNUM_DMA_CHANNELS*sfrDMA_CHANNEL_REGS];
+SfrReg_t xSfrLATE;
+SfrReg_t xSfrAD1CON1, xSfrAD1CON2, xSfrAD1CON3, xSfrAD1CHS, xSfrAD1PCFG, xSfrAD1CSSL;
+SfrReg_t xSfrU1MODE, xSfrU1BRG;
+static SfrReg_t xSfrU1STA; /* Status bits kept up to date by the model */
+volatile uint32_t ulSfrADC1BUF[16*4];
+
+static SfrReg_t * const pxRegisters[] = {
+    &xSfrDDPCON, &xSfrINTCON, &xSfrIFS0, &xSfrIFS1, &xSfrIEC0, &xSfrIEC1, &xSfrIPC2, &xSfrIPC3, &xSfrIPC6, &xSfrIPC9,
+    &xSfrT2CON, &xSfrTMR2, &xSfrPR2, &xSfrT3CON, &xSfrTMR3, &xSfrPR3,
+    &xSfrAD1CON1, &xSfrAD1CON2, &xSfrAD1CON3, &xSfrAD1CHS, &xSfrAD1PCFG, &xSfrAD1CSSL,
+    &xSfrU1MODE, &xSfrU1BRG, &xSfrU1STA, &xSfrDMACON, &xSfrLATE
+};
+
+/* Host buffers behind the DMA addresses, kept across SfrOpen() */
+static const volatile void *pvPhysical[sfrPHYSICAL_SIZE];
+static uint16_t usPhysicalCount;
+
+/* IFS/IEC bits of each vector */
+typedef struct {
+    SfrReg_t *pxIfs;
+    SfrReg_t *pxIec;
+    uint32_t ulMask;
+} SfrVector_t;
+
+static const SfrVector_t xVectors[sfrNUM_VECTORS] = {
+    {&xSfrIFS1, &xSfrIEC1, _IFS1_AD1IF_MASK},
+    {&xSfrIFS1, &xSfrIEC1, _IFS1_DMA0IF_MASK},
+    {&xSfrIFS0, &xSfrIEC0, _IFS0_INT2IF_MASK},
+    {&xSfrIFS0, &xSfrIEC0, _IFS0_U1TXIF_MASK | _IFS0_U1RXIF_MASK},
+    {&xSfrIFS0, &xSfrIEC0, _IFS0_T3IF_MASK},
+};
+
+static void prvTick(void);
+
+/* Applies the CLR/SET/INV writes */
+static SfrReg_t *prvSync(SfrReg_t *pxReg){
+    uint32_t ulClr = pxReg->ulClr;
+    uint32_t ulSet = pxReg->ulSet;
+    uint32_t ulInv = pxReg->ulInv;
+
+    if (ulClr | ulSet | ulInv) {
+        pxReg->ulValue = ((pxReg->ulValue & ~ulClr) | ulSet) ^ ulInv;
+        pxReg->ulClr = 0;
+        pxReg->ulSet = 0;
+        pxReg->ulInv = 0;
+    }
+    return pxReg;
+}
+
+int8_t SfrOpen(const char *pcUartFile){
+    void (*pvIsr[sfrNUM_VECTORS])(void);
+    uint16_t (*pusAdcInput)(uint8_t, uint64_t) = xSfr.pusAdcInput;
+    uint8_t *pucCapture = xSfr.pucCapture;
+    uint32_t ulCaptureSize = xSfr.ulCaptureSize;
+    SfrOcSample_t *pxOcCapture = xSfr.pxOcCapture;
+    uint32_t ulOcCaptureSize = xSfr.ulOcCaptureSize;
+    uint8_t ucRegister;
+
+    SfrClose();
+    memcpy(pvIsr, xSfr.pvIsr, sizeof(pvIsr));
+    memset(&xSfr, 0, sizeof(xSfr));
+    memcpy(xSfr.pvIsr, pvIsr, sizeof(pvIsr));
+    xSfr.pusAdcInput = pusAdcInput;
+    xSfr.pucCapture = pucCapture;
+    xSfr.ulCaptureSize = ulCaptureSize;
+    xSfr.pxOcCapture = pxOcCapture;
+    xSfr.ulOcCaptureSize = ulOcCaptureSize;
+
+    for (ucRegister = 0; ucRegister < sizeof(pxRegisters)/sizeof(pxRegisters[0]); ucRegister++)
+        memset((void *)pxRegisters[ucRegister], 0, sizeof(SfrReg_t));
+    memset((void *)ulSfrADC1BUF, 0, sizeof(ulSfrADC1BUF));
+    memset(xSfrOC, 0, sizeof(xSfrOC));
+    memset(xSfrDCH, 0, sizeof(xSfrDCH));
+    xSfrPR2.ulValue = 0xFFFF; /* Reset values */
+    xSfrPR3.ulValue = 0xFFFF;
+    ((volatile __U1STAbits_t *)SfrBits(&xSfrU1STA))->TRMT = 1;
+    ((volatile __U1STAbits_t *)SfrBits(&xSfrU1STA))->RIDLE = 1;
+
+    if (pcUartFile != NULL) {
+        xSfr.pxUartFile = fopen(pcUartFile, "wb");
+        if (xSfr.pxUartFile == NULL)
+            return SFR_FILE_ERROR;
+    }
+    return SFR_SUCCESS;
+}
+
+void SfrClose(void){
+    if (xSfr.pxUartFile != NULL) {
+        fclose(xSfr.pxUartFile);
+        xSfr.pxUartFile = NULL;
+    }
+}
+
+void SfrSetIsr(uint8_t ucVector, void (*pvIsr)(void)){
+    if (ucVector < sfrNUM_VECTORS)
+        xSfr.pvIsr[ucVector] = pvIsr;
+}
+
+void SfrCritical(uint8_t ucEnter){
+    if (ucEnter)
+        xSfr.ucCritical++;
+    else if (xSfr.ucCritical > 0)
+        xSfr.ucCritical--;
+}
+
+void SfrAdcSetInput(uint16_t (*pusInput)(uint8_t ucChannel, uint64_t ullTicks)){
+    xSfr.pusAdcInput = pusInput;
+}
+
+void SfrUartCapture(uint8_t *pucBuffer, uint32_t ulSize){
+    xSfr.pucCapture = pucBuffer;
+    xSfr.ulCaptureSize = (pucBuffer != NULL) ? ulSize : 0;
+    xSfr.ulTxBytes = 0;
+}
+
+void SfrUartReceive(const uint8_t *pucData, uint32_t ulLen){
+    xSfr.pucRxData = pucData;
+    xSfr.ulRxLeft = ulLen;
+}
+
+void SfrOcCapture(SfrOcSample_t *pxBuffer, uint32_t ulSize){
+    xSfr.pxOcCapture = pxBuffer;
+    xSfr.ulOcCaptureSize = (pxBuffer != NULL) ? ulSize : 0;
+    xSfr.ulOcPeriods = 0;
+}
+
+void SfrInt2Edge(uint8_t ucRising){
+    if (prvBITS(INTCON).INT2EP == (ucRising != 0))
+        prvREG(IFS0) |= _IFS0_INT2IF_MASK;
+}
+
+uint32_t SfrPhysical(const volatile void *pvAddress){
+    uint16_t usIndex;
+
+    if (pvAddress == NULL)
+        return 0;
+    for (usIndex = 0; usIndex < usPhysicalCount; usIndex++)
+        if (pvPhysical[usIndex] == pvAddress)
+            break;
+    if (usIndex == usPhysicalCount) {
+        if (usPhysicalCount == sfrPHYSICAL_SIZE)
+            return 0;
+        pvPhysical[usPhysicalCount++] = pvAddress;
+    }
+    return prvPHYSICAL_BASE + ((uint32_t)usIndex << 16);
+}
+
+void *SfrVirtual(uint32_t ulAddress){
+    uint32_t ulIndex = (ulAddress - prvPHYSICAL_BASE) >> 16;
+
+    if (ulAddress < prvPHYSICAL_BASE || ulIndex >= usPhysicalCount)
+        return NULL;
+    return (uint8_t *)pvPhysical[ulIndex] + (ulAddress & 0xFFFF);
+}
+
+/* New period of the OC modules on Timer 2 (ucOctsel 0) or Timer 3 (1):
+ * OCxRS becomes the duty. OC1 periods are counted and captured. */
+static void prvOcPeriod(uint8_t ucOctsel){
+    SfrOcSample_t *pxSample;
+    uint32_t ulCon;
+    uint8_t ucModule;
+    uint8_t ucOc1 = 0;
+
+    for (ucModule = 0; ucModule < sfrNUM_OC; ucModule++) {
+        ulCon = prvSync(&xSfrOC[ucModule].xCON)->ulValue;
+        if (!(ulCon & _OC1CON_ON_MASK) || (ulCon & _OC1CON_OCM_MASK) != prvOCM_PWM ||
+            ((ulCon & _OC1CON_OCTSEL_MASK) != 0) != ucOctsel)
+            continue;
+        xSfrOC[ucModule].xR.ulValue = prvSync(&xSfrOC[ucModule].xRS)->ulValue;
+        if (ucModule == 0)
+            ucOc1 = 1;
+    }
+    if (!ucOc1)
+        return;
+
+    if (xSfr.ulOcPeriods < xSfr.ulOcCaptureSize) {
+        pxSample = &xSfr.pxOcCapture[xSfr.ulOcPeriods];
+        for (ucModule = 0; ucModule < sfrNUM_OC; ucModule++)
+            pxSample->usR[ucModule] = xSfrOC[ucModule].xR.ulValue & 0xFFFF;
+        pxSample->usLatE = prvREG(LATE) & 0xFFFF;
+    }
+    xSfr.ulOcPeriods++;
+}
+
+/* Applies the CLR/SET/INV writes of the DMA channels, then their aborts.
+ * Called before every register access, so the writes of one driver
+ * call are applied before those of the next. */
+static void prvDmaSync(void){
+    SfrReg_t *pxChannel;
+    uint8_t ucChannel;
+
+    for (ucChannel = 0; ucChannel < sfrNUM_DMA_CHANNELS; ucChannel++) {
+        pxChannel = &xSfrDCH[ucChannel*sfrDMA_CHANNEL_REGS];
+        prvSync(&pxChannel[prvDCH_CON]);
+        prvSync(&pxChannel[prvDCH_INT]);
+        if (prvSync(&pxChannel[prvDCH_ECON])->ulValue & _DCH0ECON_CABORT_MASK) {
+            pxChannel[prvDCH_SPTR].ulValue = 0;
+            pxChannel[prvDCH_DPTR].ulValue = 0;
+            pxChannel[prvDCH_CON].ulValue &= ~_DCH0CON_CHEN_MASK;
+            pxChannel[prvDCH_ECON].ulValue &= ~_DCH0ECON_CABORT_MASK;
+        }
+    }
+}
+
+/* Size register, 0 is 64 KB */
+static uint32_t prvDmaSize(const SfrReg_t *pxReg){
+    return (pxReg->ulValue & 0xFFFF) ? (pxReg->ulValue & 0xFFFF) : 0x10000;
+}
+
+/* Moves one cell of channel ucChannel. The block ends with the larger of
+ * source and destination. */
+static void prvDmaCell(uint8_t ucChannel){
+    SfrReg_t *pxChannel = &xSfrDCH[ucChannel*sfrDMA_CHANNEL_REGS];
+    const volatile uint8_t *pucSrc = SfrVirtual(pxChannel[prvDCH_SSA].ulValue);
+    volatile uint8_t *pucDst = SfrVirtual(pxChannel[prvDCH_DSA].ulValue);
+    uint32_t ulSrcSize = prvDmaSize(&pxChannel[prvDCH_SSIZ]);
+    uint32_t ulDstSize = prvDmaSize(&pxChannel[prvDCH_DSIZ]);
+    uint32_t ulCellSize = prvDmaSize(&pxChannel[prvDCH_CSIZ]);
+    uint32_t ulBlock = (ulSrcSize > ulDstSize) ? ulSrcSize : ulDstSize;
+    uint32_t ulSrcPtr = pxChannel[prvDCH_SPTR].ulValue;
+    uint32_t ulDstPtr = pxChannel[prvDCH_DPTR].ulValue;
+    uint32_t ulByte;
+    uint32_t ulInt;
+    uint8_t ucRaised = 0;
+
+    if (pucSrc == NULL || pucDst == NULL)
+        return; /* Not an address handed out by SfrPhysical() */
+
+    for (ulByte = 0; ulByte < ulCellSize; ulByte++) {
+        pucDst[ulDstPtr % ulDstSize] = pucSrc[ulSrcPtr % ulSrcSize];
+        ulSrcPtr++;
+        ulDstPtr++;
+        if (ulSrcPtr == ulSrcSize/2)
+            ucRaised |= _DCH0INT_CHSHIF_MASK;
+    }
+
+    if (((ulSrcPtr > ulDstPtr) ? ulSrcPtr : ulDstPtr) >= ulBlock) {
+        ucRaised |= _DCH0INT_CHBCIF_MASK;
+        ulSrcPtr = 0;
+        ulDstPtr = 0;
+        if (!(pxChannel[prvDCH_CON].ulValue & _DCH0CON_CHAEN_MASK))
+            pxChannel[prvDCH_CON].ulValue &= ~_DCH0CON_CHEN_MASK;
+    }
+    pxChannel[prvDCH_SPTR].ulValue = ulSrcPtr;
+    pxChannel[prvDCH_DPTR].ulValue = ulDstPtr;
+
+    ulInt = pxChannel[prvDCH_INT].ulValue | ucRaised;
+    pxChannel[prvDCH_INT].ulValue = ulInt;
+    if (ulInt & (ulInt >> 16) & 0xFF)
+        prvREG(IFS1) |= 1UL << (_IFS1_DMA0IF_POSITION + ucChannel);
+}
+
+/* IRQ ucIrq: one cell on each enabled channel it starts, highest priority first, then lowest channel */
+static void prvDmaTrigger(uint8_t ucIrq){
+    const SfrReg_t *pxChannel;
+    int8_t cPriority;
+    uint8_t ucChannel;
+
+    if (!prvBITS(DMACON).ON)
+        return;
+
+    prvDmaSync();
+    for (cPriority = 3; cPriority >= 0; cPriority--) {
+        for (ucChannel = 0; ucChannel < sfrNUM_DMA_CHANNELS; ucChannel++) {
+            pxChannel = &xSfrDCH[ucChannel*sfrDMA_CHANNEL_REGS];
+            if ((pxChannel[prvDCH_CON].ulValue & _DCH0CON_CHEN_MASK) &&
+                (pxChannel[prvDCH_CON].ulValue & _DCH0CON_CHPRI_MASK) == (uint32_t)cPriority &&
+                (pxChannel[prvDCH_ECON].ulValue & _DCH0ECON_SIRQEN_MASK) &&
+                ((pxChannel[prvDCH_ECON].ulValue & _DCH0ECON_CHSIRQ_MASK) >> _DCH0ECON_CHSIRQ_POSITION) == ucIrq)
+                prvDmaCell(ucChannel);
+        }
+    }
+    prvSync(&xSfrLATE); /* LATECLR/LATESET written by a cell act at once */
+}
+
+/* One conversion into the ADC1BUF half being filled */
+static void prvAdcConvert(void){
+    uint16_t usScan = prvREG(AD1CSSL) & 0xFFFF;
+    uint8_t ucChannel = prvBITS(AD1CHS).CH0SA;
+    uint8_t ucSlot = xSfr.ucAdcCount;
+    uint16_t usValue;
+    uint8_t ucIterator;
+
+    if (prvBITS(AD1CON2).CSCNA && usScan != 0) {
+        for (ucIterator = 0; ucIterator < 16; ucIterator++) {
+            ucChannel = (xSfr.ucAdcScan + ucIterator) & 15;
+            if (usScan & (1 << ucChannel))
+                break;
+        }
+        xSfr.ucAdcScan = (ucChannel + 1) & 15;
+    }
+
+    usValue = (xSfr.pusAdcInput != NULL) ? xSfr.pusAdcInput(ucChannel, xSfr.ullTicks) : 0;
+    if (usValue > 1023)
+        usValue = 1023;
+    if (prvBITS(AD1CON2).BUFM && prvBITS(AD1CON2).BUFS)
+        ucSlot += 8; /* BUFS: filling ADC1BUF8-F */
+    ulSfrADC1BUF[(ucSlot & 15)*4] = usValue;
+    xSfr.ulAdcConversions++;
+    prvBITS(AD1CON1).DONE = 1;
+
+    if (++xSfr.ucAdcCount > prvBITS(AD1CON2).SMPI) {
+        xSfr.ucAdcCount = 0;
+        xSfr.ucAdcScan = 0; /* The scan starts over on each interrupt */
+        prvREG(IFS1) |= _IFS1_AD1IF_MASK;
+        if (prvBITS(AD1CON2).BUFM)
+            prvBITS(AD1CON2).BUFS ^= 1;
+        if (prvBITS(AD1CON1).CLRASAM)
+            prvBITS(AD1CON1).ASAM = 0;
+    }
+}
+
+/* Auto-sample conversions (SSRC=7), the end of a Timer 3 period (SSRC=2) is in prvTimer3Tick() */
+static void prvAdcTick(void){
+    uint32_t ulTad;
+
+    if (!prvBITS(AD1CON1).ON) {
+        xSfr.ucAdcCount = 0;
+        xSfr.ucAdcScan = 0;
+        xSfr.ulAdcDelay = 0;
+        prvBITS(AD1CON2).BUFS = 0;
+        return;
+    }
+    if (prvBITS(AD1CON1).SSRC != 7)
+        return;
+
+    if (xSfr.ulAdcDelay == 0) {
+        if (!prvBITS(AD1CON1).ASAM)
+            return;
+        ulTad = prvBITS(AD1CON3).ADRC ? 4 : 2*(prvBITS(AD1CON3).ADCS + 1); /* Internal RC, about 100 ns */
+        xSfr.ulAdcDelay = (prvBITS(AD1CON3).SAMC + 12)*ulTad;
+    }
+    if (--xSfr.ulAdcDelay == 0)
+        prvAdcConvert();
+}
+
+static void prvTimer2Tick(void){
+    if (!prvBITS(T2CON).ON)
+        return;
+
+    if (xSfr.usT2Prescale > 1) {
+        xSfr.usT2Prescale--;
+        return;
+    }
+    xSfr.usT2Prescale = usPrescaler[prvBITS(T2CON).TCKPS];
+
+    if ((prvREG(TMR2) & 0xFFFF) != (prvREG(PR2) & 0xFFFF)) {
+        prvREG(TMR2)++;
+        return;
+    }
+    prvREG(TMR2) = 0;
+    prvREG(IFS0) |= _IFS0_T2IF_MASK;
+    prvOcPeriod(0);
+    prvDmaTrigger(_TIMER_2_IRQ);
+}
+
+static void prvTimer3Tick(void){
+    if (!prvBITS(T3CON).ON)
+        return;
+
+    if (xSfr.usT3Prescale > 1) {
+        xSfr.usT3Prescale--;
+        return;
+    }
+    xSfr.usT3Prescale = usPrescaler[prvBITS(T3CON).TCKPS];
+
+    if ((prvREG(TMR3) & 0xFFFF) != (prvREG(PR3) & 0xFFFF)) {
+        prvREG(TMR3)++;
+        return;
+    }
+    prvREG(TMR3) = 0;
+    prvREG(IFS0) |= _IFS0_T3IF_MASK;
+    prvOcPeriod(1);
+    prvDmaTrigger(_TIMER_3_IRQ);
+    if (prvBITS(AD1CON1).ON && prvBITS(AD1CON1).SSRC == 2 && (prvBITS(AD1CON1).ASAM || prvBITS(AD1CON1).SAMP))
+        prvAdcConvert();
+}
+
+/* PBCLK ticks of one UART1 frame */
+static uint32_t prvUartFrame(void){
+    uint8_t ucBits = 1 + 8 + prvBITS(U1MODE).STSEL + 1; /* Start, data, stop */
+
+    if (prvBITS(U1MODE).PDSEL != 0)
+        ucBits++; /* Parity or 9th bit */
+    return (prvBITS(U1MODE).BRGH ? 4 : 16)*((prvREG(U1BRG) & 0xFFFF) + 1)*ucBits;
+}
+
+/* Pushes a U1TXREG write into the TX FIFO, dropped if it is full */
+static void prvUartCommit(void){
+    if (!xSfr.ucTxPending)
+        return;
+    xSfr.ucTxPending = 0;
+    if (xSfr.ucTxCount < sfrUART_FIFO) {
+        xSfr.ucTxFifo[(xSfr.ucTxHead + xSfr.ucTxCount) % sfrUART_FIFO] = (uint8_t)xSfr.ulTxReg;
+        xSfr.ucTxCount++;
+    }
+}
+
+static void prvUartStatus(void){
+    volatile __U1STAbits_t *pxSta = &prvBITS(U1STA);
+
+    pxSta->URXDA = xSfr.ucRxCount > 0;
+    pxSta->UTXBF = xSfr.ucTxCount == sfrUART_FIFO;
+    pxSta->TRMT = xSfr.ulTxShift == 0 && xSfr.ucTxCount == 0;
+    pxSta->RIDLE = xSfr.ulRxShift == 0;
+}
+
+static void prvUartSent(uint8_t ucByte){
+    if (xSfr.ulTxBytes < xSfr.ulCaptureSize)
+        xSfr.pucCapture[xSfr.ulTxBytes] = ucByte;
+    xSfr.ulTxBytes++;
+    if (xSfr.pxUartFile != NULL)
+        fputc(ucByte, xSfr.pxUartFile);
+}
+
+static void prvUartTick(void){
+    volatile __U1STAbits_t *pxSta = &prvBITS(U1STA);
+    uint8_t ucTxFlag;
+    uint8_t ucByte;
+
+    prvUartCommit();
+    if (!prvBITS(U1MODE).ON) {
+        xSfr.ucTxCount = 0;
+        xSfr.ucRxCount = 0;
+        xSfr.ulTxShift = 0;
+        xSfr.ulRxShift = 0;
+        prvUartStatus();
+        return;
+    }
+
+    if (pxSta->UTXEN) {
+        if (xSfr.ulTxShift > 0 && --xSfr.ulTxShift == 0)
+            prvUartSent(xSfr.ucTxByte);
+        if (xSfr.ulTxShift == 0 && xSfr.ucTxCount > 0) { /* FIFO to the shift register */
+            xSfr.ucTxByte = xSfr.ucTxFifo[xSfr.ucTxHead];
+            xSfr.ucTxHead = (xSfr.ucTxHead + 1) % sfrUART_FIFO;
+            xSfr.ucTxCount--;
+            xSfr.ulTxShift = prvUartFrame();
+        }
+    }
+
+    if (pxSta->URXEN) {
+        if (xSfr.ulRxShift == 0 && xSfr.ulRxLeft > 0)
+            xSfr.ulRxShift = prvUartFrame();
+        if (xSfr.ulRxShift > 0 && --xSfr.ulRxShift == 0) {
+            ucByte = *xSfr.pucRxData++;
+            xSfr.ulRxLeft--;
+            if (pxSta->OERR || xSfr.ucRxCount == sfrUART_FIFO) {
+                pxSta->OERR = 1; /* Nothing is received until OERR is cleared */
+                xSfr.ulRxLost++;
+            } else {
+                xSfr.ucRxFifo[(xSfr.ucRxHead + xSfr.ucRxCount) % sfrUART_FIFO] = ucByte;
+                xSfr.ucRxCount++;
+            }
+        }
+    }
+
+    prvUartStatus();
+
+    /* The flags are set for as long as the condition holds */
+    switch (pxSta->UTXISEL) {
+        case 0: ucTxFlag = !pxSta->UTXBF; break; /* At least one free position */
+        case 1: ucTxFlag = pxSta->TRMT; break; /* All sent */
+        default: ucTxFlag = xSfr.ucTxCount == 0; break; /* FIFO empty */
+    }
+    if (pxSta->UTXEN && ucTxFlag)
+        prvREG(IFS0) |= _IFS0_U1TXIF_MASK;
+    if (xSfr.ucRxCount >= ucRxThreshold[pxSta->URXISEL])
+        prvREG(IFS0) |= _IFS0_U1RXIF_MASK;
+}
+
+/* Calls the highest priority pending ISR, none while one is running,
+ * once its flag has been set for xSfr.ulIsrLatency ticks */
+static void prvDispatch(void){
+    uint8_t ucVector;
+
+    for (ucVector = 0; ucVector < sfrNUM_VECTORS; ucVector++) {
+        if (xSfr.pvIsr[ucVector] == NULL ||
+            !(prvSync(xVectors[ucVector].pxIfs)->ulValue & prvSync(xVectors[ucVector].pxIec)->ulValue & xVectors[ucVector].ulMask))
+            xSfr.ucIsrPending[ucVector] = 0;
+        else if (!xSfr.ucIsrPending[ucVector]) {
+            xSfr.ucIsrPending[ucVector] = 1;
+            xSfr.ullIsrFlagged[ucVector] = xSfr.ullTicks;
+        }
+    }
+
+    if (xSfr.ucInIsr || xSfr.ucCritical)
+        return;
+
+    for (ucVector = 0; ucVector < sfrNUM_VECTORS; ucVector++) {
+        if (!xSfr.ucIsrPending[ucVector] || xSfr.ullTicks - xSfr.ullIsrFlagged[ucVector] < xSfr.ulIsrLatency)
+            continue;
+        xSfr.ucIsrPending[ucVector] = 0;
+        xSfr.ucInIsr = 1;
+        xSfr.ulIsrCalls[ucVector]++;
+        xSfr.pvIsr[ucVector]();
+        xSfr.ucInIsr = 0;
+        return;
+    }
+}
+
+static void prvTick(void){
+    xSfr.ullTicks++;
+    prvTimer2Tick();
+    prvTimer3Tick();
+    prvAdcTick();
+    prvUartTick();
+    prvDispatch();
+}
+
+void SfrRun(uint32_t ulTicks){
+    while (ulTicks--)
+        prvTick();
+}
+
+void SfrRunOcPeriods(uint32_t ulPeriods){
+    uint32_t ulCon = prvSync(&xSfrOC[0].xCON)->ulValue;
+    uint32_t ulTarget = xSfr.ulOcPeriods + ulPeriods;
+
+    if (!(ulCon & _OC1CON_ON_MASK) || (ulCon & _OC1CON_OCM_MASK) != prvOCM_PWM ||
+        !((ulCon & _OC1CON_OCTSEL_MASK) ? prvBITS(T3CON).ON : prvBITS(T2CON).ON))
+        return; /* Would never end */
+
+    while (xSfr.ulOcPeriods != ulTarget)
+        prvTick();
+}
+
+SfrReg_t *SfrAccess(SfrReg_t *pxReg){
+    prvSync(pxReg);
+    prvDmaSync();
+    prvTick();
+    return prvSync(pxReg);
+}
+
+/* Bitfield view of a register value, apart from SfrAccess() to keep gcc's aliasing checks quiet */
+volatile void *SfrBits(SfrReg_t *pxReg){
+    return &pxReg->ulValue;
+}
+
+SfrReg_t *SfrUartStatus(void){
+    prvTick();
+    return &xSfrU1STA;
+}
+
+volatile uint32_t *SfrUartTx(void){
+    prvTick();
+    prvUartCommit();
+    xSfr.ucTxPending = 1;
+    return &xSfr.ulTxReg;
+}
+
+uint32_t SfrUartRx(void){
+    uint8_t ucByte = 0;
+
+    prvTick();
+    if (xSfr.ucRxCount > 0) {
+        ucByte = xSfr.ucRxFifo[xSfr.ucRxHead];
+        xSfr.ucRxHead = (xSfr.ucRxHead + 1) % sfrUART_FIFO;
+        xSfr.ucRxCount--;
+        prvUartStatus();
+    }
+    return ucByte;
+}
+
+uint32_t SfrCoreTimer(void){
+    return (uint32_t)xSfr.ullTicks;
+}
+
+uint32_t SfrCoreStatus(void){
+    return xSfr.ucInIsr ? (3 << _CP0_STATUS_IPL_POSITION) : 0;
+}
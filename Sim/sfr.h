@@ -0,0 +1,198 @@
+/*
+ * File:   sfr.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host (Linux/POSIX) register model of the PIC32MX peripherals
+ *           used by the shared drivers: Timer 2 and Timer 3, the ADC in
+ *           manual and Timer 3 triggered scan modes (dual buffer
+ *           ADC1BUF), UART1 with its 8 deep TX and RX FIFOs at the
+ *           programmed baudrate, OC1 to OC5 in PWM mode, the DMA
+ *           channels in interrupt triggered mode, LATE and the INT2
+ *           pin. xc.h maps the register names to this model, so
+ *           UART/uart.c, the DataAcq adc.c and the AWG drivers build
+ *           for the host as they are. The model advances one PBCLK tick
+ *           at a time and calls the ISR registered for a vector while
+ *           its IFS and IEC bits are both set, one ISR at a time.
+ *
+ *           Conversions are ready on the Timer 3 match that starts
+ *           them, and ISRs take no time of their own: the register
+ *           accesses they make do, and xSfr.ulIsrLatency holds them
+ *           back from their flag.
+ *
+ *           On a timer match the OC modules on that timer latch OCxRS
+ *           into OCxR first, then the DMA channels started by its IRQ
+ *           move one cell each, highest priority first: a sample
+ *           written by DMA is output one PWM period later, as on the
+ *           device. Every OC1 period can be captured (SfrOcCapture()).
+ *           The DMA raises the source half and block complete events.
+ */
+
+#ifndef SFR_H
+#define SFR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "xc.h"
+
+// Define return codes
+#define SFR_SUCCESS 0
+#define SFR_FILE_ERROR -1
+
+#define sfrPBCLOCK 40000000L
+
+#define sfrUART_FIFO 8 /* TX and RX FIFO depth */
+
+#define sfrPHYSICAL_SIZE 256 /* Buffers the DMA can address, SfrPhysical() */
+
+/* Interrupt vectors of the model, in priority order */
+#define sfrVECTOR_ADC 0
+#define sfrVECTOR_DMA0 1
+#define sfrVECTOR_INT2 2
+#define sfrVECTOR_UART1 3
+#define sfrVECTOR_TIMER3 4
+#define sfrNUM_VECTORS 5
+
+/* OC registers at the start of an OC1 period */
+typedef struct {
+    uint16_t usR[sfrNUM_OC]; /* OC1R to OC5R */
+    uint16_t usLatE; /* LATE */
+} SfrOcSample_t;
+
+/* State of the model */
+typedef struct {
+    uint64_t ullTicks; /* PBCLK ticks since SfrOpen() */
+    uint32_t ulIsrCalls[sfrNUM_VECTORS];
+    uint8_t ucInIsr;
+    uint8_t ucCritical; /* Interrupts held back, taskENTER_CRITICAL() */
+    void (*pvIsr[sfrNUM_VECTORS])(void);
+    uint32_t ulIsrLatency; /* PBCLK ticks from an interrupt flag to its ISR, 0 calls it on the tick it is set */
+    uint64_t ullIsrFlagged[sfrNUM_VECTORS]; /* Tick the flag of a pending vector was seen */
+    uint8_t ucIsrPending[sfrNUM_VECTORS];
+
+    /* Timers */
+    uint16_t usT2Prescale; /* PBCLK ticks left to the next TMR2 increment */
+    uint16_t usT3Prescale; /* PBCLK ticks left to the next TMR3 increment */
+
+    /* OC1 periods */
+    uint32_t ulOcPeriods; /* Since SfrOpen() or SfrOcCapture(), also the next index of pxOcCapture */
+    SfrOcSample_t *pxOcCapture;
+    uint32_t ulOcCaptureSize;
+
+    /* ADC */
+    uint16_t (*pusAdcInput)(uint8_t ucChannel, uint64_t ullTicks); /* NULL reads 0 */
+    uint8_t ucAdcScan; /* Next AD1CSSL bit to convert */
+    uint8_t ucAdcCount; /* Conversions since the last interrupt */
+    uint32_t ulAdcDelay; /* Ticks to the end of an auto-sample conversion */
+    uint32_t ulAdcConversions;
+
+    /* UART1 */
+    uint8_t ucTxFifo[sfrUART_FIFO];
+    uint8_t ucTxHead;
+    uint8_t ucTxCount;
+    uint8_t ucTxPending; /* U1TXREG was written, pushed on the next access */
+    volatile uint32_t ulTxReg;
+    uint32_t ulTxShift; /* Ticks left of the frame being sent, 0 if idle */
+    uint8_t ucTxByte;
+    uint8_t ucRxFifo[sfrUART_FIFO];
+    uint8_t ucRxHead;
+    uint8_t ucRxCount;
+    uint32_t ulRxShift; /* Ticks left of the frame being received */
+    const uint8_t *pucRxData; /* Bytes still to arrive */
+    uint32_t ulRxLeft;
+    uint32_t ulTxBytes; /* Bytes sent, also the next index of pucCapture */
+    uint32_t ulRxLost; /* Received with the RX FIFO full (OERR) */
+    uint8_t *pucCapture;
+    uint32_t ulCaptureSize;
+    FILE *pxUartFile;
+} Sfr_t;
+
+extern Sfr_t xSfr;
+
+/********************************************************************
+ * Function: 	 SfrOpen()
+ * Input: 		 pcUartFile - UART1 TX output, NULL for none
+ * Returns:      SFR_SUCCESS if the file was created.
+ *               SFR_XXX error codes in case of failure.
+ * Overview:     Resets every register and model to its power on state.
+ *               ISRs, the ADC input and the capture buffers are kept,
+ *               and so are the physical addresses handed out.
+ ********************************************************************/
+int8_t SfrOpen(const char *pcUartFile);
+
+/********************************************************************
+ * Function: 	 SfrClose()
+ * Overview:     Flushes and closes the UART1 TX output.
+ ********************************************************************/
+void SfrClose(void);
+
+/********************************************************************
+ * Function: 	 SfrRun()
+ * Precondition: SfrOpen() called
+ * Input: 		 ulTicks - PBCLK ticks to simulate
+ * Overview:     Advances the peripherals and calls the ISRs.
+ ********************************************************************/
+void SfrRun(uint32_t ulTicks);
+
+/********************************************************************
+ * Function: 	 SfrSetIsr()
+ * Input: 		 ucVector - sfrVECTOR_XXX
+ *               pvIsr - Called like the ISR of the vector, NULL for none
+ ********************************************************************/
+void SfrSetIsr(uint8_t ucVector, void (*pvIsr)(void));
+
+/********************************************************************
+ * Function: 	 SfrCritical()
+ * Input: 		 ucEnter - 1 to hold back the ISRs, 0 to let them run
+ * Overview:     Nests, like taskENTER_CRITICAL()/taskEXIT_CRITICAL().
+ ********************************************************************/
+void SfrCritical(uint8_t ucEnter);
+
+/********************************************************************
+ * Function: 	 SfrAdcSetInput()
+ * Input: 		 pusInput - Returns the 10 bit conversion of ANx
+ *                          (ucChannel) at PBCLK tick ullTicks
+ ********************************************************************/
+void SfrAdcSetInput(uint16_t (*pusInput)(uint8_t ucChannel, uint64_t ullTicks));
+
+/********************************************************************
+ * Function: 	 SfrUartCapture()
+ * Input: 		 pucBuffer - Receives the UART1 TX bytes, NULL for none
+ *               ulSize - Size of pucBuffer, later bytes are only counted
+ * Overview:     Restarts the count of sent bytes (xSfr.ulTxBytes).
+ ********************************************************************/
+void SfrUartCapture(uint8_t *pucBuffer, uint32_t ulSize);
+
+/********************************************************************
+ * Function: 	 SfrOcCapture()
+ * Input: 		 pxBuffer - Receives the OC registers of every OC1 period,
+ *                          NULL for none
+ *               ulSize - Size of pxBuffer, later periods are only counted
+ * Overview:     Restarts the count of OC1 periods (xSfr.ulOcPeriods).
+ ********************************************************************/
+void SfrOcCapture(SfrOcSample_t *pxBuffer, uint32_t ulSize);
+
+/********************************************************************
+ * Function: 	 SfrRunOcPeriods()
+ * Precondition: SfrOpen() called, OC1 on in PWM mode
+ * Input: 		 ulPeriods - OC1 periods to simulate
+ * Overview:     Runs until xSfr.ulOcPeriods has grown by ulPeriods.
+ ********************************************************************/
+void SfrRunOcPeriods(uint32_t ulPeriods);
+
+/********************************************************************
+ * Function: 	 SfrInt2Edge()
+ * Input: 		 ucRising - 1 for a rising edge on INT2, 0 for falling
+ * Overview:     Sets INT2IF if INTCON.INT2EP selects that edge.
+ ********************************************************************/
+void SfrInt2Edge(uint8_t ucRising);
+
+/********************************************************************
+ * Function: 	 SfrUartReceive()
+ * Precondition: UART1 enabled
+ * Input: 		 pucData, ulLen - Bytes sent to UART1 back to back at
+ *                          its baudrate, from the next tick. Must stay
+ *                          valid until they are all received.
+ ********************************************************************/
+void SfrUartReceive(const uint8_t *pucData, uint32_t ulLen);
+
+#endif
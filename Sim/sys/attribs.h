@@ -0,0 +1,17 @@
+/*
+ * File:   attribs.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the XC32 <sys/attribs.h>. The model calls
+ *           the ISRs registered with SfrSetIsr(), so the vector
+ *           attributes are dropped and the functions they mark are
+ *           left unused.
+ */
+
+#ifndef SIM_SYS_ATTRIBS_H
+#define SIM_SYS_ATTRIBS_H
+
+#define __ISR(vector, ...) __attribute__((unused))
+#define __builtin_enable_interrupts() ((void)0) /* Always enabled, SfrCritical() holds them back */
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * File:   kmem.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the XC32 <sys/kmem.h>. Host addresses do
+ *           not fit the 32 bit DMA address registers, so the model
+ *           hands out physical addresses of its own (SfrPhysical()),
+ *           which its DMA maps back (SfrVirtual()).
+ */
+
+#ifndef SIM_SYS_KMEM_H
+#define SIM_SYS_KMEM_H
+
+#include <stdint.h>
+#include "../xc.h"
+
+#define KVA_TO_PA(v) SfrPhysical((const volatile void *)(v))
+#define PA_TO_KVA1(pa) SfrVirtual(pa)
+
+#endif
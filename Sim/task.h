@@ -0,0 +1,62 @@
+/*
+ * File:   task.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host stand-in for the FreeRTOS task API (FreeRTOS.h)
+ */
+
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct RtosTask *TaskHandle_t;
+
+#define taskSCHEDULER_SUSPENDED ((BaseType_t)0)
+#define taskSCHEDULER_NOT_STARTED ((BaseType_t)1)
+#define taskSCHEDULER_RUNNING ((BaseType_t)2)
+
+#define taskENTER_CRITICAL() vTaskEnterCritical()
+#define taskEXIT_CRITICAL() vTaskExitCritical()
+#define xTaskNotifyGive(xTaskToNotify) xTaskGenericNotifyGive(xTaskToNotify)
+
+/********************************************************************
+ * Function: 	 RtosTaskCreate()
+ * Input: 		 pcName - Task name
+ * Returns:      Handle of a task without code of its own, NULL if out
+ *               of memory. The caller runs as that task after
+ *               RtosTaskSwitch().
+ ********************************************************************/
+TaskHandle_t RtosTaskCreate(const char *pcName);
+
+/********************************************************************
+ * Function: 	 RtosTaskSwitch()
+ * Input: 		 xTask - Task the caller runs as from now on
+ * Overview:     Selects the notification value ulTaskNotifyTake() uses
+ *               and the name printed if a wait never ends.
+ ********************************************************************/
+void RtosTaskSwitch(TaskHandle_t xTask);
+
+/********************************************************************
+ * Function: 	 RtosSetBackground()
+ * Input: 		 pxTasks - Called every PBCLK tick the caller is blocked
+ *                         (vTaskDelay() or a wait), NULL for none
+ * Overview:     Stands for the lower priority tasks that run while a
+ *               task is blocked. pxTasks runs as those tasks
+ *               (RtosTaskSwitch()), must not block, and the blocked
+ *               task is current again when it returns.
+ ********************************************************************/
+void RtosSetBackground(void (*pxTasks)(void));
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskGetSchedulerState(void);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t xTicksToDelay);
+void vTaskSuspend(TaskHandle_t xTaskToSuspend);
+void vTaskEnterCritical(void);
+void vTaskExitCritical(void);
+BaseType_t xTaskGenericNotifyGive(TaskHandle_t xTaskToNotify);
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+
+#endif
@@ -0,0 +1,411 @@
+/*
+ * File:   xc.h
+ * Author: Diogo Vala
+ *
+ * Overview: Host (Linux/POSIX) stand-in for the XC32 device header. The
+ *           special function registers used by the shared drivers
+ *           (UART/uart.c, the DataAcq adc.c, the AWG timer2.c, timer3.c,
+ *           oc.c, dma.c and playback.c) are SfrReg_t variables of the
+ *           register model (sfr.h), so those files build unchanged with
+ *           gcc -ISim. Bit positions are the PIC32MX795F512L ones.
+ *
+ *           Every access through the names below goes through the
+ *           model and takes one PBCLK tick, so a polling loop sees the
+ *           peripherals move. xxxCLR/SET/INV writes are applied on the
+ *           next access of the register. The OC and DMA drivers only
+ *           take the address of OC1CON and DCH0CON and work on the
+ *           register blocks behind them, which are laid out as on the
+ *           device.
+ */
+
+#ifndef SIM_XC_H
+#define SIM_XC_H
+
+#include <stdint.h>
+
+/* One register and its CLR/SET/INV aliases */
+typedef struct {
+    volatile uint32_t ulValue;
+    volatile uint32_t ulClr;
+    volatile uint32_t ulSet;
+    volatile uint32_t ulInv;
+} SfrReg_t;
+
+/* Register access hooks (Sim/sfr.c) */
+SfrReg_t *SfrAccess(SfrReg_t *pxReg);
+volatile void *SfrBits(SfrReg_t *pxReg);
+SfrReg_t *SfrUartStatus(void);
+volatile uint32_t *SfrUartTx(void);
+uint32_t SfrUartRx(void);
+uint32_t SfrCoreTimer(void);
+uint32_t SfrCoreStatus(void);
+uint32_t SfrPhysical(const volatile void *pvAddress); /* DMA address of a host buffer, sys/kmem.h */
+void *SfrVirtual(uint32_t ulAddress);
+
+/* Output compare module, 0x200 bytes apart from OC1CON */
+typedef struct {
+    SfrReg_t xCON;
+    SfrReg_t xR;
+    SfrReg_t xRS;
+    uint8_t ucReserved[0x200 - 3*sizeof(SfrReg_t)];
+} SfrOc_t;
+
+#define sfrNUM_OC 5 /* OC1 to OC5 */
+#define sfrNUM_DMA_CHANNELS 8
+#define sfrDMA_CHANNEL_REGS 12 /* DCHxCON to DCHxDAT */
+
+extern SfrReg_t xSfrDDPCON;
+extern SfrReg_t xSfrINTCON, xSfrIFS0, xSfrIFS1, xSfrIEC0, xSfrIEC1, xSfrIPC2, xSfrIPC3, xSfrIPC6, xSfrIPC9;
+extern SfrReg_t xSfrT2CON, xSfrTMR2, xSfrPR2;
+extern SfrReg_t xSfrT3CON, xSfrTMR3, xSfrPR3;
+extern SfrOc_t xSfrOC[sfrNUM_OC];
+extern SfrReg_t xSfrDMACON;
+extern SfrReg_t xSfrDCH[sfrNUM_DMA_CHANNELS*sfrDMA_CHANNEL_REGS];
+extern SfrReg_t xSfrLATE;
+extern SfrReg_t xSfrAD1CON1, xSfrAD1CON2, xSfrAD1CON3, xSfrAD1CHS, xSfrAD1PCFG, xSfrAD1CSSL;
+extern SfrReg_t xSfrU1MODE, xSfrU1BRG;
+extern volatile uint32_t ulSfrADC1BUF[16*4]; /* ADC1BUF0-F, 16 bytes apart */
+
+#define sfrREG(name) (SfrAccess(&xSfr##name)->ulValue)
+#define sfrCLR(name) (SfrAccess(&xSfr##name)->ulClr)
+#define sfrSET(name) (SfrAccess(&xSfr##name)->ulSet)
+#define sfrINV(name) (SfrAccess(&xSfr##name)->ulInv)
+#define sfrBITS(name) (*(volatile __##name##bits_t *)SfrBits(SfrAccess(&xSfr##name)))
+
+/* Core */
+#define _CP0_GET_COUNT() SfrCoreTimer() /* SYSCLK/2, PBCLK in the model */
+#define _CP0_GET_STATUS() SfrCoreStatus() /* IPL is set while an ISR runs */
+#define _CP0_STATUS_IPL_POSITION 10
+#define _CP0_STATUS_IPL_MASK 0x0000FC00
+
+/* IRQ numbers, DMA start triggers */
+#define _TIMER_2_IRQ 8
+#define _TIMER_3_IRQ 12
+
+/* DDPCON */
+typedef struct {
+    unsigned :3;
+    unsigned JTAGEN:1;
+    unsigned :28;
+} __DDPCONbits_t;
+#define DDPCON sfrREG(DDPCON)
+#define DDPCONbits sfrBITS(DDPCON)
+
+/* Interrupt controller, IFS0/IEC0 and IFS1/IEC1 share the layout */
+typedef struct {
+    unsigned :2;
+    unsigned INT2EP:1;
+    unsigned :9;
+    unsigned MVEC:1;
+    unsigned :19;
+} __INTCONbits_t;
+typedef struct {
+    unsigned :8;
+    unsigned T2IF:1;
+    unsigned :2;
+    unsigned INT2IF:1;
+    unsigned T3IF:1;
+    unsigned :13;
+    unsigned U1EIF:1;
+    unsigned U1RXIF:1;
+    unsigned U1TXIF:1;
+    unsigned :3;
+} __IFS0bits_t;
+typedef struct {
+    unsigned :8;
+    unsigned T2IE:1;
+    unsigned :2;
+    unsigned INT2IE:1;
+    unsigned T3IE:1;
+    unsigned :13;
+    unsigned U1EIE:1;
+    unsigned U1RXIE:1;
+    unsigned U1TXIE:1;
+    unsigned :3;
+} __IEC0bits_t;
+typedef struct {
+    unsigned :1;
+    unsigned AD1IF:1;
+    unsigned :14;
+    unsigned DMA0IF:1;
+    unsigned :15;
+} __IFS1bits_t;
+typedef struct {
+    unsigned :1;
+    unsigned AD1IE:1;
+    unsigned :14;
+    unsigned DMA0IE:1;
+    unsigned :15;
+} __IEC1bits_t;
+typedef struct {
+    unsigned :2;
+    unsigned T2IP:3;
+    unsigned :21;
+    unsigned INT2IP:3;
+    unsigned :3;
+} __IPC2bits_t;
+typedef struct {
+    unsigned :2;
+    unsigned T3IP:3;
+    unsigned :27;
+} __IPC3bits_t;
+typedef struct {
+    unsigned :26;
+    unsigned AD1IP:3;
+    unsigned :3;
+} __IPC6bits_t;
+typedef struct {
+    unsigned :2;
+    unsigned DMA0IP:3;
+    unsigned :27;
+} __IPC9bits_t;
+#define INTCON sfrREG(INTCON)
+#define INTCONCLR sfrCLR(INTCON)
+#define INTCONSET sfrSET(INTCON)
+#define INTCONbits sfrBITS(INTCON)
+#define IFS0 sfrREG(IFS0)
+#define IFS0CLR sfrCLR(IFS0)
+#define IFS0SET sfrSET(IFS0)
+#define IFS0bits sfrBITS(IFS0)
+#define IFS1 sfrREG(IFS1)
+#define IFS1CLR sfrCLR(IFS1)
+#define IFS1SET sfrSET(IFS1)
+#define IFS1bits sfrBITS(IFS1)
+#define IEC0 sfrREG(IEC0)
+#define IEC0CLR sfrCLR(IEC0)
+#define IEC0SET sfrSET(IEC0)
+#define IEC0bits sfrBITS(IEC0)
+#define IEC1 sfrREG(IEC1)
+#define IEC1CLR sfrCLR(IEC1)
+#define IEC1SET sfrSET(IEC1)
+#define IEC1bits sfrBITS(IEC1)
+#define IPC2 sfrREG(IPC2)
+#define IPC2bits sfrBITS(IPC2)
+#define IPC3 sfrREG(IPC3)
+#define IPC3bits sfrBITS(IPC3)
+#define IPC6 sfrREG(IPC6)
+#define IPC6bits sfrBITS(IPC6)
+#define IPC9 sfrREG(IPC9)
+#define IPC9bits sfrBITS(IPC9)
+#define _INTCON_INT2EP_MASK 0x00000004
+#define _INTCON_MVEC_MASK 0x00001000
+#define _IFS0_T2IF_MASK 0x00000100
+#define _IEC0_T2IE_MASK 0x00000100
+#define _IFS0_INT2IF_MASK 0x00000800
+#define _IEC0_INT2IE_MASK 0x00000800
+#define _IFS0_T3IF_MASK 0x00001000
+#define _IEC0_T3IE_MASK 0x00001000
+#define _IFS0_U1RXIF_MASK 0x08000000
+#define _IEC0_U1RXIE_MASK 0x08000000
+#define _IFS0_U1TXIF_MASK 0x10000000
+#define _IEC0_U1TXIE_MASK 0x10000000
+#define _IFS1_AD1IF_MASK 0x00000002
+#define _IEC1_AD1IE_MASK 0x00000002
+#define _IFS1_DMA0IF_POSITION 16
+#define _IFS1_DMA0IF_MASK 0x00010000
+#define _IEC1_DMA0IE_MASK 0x00010000
+
+/* Timer 2 and Timer 3, ON is also named TON */
+typedef union {
+    struct {
+        unsigned :1;
+        unsigned TCS:1;
+        unsigned :1;
+        unsigned T32:1;
+        unsigned TCKPS:3;
+        unsigned TGATE:1;
+        unsigned :5;
+        unsigned SIDL:1;
+        unsigned :1;
+        unsigned ON:1;
+        unsigned :16;
+    };
+    struct {
+        unsigned :15;
+        unsigned TON:1;
+        unsigned :16;
+    };
+} __T2CONbits_t;
+typedef union {
+    struct {
+        unsigned :1;
+        unsigned TCS:1;
+        unsigned :2;
+        unsigned TCKPS:3;
+        unsigned TGATE:1;
+        unsigned :5;
+        unsigned SIDL:1;
+        unsigned :1;
+        unsigned ON:1;
+        unsigned :16;
+    };
+    struct {
+        unsigned :15;
+        unsigned TON:1;
+        unsigned :16;
+    };
+} __T3CONbits_t;
+#define T2CON sfrREG(T2CON)
+#define T2CONbits sfrBITS(T2CON)
+#define TMR2 sfrREG(TMR2)
+#define PR2 sfrREG(PR2)
+#define T3CON sfrREG(T3CON)
+#define T3CONbits sfrBITS(T3CON)
+#define TMR3 sfrREG(TMR3)
+#define PR3 sfrREG(PR3)
+
+/* Output compare, PWM mode (OCM = 0b110) only */
+#define xSfrOC1CON xSfrOC[0].xCON
+#define OC1CON sfrREG(OC1CON)
+#define _OC1CON_OCM_POSITION 0
+#define _OC1CON_OCM_MASK 0x00000007
+#define _OC1CON_OCTSEL_POSITION 3
+#define _OC1CON_OCTSEL_MASK 0x00000008
+#define _OC1CON_ON_MASK 0x00008000
+
+/* DMA, interrupt triggered cell transfers only */
+typedef struct {
+    unsigned :11;
+    unsigned DMABUSY:1;
+    unsigned SUSPEND:1;
+    unsigned :2;
+    unsigned ON:1;
+    unsigned :16;
+} __DMACONbits_t;
+#define xSfrDCH0CON xSfrDCH[0]
+#define DMACON sfrREG(DMACON)
+#define DMACONSET sfrSET(DMACON)
+#define DMACONbits sfrBITS(DMACON)
+#define DCH0CON sfrREG(DCH0CON)
+#define _DMACON_ON_MASK 0x00008000
+#define _DCH0CON_CHPRI_POSITION 0
+#define _DCH0CON_CHPRI_MASK 0x00000003
+#define _DCH0CON_CHAEN_MASK 0x00000010
+#define _DCH0CON_CHEN_MASK 0x00000080
+#define _DCH0ECON_SIRQEN_MASK 0x00000010
+#define _DCH0ECON_CABORT_MASK 0x00000040
+#define _DCH0ECON_CFORCE_MASK 0x00000080
+#define _DCH0ECON_CHSIRQ_POSITION 8
+#define _DCH0ECON_CHSIRQ_MASK 0x0000FF00
+#define _DCH0INT_CHBCIF_MASK 0x00000008
+#define _DCH0INT_CHSHIF_MASK 0x00000040
+
+/* PORTE latch */
+#define LATE sfrREG(LATE)
+#define LATECLR sfrCLR(LATE)
+#define LATESET sfrSET(LATE)
+#define LATEINV sfrINV(LATE)
+#define _LATE_LATE8_MASK 0x00000100
+
+/* ADC */
+typedef struct {
+    unsigned DONE:1;
+    unsigned SAMP:1;
+    unsigned ASAM:1;
+    unsigned :1;
+    unsigned CLRASAM:1;
+    unsigned SSRC:3;
+    unsigned FORM:3;
+    unsigned :2;
+    unsigned SIDL:1;
+    unsigned :1;
+    unsigned ON:1;
+    unsigned :16;
+} __AD1CON1bits_t;
+typedef struct {
+    unsigned ALTS:1;
+    unsigned BUFM:1;
+    unsigned SMPI:4;
+    unsigned :1;
+    unsigned BUFS:1;
+    unsigned :2;
+    unsigned CSCNA:1;
+    unsigned :1;
+    unsigned OFFCAL:1;
+    unsigned VCFG:3;
+    unsigned :16;
+} __AD1CON2bits_t;
+typedef struct {
+    unsigned ADCS:8;
+    unsigned SAMC:5;
+    unsigned :2;
+    unsigned ADRC:1;
+    unsigned :16;
+} __AD1CON3bits_t;
+typedef struct {
+    unsigned :16;
+    unsigned CH0SA:4;
+    unsigned :3;
+    unsigned CH0NA:1;
+    unsigned CH0SB:4;
+    unsigned :3;
+    unsigned CH0NB:1;
+} __AD1CHSbits_t;
+#define AD1CON1 sfrREG(AD1CON1)
+#define AD1CON1bits sfrBITS(AD1CON1)
+#define AD1CON2 sfrREG(AD1CON2)
+#define AD1CON2bits sfrBITS(AD1CON2)
+#define AD1CON3 sfrREG(AD1CON3)
+#define AD1CON3bits sfrBITS(AD1CON3)
+#define AD1CHS sfrREG(AD1CHS)
+#define AD1CHSbits sfrBITS(AD1CHS)
+#define AD1PCFG sfrREG(AD1PCFG)
+#define AD1PCFGCLR sfrCLR(AD1PCFG)
+#define AD1PCFGSET sfrSET(AD1PCFG)
+#define AD1CSSL sfrREG(AD1CSSL)
+#define ADC1BUF0 ulSfrADC1BUF[0]
+#define ADC1BUF8 ulSfrADC1BUF[8*4]
+
+/* UART1 (UART1A) */
+typedef struct {
+    unsigned STSEL:1;
+    unsigned PDSEL:2;
+    unsigned BRGH:1;
+    unsigned RXINV:1;
+    unsigned ABAUD:1;
+    unsigned LPBACK:1;
+    unsigned WAKE:1;
+    unsigned UEN:2;
+    unsigned :1;
+    unsigned RTSMD:1;
+    unsigned IREN:1;
+    unsigned SIDL:1;
+    unsigned :1;
+    unsigned ON:1;
+    unsigned :16;
+} __U1MODEbits_t;
+typedef struct {
+    unsigned URXDA:1;
+    unsigned OERR:1;
+    unsigned FERR:1;
+    unsigned PERR:1;
+    unsigned RIDLE:1;
+    unsigned ADDEN:1;
+    unsigned URXISEL:2;
+    unsigned TRMT:1;
+    unsigned UTXBF:1;
+    unsigned UTXEN:1;
+    unsigned UTXBRK:1;
+    unsigned URXEN:1;
+    unsigned UTXINV:1;
+    unsigned UTXISEL:2;
+    unsigned ADDR:8;
+    unsigned ADM_EN:1;
+    unsigned :7;
+} __U1STAbits_t;
+#define U1MODE sfrREG(U1MODE)
+#define U1MODEbits sfrBITS(U1MODE)
+#define U1AMODE U1MODE
+#define U1AMODEbits U1MODEbits
+#define U1STA (SfrUartStatus()->ulValue)
+#define U1STAbits (*(volatile __U1STAbits_t *)SfrBits(SfrUartStatus()))
+#define U1ASTA U1STA
+#define U1ASTAbits U1STAbits
+#define U1BRG sfrREG(U1BRG)
+#define U1ABRG U1BRG
+#define U1TXREG (*SfrUartTx())
+#define U1ATXREG U1TXREG
+#define U1RXREG SfrUartRx()
+#define U1ARXREG U1RXREG
+
+#endif
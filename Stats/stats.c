@@ -0,0 +1,115 @@
+/*
+ * File:   stats.c
+ * Author: Diogo Vala
+ *
+ * Overview: CPU accounting shared by the PIC32MX projects
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "stats.h"
+
+#if configGENERATE_RUN_TIME_STATS != 1 || configUSE_TRACE_FACILITY != 1
+#error "stats.c needs configGENERATE_RUN_TIME_STATS and configUSE_TRACE_FACILITY set to 1"
+#endif
+
+StatsIsr_t xStatsIsrs[statsMAX_ISRS];
+
+/* Counters at the previous StatsPrint() */
+static struct {
+    TaskHandle_t xHandle;
+    uint32_t ulRunTime;
+} xLastTasks[statsMAX_TASKS];
+static uint32_t ulLastIsrTime[statsMAX_ISRS];
+static uint32_t ulLastIsrCount[statsMAX_ISRS];
+static uint32_t ulLastTotal = 0;
+
+static TaskStatus_t xTasks[statsMAX_TASKS]; /* Too big for the printing task stack */
+static TickType_t xPeriod;
+
+int8_t StatsIsrName(uint8_t ucIsr, const char *pcName){
+    if (ucIsr >= statsMAX_ISRS)
+        return STATS_INVALID_ISR;
+
+    xStatsIsrs[ucIsr].pcName = pcName;
+    return STATS_SUCCESS;
+}
+
+/* Prints one line, time in us and share of ulElapsed in 0.1% */
+static void prvPrintLine(const char *pcName, uint32_t ulTime, uint32_t ulElapsed, uint32_t ulLast){
+    uint32_t ulPermille = (ulElapsed == 0) ? 0 : (uint32_t)((uint64_t)ulTime*1000/ulElapsed);
+
+    printf("\r\n%-10s %9u %3u.%1u %6u", pcName, (unsigned)(ulTime/(statsTIMER_HZ/1000000)),
+            (unsigned)(ulPermille/10), (unsigned)(ulPermille%10), (unsigned)ulLast);
+}
+
+void StatsPrint(void){
+    UBaseType_t uxCount;
+    UBaseType_t uxTask;
+    UBaseType_t uxLast;
+    uint32_t ulTotal;
+    uint32_t ulElapsed;
+    uint32_t ulTime;
+    uint32_t ulIsrCount;
+    uint8_t ucIsr;
+
+    uxCount = uxTaskGetSystemState(xTasks, statsMAX_TASKS, &ulTotal);
+    ulElapsed = ulTotal - ulLastTotal; /* Modulo 2^32, fine up to 107 s */
+    ulLastTotal = ulTotal;
+
+    printf("\r\n\r\nRun time, last %u ms", (unsigned)(ulElapsed/(statsTIMER_HZ/1000)));
+    if (uxCount == 0) {
+        printf("\r\nMore than %d tasks", statsMAX_TASKS);
+        return;
+    }
+
+    printf("\r\n%-10s %9s %5s %6s", "Task", "us", "%", "Stack");
+    for (uxTask = 0; uxTask < uxCount; uxTask++) {
+        ulTime = xTasks[uxTask].ulRunTimeCounter;
+        for (uxLast = 0; uxLast < statsMAX_TASKS; uxLast++) {
+            if (xLastTasks[uxLast].xHandle == xTasks[uxTask].xHandle) {
+                ulTime -= xLastTasks[uxLast].ulRunTime; /* New tasks count from their creation */
+                break;
+            }
+        }
+        prvPrintLine(xTasks[uxTask].pcTaskName, ulTime, ulElapsed, xTasks[uxTask].usStackHighWaterMark);
+    }
+
+    for (uxLast = 0; uxLast < statsMAX_TASKS; uxLast++) {
+        xLastTasks[uxLast].xHandle = (uxLast < uxCount) ? xTasks[uxLast].xHandle : NULL;
+        xLastTasks[uxLast].ulRunTime = (uxLast < uxCount) ? xTasks[uxLast].ulRunTimeCounter : 0;
+    }
+
+    printf("\r\n%-10s %9s %5s %6s", "ISR", "us", "%", "Calls");
+    for (ucIsr = 0; ucIsr < statsMAX_ISRS; ucIsr++) {
+        if (xStatsIsrs[ucIsr].pcName == NULL)
+            continue;
+        ulTime = xStatsIsrs[ucIsr].ulTime;
+        ulIsrCount = xStatsIsrs[ucIsr].ulCount;
+        prvPrintLine(xStatsIsrs[ucIsr].pcName, ulTime - ulLastIsrTime[ucIsr], ulElapsed, ulIsrCount - ulLastIsrCount[ucIsr]);
+        ulLastIsrTime[ucIsr] = ulTime;
+        ulLastIsrCount[ucIsr] = ulIsrCount;
+    }
+
+    printf("\r\nHeap free %u, min ever %u", (unsigned)xPortGetFreeHeapSize(), (unsigned)xPortGetMinimumEverFreeHeapSize());
+}
+
+/* Prints the table every xPeriod */
+static void prvStatsTask(void *pvParam){
+    TickType_t xLastWake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&xLastWake, xPeriod);
+        StatsPrint();
+    }
+}
+
+int8_t StatsStart(UBaseType_t uxPriority, uint32_t ulPeriodMs){
+    xPeriod = pdMS_TO_TICKS(ulPeriodMs);
+    ulLastTotal = portGET_RUN_TIME_COUNTER_VALUE();
+
+    if (xTaskCreate(prvStatsTask, "Stats", configMINIMAL_STACK_SIZE*2, NULL, uxPriority, NULL) != pdPASS)
+        return STATS_NO_MEMORY;
+
+    return STATS_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/*
+ * File:   stats.h
+ * Author: Diogo Vala
+ *
+ * Overview: CPU accounting shared by the PIC32MX projects. FreeRTOS run
+ *           time stats count core timer ticks (portGET_RUN_TIME_COUNTER_VALUE
+ *           in FreeRTOSConfig.h), ISRs add their own time with
+ *           statsISR_ENTER()/StatsIsrExit(). StatsPrint() prints, for the
+ *           time since the previous call, the CPU used by each task and
+ *           ISR, the stack high water marks and the heap_4 free space.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <xc.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Define return codes
+#define STATS_SUCCESS 0
+#define STATS_INVALID_ISR -1
+#define STATS_NO_MEMORY -2
+
+#define statsMAX_TASKS 10 /* Tasks in the table, idle and timer tasks included */
+#define statsMAX_ISRS 4 /* ISR slots */
+#define statsTIMER_HZ (configCPU_CLOCK_HZ/2) /* Core timer, 25 ns at 80 MHz, wraps every 107 s */
+
+/* Time spent in one ISR, in core timer ticks */
+typedef struct {
+    const char *pcName; /* NULL for an unused slot */
+    volatile uint32_t ulTime;
+    volatile uint32_t ulCount; /* Calls */
+} StatsIsr_t;
+
+extern StatsIsr_t xStatsIsrs[statsMAX_ISRS];
+
+/* First line of an ISR handler, returns the start time */
+#define statsISR_ENTER() _CP0_GET_COUNT()
+
+/********************************************************************
+ * Function: 	 StatsIsrExit()
+ * Precondition: StatsIsrName() called for ucIsr
+ * Input: 		 ucIsr - ISR slot, 0 to statsMAX_ISRS-1
+ *               ulEnter - statsISR_ENTER() of this call
+ * Overview:     Adds the time since ulEnter to the ISR. Called on every
+ *               exit path of the handler.
+ * Note:		 The context save/restore of the wrapper is not counted.
+ *               The ISR time is also part of the task it interrupted,
+ *               and of the lower priority ISR it nested in.
+ ********************************************************************/
+static inline void StatsIsrExit(uint8_t ucIsr, uint32_t ulEnter){
+    xStatsIsrs[ucIsr].ulTime += _CP0_GET_COUNT() - ulEnter;
+    xStatsIsrs[ucIsr].ulCount++;
+}
+
+/********************************************************************
+ * Function: 	 StatsIsrName()
+ * Precondition: Before the ISR is enabled
+ * Input: 		 ucIsr - ISR slot, 0 to statsMAX_ISRS-1
+ *               pcName - Name printed in the table
+ * Returns:      STATS_SUCCESS if configuration successful.
+ *               STATS_XXX error codes in case of failure.
+ ********************************************************************/
+int8_t StatsIsrName(uint8_t ucIsr, const char *pcName);
+
+/********************************************************************
+ * Function: 	 StatsPrint()
+ * Precondition: Scheduler running, stdout redirected to the UART
+ * Overview:     Prints the CPU time of each task and ISR since the
+ *               previous call (the first one from StatsStart()),
+ *               stack high water marks (words) and heap free / minimum
+ *               ever free (bytes).
+ * Note:		 Calls longer than 107 s apart overflow the core timer.
+ ********************************************************************/
+void StatsPrint(void);
+
+/********************************************************************
+ * Function: 	 StatsStart()
+ * Precondition: Before vTaskStartScheduler()
+ * Input: 		 uxPriority - Priority of the task that prints
+ *               ulPeriodMs - Time between tables, up to 100000
+ * Returns:      STATS_SUCCESS if configuration successful.
+ *               STATS_XXX error codes in case of failure.
+ * Overview:     Creates a task that calls StatsPrint() every ulPeriodMs.
+ ********************************************************************/
+int8_t StatsStart(UBaseType_t uxPriority, uint32_t ulPeriodMs);
+
+#endif
@@ -0,0 +1,404 @@
+/*
+ * File:   dataacq_test.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host test of the DataAcq pipeline. adc.c, pipeline.c,
+ *           decimate.c and uart.c run as they are on the register model
+ *           and FreeRTOS stand-in of Sim/, and so do the ACQ, PROC and
+ *           OUT stages of stages.c that the mainXXX.c tasks and ADC ISR
+ *           call. PROC takes a set CPU time per block while the ADC
+ *           keeps converting.
+ *           For each IPC of the links: every sample of every block
+ *           must be the conversion expected for its sequence number,
+ *           and when PROC is too slow the sequence gaps must be the
+ *           blocks counted as dropped. Last, a noisy DC input must
+ *           print the same temperature on the UART as mainQueue.c
+ *           would, with less noise than the ADC samples. Then the
+ *           benchmark of the BENCHMARK builds (PipelineBenchTask())
+ *           runs its sweep with a PROC of known speed.
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -I../Sim -o dataacq_test dataacq_test.c ../PIC32MX_DataAcq_Queue/adc.c \
+ *           ../Pipeline/pipeline.c ../Pipeline/decimate.c ../Pipeline/stages.c ../UART/uart.c ../Sim/sfr.c ../Sim/rtos.c && ./dataacq_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../Sim/sfr.h"
+#include "../PIC32MX_DataAcq_Queue/adc.h" /* Same driver in the three DataAcq projects */
+#include "../Pipeline/pipeline.h"
+#include "../Pipeline/decimate.h"
+#include "../Pipeline/stages.h"
+#include "../UART/uart.h"
+
+/* mainQueue.c settings */
+#define testADC_RESOLUTION 10
+#define testADC_SAMPLE_RATE 200000
+#define testADC_SAMPLES_PER_IRQ 8
+#define testADC_BLOCK_SIZE 1000 /* 5 ms */
+#define testPOOL_BLOCKS 4
+#define testLINK_DEPTH 2
+#define testPROC_NUM_BLOCKS 20
+#define testPROC_LOG2_DECIMATION 4
+#define testOUT_STRING_MAX_SIZE 40
+
+#define testBLOCKS 60 /* Received by PROC in each run */
+#define testPROC_FAST_US 2000 /* PROC time per block, below the 5 ms block period */
+#define testPROC_SLOW_US 12000 /* Above it, blocks are dropped */
+#define testNOISE_DC 532 /* Input of the signal test, ADC counts, mid 0.1 degree step */
+#define testNOISE_SPAN 8 /* Uniform noise, +-testNOISE_SPAN counts */
+#define testSCAN_CHANNELS 0x0003 /* AN0, AN1 */
+#define testSCAN_IRQS 50
+#define testCAPTURE_SIZE 256
+#define testBENCH_PERIOD_MS 200 /* mainQueueBENCH_PERIOD_MS is 2000, shorter to keep the run quick */
+#define testBENCH_PROC_NS 4000 /* PROC time per sample in the benchmark, 250 kS/s at most */
+
+enum { TEST_PATTERN, TEST_NOISE };
+
+static const char *pcIpcNames[] = {"queue", "semphr", "task notify"};
+
+/* Block pool and links */
+static uint16_t usSamples[testPOOL_BLOCKS*testADC_BLOCK_SIZE];
+static PipelineBlock_t xBlocks[testPOOL_BLOCKS];
+static PipelinePool_t xPool;
+static PipelineLink_t xAcqToProc;
+static PipelineLink_t xProcToOut;
+static StageAcq_t xAcqStage;
+static StageProc_t xProcStage;
+static TaskHandle_t xProc, xOut;
+
+/* Input */
+static uint8_t ucInput;
+static uint32_t ulNoise;
+
+static uint8_t ucCapture[testCAPTURE_SIZE];
+
+/* Conversion n of ANx in the pattern test, n counted from SfrOpen() */
+static uint16_t prvPattern(uint8_t ucChannel, uint32_t ulConversion){
+    return (ulConversion*7 + ucChannel*512) % 1024;
+}
+
+static uint16_t prvInput(uint8_t ucChannel, uint64_t ullTicks){
+    (void)ullTicks;
+
+    if (ucInput == TEST_PATTERN)
+        return prvPattern(ucChannel, xSfr.ulAdcConversions);
+    ulNoise = ulNoise*1664525 + 1013904223; /* LCG */
+    return testNOISE_DC - testNOISE_SPAN + (ulNoise >> 16) % (2*testNOISE_SPAN + 1);
+}
+
+/* vADCInterruptHandler() of the mainXXX.c, without the run time stats */
+static void prvAdcIsr(void){
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    StageAcqFromISR(&xAcqStage, &xHigherPriorityTaskWoken);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/* Model, pool, links and ADC as mainQueue() leaves them */
+static uint8_t prvStart(uint8_t ucIpc){
+    if (SfrOpen(NULL) != SFR_SUCCESS)
+        return 0;
+    SfrAdcSetInput(prvInput);
+    SfrSetIsr(sfrVECTOR_ADC, prvAdcIsr);
+    StageAcqInit(&xAcqStage, &xPool, &xAcqToProc, adcScanRead);
+
+    return adcScanConfig(0x01, configPERIPHERAL_CLOCK_HZ, testADC_SAMPLE_RATE, testADC_SAMPLES_PER_IRQ) == adcADC_SUCCESS &&
+        PipelinePoolInit(&xPool, xBlocks, usSamples, testPOOL_BLOCKS, testADC_BLOCK_SIZE) == PIPELINE_SUCCESS &&
+        PipelineLinkInit(&xAcqToProc, ucIpc, testLINK_DEPTH, xProc) == PIPELINE_SUCCESS &&
+        PipelineLinkInit(&xProcToOut, ucIpc, testLINK_DEPTH, xOut) == PIPELINE_SUCCESS &&
+        StageProcInit(&xProcStage, &xPool, &xProcToOut, testPROC_LOG2_DECIMATION, testPROC_NUM_BLOCKS) == DECIMATE_SUCCESS;
+}
+
+static void prvStop(void){
+    adcScanControl(0);
+    SfrSetIsr(sfrVECTOR_ADC, NULL);
+    vQueueDelete(xPool.xFree);
+    if (xAcqToProc.xQueue != NULL)
+        vQueueDelete(xAcqToProc.xQueue);
+    if (xAcqToProc.xSemaphore != NULL)
+        vSemaphoreDelete(xAcqToProc.xSemaphore);
+    if (xProcToOut.xQueue != NULL)
+        vQueueDelete(xProcToOut.xQueue);
+    if (xProcToOut.xSemaphore != NULL)
+        vSemaphoreDelete(xProcToOut.xSemaphore);
+    SfrClose();
+}
+
+/* PROC receives testBLOCKS blocks, spending ulProcUs on each, and checks
+ * the raw samples against the pattern. Fails if any sample is wrong or
+ * the gaps in the sequence are not the dropped blocks. */
+static uint8_t prvTestBlocks(uint8_t ucIpc, uint32_t ulProcUs, uint8_t ucExpectDrops){
+    PipelineBlock_t *pxBlock;
+    uint32_t ulExpected = 0; /* Next sequence number */
+    uint32_t ulGaps = 0;
+    uint32_t ulBlock;
+    uint16_t usSample;
+    uint8_t ucPass = 1;
+
+    ucInput = TEST_PATTERN;
+    if (!prvStart(ucIpc)) {
+        printf("FAIL %s: pipeline init\n", pcIpcNames[ucIpc]);
+        return 0;
+    }
+    adcScanControl(1);
+
+    RtosTaskSwitch(xProc);
+    for (ulBlock = 0; ulBlock < testBLOCKS && ucPass; ulBlock++) {
+        pxBlock = PipelineReceive(&xAcqToProc, portMAX_DELAY);
+        if (pxBlock->ulSequence < ulExpected || pxBlock->usCount != testADC_BLOCK_SIZE) {
+            printf("FAIL %s: block %u has sequence %u and %u samples\n", pcIpcNames[ucIpc], (unsigned)ulBlock,
+                    (unsigned)pxBlock->ulSequence, pxBlock->usCount);
+            ucPass = 0;
+        }
+        ulGaps += pxBlock->ulSequence - ulExpected;
+        ulExpected = pxBlock->ulSequence + 1;
+
+        for (usSample = 0; usSample < pxBlock->usCount && ucPass; usSample++) {
+            uint16_t usWanted = prvPattern(0, pxBlock->ulSequence*testADC_BLOCK_SIZE + usSample);
+
+            if (pxBlock->pusSamples[usSample] != usWanted) {
+                printf("FAIL %s: block %u sample %u is %u, expected %u\n", pcIpcNames[ucIpc],
+                        (unsigned)pxBlock->ulSequence, usSample, pxBlock->pusSamples[usSample], usWanted);
+                ucPass = 0;
+            }
+        }
+        SfrRun(ulProcUs*(configPERIPHERAL_CLOCK_HZ/1000000)); /* DecimateBlock() and the rest */
+        PipelineFree(&xPool, pxBlock);
+    }
+    RtosTaskSwitch(NULL);
+
+    /* Blocks completed by ACQ: received, dropped, or still in the link */
+    if (ucPass && ulGaps + (xAcqStage.ulSequence - ulExpected) != xAcqToProc.ulDropped + RingCount(&xAcqToProc.xRing) +
+            (xAcqToProc.xQueue != NULL ? uxQueueMessagesWaiting(xAcqToProc.xQueue) : 0)) {
+        printf("FAIL %s: %u blocks missing, %u dropped\n", pcIpcNames[ucIpc], (unsigned)ulGaps, (unsigned)xAcqToProc.ulDropped);
+        ucPass = 0;
+    }
+    if (ucPass && (ulGaps > 0) != ucExpectDrops) {
+        printf("FAIL %s: %u blocks dropped with PROC taking %u us per block\n", pcIpcNames[ucIpc], (unsigned)ulGaps,
+                (unsigned)ulProcUs);
+        ucPass = 0;
+    }
+    if (ucPass && xAcqToProc.xLatency.ulCount != testBLOCKS) {
+        printf("FAIL %s: %u latencies for %u blocks\n", pcIpcNames[ucIpc], (unsigned)xAcqToProc.xLatency.ulCount, testBLOCKS);
+        ucPass = 0;
+    }
+    if (ucPass)
+        printf("PASS %s, PROC %u us/block: %u dropped, ACQ->PROC latency %u-%u us\n", pcIpcNames[ucIpc],
+                (unsigned)ulProcUs, (unsigned)ulGaps, (unsigned)(xAcqToProc.xLatency.ulMin/(pipelineTIMESTAMP_HZ/1000000)),
+                (unsigned)(xAcqToProc.xLatency.ulMax/(pipelineTIMESTAMP_HZ/1000000)));
+
+    prvStop();
+    return ucPass;
+}
+
+/* Reads two channels directly, 8 conversions per interrupt: the halves
+ * of ADC1BUF must alternate and each read must start with AN0 */
+static uint16_t usScan[testSCAN_IRQS*adcSCAN_BUFFER_SIZE];
+static uint16_t usScanCount;
+
+static void prvScanIsr(void){
+    usScanCount += adcScanRead(&usScan[usScanCount]);
+    if (usScanCount == sizeof(usScan)/sizeof(usScan[0]))
+        adcScanControl(0);
+}
+
+static uint8_t prvTestScan(void){
+    uint16_t usSample;
+
+    ucInput = TEST_PATTERN;
+    usScanCount = 0;
+    if (SfrOpen(NULL) != SFR_SUCCESS ||
+        adcScanConfig(testSCAN_CHANNELS, configPERIPHERAL_CLOCK_HZ, testADC_SAMPLE_RATE, adcSCAN_BUFFER_SIZE) != adcADC_SUCCESS) {
+        printf("FAIL scan: config\n");
+        return 0;
+    }
+    SfrAdcSetInput(prvInput);
+    SfrSetIsr(sfrVECTOR_ADC, prvScanIsr);
+    adcScanControl(1);
+    SfrRun(testSCAN_IRQS*adcSCAN_BUFFER_SIZE*(configPERIPHERAL_CLOCK_HZ/testADC_SAMPLE_RATE) + 1000);
+    SfrSetIsr(sfrVECTOR_ADC, NULL);
+    SfrClose();
+
+    if (usScanCount != sizeof(usScan)/sizeof(usScan[0])) {
+        printf("FAIL scan: %u samples\n", usScanCount);
+        return 0;
+    }
+    for (usSample = 0; usSample < usScanCount; usSample++) {
+        if (usScan[usSample] != prvPattern(usSample & 1, usSample)) {
+            printf("FAIL scan: sample %u is %u, expected %u\n", usSample, usScan[usSample], prvPattern(usSample & 1, usSample));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* pvProc() and pvOut() of the mainXXX.c on a noisy DC input. Every result
+ * after the first (filter settling) must print the temperature of
+ * testNOISE_DC, and the variance of the decimated samples must be well
+ * below the one of the input. */
+static uint8_t prvTestSignal(void){
+    static char cExpected[testOUT_STRING_MAX_SIZE];
+    char cStr[testOUT_STRING_MAX_SIZE];
+    PipelineBlock_t *pxBlock;
+    uint32_t ulVariance = 0;
+    uint16_t usTemp;
+    uint8_t ucResult;
+    uint8_t ucBlock_count;
+    uint8_t ucPass = 1;
+
+    ucInput = TEST_NOISE;
+    if (!prvStart(pipelineIPC_QUEUE) || UartInit(configPERIPHERAL_CLOCK_HZ, 115200) != UART_SUCCESS) {
+        printf("FAIL signal: init\n");
+        return 0;
+    }
+    usTemp = StageToTemp(testNOISE_DC*10 << (decimateOUT_BITS - testADC_RESOLUTION));
+    snprintf(cExpected, sizeof(cExpected), "\r\n%d.%1d (0 dropped)", usTemp/10, usTemp%10);
+    adcScanControl(1);
+
+    for (ucResult = 0; ucResult < 3 && ucPass; ucResult++) {
+        RtosTaskSwitch(xProc);
+        for (ucBlock_count = 0; ucBlock_count < testPROC_NUM_BLOCKS; ucBlock_count++)
+            StageProcBlock(&xProcStage, PipelineReceive(&xAcqToProc, portMAX_DELAY));
+
+        RtosTaskSwitch(xOut);
+        pxBlock = PipelineReceive(&xProcToOut, 0);
+        if (pxBlock == NULL) {
+            printf("FAIL signal: no result from PROC after %u blocks\n", testPROC_NUM_BLOCKS);
+            ucPass = 0;
+            break;
+        }
+        ulVariance = PipelineStatsVariance(&pxBlock->xStats, 1);
+        StageOutFormat(cStr, sizeof(cStr), pxBlock, xAcqToProc.ulDropped);
+        PipelineFree(&xPool, pxBlock);
+        SfrUartCapture(ucCapture, sizeof(ucCapture));
+        PrintStr((uint8_t *)cStr);
+        SfrRun(strlen(cStr)*10*(configPERIPHERAL_CLOCK_HZ/115200)); /* Last bytes still in the FIFO */
+
+        if (ucResult > 0 && (xSfr.ulTxBytes != strlen(cExpected) || memcmp(ucCapture, cExpected, xSfr.ulTxBytes) != 0)) {
+            printf("FAIL signal: result %u printed \"%.*s\", expected \"%s\"\n", ucResult,
+                    (int)(xSfr.ulTxBytes < sizeof(ucCapture) ? xSfr.ulTxBytes : sizeof(ucCapture)), ucCapture, cExpected + 2);
+            ucPass = 0;
+        }
+        /* In ADC counts^2, the decimated samples are 2^6 times larger */
+        if (ucResult > 0 && ulVariance >= ((testNOISE_SPAN*(testNOISE_SPAN + 1)/3)/8 << 2*(decimateOUT_BITS - testADC_RESOLUTION))) {
+            printf("FAIL signal: result %u variance %.2f counts^2\n", ucResult,
+                    ulVariance/(double)(1 << 2*(decimateOUT_BITS - testADC_RESOLUTION)));
+            ucPass = 0;
+        }
+    }
+    RtosTaskSwitch(NULL);
+    SfrUartCapture(NULL, 0);
+    prvStop();
+
+    if (ucPass)
+        printf("PASS signal: printed \"%s\", variance %.3f counts^2 for %d at the input\n", cExpected + 2,
+                ulVariance/(double)(1 << 2*(decimateOUT_BITS - testADC_RESOLUTION)), testNOISE_SPAN*(testNOISE_SPAN + 1)/3);
+    return ucPass;
+}
+
+/* Benchmark state, PROC busy until ullProcBusy */
+static const uint32_t ulBenchRates[] = {100000, 200000, 400000};
+static PipelineBenchResult_t xBenchResults[sizeof(ulBenchRates)/sizeof(ulBenchRates[0])];
+static uint64_t ullProcBusy;
+
+/* prvBenchAdc() of mainQueue.c */
+static int8_t prvBenchAdc(uint32_t ulRate){
+    adcScanControl(0);
+    if (ulRate == 0)
+        return 0;
+    if (adcScanConfig(0x01, configPERIPHERAL_CLOCK_HZ, ulRate, testADC_SAMPLES_PER_IRQ) != adcADC_SUCCESS)
+        return -1;
+    adcScanControl(1);
+    return 0;
+}
+
+/* PROC and OUT while BENCH waits. PROC takes testBENCH_PROC_NS per
+ * sample, OUT frees the blocks. */
+static void prvBenchTasks(void){
+    PipelineBlock_t *pxBlock;
+
+    if (xSfr.ullTicks >= ullProcBusy) {
+        RtosTaskSwitch(xProc);
+        pxBlock = PipelineReceive(&xAcqToProc, 0);
+        if (pxBlock != NULL) {
+            ullProcBusy = xSfr.ullTicks + (uint64_t)pxBlock->usCount*testBENCH_PROC_NS*(configPERIPHERAL_CLOCK_HZ/1000000)/1000;
+            StageProcBlock(&xProcStage, pxBlock);
+        }
+    }
+    RtosTaskSwitch(xOut);
+    pxBlock = PipelineReceive(&xProcToOut, 0);
+    if (pxBlock != NULL)
+        PipelineFree(&xPool, pxBlock);
+}
+
+/* PipelineBenchTask() of the mainXXX.c BENCHMARK builds, with PROC
+ * limited to 1e9/testBENCH_PROC_NS samples per second. Below that every
+ * sample must be delivered with no drops, above it PROC must get what
+ * it can take and ACQ must drop the rest. A block of the measurement
+ * time and 5% of the rate are allowed for its start and end. The
+ * stand-in has no scheduler, the switches/s it prints stay at 0. */
+static uint8_t prvTestBench(uint8_t ucIpc){
+    PipelineBench_t xBench = {&xAcqToProc, &xProcToOut, ucIpc, testADC_BLOCK_SIZE, ulBenchRates,
+        sizeof(ulBenchRates)/sizeof(ulBenchRates[0]), testBENCH_PERIOD_MS, prvBenchAdc, xBenchResults};
+    uint32_t ulCapacity = 1000000000UL/testBENCH_PROC_NS;
+    uint32_t ulExpected, ulSlack;
+    uint8_t ucRate;
+    uint8_t ucPass = 1;
+
+    ucInput = TEST_PATTERN;
+    if (!prvStart(ucIpc)) {
+        printf("FAIL bench %s: pipeline init\n", pcIpcNames[ucIpc]);
+        return 0;
+    }
+    ullProcBusy = 0;
+    RtosSetBackground(prvBenchTasks);
+    PipelineBench(&xBench);
+    RtosSetBackground(NULL);
+    printf("\n");
+
+    for (ucRate = 0; ucRate < xBench.ucRates; ucRate++) {
+        const PipelineBenchResult_t *pxResult = &xBenchResults[ucRate];
+
+        ulExpected = (ulBenchRates[ucRate] < ulCapacity) ? ulBenchRates[ucRate] : ulCapacity;
+        ulSlack = ulExpected/20 + testADC_BLOCK_SIZE*1000/testBENCH_PERIOD_MS;
+        if (pxResult->ulRate != ulBenchRates[ucRate] || pxResult->ulDelivered + ulSlack < ulExpected ||
+            pxResult->ulDelivered > ulExpected + ulSlack || (pxResult->ulDropped > 0) != (ulBenchRates[ucRate] > ulCapacity)) {
+            printf("FAIL bench %s %u S/s: %u S/s delivered, %u dropped, PROC takes %u S/s\n", pcIpcNames[ucIpc],
+                    (unsigned)ulBenchRates[ucRate], (unsigned)pxResult->ulDelivered, (unsigned)pxResult->ulDropped,
+                    (unsigned)ulCapacity);
+            ucPass = 0;
+        }
+    }
+    if (ucPass)
+        printf("PASS bench %s: %u rates, PROC takes %u S/s\n", pcIpcNames[ucIpc], xBench.ucRates, (unsigned)ulCapacity);
+
+    prvStop();
+    return ucPass;
+}
+
+int main(void){
+    uint8_t ucIpc;
+    uint8_t ucFailed = 0;
+
+    xProc = RtosTaskCreate("Proc");
+    xOut = RtosTaskCreate("Out");
+
+    if (!prvTestScan())
+        ucFailed++;
+    for (ucIpc = pipelineIPC_QUEUE; ucIpc <= pipelineIPC_TASK_NOTIFY; ucIpc++) {
+        if (!prvTestBlocks(ucIpc, testPROC_FAST_US, 0))
+            ucFailed++;
+        if (!prvTestBlocks(ucIpc, testPROC_SLOW_US, 1))
+            ucFailed++;
+    }
+    if (!prvTestSignal())
+        ucFailed++;
+    for (ucIpc = pipelineIPC_QUEUE; ucIpc <= pipelineIPC_TASK_NOTIFY; ucIpc++) {
+        if (!prvTestBench(ucIpc))
+            ucFailed++;
+    }
+
+    printf("%s: %u of %u checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed, 1 + 2*3 + 1 + 3);
+    return ucFailed ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * File:   decimate_test.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host test of Pipeline/decimate.c against a floating point
+ *           reference. The reference is computed independently of the
+ *           fixed point code: the CIC is the convolution with three
+ *           boxcars of 2^N samples, in doubles with no wrap around,
+ *           then the gain scaling and the FIR are exact products. Every
+ *           output must be within the rounding bound of the reference:
+ *           0.5 LSB for the Q15 FIR output, plus 0.5 LSB of CIC
+ *           rounding times the sum of |coefficients| when the CIC gain
+ *           is scaled down (1.43 LSB). Where the output does not
+ *           saturate the mean error must stay within 0.15 LSB, so a
+ *           truncation in place of a rounding is caught. The record
+ *           is also filtered in place in blocks of uneven sizes,
+ *           which must give the outputs of one call bit for bit, so the
+ *           phase and filter state carry over.
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -o decimate_test decimate_test.c ../Pipeline/decimate.c -lm && ./decimate_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../Pipeline/decimate.h"
+
+#define testSEGMENT_SIZE 4096
+#define testRECORD_SIZE (4*testSEGMENT_SIZE)
+#define testNUM_RATIOS 4
+#define testMAX_MEAN_ERROR 0.15 /* LSB, a truncation instead of a rounding shifts it by up to 0.5 */
+
+static const uint8_t ucRatios[testNUM_RATIOS] = {0, 1, 4, 7};
+static const uint16_t usBlockSizes[] = {1, 3, 7, 64, 129, 500, 2, 250}; /* Cycled through */
+
+/* The filter specification of decimate.c, Q15 */
+static const int16_t sCoefficients[decimateFIR_TAPS] = {
+    -618, -469, 1275, 1355, -2400, -3570, 4834, 15977,
+    15977, 4834, -3570, -2400, 1355, 1275, -469, -618
+};
+
+static uint16_t usInput[testRECORD_SIZE];
+static double dReference[testRECORD_SIZE];
+static uint16_t usOutput[testRECORD_SIZE];
+static uint16_t usBlockOutput[testRECORD_SIZE];
+static uint16_t usBlock[testRECORD_SIZE];
+
+/* Full scale steps (the FIR overshoot saturates at both ends), a triangle,
+ * uniform noise and a slow ramp to full scale */
+static void prvRecord(void){
+    uint32_t ulState = 12345;
+    uint16_t usIterator, usPhase;
+
+    for (usIterator = 0; usIterator < testSEGMENT_SIZE; usIterator++) {
+        usInput[usIterator] = 1023*((usIterator/512) % 2);
+        usPhase = usIterator % 200;
+        usInput[testSEGMENT_SIZE + usIterator] = 10*(usPhase < 200 - usPhase ? usPhase : 200 - usPhase);
+        ulState = 1664525*ulState + 1013904223;
+        usInput[2*testSEGMENT_SIZE + usIterator] = (ulState >> 16) % 1024;
+        usInput[3*testSEGMENT_SIZE + usIterator] = (uint32_t)usIterator*1023/(testSEGMENT_SIZE - 1);
+    }
+}
+
+/* Floating point decimator, from a cleared state like DecimateInit().
+ * Returns the number of outputs. */
+static uint32_t prvReference(uint8_t ucLog2Ratio){
+    static double dCic[testRECORD_SIZE];
+    uint32_t ulRatio = 1UL << ucLog2Ratio;
+    uint32_t ulOutputs = testRECORD_SIZE/ulRatio;
+    double dScale = ldexp(1.0, -(decimateCIC_ORDER*ucLog2Ratio + decimateIN_BITS - decimateOUT_BITS));
+    double dBox[3*128];
+    double dSum;
+    uint32_t ulLength = 1, ulOutput, ulTap;
+    int32_t lIndex;
+    uint8_t ucStage;
+
+    /* Impulse response of the CIC, three boxcars of ulRatio */
+    dBox[0] = 1.0;
+    for (ucStage = 0; ucStage < decimateCIC_ORDER; ucStage++) {
+        for (ulTap = ulLength + ulRatio - 1; ulTap-- > 0;) {
+            dSum = 0.0;
+            for (lIndex = (int32_t)ulTap; lIndex > (int32_t)ulTap - (int32_t)ulRatio && lIndex >= 0; lIndex--)
+                if ((uint32_t)lIndex < ulLength)
+                    dSum += dBox[lIndex];
+            dBox[ulTap] = dSum;
+        }
+        ulLength += ulRatio - 1;
+    }
+
+    /* Output n ends with input (n+1)*ulRatio-1 */
+    for (ulOutput = 0; ulOutput < ulOutputs; ulOutput++) {
+        dSum = 0.0;
+        for (ulTap = 0; ulTap < ulLength; ulTap++) {
+            lIndex = (int32_t)((ulOutput + 1)*ulRatio - 1 - ulTap);
+            if (lIndex >= 0)
+                dSum += dBox[ulTap]*usInput[lIndex];
+        }
+        dCic[ulOutput] = dSum*dScale;
+    }
+
+    for (ulOutput = 0; ulOutput < ulOutputs; ulOutput++) {
+        dSum = 0.0;
+        for (ulTap = 0; ulTap < decimateFIR_TAPS; ulTap++)
+            if (ulOutput >= ulTap)
+                dSum += dCic[ulOutput - ulTap]*sCoefficients[ulTap]/(double)(1 << decimateFIR_SHIFT);
+        dReference[ulOutput] = fmin(fmax(dSum, 0.0), UINT16_MAX);
+    }
+    return ulOutputs;
+}
+
+/* Rounding bound of decimate.c against the reference, in output LSB */
+static double prvBound(uint8_t ucLog2Ratio){
+    double dSum = 0.0;
+    uint8_t ucTap;
+
+    if (decimateCIC_ORDER*ucLog2Ratio + decimateIN_BITS <= decimateOUT_BITS)
+        return 0.5; /* The CIC output is scaled up, exact */
+    for (ucTap = 0; ucTap < decimateFIR_TAPS; ucTap++)
+        dSum += abs(sCoefficients[ucTap]);
+    return 0.5 + 0.5*dSum/(1 << decimateFIR_SHIFT);
+}
+
+static uint8_t prvCheckReference(uint8_t ucLog2Ratio, uint32_t ulOutputs, uint32_t ulExpected){
+    double dBound = prvBound(ucLog2Ratio);
+    double dError, dWorst = 0.0, dMean = 0.0;
+    uint32_t ulIndex, ulWorst = 0, ulLinear = 0;
+
+    if (ulOutputs != ulExpected) {
+        printf("FAIL ratio %u: %u outputs, expected %u\n", 1U << ucLog2Ratio, (unsigned)ulOutputs, (unsigned)ulExpected);
+        return 0;
+    }
+    for (ulIndex = 0; ulIndex < ulOutputs; ulIndex++) {
+        dError = usOutput[ulIndex] - dReference[ulIndex];
+        if (dReference[ulIndex] > 0.0 && dReference[ulIndex] < UINT16_MAX) { /* Not saturated */
+            dMean += dError;
+            ulLinear++;
+        }
+        if (fabs(dError) > fabs(dWorst)) {
+            dWorst = dError;
+            ulWorst = ulIndex;
+        }
+    }
+    dMean /= ulLinear;
+    if (fabs(dWorst) > dBound + 1e-9 || fabs(dMean) > testMAX_MEAN_ERROR) {
+        printf("FAIL ratio %u: output %u is %u, reference %.3f, bound %.3f LSB, mean error %.3f LSB\n", 1U << ucLog2Ratio,
+                (unsigned)ulWorst, usOutput[ulWorst], dReference[ulWorst], dBound, dMean);
+        return 0;
+    }
+    printf("PASS ratio %u: %u outputs, worst error %.3f of %.3f LSB, mean %.4f LSB\n", 1U << ucLog2Ratio,
+            (unsigned)ulOutputs, dWorst, dBound, dMean);
+    return 1;
+}
+
+static uint8_t prvCheckBlocks(uint8_t ucLog2Ratio, uint32_t ulOutputs, uint32_t ulExpected){
+    uint32_t ulIndex;
+
+    if (ulOutputs != ulExpected) {
+        printf("FAIL ratio %u uneven blocks: %u outputs, expected %u\n", 1U << ucLog2Ratio, (unsigned)ulOutputs,
+                (unsigned)ulExpected);
+        return 0;
+    }
+    for (ulIndex = 0; ulIndex < ulOutputs; ulIndex++) {
+        if (usBlockOutput[ulIndex] != usOutput[ulIndex]) {
+            printf("FAIL ratio %u uneven blocks: output %u is %u, one block gives %u\n", 1U << ucLog2Ratio,
+                    (unsigned)ulIndex, usBlockOutput[ulIndex], usOutput[ulIndex]);
+            return 0;
+        }
+    }
+    printf("PASS ratio %u uneven blocks: %u outputs\n", 1U << ucLog2Ratio, (unsigned)ulOutputs);
+    return 1;
+}
+
+int main(void){
+    Decimator_t xDecimator;
+    uint32_t ulExpected, ulOutputs, ulDone;
+    uint16_t usCount, usBlockOutputs;
+    uint8_t ucRatio, ucBlock;
+    uint8_t ucFailed = 0;
+    uint8_t ucChecks = 1;
+
+    prvRecord();
+
+    if (DecimateInit(&xDecimator, decimateMAX_LOG2_RATIO + 1) != DECIMATE_INVALID_RATIO) {
+        printf("FAIL ratio 2^%u accepted\n", decimateMAX_LOG2_RATIO + 1);
+        ucFailed++;
+    }
+
+    for (ucRatio = 0; ucRatio < testNUM_RATIOS; ucRatio++) {
+        ulExpected = prvReference(ucRatios[ucRatio]);
+        ucChecks += 2;
+
+        /* Whole record in one call */
+        DecimateInit(&xDecimator, ucRatios[ucRatio]);
+        ulOutputs = DecimateBlock(&xDecimator, usInput, usOutput, testRECORD_SIZE);
+        if (!prvCheckReference(ucRatios[ucRatio], ulOutputs, ulExpected))
+            ucFailed++;
+
+        /* Uneven blocks, in place like pvProc() */
+        DecimateInit(&xDecimator, ucRatios[ucRatio]);
+        memcpy(usBlock, usInput, sizeof(usInput));
+        ulOutputs = 0;
+        for (ulDone = 0, ucBlock = 0; ulDone < testRECORD_SIZE; ulDone += usCount, ucBlock++) {
+            usCount = usBlockSizes[ucBlock % (sizeof(usBlockSizes)/sizeof(usBlockSizes[0]))];
+            if (usCount > testRECORD_SIZE - ulDone)
+                usCount = testRECORD_SIZE - ulDone;
+            usBlockOutputs = DecimateBlock(&xDecimator, &usBlock[ulDone], &usBlock[ulDone], usCount);
+            memcpy(&usBlockOutput[ulOutputs], &usBlock[ulDone], usBlockOutputs*sizeof(uint16_t));
+            ulOutputs += usBlockOutputs;
+        }
+        if (!prvCheckBlocks(ucRatios[ucRatio], ulOutputs, ulExpected))
+            ucFailed++;
+    }
+
+    printf("%s: %u of %u checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed, ucChecks);
+    return ucFailed ? 1 : 0;
+}
@@ -0,0 +1,387 @@
+/*
+ * File:   uart_test.c
+ * Author: Diogo Vala
+ *
+ * Overview: Host test of the interrupt driven UART of UART/uart.c, run as
+ *           it is on the UART1 model of Sim/ at 115200 baud. Bytes
+ *           written with UartWrite() must leave the TX pin in order and
+ *           back to back, at the line rate, while the writer only spends
+ *           the time to copy them to the TX ring. Bytes arriving at the
+ *           line rate must be read back in order with UartRead(), with
+ *           no RX FIFO overrun, also while a long write is sending.
+ *           With no wait, both must return at once with what fits.
+ *           Last, UartCalcBrg() must find the best UxBRG and BRGH for
+ *           every baudrate and PBCLK of the tables, checked against a
+ *           search of all the dividers.
+ *
+ *           Build and run from this folder:
+ *           gcc -Wall -O2 -I../Sim -o uart_test uart_test.c ../UART/uart.c ../Sim/sfr.c ../Sim/rtos.c && ./uart_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Sim/sfr.h"
+#include "../UART/uart.h"
+
+#define testBAUDRATE 115200
+#define testFRAME_TICKS (10*4*87) /* 10 bits, BRGH=1, BRG=86 at 40 MHz */
+#define testSTART_TICKS 64 /* UartWrite() to the first start bit */
+#define testTX_RING 256
+#define testRX_RING 256
+#define testBYTES 1024 /* Per transfer, several times the rings */
+#define testREAD_CHUNK 64 /* UartRead() size of the reader */
+#define testMESSAGE 100 /* Bytes of the CPU time check, fits the TX ring */
+
+/* BRG matrix, PBCLK of the boards and crystals in use */
+static const uint32_t ulBrgClocks[] = {4000000, 8000000, 10000000, 20000000, 36000000, 40000000, 48000000, 80000000};
+static const uint32_t ulBrgRates[] = {300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+static uint8_t ucTxData[testBYTES];
+static uint8_t ucRxData[testBYTES];
+static uint8_t ucCapture[testBYTES];
+static uint8_t ucRead[testBYTES];
+
+/* UART1 vector of the applications */
+static void prvUartIsr(void){
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    UartInterruptHandler(&xHigherPriorityTaskWoken);
+    portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/* LCG bytes, the sequence does not repeat within a ring */
+static void prvPattern(uint8_t *pucData, uint32_t ulLen, uint32_t ulSeed){
+    uint32_t ulIndex;
+
+    for (ulIndex = 0; ulIndex < ulLen; ulIndex++) {
+        ulSeed = 1664525*ulSeed + 1013904223;
+        pucData[ulIndex] = (uint8_t)(ulSeed >> 24);
+    }
+}
+
+/* First differing byte, ulLen if none */
+static uint32_t prvDiffer(const uint8_t *pucData, const uint8_t *pucExpected, uint32_t ulLen){
+    uint32_t ulIndex;
+
+    for (ulIndex = 0; ulIndex < ulLen; ulIndex++)
+        if (pucData[ulIndex] != pucExpected[ulIndex])
+            break;
+    return ulIndex;
+}
+
+static uint8_t prvStart(size_t xRxSize){
+    SfrSetIsr(sfrVECTOR_UART1, prvUartIsr);
+    if (SfrOpen(NULL) != SFR_SUCCESS || UartInit(configPERIPHERAL_CLOCK_HZ, testBAUDRATE) != UART_SUCCESS ||
+            UartBufferedInit(testTX_RING, xRxSize) != UART_SUCCESS)
+        return 0;
+    SfrUartCapture(ucCapture, sizeof(ucCapture));
+    return 1;
+}
+
+/* The counts of the model are kept for the checks */
+static void prvStop(void){
+    SfrSetIsr(sfrVECTOR_UART1, NULL);
+    SfrClose();
+}
+
+/* Runs until ulBytes were sent, or for the time they take on the line */
+static void prvDrain(uint32_t ulBytes){
+    uint64_t ullLimit = xSfr.ullTicks + (uint64_t)(ulBytes + 1)*testFRAME_TICKS;
+
+    while (xSfr.ulTxBytes < ulBytes && xSfr.ullTicks < ullLimit)
+        SfrRun(1);
+}
+
+static uint8_t prvCheckSent(const char *pcTest, uint32_t ulBytes){
+    uint32_t ulIndex;
+
+    if (xSfr.ulTxBytes != ulBytes) {
+        printf("FAIL %s: %u bytes sent, expected %u\n", pcTest, (unsigned)xSfr.ulTxBytes, (unsigned)ulBytes);
+        return 0;
+    }
+    ulIndex = prvDiffer(ucCapture, ucTxData, ulBytes);
+    if (ulIndex != ulBytes) {
+        printf("FAIL %s: byte %u sent 0x%02X, expected 0x%02X\n", pcTest, (unsigned)ulIndex, ucCapture[ulIndex], ucTxData[ulIndex]);
+        return 0;
+    }
+    return 1;
+}
+
+/* One write of several rings: every byte in order, no idle time on the
+ * line between the first start bit and the last stop bit. */
+static uint8_t prvTestTxThroughput(void){
+    uint64_t ullStart;
+    uint64_t ullElapsed;
+    size_t xSent;
+
+    prvPattern(ucTxData, testBYTES, 1);
+    if (!prvStart(0)) {
+        printf("FAIL TX throughput: init\n");
+        return 0;
+    }
+    ullStart = xSfr.ullTicks;
+    xSent = UartWrite(ucTxData, testBYTES, portMAX_DELAY);
+    prvDrain(testBYTES);
+    ullElapsed = xSfr.ullTicks - ullStart;
+    prvStop();
+
+    if (xSent != testBYTES) {
+        printf("FAIL TX throughput: %u bytes written, expected %u\n", (unsigned)xSent, testBYTES);
+        return 0;
+    }
+    if (!prvCheckSent("TX throughput", testBYTES))
+        return 0;
+    if (ullElapsed > (uint64_t)testBYTES*testFRAME_TICKS + testSTART_TICKS) {
+        printf("FAIL TX throughput: %u bytes in %.2f frames\n", testBYTES, (double)ullElapsed/testFRAME_TICKS);
+        return 0;
+    }
+    printf("PASS TX throughput: %u bytes in order at %.0f bytes/s, line rate %.0f bytes/s\n", testBYTES,
+            testBYTES*(double)configPERIPHERAL_CLOCK_HZ/ullElapsed, (double)configPERIPHERAL_CLOCK_HZ/testFRAME_TICKS);
+    return 1;
+}
+
+/* A message that fits the ring costs the writer far less than one frame,
+ * PrintStr() waits until all but the last 8 bytes are on the line. */
+static uint8_t prvTestTxCpu(void){
+    static char cMessage[testMESSAGE + 1];
+    uint64_t ullStart;
+    uint64_t ullWrite, ullPolled;
+    size_t xSent;
+
+    prvPattern(ucTxData, testMESSAGE, 2);
+    for (xSent = 0; xSent < testMESSAGE; xSent++)
+        ucTxData[xSent] |= 0x01; /* No NULL in the string */
+    memcpy(cMessage, ucTxData, testMESSAGE);
+    if (!prvStart(0)) {
+        printf("FAIL TX CPU time: init\n");
+        return 0;
+    }
+    ullStart = xSfr.ullTicks;
+    PrintStr((uint8_t *)cMessage);
+    ullPolled = xSfr.ullTicks - ullStart;
+    prvDrain(testMESSAGE);
+    SfrUartCapture(ucCapture, sizeof(ucCapture));
+
+    ullStart = xSfr.ullTicks;
+    xSent = UartWrite(ucTxData, testMESSAGE, portMAX_DELAY);
+    ullWrite = xSfr.ullTicks - ullStart;
+    prvDrain(testMESSAGE);
+    prvStop();
+
+    if (xSent != testMESSAGE || !prvCheckSent("TX CPU time", testMESSAGE))
+        return 0;
+    if (ullWrite >= testFRAME_TICKS) {
+        printf("FAIL TX CPU time: UartWrite() took %u PBCLK ticks for %u bytes\n", (unsigned)ullWrite, testMESSAGE);
+        return 0;
+    }
+    printf("PASS TX CPU time: %u bytes in %u PBCLK ticks, PrintStr() %u\n", testMESSAGE, (unsigned)ullWrite, (unsigned)ullPolled);
+    return 1;
+}
+
+/* With no wait, a write larger than the free ring space returns at once
+ * with what fit, and only those bytes are sent. */
+static uint8_t prvTestTxNonBlocking(void){
+    uint64_t ullStart;
+    uint64_t ullElapsed;
+    size_t xFirst, xSecond;
+
+    prvPattern(ucTxData, testBYTES, 3);
+    if (!prvStart(0)) {
+        printf("FAIL TX non-blocking: init\n");
+        return 0;
+    }
+    ullStart = xSfr.ullTicks;
+    xFirst = UartWrite(ucTxData, testBYTES, 0);
+    xSecond = UartWrite(&ucTxData[xFirst], testBYTES - xFirst, 0); /* Full ring, or what the ISR moved to the FIFO */
+    ullElapsed = xSfr.ullTicks - ullStart;
+    prvDrain(xFirst + xSecond);
+    prvStop();
+
+    if (xFirst == 0 || xFirst > testTX_RING || xSecond > sfrUART_FIFO || ullElapsed >= testFRAME_TICKS) {
+        printf("FAIL TX non-blocking: wrote %u and %u bytes in %u PBCLK ticks\n", (unsigned)xFirst, (unsigned)xSecond,
+                (unsigned)ullElapsed);
+        return 0;
+    }
+    if (!prvCheckSent("TX non-blocking", xFirst + xSecond))
+        return 0;
+    printf("PASS TX non-blocking: wrote %u and %u of %u bytes in %u PBCLK ticks\n", (unsigned)xFirst, (unsigned)xSecond,
+            testBYTES, (unsigned)ullElapsed);
+    return 1;
+}
+
+/* Reads testREAD_CHUNK bytes at most, then works for half the time they
+ * take on the line. Returns the bytes read. */
+static uint32_t prvReadAll(uint32_t ulBytes){
+    uint32_t ulRead = 0;
+    size_t xCount;
+
+    do {
+        xCount = UartRead(&ucRead[ulRead], ulBytes - ulRead < testREAD_CHUNK ? ulBytes - ulRead : testREAD_CHUNK,
+                pdMS_TO_TICKS(10));
+        ulRead += xCount;
+        SfrRun(xCount*testFRAME_TICKS/2);
+    } while (xCount > 0 && ulRead < ulBytes);
+    return ulRead;
+}
+
+static uint8_t prvCheckRead(const char *pcTest, uint32_t ulRead, uint32_t ulBytes){
+    uint32_t ulIndex;
+
+    if (ulRead != ulBytes || xSfr.ulRxLost != 0) {
+        printf("FAIL %s: %u of %u bytes read, %u overrun\n", pcTest, (unsigned)ulRead, (unsigned)ulBytes, (unsigned)xSfr.ulRxLost);
+        return 0;
+    }
+    ulIndex = prvDiffer(ucRead, ucRxData, ulBytes);
+    if (ulIndex != ulBytes) {
+        printf("FAIL %s: byte %u read 0x%02X, expected 0x%02X\n", pcTest, (unsigned)ulIndex, ucRead[ulIndex], ucRxData[ulIndex]);
+        return 0;
+    }
+    return 1;
+}
+
+/* Back to back bytes at the line rate, read in chunks. When all are read
+ * a read with no wait returns nothing at once. */
+static uint8_t prvTestRx(void){
+    uint64_t ullStart;
+    uint64_t ullElapsed;
+    uint32_t ulRead;
+    size_t xEmpty;
+
+    prvPattern(ucRxData, testBYTES, 4);
+    if (!prvStart(testRX_RING)) {
+        printf("FAIL RX: init\n");
+        return 0;
+    }
+    SfrUartReceive(ucRxData, testBYTES);
+    ulRead = prvReadAll(testBYTES);
+    ullStart = xSfr.ullTicks;
+    xEmpty = UartRead(ucRead, 1, 0);
+    ullElapsed = xSfr.ullTicks - ullStart;
+    prvStop();
+
+    if (!prvCheckRead("RX", ulRead, testBYTES))
+        return 0;
+    if (xEmpty != 0 || ullElapsed != 0) {
+        printf("FAIL RX non-blocking: read %u bytes of an empty ring in %u PBCLK ticks\n", (unsigned)xEmpty, (unsigned)ullElapsed);
+        return 0;
+    }
+    printf("PASS RX: %u bytes in order, no overrun, empty read returned at once\n", testBYTES);
+    return 1;
+}
+
+/* Bytes arriving while a blocking write sends: the ISR keeps draining the
+ * RX FIFO into the ring until the reader gets to them. */
+static uint8_t prvTestDuplex(void){
+    uint32_t ulRead;
+    size_t xSent;
+
+    prvPattern(ucTxData, testBYTES, 5);
+    prvPattern(ucRxData, testBYTES/2, 6);
+    if (!prvStart(testBYTES/2)) {
+        printf("FAIL duplex: init\n");
+        return 0;
+    }
+    SfrUartReceive(ucRxData, testBYTES/2);
+    xSent = UartWrite(ucTxData, testBYTES, portMAX_DELAY);
+    ulRead = prvReadAll(testBYTES/2);
+    prvDrain(testBYTES);
+    prvStop();
+
+    if (xSent != testBYTES || !prvCheckSent("duplex", testBYTES) || !prvCheckRead("duplex", ulRead, testBYTES/2))
+        return 0;
+    printf("PASS duplex: %u bytes sent and %u read in order\n", testBYTES, testBYTES/2);
+    return 1;
+}
+
+/* Smallest error of any UxBRG with 4 (BRGH=1) or 16 UART clocks per bit, by trying them all */
+static int32_t prvBestError(uint32_t ulClock, uint32_t ulRate, uint8_t ucClocks){
+    uint32_t ulDivider, ulAchieved;
+    int32_t lError, lBest = INT32_MAX;
+
+    for (ulDivider = 1; ulDivider <= 65536; ulDivider++) {
+        ulAchieved = (uint32_t)(((uint64_t)ulClock + ucClocks*ulDivider/2)/(ucClocks*(uint64_t)ulDivider));
+        lError = (int32_t)(((int64_t)ulAchieved - ulRate)*1000000/ulRate);
+        if (labs(lError) < labs(lBest))
+            lBest = lError;
+    }
+    return lBest;
+}
+
+/* Every clock and baudrate of the tables: UartCalcBrg() must find the
+ * setting with the smallest error, report the baudrate it gives, prefer
+ * BRGH=0 on ties, and UartInit() must program it, or refuse errors
+ * above 2%. */
+static uint8_t prvTestBrg(void){
+    UartBrg_t xBrg;
+    uint32_t ulClock, ulRate, ulAchieved;
+    int32_t lBest16, lBest4, lBest, lWorst = 0;
+    uint8_t ucClock, ucRate, ucUsable = 0;
+    uint8_t ucPass = 1;
+    int xCalc, xInit;
+
+    for (ucClock = 0; ucClock < sizeof(ulBrgClocks)/sizeof(ulBrgClocks[0]); ucClock++) {
+        for (ucRate = 0; ucRate < sizeof(ulBrgRates)/sizeof(ulBrgRates[0]); ucRate++) {
+            ulClock = ulBrgClocks[ucClock];
+            ulRate = ulBrgRates[ucRate];
+            lBest16 = prvBestError(ulClock, ulRate, 16);
+            lBest4 = prvBestError(ulClock, ulRate, 4);
+            lBest = labs(lBest4) < labs(lBest16) ? lBest4 : lBest16;
+            xCalc = UartCalcBrg(ulClock, ulRate, &xBrg);
+            SfrOpen(NULL);
+            xInit = UartInit(ulClock, ulRate);
+
+            if (labs(lBest) > UART_MAX_BR_ERROR) {
+                if (xInit != UART_BR_NOT_SUP) {
+                    printf("FAIL BRG %u Hz %u baud: accepted, best error %d ppm\n", (unsigned)ulClock, (unsigned)ulRate, (int)lBest);
+                    ucPass = 0;
+                }
+                continue;
+            }
+            ucUsable++;
+            if (labs(lBest) > labs(lWorst))
+                lWorst = lBest;
+
+            ulAchieved = (uint32_t)(ulClock/((xBrg.brgh ? 4.0 : 16.0)*(xBrg.brg + 1)) + 0.5);
+            if (xCalc != UART_SUCCESS || labs(xBrg.error) != labs(lBest) ||
+                    (xBrg.brgh && labs(lBest16) == labs(lBest)) || xBrg.br != ulAchieved ||
+                    xBrg.error != (int32_t)(((int64_t)xBrg.br - ulRate)*1000000/ulRate)) {
+                printf("FAIL BRG %u Hz %u baud: BRG %u BRGH %u, %u baud %d ppm, best %d ppm BRGH=0, %d ppm BRGH=1\n",
+                        (unsigned)ulClock, (unsigned)ulRate, xBrg.brg, xBrg.brgh, (unsigned)xBrg.br, (int)xBrg.error,
+                        (int)lBest16, (int)lBest4);
+                ucPass = 0;
+            }
+            else if (xInit != UART_SUCCESS || U1ABRG != xBrg.brg || U1AMODEbits.BRGH != xBrg.brgh) {
+                printf("FAIL BRG %u Hz %u baud: UartInit() returned %d, BRG %u BRGH %u\n", (unsigned)ulClock, (unsigned)ulRate,
+                        xInit, (unsigned)U1ABRG, (unsigned)U1AMODEbits.BRGH);
+                ucPass = 0;
+            }
+        }
+    }
+    SfrClose();
+
+    if (ucPass)
+        printf("PASS BRG: %u of %u clock and baudrate pairs within 2%%, worst %d ppm\n", ucUsable,
+                (unsigned)(sizeof(ulBrgClocks)/sizeof(ulBrgClocks[0])*sizeof(ulBrgRates)/sizeof(ulBrgRates[0])), (int)lWorst);
+    return ucPass;
+}
+
+int main(void){
+    uint8_t ucFailed = 0;
+
+    if (!prvTestTxThroughput())
+        ucFailed++;
+    if (!prvTestTxCpu())
+        ucFailed++;
+    if (!prvTestTxNonBlocking())
+        ucFailed++;
+    if (!prvTestRx())
+        ucFailed++;
+    if (!prvTestDuplex())
+        ucFailed++;
+    if (!prvTestBrg())
+        ucFailed++;
+
+    printf("%s: %u of 6 checks failed\n", ucFailed ? "FAIL" : "PASS", ucFailed);
+    return ucFailed ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * File:   trace.c
+ * Author: Diogo Vala
+ *
+ * Overview: In RAM trace recorder
+ */
+
+#include <xc.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "../UART/uart.h"
+#include "trace.h"
+
+#if (traceBUFFER_RECORDS & (traceBUFFER_RECORDS - 1)) != 0 || traceBUFFER_RECORDS > 32768
+#error "traceBUFFER_RECORDS must be a power of 2, up to 32768"
+#endif
+
+#define traceFRAME_OVERHEAD 5 /* 'T' 'R' type length(2) */
+
+/* Free running indexes, the slot is the index modulo traceBUFFER_RECORDS */
+static TraceRecord_t xBuffer[traceBUFFER_RECORDS];
+static volatile uint16_t usHead = 0; /* Written by TraceRecord() */
+static volatile uint16_t usTail = 0; /* Written by the sender, and TraceRecord() in snapshot mode */
+static volatile uint8_t ucRunning = 0;
+static volatile uint8_t ucMode = traceMODE_SNAPSHOT;
+static volatile uint32_t ulDropped = 0; /* Overwritten (snapshot) or not recorded (stream) */
+
+/* Used by one sender at a time, TraceDump() or the stream task */
+static uint8_t ucFrame[traceFRAME_OVERHEAD + traceFRAME_RECORDS*sizeof(TraceRecord_t)];
+static TaskStatus_t xTasks[traceMAX_TASKS];
+static TickType_t xStreamPeriod;
+
+void TraceRecord(uint8_t ucEvent, uint8_t ucId, uint16_t usArg){
+    uint32_t ulStatus;
+    TraceRecord_t *pxRecord;
+
+    if (!ucRunning)
+        return;
+
+    ulStatus = __builtin_disable_interrupts(); /* Any ISR level may record */
+    if ((uint16_t)(usHead - usTail) == traceBUFFER_RECORDS) {
+        ulDropped++;
+        if (ucMode == traceMODE_STREAM) {
+            _CP0_SET_STATUS(ulStatus);
+            return;
+        }
+        usTail++; /* Snapshot, overwrite the oldest */
+    }
+
+    pxRecord = &xBuffer[usHead & (traceBUFFER_RECORDS - 1)];
+    pxRecord->ulTime = _CP0_GET_COUNT();
+    pxRecord->ucEvent = ucEvent;
+    pxRecord->ucId = ucId;
+    pxRecord->usArg = usArg;
+    usHead++;
+    _CP0_SET_STATUS(ulStatus);
+}
+
+void TraceStart(uint8_t ucNewMode){
+    uint32_t ulStatus = __builtin_disable_interrupts();
+
+    usHead = 0;
+    usTail = 0;
+    ulDropped = 0;
+    ucMode = ucNewMode;
+    ucRunning = 1;
+    _CP0_SET_STATUS(ulStatus);
+}
+
+void TraceStop(void){
+    ucRunning = 0;
+}
+
+/* Sends ucFrame with usLength bytes of payload, already in place */
+static void prvSendFrame(uint8_t ucType, uint16_t usLength){
+    ucFrame[0] = 'T';
+    ucFrame[1] = 'R';
+    ucFrame[2] = ucType;
+    ucFrame[3] = usLength & 0xFF;
+    ucFrame[4] = usLength >> 8;
+    UartWrite(ucFrame, traceFRAME_OVERHEAD + usLength, portMAX_DELAY); /* One write, printf() cannot split it */
+}
+
+static void prvSendHeader(void){
+    uint32_t ulHz = configCPU_CLOCK_HZ/2;
+    uint32_t ulLost = ulDropped;
+
+    memcpy(&ucFrame[traceFRAME_OVERHEAD], &ulHz, sizeof(ulHz)); /* Little endian, like the host */
+    memcpy(&ucFrame[traceFRAME_OVERHEAD + 4], &ulLost, sizeof(ulLost));
+    prvSendFrame(traceFRAME_HEADER, 8);
+}
+
+static void prvSendNames(void){
+    UBaseType_t uxCount;
+    UBaseType_t uxTask;
+    uint16_t usLength = 0;
+    size_t xNameLength;
+
+    uxCount = uxTaskGetSystemState(xTasks, traceMAX_TASKS, NULL);
+    for (uxTask = 0; uxTask < uxCount; uxTask++) {
+        xNameLength = strlen(xTasks[uxTask].pcTaskName);
+        ucFrame[traceFRAME_OVERHEAD + usLength++] = (uint8_t)xTasks[uxTask].xTaskNumber;
+        ucFrame[traceFRAME_OVERHEAD + usLength++] = (uint8_t)xNameLength;
+        memcpy(&ucFrame[traceFRAME_OVERHEAD + usLength], xTasks[uxTask].pcTaskName, xNameLength);
+        usLength += xNameLength;
+    }
+    prvSendFrame(traceFRAME_NAMES, usLength);
+}
+
+/* Sends the records from usTail to usHead, oldest first
+ *
+ * Sending records more events (the UART mutex and ISR, context switches),
+ * so usHead is read once: the records added meanwhile are left for the
+ * next call, otherwise a streaming sender could never catch up.
+ */
+static void prvSendRecords(void){
+    uint16_t usEnd = usHead;
+    uint16_t usCount;
+    uint16_t usRecord;
+
+    while ((usCount = usEnd - usTail) != 0) {
+        if (usCount > traceFRAME_RECORDS)
+            usCount = traceFRAME_RECORDS;
+        for (usRecord = 0; usRecord < usCount; usRecord++)
+            memcpy(&ucFrame[traceFRAME_OVERHEAD + usRecord*sizeof(TraceRecord_t)],
+                    &xBuffer[(usTail + usRecord) & (traceBUFFER_RECORDS - 1)], sizeof(TraceRecord_t));
+        usTail += usCount; /* Slots free for TraceRecord() */
+        prvSendFrame(traceFRAME_EVENTS, usCount*sizeof(TraceRecord_t));
+    }
+}
+
+void TraceDump(void){
+    TraceStop();
+    prvSendHeader();
+    prvSendNames();
+    prvSendRecords();
+    TraceStart(traceMODE_SNAPSHOT);
+}
+
+/* Sends the new records every xStreamPeriod */
+static void prvStreamTask(void *pvParam){
+    TickType_t xLastWake = xTaskGetTickCount();
+    uint32_t ulLastDropped = 0;
+
+    prvSendHeader();
+    prvSendNames();
+    while (1) {
+        vTaskDelayUntil(&xLastWake, xStreamPeriod);
+        prvSendRecords();
+        if (ulDropped != ulLastDropped) { /* Lets the host see the gaps */
+            ulLastDropped = ulDropped;
+            prvSendHeader();
+        }
+    }
+}
+
+int8_t TraceStreamStart(uint8_t ucPriority, uint32_t ulPeriodMs){
+    xStreamPeriod = pdMS_TO_TICKS(ulPeriodMs);
+
+    if (xTaskCreate(prvStreamTask, "Trace", configMINIMAL_STACK_SIZE, NULL, ucPriority, NULL) != pdPASS)
+        return TRACE_NO_MEMORY;
+
+    return TRACE_SUCCESS;
+}
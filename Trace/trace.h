@@ -0,0 +1,153 @@
+/*
+ * File:   trace.h
+ * Author: Diogo Vala
+ *
+ * Overview: In RAM trace of scheduler, queue and ISR events. Each event
+ *           is an 8 byte record stamped with the core timer. The buffer
+ *           is dumped on demand (snapshot mode, oldest records are
+ *           overwritten) or streamed by a task (stream mode, records
+ *           are dropped when the buffer is full), over the UART in
+ *           frames that trace_decode.m turns into a timeline.
+ *
+ *           Included by FreeRTOSConfig.h, to define the kernel trace
+ *           macros, and by the ISR wrappers (.S), for traceISR_WRAP.
+ *           Only depends on stdint.h for that reason.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Define return codes
+#define TRACE_SUCCESS 0
+#define TRACE_NO_MEMORY -1
+
+#ifndef traceBUFFER_RECORDS
+#define traceBUFFER_RECORDS 512 /* Power of 2, 8 bytes each */
+#endif
+#define traceMAX_TASKS 10 /* Tasks in the names frame */
+#define traceFRAME_RECORDS 32 /* Records per events frame */
+
+/* Event types (ucEvent of a record) */
+#define traceEVT_TASK_IN 1 /* ucId: task number */
+#define traceEVT_ISR_ENTER 2 /* ucId: interrupt vector */
+#define traceEVT_ISR_EXIT 3 /* ucId: interrupt vector */
+#define traceEVT_QUEUE_SEND 4 /* ucId: items before the send, usArg: queue address (low half) */
+#define traceEVT_QUEUE_SEND_FAILED 5
+#define traceEVT_QUEUE_SEND_FROM_ISR 6
+#define traceEVT_QUEUE_SEND_FROM_ISR_FAILED 7
+#define traceEVT_QUEUE_RECEIVE 8
+#define traceEVT_QUEUE_RECEIVE_FROM_ISR 9
+#define traceEVT_QUEUE_BLOCK_SEND 10 /* Task blocks on a full queue */
+#define traceEVT_QUEUE_BLOCK_RECEIVE 11 /* Task blocks on an empty queue */
+#define traceEVT_STREAM_SEND_FROM_ISR 12 /* ucId: bytes (255 max), usArg: stream buffer address (low half) */
+#define traceEVT_STREAM_RECEIVE 13
+#define traceEVT_NOTIFY_GIVE_FROM_ISR 14 /* ucId: task number notified */
+#define traceEVT_NOTIFY_TAKE 15 /* ucId: task number */
+#define traceEVT_USER 16 /* TraceUser() */
+
+/* Modes */
+#define traceMODE_SNAPSHOT 0 /* Overwrite the oldest records, TraceDump() */
+#define traceMODE_STREAM 1 /* Drop new records when full, TraceStreamStart() */
+
+/* Frames sent over the UART: 'T' 'R' type length(2) payload, little endian */
+#define traceFRAME_HEADER 'H' /* Timer frequency (4), dropped records (4) */
+#define traceFRAME_NAMES 'N' /* Per task: number (1), name length (1), name */
+#define traceFRAME_EVENTS 'E' /* Records */
+
+#ifdef __LANGUAGE_ASSEMBLY
+
+/* Wraps the call to an ISR handler, after portSAVE_CONTEXT. No delay
+ * slot instructions are expected from the caller (noreorder). */
+	.macro traceISR_WRAP handler, vector
+	li		a0, traceEVT_ISR_ENTER
+	li		a1, \vector
+	jal		TraceRecord
+	move	a2, zero
+	jal		\handler
+	nop
+	li		a0, traceEVT_ISR_EXIT
+	li		a1, \vector
+	jal		TraceRecord
+	move	a2, zero
+	.endm
+
+#else
+
+#include <stdint.h>
+
+/* One event */
+typedef struct {
+    uint32_t ulTime; /* Core timer, SYSCLK/2 */
+    uint8_t ucEvent; /* traceEVT_XXX */
+    uint8_t ucId;
+    uint16_t usArg;
+} TraceRecord_t;
+
+/********************************************************************
+ * Function: 	 TraceRecord()
+ * Precondition:
+ * Input: 		 ucEvent - traceEVT_XXX
+ *               ucId, usArg - Event data
+ * Overview:     Adds a record. Safe from any task, ISR or critical
+ *               section, interrupts are disabled for a few cycles.
+ *               Does nothing while the trace is stopped.
+ ********************************************************************/
+void TraceRecord(uint8_t ucEvent, uint8_t ucId, uint16_t usArg);
+
+/* Application marker, e.g. around a block of code */
+#define TraceUser(ucId, usArg) TraceRecord(traceEVT_USER, (ucId), (usArg))
+
+/********************************************************************
+ * Function: 	 TraceStart() / TraceStop()
+ * Precondition:
+ * Input: 		 ucMode - traceMODE_XXX
+ * Overview:     Clears the buffer and starts recording / stops
+ *               recording, the buffer is kept.
+ ********************************************************************/
+void TraceStart(uint8_t ucMode);
+void TraceStop(void);
+
+/********************************************************************
+ * Function: 	 TraceDump()
+ * Precondition: Snapshot mode. Task context, UartBufferedInit() called.
+ * Overview:     Stops recording and sends the header, task names and
+ *               all the records, oldest first. Recording restarts with
+ *               an empty buffer.
+ ********************************************************************/
+void TraceDump(void);
+
+/********************************************************************
+ * Function: 	 TraceStreamStart()
+ * Precondition: Stream mode. Before vTaskStartScheduler(),
+ *               UartBufferedInit() called.
+ * Input: 		 ucPriority - Priority of the task that sends
+ *               ulPeriodMs - Time between sends
+ * Returns:      TRACE_SUCCESS if the task was created.
+ *               TRACE_XXX error codes in case of failure.
+ * Overview:     Creates a task that sends the header and names once,
+ *               then the new records every ulPeriodMs.
+ * Note:		 115200 baud carries about 1400 records/s. Records that
+ *               do not fit are counted in the header frames.
+ ********************************************************************/
+int8_t TraceStreamStart(uint8_t ucPriority, uint32_t ulPeriodMs);
+
+/* Kernel hooks, expanded inside tasks.c, queue.c and stream_buffer.c */
+#if traceRECORDER_ENABLE
+#define traceTASK_SWITCHED_IN() TraceRecord(traceEVT_TASK_IN, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#define traceQUEUE_SEND(pxQueue) TraceRecord(traceEVT_QUEUE_SEND, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceQUEUE_SEND_FAILED(pxQueue) TraceRecord(traceEVT_QUEUE_SEND_FAILED, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) TraceRecord(traceEVT_QUEUE_SEND_FROM_ISR, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) TraceRecord(traceEVT_QUEUE_SEND_FROM_ISR_FAILED, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceQUEUE_RECEIVE(pxQueue) TraceRecord(traceEVT_QUEUE_RECEIVE, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) TraceRecord(traceEVT_QUEUE_RECEIVE_FROM_ISR, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) TraceRecord(traceEVT_QUEUE_BLOCK_SEND, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) TraceRecord(traceEVT_QUEUE_BLOCK_RECEIVE, (uint8_t)(pxQueue)->uxMessagesWaiting, (uint16_t)(uintptr_t)(pxQueue))
+#define traceSTREAM_BUFFER_SEND_FROM_ISR(xStreamBuffer, xBytes) TraceRecord(traceEVT_STREAM_SEND_FROM_ISR, (xBytes) > 255 ? 255 : (uint8_t)(xBytes), (uint16_t)(uintptr_t)(xStreamBuffer))
+#define traceSTREAM_BUFFER_RECEIVE(xStreamBuffer, xBytes) TraceRecord(traceEVT_STREAM_RECEIVE, (xBytes) > 255 ? 255 : (uint8_t)(xBytes), (uint16_t)(uintptr_t)(xStreamBuffer))
+#define traceTASK_NOTIFY_GIVE_FROM_ISR() TraceRecord(traceEVT_NOTIFY_GIVE_FROM_ISR, (uint8_t)pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_TAKE() TraceRecord(traceEVT_NOTIFY_TAKE, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#endif
+
+#endif /* __LANGUAGE_ASSEMBLY */
+
+#endif
@@ -0,0 +1,123 @@
+function trace_decode(capture, output)
+% Converts a trace capture into Chrome trace JSON
+%
+% capture - file with the raw bytes received from the UART (TraceDump()
+%           or the trace stream). Text between frames is skipped.
+% output  - JSON file, open it in chrome://tracing or ui.perfetto.dev
+%
+% Frames: 'T' 'R' type length(2) payload, little endian (Trace/trace.h).
+% Tasks are slices on the "Tasks" row, ISRs on the "ISR" row, queue and
+% notification events are instants on the row of the task that ran them.
+
+fid = fopen(capture, 'r');
+data = fread(fid, Inf, 'uint8=>uint8')';
+fclose(fid);
+
+hz = 40e6;
+names = containers.Map('KeyType', 'double', 'ValueType', 'char');
+records = zeros(0, 4); % time, event, id, arg
+dropped = 0;
+
+i = 1;
+while i + 4 <= numel(data)
+    if data(i) ~= 'T' || data(i+1) ~= 'R' || ~any(data(i+2) == 'HNE')
+        i = i + 1;
+        continue;
+    end
+    len = double(data(i+3)) + 256*double(data(i+4));
+    if i + 4 + len > numel(data)
+        break;
+    end
+    payload = data(i+5 : i+4+len);
+    switch char(data(i+2))
+        case 'H'
+            hz = double(typecast(payload(1:4), 'uint32'));
+            dropped = double(typecast(payload(5:8), 'uint32'));
+        case 'N'
+            k = 1;
+            while k < numel(payload)
+                n = double(payload(k+1));
+                names(double(payload(k))) = char(payload(k+2 : k+1+n));
+                k = k + 2 + n;
+            end
+        case 'E'
+            r = reshape(payload, 8, []);
+            records = [records; ...
+                double(typecast(reshape(r(1:4,:), 1, []), 'uint32'))', ...
+                double(r(5,:))', double(r(6,:))', ...
+                double(typecast(reshape(r(7:8,:), 1, []), 'uint16'))']; %#ok<AGROW>
+    end
+    i = i + 5 + len;
+end
+
+if isempty(records)
+    error('trace_decode: no events in %s', capture);
+end
+
+% Core timer wraps every 2^32 ticks
+t = records(:,1);
+t = t + 2^32*cumsum([0; diff(t) < -2^31]);
+us = (t - t(1))/hz*1e6;
+
+vectors = containers.Map('KeyType', 'double', 'ValueType', 'char');
+vectors(0) = 'Core timer';  vectors(4) = 'Timer 1';  vectors(8) = 'Timer 2';
+vectors(12) = 'Timer 3';    vectors(24) = 'UART 1';  vectors(27) = 'ADC';
+vectors(36) = 'DMA 0';      vectors(37) = 'DMA 1';   vectors(38) = 'DMA 2';
+
+kinds = {'', '', '', 'queue send', 'queue send failed', 'queue send ISR', ...
+    'queue send ISR failed', 'queue receive', 'queue receive ISR', ...
+    'block on send', 'block on receive', 'stream send ISR', 'stream receive', ...
+    'notify give ISR', 'notify take', 'user'};
+
+events = {};
+events{end+1} = struct('name', 'thread_name', 'ph', 'M', 'pid', 1, 'tid', 1, 'args', struct('name', 'Tasks'));
+events{end+1} = struct('name', 'thread_name', 'ph', 'M', 'pid', 1, 'tid', 2, 'args', struct('name', 'ISR'));
+current = '';
+since = 0;
+for k = 1:size(records, 1)
+    event = records(k,2); id = records(k,3); arg = records(k,4);
+    switch event
+        case 1 % Task switched in, closes the previous slice
+            if ~isempty(current)
+                events{end+1} = struct('name', current, 'ph', 'X', 'ts', since, 'dur', us(k) - since, 'pid', 1, 'tid', 1); %#ok<AGROW>
+            end
+            if isKey(names, id)
+                current = names(id);
+            else
+                current = sprintf('task %d', id);
+            end
+            since = us(k);
+        case {2, 3} % ISR enter/exit
+            if isKey(vectors, id)
+                name = vectors(id);
+            else
+                name = sprintf('vector %d', id);
+            end
+            phase = 'B';
+            if event == 3
+                phase = 'E';
+            end
+            events{end+1} = struct('name', name, 'ph', phase, 'ts', us(k), 'pid', 1, 'tid', 2); %#ok<AGROW>
+        otherwise
+            if event <= numel(kinds)
+                name = sprintf('%s 0x%04X (%d)', kinds{event}, arg, id);
+            else
+                name = sprintf('event %d', event);
+            end
+            events{end+1} = struct('name', name, 'ph', 'i', 's', 't', 'ts', us(k), 'pid', 1, 'tid', 1); %#ok<AGROW>
+    end
+end
+
+fid = fopen(output, 'w');
+fprintf(fid, '{"traceEvents":[\n');
+for k = 1:numel(events)
+    fprintf(fid, '%s', jsonencode(events{k}));
+    if k < numel(events)
+        fprintf(fid, ',\n');
+    end
+end
+fprintf(fid, '\n],"otherData":{"dropped":%d}}\n', dropped);
+fclose(fid);
+
+fprintf('%d events, %d dropped, %.3f ms\n', size(records, 1), dropped, us(end)/1e3);
+end
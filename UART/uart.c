@@ -15,14 +15,85 @@
  * Revisions:
  *      2017-10-25: initial release
  *      2019-01-28: updated to MPLAB X IDE v5.\0 + XC32 v2.15
+ *      2021-07-05: interrupt driven TX/RX rings (FreeRTOS stream buffers)
+ *      2021-07-12: any PBCLOCK/baudrate, BRG and BRGH computed
+ *      2021-07-19: DMA transmit, enabled with UART_DMA_TX_CHANNEL
  */
 
 
 #include <xc.h>
+#include <sys/kmem.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include "uart.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+
+// Buffered mode state. The rings are FreeRTOS stream buffers: single writer,
+// single reader, no locks between the task and the ISR side.
+static StreamBufferHandle_t xTxRing = NULL; // Filled by tasks, drained by the ISR
+static StreamBufferHandle_t xRxRing = NULL; // Filled by the ISR, drained by one task
+static SemaphoreHandle_t xTxMutex = NULL;   // Serializes writers, the ring only allows one
+
+#ifdef UART_DMA_TX_CHANNEL
+// Register r of the DMA channel, channel blocks are 0xC0 bytes apart
+#define UART_DMA_REG(r) (*(&DCH0##r + (UART_DMA_TX_CHANNEL)*0xC0/sizeof(DCH0CON)))
+#define UART_DMA_IF_MASK (1 << (_IFS1_DMA0IF_POSITION + (UART_DMA_TX_CHANNEL)))
+
+static volatile int dmaBusy = 0;            // A UartWriteDMA() buffer is being sent
+static TaskHandle_t dmaNotify = NULL;       // Notified when it is done
+static uint32_t dmaTxisel;                  // UTXISEL to restore when it is done
+#endif
+
+/********************************************************************
+* Function: 	UartCalcBrg()
+* Precondition: 
+* Input: 		PB Clock and baudrate
+* Output:		brg - BRG/BRGH setting, achieved baudrate and its error
+* Returns:      UART_SUCCESS if Ok.
+*               UART_BR_NOT_SUP if the baudrate can't be generated.
+* Side Effects:	None.
+* Overview:     Computes UxBRG for both BRGH values, rounded to the
+*               nearest divider, and keeps the one with the smallest
+*               error. BRGH=0 (16x sampling, more noise immune) wins ties.
+* Note:		 	br = pbclock/(16*(BRG+1)) with BRGH=0
+*               br = pbclock/(4*(BRG+1)) with BRGH=1
+********************************************************************/
+int UartCalcBrg(uint64_t pbclock, uint32_t br, UartBrg_t *brg)
+{
+    uint8_t brgh;
+    uint32_t clocks; // UART clocks per bit
+    uint64_t divider;
+    uint32_t achieved;
+    int32_t error;
+    int found = 0;
+
+    if(br == 0)
+        return UART_BR_NOT_SUP;
+
+    for(brgh = 0; brgh <= 1; brgh++) {
+        clocks = brgh ? 4 : 16;
+        divider = (pbclock + (uint64_t)clocks*br/2) / ((uint64_t)clocks*br); // Rounded BRG+1
+        if(divider == 0 || divider > 65536)
+            continue;
+
+        achieved = (uint32_t)((pbclock + clocks*divider/2) / (clocks*divider));
+        error = (int32_t)(((int64_t)achieved - br)*1000000 / br);
+        if(!found || labs(error) < labs(brg->error)) {
+            brg->brg = (uint16_t)(divider - 1);
+            brg->brgh = brgh;
+            brg->br = achieved;
+            brg->error = error;
+            found = 1;
+        }
+    }
+
+    return found ? UART_SUCCESS : UART_BR_NOT_SUP;
+}
+
 /********************************************************************
 * Function: 	UartInit()
 * Precondition: 
@@ -32,30 +103,34 @@
 * Side Effects:	Takes control of U1A TX and RX pins
 * Overview:     Initializes UART.
 *		
-* Note:		 	Only supports 40MHz PBCLOCK, UART1A and 
-*               {9600/115200},8,n,1 configuration
+* Note:		 	UART1A, {br},8,n,1 configuration. Fails if the baudrate
+*               error is above UART_MAX_BR_ERROR, UartCalcBrg() gives
+*               the achieved baudrate.
 * 
 ********************************************************************/	
 int UartInit(uint64_t pbclock, uint32_t br)
 {
-   if(pbclock != 40000000L) 
-       return UART_PBCLOCK_NOT_SUP; // Todo: add support to common pbclock values.
-       
-   // In the following are used the table values provided in the datasheet
-   //PIC32MX Family Reference Manual, DS61107E-pages 21-14 and following
- 	switch(br) {
-        case 115200:
-            U1ABRG=21; 
-            U1AMODEbits.BRGH = 0;
-            break;
-            
-        case 9600:
-            U1ABRG=259; 
-            U1AMODEbits.BRGH = 0;
-            break;
-        default:
-            return UART_BR_NOT_SUP; // Baudrate not supported
-    }
+    UartBrg_t brg;
+
+    if(UartCalcBrg(pbclock, br, &brg) != UART_SUCCESS || labs(brg.error) > UART_MAX_BR_ERROR)
+        return UART_BR_NOT_SUP; // Baudrate not supported
+
+    U1ABRG = brg.brg;
+    U1AMODEbits.BRGH = brg.brgh;
+
+#ifdef UART_DMA_TX_CHANNEL
+    // One byte to U1ATXREG on each TX event, interrupt at the end of the block
+    DMACONSET = _DMACON_ON_MASK;
+    UART_DMA_REG(CONCLR) = _DCH0CON_CHEN_MASK;
+    UART_DMA_REG(CON) = 0; // Lowest priority, no auto enable
+    UART_DMA_REG(ECON) = (_UART1_TX_IRQ << _DCH0ECON_CHSIRQ_POSITION) | _DCH0ECON_SIRQEN_MASK;
+    UART_DMA_REG(DSA) = KVA_TO_PA(&U1ATXREG);
+    UART_DMA_REG(DSIZ) = 1;
+    UART_DMA_REG(CSIZ) = 1;
+    UART_DMA_REG(INT) = _DCH0INT_CHBCIE_MASK;
+    IFS1CLR = UART_DMA_IF_MASK;
+    IEC1SET = UART_DMA_IF_MASK;
+#endif
     
     // Common configuration settings
     U1AMODEbits.SIDL=0; // Continue operation in idle mode 
@@ -158,6 +233,254 @@ void PrintStr(uint8_t *txStr)
         PutChar(*(txStr++));
 }
 
+/********************************************************************
+* Function: 	UartBufferedInit()
+* Precondition: UartInit() called. UART1 interrupt priority set in IPC6,
+*               at or below configMAX_SYSCALL_INTERRUPT_PRIORITY, and the
+*               UART1 vector calls UartInterruptHandler().
+* Input: 		txSize - TX ring size in bytes
+*               rxSize - RX ring size in bytes, 0 leaves RX to the
+*                        application (U1RXIE is not touched)
+* Returns:      UART_SUCCESS if Ok.
+*               UART_NO_MEMORY if the rings could not be allocated.
+* Side Effects:	printf() output goes through the TX ring when called
+*               from a task. PutChar()/GetChar() are still polled.
+* Overview:     Switches the UART to interrupt driven operation.
+* Note:		 	TX interrupts when the hardware FIFO is empty, so each
+*               interrupt refills all 8 positions. RX interrupts on each
+*               byte, since there is no RX timeout to flush a partially
+*               filled FIFO, and the ISR drains the whole FIFO.
+********************************************************************/
+int UartBufferedInit(size_t txSize, size_t rxSize)
+{
+    xTxRing = xStreamBufferCreate(txSize, 1);
+    xTxMutex = xSemaphoreCreateMutex();
+    if(xTxRing == NULL || xTxMutex == NULL)
+        return UART_NO_MEMORY;
+
+    IEC0CLR = _IEC0_U1TXIE_MASK;
+    U1STAbits.UTXISEL = 2; // Interrupt when the TX FIFO becomes empty
+    IFS0CLR = _IFS0_U1TXIF_MASK;
+
+    if(rxSize > 0) {
+        xRxRing = xStreamBufferCreate(rxSize, 1);
+        if(xRxRing == NULL)
+            return UART_NO_MEMORY;
+
+        U1STAbits.URXISEL = 0; // Interrupt when a byte is received
+        IFS0CLR = _IFS0_U1RXIF_MASK;
+        IEC0SET = _IEC0_U1RXIE_MASK;
+    }
+
+    return UART_SUCCESS;
+}
+
+/********************************************************************
+* Function: 	UartWrite()
+* Precondition: UartBufferedInit() called. Task context only.
+* Input: 		data, len - Bytes to send
+*               xTicksToWait - Time to wait for ring space, 0 to only
+*               copy what fits (non-blocking)
+* Returns:      Number of bytes queued for transmission.
+* Side Effects:	None.
+* Overview:     Copies data to the TX ring and starts the transmitter.
+* Note:		 	Can be called from several tasks.
+********************************************************************/
+size_t UartWrite(const uint8_t *data, size_t len, TickType_t xTicksToWait)
+{
+    size_t sent = 0;
+    size_t chunk;
+
+    if(xSemaphoreTake(xTxMutex, xTicksToWait) != pdTRUE)
+        return 0;
+
+    do {
+        chunk = xStreamBufferSend(xTxRing, data + sent, len - sent, xTicksToWait);
+        sent += chunk;
+#ifdef UART_DMA_TX_CHANNEL
+        if(!dmaBusy) // Otherwise started at the end of the DMA transfer
+#endif
+        IEC0SET = _IEC0_U1TXIE_MASK; // ISR drains the ring, FIFO empty keeps U1TXIF set
+    } while(sent < len && chunk > 0 && xTicksToWait > 0); // Longer than the ring, or timeout
+
+    xSemaphoreGive(xTxMutex);
+    return sent;
+}
+
+/********************************************************************
+* Function: 	UartRead()
+* Precondition: UartBufferedInit() called with rxSize > 0. Task context,
+*               a single reader task.
+* Input: 		data, len - Where to store up to len bytes
+*               xTicksToWait - Time to wait for the first byte, 0 to
+*               return immediately (non-blocking)
+* Returns:      Number of bytes read, 0 on timeout.
+* Side Effects:	None.
+* Overview:     Gets the bytes already received, without waiting for
+*               len of them.
+* Note:		 	None.
+********************************************************************/
+size_t UartRead(uint8_t *data, size_t len, TickType_t xTicksToWait)
+{
+    if(xRxRing == NULL)
+        return 0;
+
+    return xStreamBufferReceive(xRxRing, data, len, xTicksToWait);
+}
+
+/********************************************************************
+* Function: 	UartInterruptHandler()
+* Precondition: UartBufferedInit() called
+* Input: 		pxHigherPriorityTaskWoken - Set to pdTRUE if a task
+*               waiting on a ring was woken
+* Output:		None
+* Side Effects:	Clears U1TXIF, and U1RXIF if the RX ring is used.
+* Overview:     Refills the TX FIFO from the TX ring, disabling the TX
+*               interrupt when the ring is empty, and drains the RX FIFO
+*               into the RX ring.
+* Note:		 	To be called from the UART1 ISR. The caller must end
+*               with portEND_SWITCHING_ISR().
+********************************************************************/
+void UartInterruptHandler(BaseType_t *pxHigherPriorityTaskWoken)
+{
+    uint8_t byte;
+    uint8_t rxBytes[8];
+    uint8_t rxCount = 0;
+
+    if(IEC0bits.U1TXIE && IFS0bits.U1TXIF) {
+        while(!U1STAbits.UTXBF) {
+            if(xStreamBufferReceiveFromISR(xTxRing, &byte, 1, pxHigherPriorityTaskWoken) == 0) {
+                IEC0CLR = _IEC0_U1TXIE_MASK; // Nothing else to send
+                break;
+            }
+            U1ATXREG = byte;
+        }
+        IFS0CLR = _IFS0_U1TXIF_MASK;
+    }
+
+    if(xRxRing != NULL && IFS0bits.U1RXIF) {
+        if(U1STAbits.OERR ||U1STAbits.FERR || U1STAbits.PERR) // receive errors?
+        {
+            (void)U1RXREG;          // dummy read to clear FERR/PERR
+            U1STAbits.OERR = 0;     // clear OERR to keep receiving
+        }
+        while(U1STAbits.URXDA && rxCount < sizeof(rxBytes))
+            rxBytes[rxCount++] = U1ARXREG;
+        IFS0CLR = _IFS0_U1RXIF_MASK;
+
+        xStreamBufferSendFromISR(xRxRing, rxBytes, rxCount, pxHigherPriorityTaskWoken); // Dropped if the reader is too slow
+    }
+}
+
+#ifdef UART_DMA_TX_CHANNEL
+/********************************************************************
+* Function: 	UartWriteDMA()
+* Precondition: UartInit() called. DMA channel UART_DMA_TX_CHANNEL
+*               interrupt priority set and routed to
+*               UartDMAInterruptHandler(). Task context.
+* Input: 		data, len - Buffer to send, must not be changed until
+*               the transfer is done
+*               notify - Task notified (xTaskNotifyGive) when done, or NULL
+* Returns:      UART_SUCCESS if the transfer started.
+*               UART_BUSY if a DMA transfer or the TX ring is still sending.
+*               UART_FAIL if len is 0.
+* Side Effects:	Holds back the TX ring until the transfer is done.
+* Overview:     Sends a buffer without copying it and without CPU
+*               intervention, one byte per UART TX event.
+* Note:		 	UartDMABusy() can be polled instead of the notification.
+********************************************************************/
+int UartWriteDMA(const uint8_t *data, uint16_t len, TaskHandle_t notify)
+{
+    if(len == 0)
+        return UART_FAIL;
+
+    taskENTER_CRITICAL();
+    if(dmaBusy || (xTxRing != NULL && !xStreamBufferIsEmpty(xTxRing))) {
+        taskEXIT_CRITICAL();
+        return UART_BUSY;
+    }
+    dmaBusy = 1;
+    taskEXIT_CRITICAL();
+
+    dmaNotify = notify;
+    IEC0CLR = _IEC0_U1TXIE_MASK; // TX ring waits for the DMA
+    dmaTxisel = U1STAbits.UTXISEL;
+    U1STAbits.UTXISEL = 0; // TX event whenever a FIFO position frees
+
+    UART_DMA_REG(SSA) = KVA_TO_PA(data);
+    UART_DMA_REG(SSIZ) = len;
+    UART_DMA_REG(INTCLR) = 0xFF; // Clear event flags
+    UART_DMA_REG(CONSET) = _DCH0CON_CHEN_MASK;
+    UART_DMA_REG(ECONSET) = _DCH0ECON_CFORCE_MASK; // First byte, the next ones follow the TX events
+
+    return UART_SUCCESS;
+}
+
+/********************************************************************
+* Function: 	UartDMABusy()
+* Precondition: UartInit() called
+* Input: 		None
+* Returns:      1 while an UartWriteDMA() buffer is being sent, 0 otherwise.
+* Side Effects:	None.
+* Overview:     Transfer status.
+* Note:		 	None.
+********************************************************************/
+int UartDMABusy(void)
+{
+    return dmaBusy;
+}
+
+/********************************************************************
+* Function: 	UartDMAInterruptHandler()
+* Precondition: UartWriteDMA() called
+* Input: 		pxHigherPriorityTaskWoken - Set to pdTRUE if the notified
+*               task has a higher priority than the interrupted one
+* Output:		None
+* Side Effects:	Clears the DMA channel interrupt flag.
+* Overview:     Ends the transfer, notifies the task and lets the TX
+*               ring send again.
+* Note:		 	To be called from the DMA channel ISR. The caller must end
+*               with portEND_SWITCHING_ISR(). The last bytes are still in
+*               the UART FIFO, but the buffer can already be reused.
+********************************************************************/
+void UartDMAInterruptHandler(BaseType_t *pxHigherPriorityTaskWoken)
+{
+    UART_DMA_REG(INTCLR) = _DCH0INT_CHBCIF_MASK;
+    IFS1CLR = UART_DMA_IF_MASK;
+
+    U1STAbits.UTXISEL = dmaTxisel;
+    dmaBusy = 0;
+    if(xTxRing != NULL)
+        IEC0SET = _IEC0_U1TXIE_MASK; // Send what was written meanwhile, disables itself if empty
+
+    if(dmaNotify != NULL)
+        vTaskNotifyGiveFromISR(dmaNotify, pxHigherPriorityTaskWoken);
+}
+#endif
+
+/********************************************************************
+* Function: 	_mon_putc()
+* Precondition: None
+* Input: 		Character
+* Output:		None
+* Side Effects:	None.
+* Overview:     stdout hook of the XC32 libc. Goes through the TX ring
+*               when buffered mode is on and it is called from a task,
+*               otherwise (ISR, critical section, before the scheduler
+*               starts) the character is sent with PutChar().
+* Note:		 	Replaces the default one selected with __XC_UART.
+********************************************************************/
+void _mon_putc(char c)
+{
+    uint8_t byte = (uint8_t)c;
+
+    if(xTxRing != NULL && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING &&
+       (_CP0_GET_STATUS() & _CP0_STATUS_IPL_MASK) == 0)
+        UartWrite(&byte, 1, portMAX_DELAY);
+    else
+        PutChar(byte);
+}
+
 /***************************************End Of File*************************************/
 
 
@@ -15,25 +15,59 @@
  * Revisions:
  *      2017-10-25: initial release
  *      2019-01-28: update to MPLAB X IDE v5.\0 + XC32 v2.15
+ *      2021-07-05: interrupt driven TX/RX rings (FreeRTOS stream buffers)
+ *      2021-07-12: any PBCLOCK/baudrate, BRG and BRGH computed
+ *      2021-07-19: DMA transmit, enabled with UART_DMA_TX_CHANNEL
  */
 
 #ifndef __UART_H__
 #define __UART_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "task.h"
 
 // Define return codes
 #define UART_SUCCESS 0
 #define UART_FAIL -1;
 #define UART_BR_NOT_SUP -2
 #define UART_PBCLOCK_NOT_SUP -3
+#define UART_NO_MEMORY -4
+#define UART_BUSY -5
+
+#define UART_MAX_BR_ERROR 20000 // Max baudrate error accepted by UartInit, ppm (2%)
+
+// Baudrate generator setting
+typedef struct {
+    uint16_t brg;   // UxBRG
+    uint8_t brgh;   // UxMODE.BRGH, 1: 4x clock, 0: 16x clock
+    uint32_t br;    // Achieved baudrate
+    int32_t error;  // (br - requested)/requested, ppm
+} UartBrg_t;
 
 // Define prototypes (public interface)
+int UartCalcBrg(uint64_t pbclock, uint32_t br, UartBrg_t *brg);
 int UartInit(uint64_t pbclock, uint32_t br);
 int UartClose(void);
 int GetChar(uint8_t *byte);
 void PutChar(uint8_t txChar);
 void PrintStr(uint8_t *txStr);
 
+// Buffered (interrupt driven) interface
+int UartBufferedInit(size_t txSize, size_t rxSize);
+size_t UartWrite(const uint8_t *data, size_t len, TickType_t xTicksToWait);
+size_t UartRead(uint8_t *data, size_t len, TickType_t xTicksToWait);
+void UartInterruptHandler(BaseType_t *pxHigherPriorityTaskWoken);
+
+// DMA transmit interface. Enabled per project by defining UART_DMA_TX_CHANNEL
+// (0-7) in the compiler preprocessor macros. The project routes the DMA
+// channel vector to UartDMAInterruptHandler().
+#ifdef UART_DMA_TX_CHANNEL
+int UartWriteDMA(const uint8_t *data, uint16_t len, TaskHandle_t notify);
+int UartDMABusy(void);
+void UartDMAInterruptHandler(BaseType_t *pxHigherPriorityTaskWoken);
+#endif
+
 
 #endif